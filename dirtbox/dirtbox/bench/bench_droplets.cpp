@@ -0,0 +1,97 @@
+// times the droplet model at every SIMD level on one thread and then for thread pools of
+// growing size, and checks that the state hashes match. Reports droplets per second per core,
+// the number to size droplet jobs with.
+//
+// usage: bench_droplets [size] [droplets] [max threads]
+#include <terrain/droplet_cpu.h>
+#include <terrain/erosion_kernels.h>
+#include <util/thread_pool.h>
+
+#include <cmath>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+using namespace dirtbox::terrain;
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+std::vector<float> make_terrain(int w, int h) {
+    std::vector<float> rgba((std::size_t)w * h * 4, 0.0f);
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            float e = 0;
+            float amp = 0.5f;
+            float freq = 4.0f / w;
+            for (int o = 0; o < 5; ++o, amp *= 0.5f, freq *= 2.0f)
+                e += amp * std::sin(x * freq * 6.283f + o) * std::cos(y * freq * 6.283f + 2 * o);
+            rgba[4 * ((std::size_t)y * w + x)] = 1.0f + e;
+        }
+    }
+    return rgba;
+}
+
+struct Result {
+    double seconds;
+    uint64_t moves;
+    uint64_t hash;
+};
+
+Result run(const std::vector<float>& input, int size, float droplets, util::ThreadPool& pool, SimdLevel level) {
+    DropletParameters params;
+    params.droplets = droplets;
+    DropletModelCPU model{params, 30.0f, 100.0f};
+    model.setThreadPool(pool);
+    model.setSimdLevel(level);
+    model.init(size, size, input.data());
+    const auto start = clock_type::now();
+    while (model.getIteration() < model.getBatches())
+        model.step();
+    const double seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+    return {seconds, model.getMoves(), model.getStateHash()};
+}
+
+}
+
+int main(int argc, char** argv) {
+    const int size = argc > 1 ? std::atoi(argv[1]) : 1024;
+    const float droplets = argc > 2 ? (float)std::atof(argv[2]) : 1000000.0f;
+    const unsigned int max_threads = argc > 3 ? std::atoi(argv[3]) : std::max(1u, std::thread::hardware_concurrency());
+    if (size < 2 || droplets <= 0 || max_threads == 0) {
+        std::fprintf(stderr, "usage: %s [size] [droplets] [max threads]\n", argv[0]);
+        return 1;
+    }
+
+    const std::vector<float> input = make_terrain(size, size);
+    std::printf("%dx%d, %.0f droplets\n", size, size, droplets);
+
+    bool match = true;
+    uint64_t reference = 0;
+    {
+        util::ThreadPool pool{0};
+        for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::SSE41, SimdLevel::AVX2}) {
+            if (level > detectSimdLevel())
+                continue;
+            const Result r = run(input, size, droplets, pool, level);
+            if (level == SimdLevel::Scalar)
+                reference = r.hash;
+            match = match && r.hash == reference;
+            std::printf("%-8s  1 thread   %8.1f ms  %7.2f M droplets/s per core  %7.1f M moves/s  %016llx %s\n", toString(level), r.seconds * 1e3,
+                droplets / r.seconds * 1e-6, r.moves / r.seconds * 1e-6, (unsigned long long)r.hash, r.hash == reference ? "" : "MISMATCH");
+        }
+    }
+
+    for (unsigned int threads = 2; threads <= max_threads; threads *= 2) {
+        util::ThreadPool pool{threads - 1};
+        const Result r = run(input, size, droplets, pool, detectSimdLevel());
+        match = match && r.hash == reference;
+        std::printf("%-8s %2u threads  %8.1f ms  %7.2f M droplets/s per core  %7.1f M moves/s  %016llx %s\n", toString(detectSimdLevel()), threads, r.seconds * 1e3,
+            droplets / r.seconds / threads * 1e-6, r.moves / r.seconds * 1e-6, (unsigned long long)r.hash, r.hash == reference ? "" : "MISMATCH");
+    }
+    return match ? 0 : 1;
+}
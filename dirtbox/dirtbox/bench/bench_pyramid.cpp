@@ -0,0 +1,106 @@
+// compares the coarse to fine Erosion2 schedule with a flat full resolution run. A long flat run
+// is the converged reference; convergence is the mean absolute elevation difference to it. The
+// flat run is stepped until it is as close to the reference as the pyramid result and the wall
+// clock times to get there are reported.
+//
+// usage: bench_pyramid [size] [pyramid iterations] [reference iterations]
+#include <terrain/erosion_model2_cpu.h>
+#include <terrain/erosion_pyramid_cpu.h>
+
+#include <cmath>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace dirtbox::terrain;
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+std::vector<float> make_terrain(int w, int h) {
+    std::vector<float> rgba((std::size_t)w * h * 4, 0.0f);
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            float e = 0;
+            float amp = 0.5f;
+            float freq = 4.0f / w;
+            for (int o = 0; o < 5; ++o, amp *= 0.5f, freq *= 2.0f)
+                e += amp * std::sin(x * freq * 6.283f + o) * std::cos(y * freq * 6.283f + 2 * o);
+            rgba[4 * ((std::size_t)y * w + x)] = 1.0f + e;
+        }
+    }
+    return rgba;
+}
+
+float mean_abs_diff(const std::vector<float>& a, const std::vector<float>& b) {
+    double sum = 0;
+    for (std::size_t i = 0; i < a.size(); i += 4)
+        sum += std::abs((a[i] + a[i + 1]) - (b[i] + b[i + 1]));
+    return sum / (a.size() / 4);
+}
+
+}
+
+int main(int argc, char** argv) {
+    const int size = argc > 1 ? std::atoi(argv[1]) : 512;
+    const int iterations = argc > 2 ? std::atoi(argv[2]) : 500;
+    const int reference_iterations = argc > 3 ? std::atoi(argv[3]) : 4 * iterations;
+    if (size <= 0 || iterations <= 0 || reference_iterations < iterations) {
+        std::fprintf(stderr, "usage: %s [size] [pyramid iterations] [reference iterations]\n", argv[0]);
+        return 1;
+    }
+
+    Erosion2Parameters params;
+    params.iterations = iterations;
+    const Erosion2PyramidParameters pyramid;
+    const std::vector<float> input = make_terrain(size, size);
+
+    // converged reference
+    std::vector<float> reference = input;
+    {
+        Erosion2ModelCPU model{params};
+        model.init(size, size, reference.data());
+        for (int i = 0; i < reference_iterations; ++i)
+            model.step();
+        model.copyTo(reference.data());
+    }
+    const float initial_error = mean_abs_diff(input, reference);
+
+    // pyramid
+    std::vector<float> result = input;
+    Erosion2PyramidCPU pyr{params, pyramid};
+    const auto pyr_start = clock_type::now();
+    pyr.run(size, size, result.data());
+    const double pyr_seconds = std::chrono::duration<double>(clock_type::now() - pyr_start).count();
+    const float pyr_error = mean_abs_diff(result, reference);
+
+    std::printf("%dx%d, reference %d iterations, initial error %.5f\n", size, size, reference_iterations, initial_error);
+    for (const auto& l : pyr.getLevels())
+        std::printf("  level 1/%d %4dx%-4d %6d iterations %8.3f s\n", l.factor, l.width, l.height, l.iterations, l.seconds);
+    std::printf("pyramid  %8.3f s error %.5f\n", pyr_seconds, pyr_error);
+
+    // flat run until it matches the pyramid error, only stepping is timed
+    std::vector<float> flat = input;
+    Erosion2ModelCPU model{params};
+    model.init(size, size, flat.data());
+    double flat_seconds = 0;
+    float flat_error = initial_error;
+    int flat_iterations = 0;
+    constexpr int CheckEvery = 10;
+    while (flat_error > pyr_error && flat_iterations < reference_iterations) {
+        const auto start = clock_type::now();
+        for (int i = 0; i < CheckEvery; ++i)
+            model.step();
+        flat_seconds += std::chrono::duration<double>(clock_type::now() - start).count();
+        flat_iterations += CheckEvery;
+        model.copyTo(flat.data());
+        flat_error = mean_abs_diff(flat, reference);
+    }
+
+    std::printf("flat     %8.3f s error %.5f after %d iterations%s\n", flat_seconds, flat_error, flat_iterations,
+        flat_error > pyr_error ? " (did not reach the pyramid error)" : "");
+    std::printf("wall clock saving %.1f%% (%.2fx)\n", 100.0 * (1.0 - pyr_seconds / flat_seconds), flat_seconds / pyr_seconds);
+    return 0;
+}
@@ -0,0 +1,89 @@
+// compares Erosion2 with sparse active tiles to the dense update. The terrain is a mountain range
+// on one side of a flat plain, so most tiles become stable. Reports the share of skipped tile
+// updates, the wall clock times and the elevation error of the sparse run.
+//
+// usage: bench_sparse [size] [iterations] [activity threshold]
+#include <terrain/erosion_model2_cpu.h>
+
+#include <cmath>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <algorithm>
+
+using namespace dirtbox::terrain;
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+std::vector<float> make_terrain(int w, int h) {
+    std::vector<float> rgba((std::size_t)w * h * 4, 0.0f);
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            // ridges fade out over the first quarter of the map
+            const float fade = std::clamp(1.0f - 4.0f * x / w, 0.0f, 1.0f);
+            float e = 0;
+            float amp = 0.5f;
+            float freq = 4.0f / w;
+            for (int o = 0; o < 5; ++o, amp *= 0.5f, freq *= 2.0f)
+                e += amp * std::sin(x * freq * 6.283f + o) * std::cos(y * freq * 6.283f + 2 * o);
+            rgba[4 * ((std::size_t)y * w + x)] = 1.0f + fade * e;
+        }
+    }
+    return rgba;
+}
+
+double run(Erosion2ModelCPU& model, int size, int iterations, std::vector<float>& rgba) {
+    model.init(size, size, rgba.data());
+    const auto start = clock_type::now();
+    for (int i = 0; i < iterations; ++i)
+        model.step();
+    const double seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+    model.copyTo(rgba.data());
+    return seconds;
+}
+
+}
+
+int main(int argc, char** argv) {
+    const int size = argc > 1 ? std::atoi(argv[1]) : 512;
+    const int iterations = argc > 2 ? std::atoi(argv[2]) : 500;
+    const float threshold = argc > 3 ? std::atof(argv[3]) : 1e-4f;
+    if (size <= 0 || iterations <= 0 || threshold <= 0) {
+        std::fprintf(stderr, "usage: %s [size] [iterations] [activity threshold]\n", argv[0]);
+        return 1;
+    }
+
+    Erosion2Parameters params;
+    const std::vector<float> input = make_terrain(size, size);
+
+    std::vector<float> dense = input;
+    Erosion2ModelCPU dense_model{params};
+    const double dense_seconds = run(dense_model, size, iterations, dense);
+
+    params.activity_threshold = threshold;
+    std::vector<float> sparse = input;
+    Erosion2ModelCPU sparse_model{params};
+    const double sparse_seconds = run(sparse_model, size, iterations, sparse);
+
+    double sum = 0, eroded = 0;
+    float max_error = 0;
+    for (std::size_t i = 0; i < input.size(); i += 4) {
+        const float e = std::abs((dense[i] + dense[i + 1]) - (sparse[i] + sparse[i + 1]));
+        sum += e;
+        eroded += std::abs((dense[i] + dense[i + 1]) - (input[i] + input[i + 1]));
+        max_error = std::max(max_error, e);
+    }
+
+    const double updates = (double)sparse_model.getNumTiles() * iterations;
+    std::printf("%dx%d, %d iterations, %d tiles of %d cells, threshold %g\n", size, size, iterations,
+        sparse_model.getNumTiles(), Erosion2ModelCPU::TileSize, threshold);
+    std::printf("dense  %8.3f s\n", dense_seconds);
+    std::printf("sparse %8.3f s, skipped %.1f%% of tile updates, %d active at the end\n", sparse_seconds,
+        100.0 * sparse_model.getSkippedTiles() / updates, sparse_model.getActiveTiles());
+    std::printf("speedup %.2fx, elevation error mean %.6f max %.6f, mean dense elevation change %.6f\n",
+        dense_seconds / sparse_seconds, sum / (input.size() / 4), max_error, eroded / (input.size() / 4));
+    return 0;
+}
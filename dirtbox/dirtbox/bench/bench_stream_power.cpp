@@ -0,0 +1,93 @@
+// times the implicit stream power solver against a step of the Erosion2 pipe model on the same
+// terrain. Reports the depression fill, the time per sweep for thread pools of growing size and
+// the largest drainage area, which shows how far the drainage network has organized.
+//
+// usage: bench_stream_power [size] [sweeps] [max threads]
+#include <terrain/stream_power_cpu.h>
+#include <terrain/erosion_model2_cpu.h>
+#include <util/thread_pool.h>
+
+#include <cmath>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+using namespace dirtbox::terrain;
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+std::vector<float> make_terrain(int w, int h) {
+    std::vector<float> rgba((std::size_t)w * h * 4, 0.0f);
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            float e = 0;
+            float amp = 0.5f;
+            float freq = 4.0f / w;
+            for (int o = 0; o < 5; ++o, amp *= 0.5f, freq *= 2.0f)
+                e += amp * std::sin(x * freq * 6.283f + o) * std::cos(y * freq * 6.283f + 2 * o);
+            rgba[4 * ((std::size_t)y * w + x)] = 1.0f + e;
+        }
+    }
+    return rgba;
+}
+
+double seconds_since(clock_type::time_point start) {
+    return std::chrono::duration<double>(clock_type::now() - start).count();
+}
+
+}
+
+int main(int argc, char** argv) {
+    const int size = argc > 1 ? std::atoi(argv[1]) : 1024;
+    const int sweeps = argc > 2 ? std::atoi(argv[2]) : 40;
+    const unsigned int max_threads = argc > 3 ? std::atoi(argv[3]) : std::max(1u, std::thread::hardware_concurrency());
+    if (size <= 0 || sweeps <= 0 || max_threads == 0) {
+        std::fprintf(stderr, "usage: %s [size] [sweeps] [max threads]\n", argv[0]);
+        return 1;
+    }
+
+    const std::vector<float> input = make_terrain(size, size);
+    const Erosion2Parameters pipe_params;
+    const float cell_area = pipe_params.cell_size * pipe_params.cell_size;
+    std::printf("%dx%d, %d sweeps\n", size, size, sweeps);
+
+    for (unsigned int threads = 1; threads <= max_threads; threads *= 2) {
+        util::ThreadPool pool{threads - 1};
+        StreamPowerModelCPU model{StreamPowerParameters{}, pipe_params.cell_size, pipe_params.terrain_elevation_scale};
+        model.setThreadPool(pool);
+
+        const auto init_start = clock_type::now();
+        model.init(size, size, input.data());
+        const double init_seconds = seconds_since(init_start);
+
+        const auto start = clock_type::now();
+        for (int i = 0; i < sweeps; ++i)
+            model.step();
+        const double seconds = seconds_since(start);
+
+        const StreamPowerGrid& state = model.getState();
+        float largest = 0;
+        for (int y = 0; y < size; ++y)
+            for (int x = 0; x < size; ++x)
+                largest = std::max(largest, state.at(StreamPowerField::Area, x, y));
+
+        std::printf("%3u threads  init %8.1f ms (%llu cells filled)  %8.2f ms/sweep  %8.1f ms total  %zu basins  largest %.0f cells  %016llx\n",
+            threads, init_seconds * 1e3, (unsigned long long)model.getFilledCells(), seconds * 1e3 / sweeps, (init_seconds + seconds) * 1e3,
+            model.getBasins(), largest / cell_area, (unsigned long long)model.getStateHash());
+    }
+
+    // one pipe model step moves water about one cell, continental drainage needs many thousands
+    Erosion2ModelCPU pipe{pipe_params};
+    pipe.init(size, size, input.data());
+    const int pipe_steps = 10;
+    const auto pipe_start = clock_type::now();
+    for (int i = 0; i < pipe_steps; ++i)
+        pipe.step();
+    std::printf("pipe model  %8.2f ms/step\n", seconds_since(pipe_start) * 1e3 / pipe_steps);
+    return 0;
+}
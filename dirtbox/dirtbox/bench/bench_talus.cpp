@@ -0,0 +1,145 @@
+// microbenchmark for the standalone thermal pass. Runs the talus kernels at every SimdLevel
+// supported by this CPU on one thread against the scalar reference, then times
+// Erosion2ModelCPU::thermalStep against a full step.
+//
+// usage: bench_talus [width] [height] [iterations]
+#include <terrain/erosion_kernels.h>
+#include <terrain/erosion_model2_cpu.h>
+#include <terrain/soa_grid.h>
+#include <util/thread_pool.h>
+
+#include <cmath>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using namespace dirtbox::terrain;
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+enum class BenchField : uint8_t {
+    Rock,
+    Water,
+    Hardness,
+    Flow0, Flow1, Flow2, Flow3, Flow4, Flow5, Flow6, Flow7,
+    Count
+};
+
+using BenchGrid = SoAGrid<BenchField>;
+
+// steep ridges so most cells shed soil
+float ridge(int x, int y) {
+    return 40 + 30 * std::sin(x * 0.21f) * std::cos(y * 0.17f) + 5 * std::sin((x + 3 * y) * 0.9f);
+}
+
+void init_grid(BenchGrid& grid, int w, int h) {
+    grid.resize(w, h);
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            grid.at(BenchField::Rock, x, y) = ridge(x, y);
+            grid.at(BenchField::Water, x, y) = 0.1f + 0.1f * std::sin((x - y) * 0.3f);
+            grid.at(BenchField::Hardness, x, y) = 0.05f + 0.05f * std::cos(x * 0.07f);
+        }
+    }
+}
+
+TalusKernelArgs make_args(BenchGrid& grid) {
+    TalusKernelArgs a{};
+    a.rock = grid.data(BenchField::Rock);
+    a.water = grid.data(BenchField::Water);
+    a.hardness = grid.data(BenchField::Hardness);
+    for (int d = 0; d < 8; ++d)
+        a.flows[d] = grid.data(static_cast<BenchField>(static_cast<int>(BenchField::Flow0) + d));
+    a.rock_out = grid.data(BenchField::Rock);
+    a.width = grid.getWidth();
+    a.height = grid.getHeight();
+    a.stride = grid.getStride();
+    // Erosion2Parameters defaults with a small cell so the slopes pass the talus angle
+    a.cell_size = 1.0f;
+    a.time_step = 1.0f;
+    a.thermal_erosion_rate = 0.15f;
+    a.talus_angle_tangent_coef = 0.8f;
+    a.talus_angle_tangent_bias = 0.1f;
+    a.min_hardness = 0.05f;
+    a.max_hardness = 0.1f;
+    return a;
+}
+
+// returns seconds per pass
+double run(BenchGrid& grid, SimdLevel level, int iterations) {
+    const TalusKernelArgs args = make_args(grid);
+    const auto start = clock_type::now();
+    for (int i = 0; i < iterations; ++i) {
+        computeTalusFlows(args, 0, args.height, level);
+        applyTalusFlows(args, 0, args.height, level);
+    }
+    return std::chrono::duration<double>(clock_type::now() - start).count() / iterations;
+}
+
+double seconds_since(clock_type::time_point start) {
+    return std::chrono::duration<double>(clock_type::now() - start).count();
+}
+
+}
+
+int main(int argc, char** argv) {
+    const int w = argc > 1 ? std::atoi(argv[1]) : 1024;
+    const int h = argc > 2 ? std::atoi(argv[2]) : 1024;
+    const int iterations = argc > 3 ? std::atoi(argv[3]) : 50;
+    if (w <= 0 || h <= 0 || iterations <= 0) {
+        std::fprintf(stderr, "usage: %s [width] [height] [iterations]\n", argv[0]);
+        return 1;
+    }
+
+    const SimdLevel supported = detectSimdLevel();
+    std::printf("talus kernels %dx%d, %d passes, cpu supports %s\n", w, h, iterations, toString(supported));
+
+    BenchGrid reference;
+    init_grid(reference, w, h);
+    const double scalar_time = run(reference, SimdLevel::Scalar, iterations);
+    const double cells = (double)w * h;
+    std::printf("%-8s %10.3f ms %14.0f cells/s %6.2fx\n", toString(SimdLevel::Scalar), scalar_time * 1e3, cells / scalar_time, 1.0);
+
+    int status = 0;
+    for (SimdLevel level : {SimdLevel::SSE41, SimdLevel::AVX2}) {
+        if (level > supported)
+            break;
+
+        BenchGrid grid;
+        init_grid(grid, w, h);
+        const double t = run(grid, level, iterations);
+
+        // same expressions in the same order, the rock must match the reference exactly
+        const bool match = std::memcmp(grid.data(BenchField::Rock), reference.data(BenchField::Rock), grid.getPlaneSize() * sizeof(float)) == 0;
+        if (!match)
+            status = 1;
+        std::printf("%-8s %10.3f ms %14.0f cells/s %6.2fx %s\n", toString(level), t * 1e3, cells / t, scalar_time / t, match ? "" : "MISMATCH");
+    }
+
+    // thermal passes and full steps of the model on the default pool
+    std::vector<float> rgba((std::size_t)w * h * 4, 0.0f);
+    for (int y = 0; y < h; ++y)
+        for (int x = 0; x < w; ++x)
+            rgba[4 * ((std::size_t)y * w + x)] = ridge(x, y) / 100;
+    Erosion2Parameters params;
+    params.cell_size = 1.0f;
+    Erosion2ModelCPU model{params};
+    model.init(w, h, rgba.data());
+
+    const auto thermal_start = clock_type::now();
+    for (int i = 0; i < iterations; ++i)
+        model.thermalStep(1.0f);
+    const double thermal_seconds = seconds_since(thermal_start) / iterations;
+
+    const int steps = std::max(1, iterations / 10);
+    const auto step_start = clock_type::now();
+    for (int i = 0; i < steps; ++i)
+        model.step();
+    const double step_seconds = seconds_since(step_start) / steps;
+    std::printf("thermal pass %8.3f ms, step %8.3f ms, %.1f passes per step\n", thermal_seconds * 1e3, step_seconds * 1e3, step_seconds / thermal_seconds);
+    return status;
+}
@@ -0,0 +1,73 @@
+// runs the CPU erosion models on a synthetic terrain with thread pools of different sizes and
+// checks that the state hashes match.
+//
+// usage: check_determinism [size] [iterations] [max threads]
+#include <terrain/erosion_model2_cpu.h>
+#include <terrain/etes_model_cpu.h>
+#include <terrain/stream_power_cpu.h>
+#include <terrain/droplet_cpu.h>
+#include <util/thread_pool.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+using namespace dirtbox::terrain;
+
+namespace {
+
+std::vector<float> make_terrain(int w, int h) {
+    std::vector<float> rgba((std::size_t)w * h * 4, 0.0f);
+    for (int y = 0; y < h; ++y)
+        for (int x = 0; x < w; ++x)
+            rgba[4 * ((std::size_t)y * w + x)] = 0.5f + 0.3f * std::sin(x * 0.05f) * std::cos(y * 0.04f);
+    return rgba;
+}
+
+template<typename Model>
+uint64_t run(Model& model, util::ThreadPool& pool, const std::vector<float>& terrain, int size, int iterations) {
+    model.setThreadPool(pool);
+    model.init(size, size, terrain.data());
+    for (int i = 0; i < iterations; ++i)
+        model.step();
+    return model.getStateHash();
+}
+
+template<typename MakeModel>
+bool check(const char* name, MakeModel make_model, const std::vector<float>& terrain, int size, int iterations, unsigned int max_threads) {
+    bool match = true;
+    uint64_t reference = 0;
+    for (unsigned int threads = 1; threads <= max_threads; threads *= 2) {
+        util::ThreadPool pool{threads - 1};
+        auto model = make_model();
+        const uint64_t hash = run(model, pool, terrain, size, iterations);
+        if (threads == 1)
+            reference = hash;
+        match = match && hash == reference;
+        std::printf("%-12s %3u threads %016llx %s\n", name, threads, (unsigned long long)hash, hash == reference ? "" : "MISMATCH");
+    }
+    return match;
+}
+
+}
+
+int main(int argc, char** argv) {
+    const int size = argc > 1 ? std::atoi(argv[1]) : 256;
+    const int iterations = argc > 2 ? std::atoi(argv[2]) : 20;
+    const unsigned int max_threads = argc > 3 ? std::atoi(argv[3]) : std::max(1u, std::thread::hardware_concurrency());
+    if (size <= 0 || iterations <= 0 || max_threads == 0) {
+        std::fprintf(stderr, "usage: %s [size] [iterations] [max threads]\n", argv[0]);
+        return 1;
+    }
+
+    const std::vector<float> terrain = make_terrain(size, size);
+
+    bool ok = true;
+    ok &= check("erosion2", []() {return Erosion2ModelCPU{Erosion2Parameters{}};}, terrain, size, iterations, max_threads);
+    ok &= check("etes", []() {return ETESModelCPU{ETESModelParameters{}, 1234};}, terrain, size, std::max(1, iterations / 10), max_threads);
+    ok &= check("droplets", []() {return DropletModelCPU{DropletParameters{}, 30.0f, 100.0f};}, terrain, size, iterations, max_threads);
+    ok &= check("stream_power", []() {return StreamPowerModelCPU{StreamPowerParameters{}, 30.0f, 100.0f};}, terrain, size, iterations, max_threads);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,112 @@
+// checks that incremental Erosion2 runs only take the flow state of the last full run when the
+// terrain still has its size. A run over a shrunk terrain has to start from still water and leave
+// the stored state alone, even though the old state still covers its window.
+//
+// usage: check_incremental [size] [iterations]
+#include <terrain/erosion_model2_cpu.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <utility>
+
+using namespace dirtbox::terrain;
+
+namespace {
+
+std::vector<float> make_terrain(int w, int h) {
+    std::vector<float> rgba((std::size_t)w * h * 4, 0.0f);
+    for (int y = 0; y < h; ++y)
+        for (int x = 0; x < w; ++x)
+            rgba[4 * ((std::size_t)y * w + x)] = 1.0f + 0.3f * std::sin(x * 0.11f) * std::cos(y * 0.07f);
+    return rgba;
+}
+
+IncrementalRegion make_region(int width, int height, const TerrainRegion& dirty, int margin) {
+    IncrementalRegion region;
+    region.margin = margin;
+    region.dirty = dirty.clamped(width, height);
+    region.window = region.dirty.grown(margin, width, height);
+    region.width = width;
+    region.height = height;
+    return region;
+}
+
+// out flows and velocity of the window match the terrain state at the window position
+bool window_matches(const Erosion2Grid& window, const Erosion2Grid& terrain, const TerrainRegion& w) {
+    for (auto field : {Erosion2Field::OutFlowPosX, Erosion2Field::VelocityX, Erosion2Field::Hardness})
+        for (int y = 0; y < w.height(); ++y)
+            for (int x = 0; x < w.width(); ++x)
+                if (window.at(field, x, y) != terrain.at(field, w.x0 + x, w.y0 + y))
+                    return false;
+    return true;
+}
+
+bool still_water(const Erosion2Grid& window) {
+    for (auto field : {Erosion2Field::OutFlowPosY, Erosion2Field::OutFlowPosX, Erosion2Field::OutFlowNegY, Erosion2Field::OutFlowNegX,
+                       Erosion2Field::VelocityX, Erosion2Field::VelocityY})
+        for (int y = 0; y < window.getHeight(); ++y)
+            for (int x = 0; x < window.getWidth(); ++x)
+                if (window.at(field, x, y) != 0)
+                    return false;
+    return true;
+}
+
+bool report(const char* name, bool ok) {
+    std::printf("%-40s %s\n", name, ok ? "ok" : "FAILED");
+    return ok;
+}
+
+}
+
+int main(int argc, char** argv) {
+    const int size = argc > 1 ? std::atoi(argv[1]) : 128;
+    const int iterations = argc > 2 ? std::atoi(argv[2]) : 50;
+    if (size < 32 || iterations <= 0) {
+        std::fprintf(stderr, "usage: %s [size >= 32] [iterations]\n", argv[0]);
+        return 1;
+    }
+
+    Erosion2Parameters params;
+    const std::vector<float> input = make_terrain(size, size);
+    Erosion2ModelCPU full{params};
+    full.init(size, size, input.data());
+    for (int i = 0; i < iterations; ++i)
+        full.step();
+    Erosion2Grid stored = std::as_const(full).getState();
+    const uint64_t stored_hash = stored.hash();
+
+    bool ok = true;
+    const TerrainRegion dirty{size / 4, size / 4, size / 4 + 8, size / 4 + 8};
+    {
+        // same size, the window starts from the stored flows and writes its dirty cells back
+        const IncrementalRegion region = make_region(size, size, dirty, 8);
+        const std::vector<float> window = cropRGBA(input.data(), size, region.window);
+        Erosion2ModelCPU model{params};
+        model.init(region.window.width(), region.window.height(), window.data());
+        ok &= report("same size seeds from the stored state", seedIncrementalRun(model, stored, region));
+        ok &= report("seeded window matches the stored state", window_matches(std::as_const(model).getState(), stored, region.window));
+        model.step();
+        ok &= report("same size stores the dirty cells", storeIncrementalRun(std::as_const(model), stored, region));
+    }
+    {
+        // the terrain shrank, the old state still covers the window but is at the wrong positions
+        const int shrunk = size * 3 / 4;
+        const IncrementalRegion region = make_region(shrunk, shrunk, dirty, 8);
+        const std::vector<float> shrunk_input = make_terrain(shrunk, shrunk);
+        const std::vector<float> window = cropRGBA(shrunk_input.data(), shrunk, region.window);
+        Erosion2ModelCPU model{params};
+        model.init(region.window.width(), region.window.height(), window.data());
+        Erosion2Grid before = stored;
+        ok &= report("shrunk terrain is not seeded", !seedIncrementalRun(model, stored, region));
+        ok &= report("shrunk window starts from still water", still_water(std::as_const(model).getState()));
+        model.step();
+        ok &= report("shrunk terrain is not stored", !storeIncrementalRun(std::as_const(model), stored, region));
+        ok &= report("stored state is unchanged", stored.hash() == before.hash());
+    }
+    ok &= report("full run state was not modified", std::as_const(full).getState().hash() == stored_hash);
+
+    std::printf("%s\n", ok ? "passed" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,105 @@
+// compares Erosion2 with half precision out flows, velocity and soil flows to the full precision
+// run. Both runs use the CPU model, which rounds the same values as the GPU half precision
+// textures. Reports the error of each elevation layer at four points of the run and the GPU
+// state memory of both modes.
+//
+// usage: check_precision [size] [iterations]
+#include <terrain/erosion_model2_cpu.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <algorithm>
+#include <utility>
+
+using namespace dirtbox::terrain;
+
+namespace {
+
+std::vector<float> make_terrain(int w, int h) {
+    std::vector<float> rgba((std::size_t)w * h * 4, 0.0f);
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            float e = 0;
+            float amp = 0.5f;
+            float freq = 4.0f / w;
+            for (int o = 0; o < 5; ++o, amp *= 0.5f, freq *= 2.0f)
+                e += amp * std::sin(x * freq * 6.283f + o) * std::cos(y * freq * 6.283f + 2 * o);
+            rgba[4 * ((std::size_t)y * w + x)] = 1.0f + e;
+        }
+    }
+    return rgba;
+}
+
+struct LayerError {
+    double mean = 0;
+    float max = 0;
+};
+
+LayerError compare(const Erosion2Grid& full, const Erosion2Grid& half, Erosion2Field field) {
+    LayerError e;
+    const int w = full.getWidth();
+    const int h = full.getHeight();
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            const std::size_t i = full.index(x, y);
+            const float d = std::abs(full.data(field)[i] - half.data(field)[i]);
+            e.mean += d;
+            e.max = std::max(e.max, d);
+        }
+    }
+    e.mean /= (double)w * h;
+    return e;
+}
+
+// mean absolute rock change of a run, the scale the errors are measured against
+double mean_erosion(const Erosion2Grid& state, const std::vector<float>& input, float scale) {
+    double sum = 0;
+    for (int y = 0; y < state.getHeight(); ++y)
+        for (int x = 0; x < state.getWidth(); ++x)
+            sum += std::abs(state.data(Erosion2Field::Rock)[state.index(x, y)] - input[4 * ((std::size_t)y * state.getWidth() + x)] * scale);
+    return sum / ((double)state.getWidth() * state.getHeight());
+}
+
+}
+
+int main(int argc, char** argv) {
+    const int size = argc > 1 ? std::atoi(argv[1]) : 256;
+    const int iterations = argc > 2 ? std::atoi(argv[2]) : 400;
+    if (size <= 0 || iterations < 4) {
+        std::fprintf(stderr, "usage: %s [size] [iterations >= 4]\n", argv[0]);
+        return 1;
+    }
+
+    Erosion2Parameters params;
+    const std::vector<float> input = make_terrain(size, size);
+
+    Erosion2ModelCPU full{params};
+    params.half_precision = 1;
+    Erosion2ModelCPU half{params};
+    full.init(size, size, input.data());
+    half.init(size, size, input.data());
+
+    const double cells = (double)size * size;
+    std::printf("%dx%d, %d iterations\n", size, size, iterations);
+    std::printf("GPU state: full %.1f MB, half %.1f MB\n",
+        cells * Erosion2Parameters{}.gpuStateBytesPerCell() / (1 << 20),
+        cells * params.gpuStateBytesPerCell() / (1 << 20));
+    std::printf("%10s %10s %22s %22s %22s %22s\n", "iteration", "erosion", "rock mean/max", "sand mean/max", "sediment mean/max", "water mean/max");
+
+    for (int i = 1; i <= iterations; ++i) {
+        full.step();
+        half.step();
+        if (i % (iterations / 4) != 0 && i != iterations)
+            continue;
+
+        std::printf("%10d %10.6f", i, mean_erosion(std::as_const(full).getState(), input, params.terrain_elevation_scale));
+        for (auto field : {Erosion2Field::Rock, Erosion2Field::Sand, Erosion2Field::Sediment, Erosion2Field::Water}) {
+            const LayerError e = compare(std::as_const(full).getState(), std::as_const(half).getState(), field);
+            std::printf("  %10.3g/%10.3g", e.mean, e.max);
+        }
+        std::printf("\n");
+    }
+    return 0;
+}
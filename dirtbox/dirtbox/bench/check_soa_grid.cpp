@@ -0,0 +1,52 @@
+// checks PlaneView::neighborhoodOf against at() on every cell of grids with and without row
+// padding: neighbors in Dirmap order, edge values at the border and the valid mask.
+//
+// usage: check_soa_grid
+#include <terrain/soa_grid.h>
+
+#include <cstdio>
+#include <algorithm>
+#include <utility>
+
+using namespace dirtbox::terrain;
+
+namespace {
+
+bool check(int w, int h) {
+    SoAGrid<ScalarField> grid{w, h};
+    for (int y = 0; y < h; ++y)
+        for (int x = 0; x < w; ++x)
+            grid.at(ScalarField::Value, x, y) = (float)(y * 1000 + x);
+    const PlaneView<const float> plane = std::as_const(grid).plane(ScalarField::Value);
+
+    int errors = 0;
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            const PlaneNeighborhood<float> n = plane.neighborhoodOf(x, y);
+            errors += n.center != plane.at(x, y);
+            for (int d = 0; d < 8; ++d) {
+                const int nx = x + DirmapDX[d];
+                const int ny = y + DirmapDY[d];
+                const bool inside = nx >= 0 && nx < w && ny >= 0 && ny < h;
+                const float expected = plane.at(std::clamp(nx, 0, w - 1), std::clamp(ny, 0, h - 1));
+                errors += n.isValid(d) != inside;
+                errors += n.adjacent[d] != expected;
+                // the opposite direction leads back to the cell
+                errors += DirmapDX[PlaneNeighborhood<float>::opposite(d)] != -DirmapDX[d];
+                errors += DirmapDY[PlaneNeighborhood<float>::opposite(d)] != -DirmapDY[d];
+            }
+        }
+    }
+    std::printf("%4dx%-4d stride %4d %s\n", w, h, grid.getStride(), errors == 0 ? "ok" : "FAILED");
+    return errors == 0;
+}
+
+}
+
+int main() {
+    bool ok = true;
+    for (const auto& [w, h] : {std::pair{1, 1}, {2, 3}, {16, 16}, {17, 5}, {33, 40}})
+        ok &= check(w, h);
+    std::printf("%s\n", ok ? "passed" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,25 @@
+// ETES step end, makes the scanned counts current and writes the dispatch arguments of the next
+// step. Stores the events stepped in the cycle and the live events in event_stats
+#include "bgfx_compute.sh"
+#include "cs_etes_common.sh"
+
+BUFFER_RW(event_counters,   uint,   3);
+BUFFER_RW(indirect_buffer,  uvec4,  11);
+UIMAGE2D_WR(event_stats,    r32ui,  12);
+
+NUM_THREADS(1u, 1u, 1u);
+
+void main() {
+    const uint events = event_counters[2];
+    const uint cells = event_counters[3];
+    const uint stepped = event_counters[4] + event_counters[0];
+    event_counters[0] = events;
+    event_counters[1] = cells;
+    event_counters[4] = stepped;
+
+    dispatchIndirect(indirect_buffer, 0u, (cells + CELL_GROUP - 1u) / CELL_GROUP, 1u, 1u);
+    dispatchIndirect(indirect_buffer, 1u, (events + EVENT_GROUP - 1u) / EVENT_GROUP, 1u, 1u);
+
+    imageStore(event_stats, ivec2(0, 0), uvec4(stepped, 0u, 0u, 0u));
+    imageStore(event_stats, ivec2(1, 0), uvec4(events, 0u, 0u, 0u));
+}
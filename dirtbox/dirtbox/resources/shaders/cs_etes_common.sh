@@ -21,4 +21,32 @@ uniform vec4 u_rand_offset;
 #define rock_erosion_base_value     u_params[2].z
 #define iterations                  u_params[2].w
 
-#define rainfall                    u_params[3].x
\ No newline at end of file
+#define rainfall                    u_params[3].x
+
+/*
+* event scheduling. The live events of a step are compact and grouped by cell: active_cells holds
+* the cells with events and the range of their events, event_data and event_info one entry per
+* event. A step counts the events moving into each cell, scans the counts and scatters the events
+* into the next compact arrays, so its work follows the live events and not the grid size.
+*
+* event_counters:
+*  0: live events
+*  1: active cells
+*  2: live events of the next step, from the scan
+*  3: active cells of the next step, from the scan
+*  4: events stepped since the cycle started
+*
+* active_cells
+*  x: cell index
+*  y: first event
+*  z: events
+*
+* event_info
+*  x: cell the event moves to, NO_CELL once it ended
+*  y: rank of the event among the events moving to that cell
+*  zw: exclusive scan of the group, active cell and event slot
+*/
+#define NO_CELL 0xffffffffu
+// threads of the passes with one invocation per event and per active cell
+#define EVENT_GROUP 256u
+#define CELL_GROUP 64u
@@ -1,54 +1,21 @@
+// ETES runoff step, one invocation per active cell. Runs the events of the cell one after the
+// other, then counts each event that moves on in cell_count of the cell it moves to
 #include "bgfx_compute.sh"
 #include "cs_etes_common.sh"
 
 /*
-* u_event_data for runoff
+* event_data for runoff
 * x water;
 * y sediment_humus;
 * z sediment_sand;
 * w sediment_rock;
 *
 */
-BUFFER_RW(u_event_data, vec4, 7);
-/*
-* u_event_data_2
-* x dir index
-* y 
-* z 
-* w 
-*
-*/
-BUFFER_RW(u_event_data_2, ivec4, 8);
-
-UIMAGE2D_RO(list_next_a, r32ui ,      5);
-UIMAGE2D_WR(list_next_b, r32ui ,      6);
-
-/////// GPU Linked list //////
-
-uint list_next_element(uint index, in uvec2 bounds) {
-    // index -> pos
-    ivec2 pos = ivec2(
-        index % bounds.x,
-        index / bounds.x
-    );
-    return imageLoad(list_next_a, pos).x;
-}
-
-void cellAddEvent(uint index_event, inout uvec4 cell, in uvec2 bounds) {
-    if (cell.z > 0) {
-        ivec2 pos = ivec2(
-            cell.y % bounds.x,
-            cell.y / bounds.x
-        );
-        imageStore(list_next_b, pos, uvec4(index_event)); // point old tail element to new element
-    } else { // first element in cell list, point head
-        cell.x = index_event;
-    }
-    cell.y = index_event; // point tail
-    cell.z += 1; // increment count
-}
-
-//////////////////////////////
+BUFFER_RO(active_cells,     uvec4,  2);
+BUFFER_RO(event_counters,   uint,   3);
+BUFFER_RW(cell_count,       uint,   5);
+BUFFER_RW(event_data,       vec4,   7);
+BUFFER_WR(event_info,       uvec4,  8);
 
 ///////// CELL data //////////////
 
@@ -64,17 +31,9 @@ void cellAddEvent(uint index_event, inout uvec4 cell, in uvec2 bounds) {
 *  y: 
 *  z: 
 *  w: 
-*
-* cell_data
-*  x: head index
-*  y: tail index
-*  z: num events
-*  w: 
 */
 IMAGE2D_RW(elevation_data    , rgba32f,   0);
 IMAGE2D_RW(ground_data       , rgba32f,   1);
-UIMAGE2D_RO(cell_data_a      , rgba32ui,   2);
-UIMAGE2D_WR(cell_data_b      , rgba32ui,   3);
 
 IMAGE2D_RO(rand_data,    r32f,   4);
 
@@ -113,9 +72,10 @@ float linear_min_max(float x, float min, float max) {
  * @param x 
  * @param min 
  * @param max 
+ * @param mul steepness
  * @return float [0, 1]
  */
-float logistic_between(float x, float min, float max, float mul = 1.0f) {
+float logistic_between(float x, float min, float max, float mul) {
     return sigmoid_approx(mul * linear_min_max(x, min, max));
 }
 
@@ -159,7 +119,8 @@ float getCellGranularDepth(in vec4 elevation_data) {
     return elevation_data.y + elevation_data.z + elevation_data.w;
 }
 
-float sedimentDepositionCalculation(float available_material, float s, float veg_density) {
+// deposition does not depend on the vegetation, which only holds back lift and erosion
+float sedimentDepositionCalculation(float available_material, float s) {
     float deposit = step_time_constant * (1.f - s);
     deposit *= available_material;
     deposit = min(deposit, available_material);
@@ -194,14 +155,25 @@ float sedimentLiftCalculation(float available_material, float s, float veg_densi
 * @return float    meters of erosion 
 */
 float erosion(float erosion_base, float available_material, float s, float w, float sediment_saturation, float veg_density, float granular_depth) {
-    float erosion = step_time_constant * erosion_base * logistic_between(w, 0.f, 1.f) * 
-        (s + 0.2f * logistic_between(sediment_saturation, 0.f, 1.f)) * 
-        (1.f - logistic_between(granular_depth, 0.1f, 2.f));
+    float erosion = step_time_constant * erosion_base * logistic_between(w, 0.f, 1.f, 1.f) * 
+        (s + 0.2f * logistic_between(sediment_saturation, 0.f, 1.f, 1.f)) * 
+        (1.f - logistic_between(granular_depth, 0.1f, 2.f, 1.f));
     erosion = min(available_material, erosion);
     return erosion;
 }
 
-int step_runoff(inout vec4 event_data, inout vec4 cell_elev, inout vec4 ground_data, in ivec2 pos) {
+void drop_sediment(inout vec4 event_data, inout vec4 cell_elev) {
+    cell_elev.z += event_data.z;
+    event_data.z = 0;
+
+    cell_elev.w += event_data.y;
+    event_data.y = 0;
+
+    cell_elev.y += event_data.w;
+    event_data.w = 0;
+}
+
+int step_runoff(inout vec4 event_data, inout vec4 cell_elev, inout vec4 ground_data, in ivec2 pos, float r) {
     //pick new direction
     const ivec2 bounds = ivec2(imageSize(elevation_data));
     float c_z = getCellElevation(cell_elev);
@@ -217,7 +189,7 @@ int step_runoff(inout vec4 event_data, inout vec4 cell_elev, inout vec4 ground_d
                     slopes[i] = abs(slope(c_z, n_z));
             }
     }
-    int r_dir = weighted_pick(slopes, rand(pos));
+    int r_dir = weighted_pick(slopes, r);
     if (r_dir != -1) {
         float grade = slopes[r_dir];
         float r_slope = logistic_between(grade, -4.f, 5.f, 10.0);
@@ -241,9 +213,9 @@ int step_runoff(inout vec4 event_data, inout vec4 cell_elev, inout vec4 ground_d
 
         } else {
             // sediment deposition
-            sand = -sedimentDepositionCalculation(event_data.z, r_slope, cell_vd);
-            humus = -sedimentDepositionCalculation(event_data.y, r_slope, cell_vd);
-            rock = -sedimentDepositionCalculation(event_data.w, r_slope, cell_vd);
+            sand = -sedimentDepositionCalculation(event_data.z, r_slope);
+            humus = -sedimentDepositionCalculation(event_data.y, r_slope);
+            rock = -sedimentDepositionCalculation(event_data.w, r_slope);
         }
 
         // erosion bedrock -> rock -> sand
@@ -280,104 +252,43 @@ int step_runoff(inout vec4 event_data, inout vec4 cell_elev, inout vec4 ground_d
         ground_data.x += absorb;
 
         // drop remaining material
-        cell_elev.z += event_data.z;
-        event_data.z = 0;
-
-        cell_elev.w += event_data.y;
-        event_data.y = 0;
-
-        cell_elev.y += event_data.w;
-        event_data.w = 0;
+        drop_sediment(event_data, cell_elev);
     }
     return r_dir;
 }
 
-void evaluate_events(in ivec2 pos) {
-    const uvec2 bounds = imageSize(elevation_data);
-    // erode, update event values
-    uvec4 cell = imageLoad(cell_data_a, pos);
+NUM_THREADS(64u, 1u, 1u);
+void main()
+{
+    const uint slot = gl_GlobalInvocationID.x;
+    if (slot >= event_counters[1])
+        return;
+    const uvec4 cell = active_cells[slot];
+    const ivec2 bounds = ivec2(imageSize(elevation_data));
+    const ivec2 pos = ivec2(cell.x % uint(bounds.x), cell.x / uint(bounds.x));
+
     vec4 cell_elev = imageLoad(elevation_data, pos);
     vec4 ground = imageLoad(ground_data, pos);
-
-    if (cell.z > 0) {
-        uint index = cell.x; // head index
-        int n = 0;
-        while (n < cell.z && index != 0) {
-            // do event
-            vec4 evnt = u_event_data[index];
-            int dir = step_runoff(evnt, cell_elev, ground, pos);
-            
-            u_event_data_2[index].x = dir;
-            u_event_data[index] = evnt;
-
-            index = list_next_element(index, bounds);
-            n++;
+    // events of one cell draw spread out numbers from the random number of the cell
+    const float r = rand(uvec2(pos));
+    for (uint i = 0u; i < cell.z; ++i) {
+        const uint e = cell.y + i;
+        vec4 evnt = event_data[e];
+        const int dir = step_runoff(evnt, cell_elev, ground, pos, fract(r + 0.618034 * float(i)));
+
+        uvec4 info = uvec4(NO_CELL, 0u, 0u, 0u);
+        if (dir != -1 && evnt.x > 0) {
+            const ivec2 n_p = pos + Dirmap[dir];
+            info.x = uint(n_p.x) + uint(bounds.x) * uint(n_p.y);
+            atomicFetchAndAdd(cell_count[info.x], 1u, info.y);
+        } else {
+            // the event ends here, without water it leaves its sediment
+            drop_sediment(evnt, cell_elev);
         }
+        event_data[e] = evnt;
+        event_info[e] = info;
     }
 
-    barrier();
-
     imageStore(elevation_data, pos, cell_elev);
     imageStore(ground_data, pos, ground);
 }
-
-void collect_neighbor_events(in ivec2 pos) {
-    // for every valid neighbor
-    //  for ne in neighbor events
-    //   if ne.dir points towards pos
-    //    insert ne into cell_data_b
-    const uvec2 bounds = imageSize(elevation_data);
-    uvec4 new_cell = uvec4(0);
-    int s = int(8 * rand(pos));
-    for (int i = 0; i < 8; ++i) {
-        // TODO: random event evaluation order
-        int v = i;//(i + s) % 8;
-        ivec2 n_p = pos + Dirmap[v];
-        if (n_p.x > 0 && n_p.x < bounds.x &&
-            n_p.y > 0 && n_p.y < bounds.y) {
-                // get neighbor cell indexing data
-                const uvec4 cell = imageLoad(cell_data_a, n_p);
-                if (cell.z > 0) {
-                    uint index = cell.x; // head index
-                    uint n = 0;
-                    while (n < cell.z && index != 0) {
-                        // check if event is moving here
-                        int op = (v + 4) % 8;
-                        if (u_event_data_2[index].x == op) {
-                            // add new events
-                            cellAddEvent(index, new_cell, bounds);
-                        }
-
-                        index = list_next_element(index, bounds);
-                        n++;
-                    }
-                }
-            }
-    }
-    imageStore(cell_data_b, pos, new_cell);
-}
-
-
-NUM_THREADS(1u, 1u, 1u);
-void main()
-{
-    const ivec2 bounds = ivec2(imageSize(elevation_data));
-    const ivec2 pos = ivec2(gl_GlobalInvocationID.xy);
-    const int index = int(gl_GlobalInvocationID.x + bounds.x * gl_GlobalInvocationID.y);
-
-    imageStore(list_next_b, pos, uvec4(0));
-    u_event_data_2[index].x = -1;
-    //u_event_data[index].x += rainfall * step_time_constant * rand(pos);
-
-    barrier();
-
-    // evaluate events
-    evaluate_events(pos);
-
-    barrier();
-    
-    //move events
-    collect_neighbor_events(pos);
-
-    barrier();
-}
\ No newline at end of file
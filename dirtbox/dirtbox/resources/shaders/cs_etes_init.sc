@@ -1,24 +1,35 @@
+// ETES event cycle start: one event with rainfall in every cell, already compact with event i in
+// cell i. Writes the counters and dispatch arguments of the first step
 #include "bgfx_compute.sh"
 #include "cs_etes_common.sh"
 
-NUM_THREADS(1u, 1u, 1u);
+NUM_THREADS(16u, 16u, 1u);
 
-UIMAGE2D_WR(cell_data, rgba32ui,    0);
-BUFFER_RW(u_event_data, vec4,       1);
-UIMAGE2D_WR(list_next, r32ui ,       2);
-IMAGE2D_RO(rand_data,    r32f,   4);
-
-float rand(uvec2 pos) {
-    return imageLoad(rand_data, ivec2(pos + u_rand_offset.xy)).x;
-}
+BUFFER_RW(active_cells,     uvec4,  2);
+BUFFER_RW(event_counters,   uint,   3);
+BUFFER_RW(event_data,       vec4,   7);
+BUFFER_RW(indirect_buffer,  uvec4,  11);
+IMAGE2D_RO(elevation_data,  rgba32f, 0);
 
 void main() {
-    const ivec2 bounds = ivec2(imageSize(cell_data));
+    const ivec2 bounds = ivec2(imageSize(elevation_data));
     const ivec2 pos = ivec2(gl_GlobalInvocationID.xy);
-    const int index = int(gl_GlobalInvocationID.x + bounds.x * gl_GlobalInvocationID.y);
-    
-    imageStore(cell_data, pos, uvec4(index, index, 1, 0));
-    imageStore(list_next, pos, uvec4(0));
-    //if (rand(pos) > 0.2)
-        u_event_data[index] = vec4(rainfall, 0, 0, 0);
-}
\ No newline at end of file
+    // the grid is rounded up to whole work groups
+    if (pos.x >= bounds.x || pos.y >= bounds.y)
+        return;
+    const uint index = uint(pos.x) + uint(bounds.x) * uint(pos.y);
+
+    event_data[index] = vec4(rainfall, 0, 0, 0);
+    active_cells[index] = uvec4(index, index, 1u, 0u);
+
+    if (index == 0u) {
+        const uint cells = uint(bounds.x) * uint(bounds.y);
+        event_counters[0] = cells;
+        event_counters[1] = cells;
+        event_counters[2] = 0u;
+        event_counters[3] = 0u;
+        event_counters[4] = 0u;
+        dispatchIndirect(indirect_buffer, 0u, (cells + CELL_GROUP - 1u) / CELL_GROUP, 1u, 1u);
+        dispatchIndirect(indirect_buffer, 1u, (cells + EVENT_GROUP - 1u) / EVENT_GROUP, 1u, 1u);
+    }
+}
@@ -0,0 +1,17 @@
+// exclusive scan of one uvec2 per invocation over a work group of EVENT_GROUP invocations. Every
+// invocation of the group must call it
+
+SHARED uvec2 scan_block[EVENT_GROUP];
+
+uvec2 scan_group(uvec2 value, uint t, out uvec2 total) {
+    scan_block[t] = value;
+    barrier();
+    for (uint d = 1u; d < EVENT_GROUP; d <<= 1u) {
+        const uvec2 before = t >= d ? scan_block[t - d] : uvec2(0u, 0u);
+        barrier();
+        scan_block[t] += before;
+        barrier();
+    }
+    total = scan_block[EVENT_GROUP - 1u];
+    return scan_block[t] - value;
+}
@@ -0,0 +1,29 @@
+// ETES event scan, first level. Every event heading a cell, rank 0, adds the cell and its event
+// count. Scans them within the work group into event_info.zw and stores the group total
+#include "bgfx_compute.sh"
+#include "cs_etes_common.sh"
+#include "cs_etes_scan.sh"
+
+BUFFER_RO(event_counters,   uint,   3);
+BUFFER_RO(cell_count,       uint,   5);
+BUFFER_RW(event_info,       uvec4,  8);
+BUFFER_WR(scan_sums,        uvec2,  10);
+
+NUM_THREADS(256u, 1u, 1u);
+
+void main() {
+    const uint e = gl_GlobalInvocationID.x;
+    const bool live = e < event_counters[0];
+    uvec4 info = live ? event_info[e] : uvec4(NO_CELL, 0u, 0u, 0u);
+
+    uvec2 value = uvec2(0u, 0u);
+    if (info.x != NO_CELL && info.y == 0u)
+        value = uvec2(1u, cell_count[info.x]);
+
+    uvec2 total;
+    const uvec2 before = scan_group(value, gl_LocalInvocationIndex, total);
+    if (live)
+        event_info[e].zw = before;
+    if (gl_LocalInvocationIndex == 0u)
+        scan_sums[gl_WorkGroupID.x] = total;
+}
@@ -0,0 +1,27 @@
+// ETES event scan, last level. Every event heading a cell adds its group offset, appends the cell
+// to active_cells with the slot of its first event and clears its count for the next step
+#include "bgfx_compute.sh"
+#include "cs_etes_common.sh"
+
+BUFFER_WR(active_cells,     uvec4,  2);
+BUFFER_RO(event_counters,   uint,   3);
+BUFFER_RW(cell_count,       uint,   5);
+BUFFER_WR(cell_offset,      uint,   6);
+BUFFER_RO(event_info,       uvec4,  8);
+BUFFER_RO(scan_sums,        uvec2,  10);
+
+NUM_THREADS(256u, 1u, 1u);
+
+void main() {
+    const uint e = gl_GlobalInvocationID.x;
+    if (e >= event_counters[0])
+        return;
+    const uvec4 info = event_info[e];
+    if (info.x == NO_CELL || info.y != 0u)
+        return;
+
+    const uvec2 slot = info.zw + scan_sums[gl_WorkGroupID.x];
+    active_cells[slot.x] = uvec4(info.x, slot.y, cell_count[info.x], 0u);
+    cell_offset[info.x] = slot.y;
+    cell_count[info.x] = 0u;
+}
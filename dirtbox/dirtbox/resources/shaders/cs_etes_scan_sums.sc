@@ -0,0 +1,35 @@
+// ETES event scan, second level. One work group scans the group totals of cs_etes_scan_blocks in
+// place, each invocation a run of them, and stores the counts of the next step
+#include "bgfx_compute.sh"
+#include "cs_etes_common.sh"
+#include "cs_etes_scan.sh"
+
+BUFFER_RW(event_counters,   uint,   3);
+BUFFER_RW(scan_sums,        uvec2,  10);
+
+NUM_THREADS(256u, 1u, 1u);
+
+void main() {
+    const uint t = gl_LocalInvocationIndex;
+    const uint groups = (event_counters[0] + EVENT_GROUP - 1u) / EVENT_GROUP;
+    const uint run = (groups + EVENT_GROUP - 1u) / EVENT_GROUP;
+    const uint g0 = min(t * run, groups);
+    const uint g1 = min(g0 + run, groups);
+
+    uvec2 sum = uvec2(0u, 0u);
+    for (uint g = g0; g < g1; ++g)
+        sum += scan_sums[g];
+
+    uvec2 total;
+    uvec2 offset = scan_group(sum, t, total);
+    for (uint g = g0; g < g1; ++g) {
+        const uvec2 value = scan_sums[g];
+        scan_sums[g] = offset;
+        offset += value;
+    }
+
+    if (t == 0u) {
+        event_counters[2] = total.y;
+        event_counters[3] = total.x;
+    }
+}
@@ -0,0 +1,20 @@
+// ETES event scatter, copies every live event to the slot of its cell plus its rank
+#include "bgfx_compute.sh"
+#include "cs_etes_common.sh"
+
+BUFFER_RO(event_counters,   uint,   3);
+BUFFER_RO(cell_offset,      uint,   6);
+BUFFER_RO(event_data,       vec4,   7);
+BUFFER_RO(event_info,       uvec4,  8);
+BUFFER_WR(event_data_next,  vec4,   9);
+
+NUM_THREADS(256u, 1u, 1u);
+
+void main() {
+    const uint e = gl_GlobalInvocationID.x;
+    if (e >= event_counters[0])
+        return;
+    const uvec4 info = event_info[e];
+    if (info.x != NO_CELL)
+        event_data_next[cell_offset[info.x] + info.y] = event_data[e];
+}
@@ -0,0 +1,85 @@
+// Erosion2 pass 5: semi-Lagrangian transport of the suspended sediment and the thermal soil
+// flows from the 8 neighbors. Writes the new state
+#include "bgfx_compute.sh"
+#include "cs_model2_common.sh"
+
+IMAGE2D_RO(elevation_data_in    , rgba32f,   0);
+IMAGE2D_WR(elevation_data_out   , rgba32f,   3);
+IMAGE2D_RO(vel_out              , FLOW_FORMAT,   5);
+IMAGE2D_RO(soil_flows_1         , FLOW_FORMAT,   6);
+IMAGE2D_RO(soil_flows_2         , FLOW_FORMAT,   7);
+IMAGE2D_RO(elevation_mid        , rgba32f,  10);
+
+// last step in which a tile changed by more than activity_threshold
+BUFFER_RW(tile_changed          , uint, 9);
+
+// thermal soil out flows of the group and its border
+SHARED vec4 soil_out_1[HALO_CELLS];
+SHARED vec4 soil_out_2[HALO_CELLS];
+
+float bilinear_sediment(in vec2 pos, in ivec2 bounds) {
+    const vec2 cell = floor(pos);
+    const vec2 weight = pos - cell;
+    const ivec2 coords = ivec2(cell);
+
+    float bl = imageLoad(elevation_mid, border_clamp(coords                , bounds)).z;
+    float br = imageLoad(elevation_mid, border_clamp(coords + ivec2(1,0)   , bounds)).z;
+    float tl = imageLoad(elevation_mid, border_clamp(coords + ivec2(0,1)   , bounds)).z;
+    float tr = imageLoad(elevation_mid, border_clamp(coords + ivec2(1,1)   , bounds)).z;
+
+    float bot = bl * (1 - weight.x) + br * weight.x;
+    float top = tl * (1 - weight.x) + tr * weight.x;
+    return bot * (1 - weight.y) + top * weight.y;
+}
+
+NUM_THREADS(16u, 16u, 1u);
+
+void main() {
+    const ivec2 bounds = ivec2(imageSize(elevation_data_in));
+    const ivec2 origin = group_origin();
+    for (uint i = gl_LocalInvocationIndex; i < HALO_CELLS; i += GROUP_CELLS) {
+        const ivec2 cell = halo_cell(i, origin, bounds);
+        soil_out_1[i] = imageLoad(soil_flows_1, cell);
+        soil_out_2[i] = imageLoad(soil_flows_2, cell);
+    }
+    barrier();
+
+    const ivec2 local = ivec2(gl_LocalInvocationID.xy);
+    const ivec2 pos = origin + local;
+    if (!inside(pos, bounds))
+        return;
+
+    vec4 elev = imageLoad(elevation_mid, pos);
+    const vec4 wvel = imageLoad(vel_out, pos);
+    const float cell_area = cell_size * cell_size;
+
+    // sediment transport
+    elev.z = bilinear_sediment(vec2(pos) - wvel.xy / cell_size * step_time_constant, bounds);
+
+    // soil flow accum
+    const uint self = halo_index(local);
+    const float total_soil_out_flow = dot(soil_out_1[self], vec4(1, 1, 1, 1)) + dot(soil_out_2[self], vec4(1, 1, 1, 1));
+    float total_soil_in_flow = 0;
+    for (int i = 0; i < 8; i++) {
+        int nfi = (i + 4) % 8;
+        if (inside(pos + Dirmap[i], bounds)) {
+            const uint n = halo_index(local + Dirmap[i]);
+            if (nfi < 4) {
+                total_soil_in_flow += soil_out_1[n][nfi];
+            } else {
+                total_soil_in_flow += soil_out_2[n][nfi - 4];
+            }
+        }
+    }
+    elev.x += (total_soil_in_flow - total_soil_out_flow) * step_time_constant / cell_area;
+
+    // largest change of rock, sediment and water moved by flow, for the tile activity.
+    // every cell that changes writes the same value, the race is harmless
+    const vec4 elev_in = imageLoad(elevation_data_in, pos) * terrain_elevation_scale;
+    const float change = max(max(abs(elev.x - elev_in.x), abs(elev.z - elev_in.z)), abs(wvel.z));
+    if (tile_sparse && change > activity_threshold)
+        tile_changed[tile_list[gl_WorkGroupID.x / GROUPS_PER_TILE]] = tile_step;
+
+    // save state
+    imageStore(elevation_data_out, pos, elev / terrain_elevation_scale);
+}
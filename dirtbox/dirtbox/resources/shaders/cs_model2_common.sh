@@ -0,0 +1,105 @@
+// references: https://old.cescg.org/CESCG-2011/papers/TUBudapest-Jako-Balazs.pdf
+// Erosion2 helpers shared by the passes of a step. A step runs, in order:
+//  cs_model2_flux                  pipe out flows
+//  cs_model2_water                 water level and velocity
+//  cs_model2_erosion_deposition    soil uptake and deposition of suspended sediment
+//  cs_model2_thermal               thermal soil out flows
+//  cs_model2_advection             sediment transport and thermal soil in flows, writes the new state
+// cs_model2_talus is a thermal pass of its own that runs any number of times between steps.
+// A pass only reads neighbors from images no pass writes in the same dispatch, so work groups
+// never wait on each other. Each pass stages the neighborhood of its 16x16 group in shared memory
+
+#include "cs_model2_params.sh"
+#include "cs_model2_tiles_common.sh"
+
+/*
+images, the same slot in every pass:
+0:  elevation_data_in
+1:  out_flows_in
+2:  vel_in
+3:  elevation_data_out
+4:  out_flows_out
+5:  vel_out
+6:  soil_flows_1
+7:  soil_flows_2
+10: elevation_mid, scaled elevation between the passes
+
+elevation_data:
+x: rock
+y: sand
+z: suspended_sediment
+w: water
+
+out_flows:
+x: u
+y: d
+z: l
+w: r
+
+velocity:
+x: x
+y: y
+z: water moved by flow in the last step
+w: local soil hardness
+*/
+
+// active tiles, when tile_sparse
+BUFFER_RO(tile_list             , uint, 8);
+
+const ivec2 Dirmap[8] = {
+    ivec2(-1, 1),
+    ivec2(0 , 1),
+    ivec2(1 , 1),
+    ivec2(1 , 0),
+    ivec2(1 , -1),
+    ivec2(0 , -1),
+    ivec2(-1, -1),
+    ivec2(-1, 0)
+};
+
+#define GROUP_CELLS (GROUP_SIZE * GROUP_SIZE)
+// cells of a work group and a one cell border
+#define HALO_SIZE (GROUP_SIZE + 2u)
+#define HALO_CELLS (HALO_SIZE * HALO_SIZE)
+
+float cell_height(in vec4 c) {
+    return c.x + c.w;
+}
+
+bool inside(in ivec2 pos, in ivec2 bounds) {
+    return pos.x >= 0 && pos.x < bounds.x && pos.y >= 0 && pos.y < bounds.y;
+}
+
+ivec2 border_clamp(in ivec2 pos, in ivec2 bounds) {
+    return clamp(pos, ivec2(0, 0), bounds - 1);
+}
+
+// first cell of this work group
+ivec2 group_origin() {
+    if (tile_sparse)
+        return tile_group_origin(tile_list[gl_WorkGroupID.x / GROUPS_PER_TILE], gl_WorkGroupID.xy);
+    return ivec2(gl_WorkGroupID.xy * GROUP_SIZE);
+}
+
+// grid cell of entry i of a HALO_CELLS staging array, clamped to the grid
+ivec2 halo_cell(uint i, in ivec2 origin, in ivec2 bounds) {
+    return border_clamp(origin - 1 + ivec2(i % HALO_SIZE, i / HALO_SIZE), bounds);
+}
+
+// staging array entry of a cell relative to the group origin, -1 to GROUP_SIZE
+uint halo_index(in ivec2 local) {
+    return uint(local.y + 1) * HALO_SIZE + uint(local.x + 1);
+}
+
+float lmax(float x) {
+    if (x <= 0)
+        return 0;
+    else if (x >= maximal_erosion_depth)
+        return 1;
+    else
+        return 1 - (maximal_erosion_depth - x) / maximal_erosion_depth;
+}
+
+float soil_k(float x, float cell_area) {
+    return x / (water_sediment_capacity * cell_area) + 1;
+}
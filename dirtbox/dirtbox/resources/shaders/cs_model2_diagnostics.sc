@@ -0,0 +1,46 @@
+// Erosion2 conservation diagnostics, first level. Each work group reduces its cells in shared
+// memory and writes two texels of diagnostics_out at (2 * group.x, group.y):
+// 0: water, suspended sediment and soil column sums in m, non-finite cells
+// 1: smallest and largest ground height in m, sum and largest of its absolute change since the
+//    last reduction
+// cs_model2_diagnostics_reduce.sc reduces the groups further, see Erosion2ModelCPU::getDiagnostics
+#include "bgfx_compute.sh"
+#include "cs_model2_params.sh"
+
+IMAGE2D_RO(elevation_data_in    , rgba32f, 0);
+IMAGE2D_WR(diagnostics_out      , rgba32f, 1);
+// ground height in m of the last reduction, replaced with the current one
+IMAGE2D_RW(height_reference     , r32f,    2);
+
+#include "cs_model2_diagnostics_common.sh"
+
+NUM_THREADS(16u, 16u, 1u);
+
+void main() {
+    const ivec2 bounds = ivec2(imageSize(elevation_data_in));
+    const ivec2 pos = ivec2(gl_GlobalInvocationID.xy);
+    const uint i = gl_LocalInvocationIndex;
+
+    vec4 sums = vec4(0, 0, 0, 0);
+    vec4 height_range = vec4(DIAG_MAX, -DIAG_MAX, 0, 0);
+    if (pos.x < bounds.x && pos.y < bounds.y) {
+        const vec4 e = imageLoad(elevation_data_in, pos) * terrain_elevation_scale;
+        const float height = e.x + e.y;
+        if (any(isnan(e)) || any(isinf(e))) {
+            sums.w = 1;
+        } else {
+            const float change = abs(height - imageLoad(height_reference, pos).x);
+            sums = vec4(e.w, e.z, height, 0);
+            height_range = vec4(height, height, change, change);
+        }
+        imageStore(height_reference, pos, vec4(height, 0, 0, 0));
+    }
+    diag_sums[i] = sums;
+    diag_height[i] = height_range;
+    barrier();
+
+    diagnosticsReduceGroup(i);
+
+    if (i == 0u)
+        diagnosticsStore(ivec2(gl_WorkGroupID.xy));
+}
@@ -0,0 +1,28 @@
+// Erosion2 conservation diagnostics, shared memory tree reduction of a 16x16 work group. Include
+// after the declaration of diagnostics_out
+
+// identity of the height range
+#define DIAG_MAX 3.402823e38
+
+// x: water, y: suspended sediment, z: soil, w: non-finite cells
+SHARED vec4 diag_sums[256];
+// x: smallest, y: largest ground height, z: sum, w: largest of the absolute height change
+SHARED vec4 diag_height[256];
+
+// leaves the group result in element 0
+void diagnosticsReduceGroup(uint i) {
+    for (uint s = 128u; s > 0u; s >>= 1u) {
+        if (i < s) {
+            const vec4 a = diag_height[i];
+            const vec4 b = diag_height[i + s];
+            diag_sums[i] += diag_sums[i + s];
+            diag_height[i] = vec4(min(a.x, b.x), max(a.y, b.y), a.z + b.z, max(a.w, b.w));
+        }
+        barrier();
+    }
+}
+
+void diagnosticsStore(ivec2 group) {
+    imageStore(diagnostics_out, ivec2(2 * group.x, group.y), diag_sums[0]);
+    imageStore(diagnostics_out, ivec2(2 * group.x + 1, group.y), diag_height[0]);
+}
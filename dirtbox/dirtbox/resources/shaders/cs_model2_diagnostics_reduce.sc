@@ -0,0 +1,33 @@
+// Erosion2 conservation diagnostics, further levels. Reduces 16x16 group results of the previous
+// level in the layout of cs_model2_diagnostics.sc. The last level has a single group and writes
+// the totals to texels (0, 0) and (1, 0)
+#include "bgfx_compute.sh"
+
+IMAGE2D_RO(diagnostics_in       , rgba32f, 0);
+IMAGE2D_WR(diagnostics_out      , rgba32f, 1);
+
+#include "cs_model2_diagnostics_common.sh"
+
+NUM_THREADS(16u, 16u, 1u);
+
+void main() {
+    const ivec2 size = ivec2(imageSize(diagnostics_in));
+    const ivec2 bounds = ivec2(size.x / 2, size.y);
+    const ivec2 pos = ivec2(gl_GlobalInvocationID.xy);
+    const uint i = gl_LocalInvocationIndex;
+
+    vec4 sums = vec4(0, 0, 0, 0);
+    vec4 height_range = vec4(DIAG_MAX, -DIAG_MAX, 0, 0);
+    if (pos.x < bounds.x && pos.y < bounds.y) {
+        sums = imageLoad(diagnostics_in, ivec2(2 * pos.x, pos.y));
+        height_range = imageLoad(diagnostics_in, ivec2(2 * pos.x + 1, pos.y));
+    }
+    diag_sums[i] = sums;
+    diag_height[i] = height_range;
+    barrier();
+
+    diagnosticsReduceGroup(i);
+
+    if (i == 0u)
+        diagnosticsStore(ivec2(gl_WorkGroupID.xy));
+}
@@ -0,0 +1,66 @@
+// Erosion2 pass 3: soil uptake into and deposition from the suspended sediment, depending on the
+// sediment capacity of the flow, and evaporation
+#include "bgfx_compute.sh"
+#include "cs_model2_common.sh"
+
+IMAGE2D_RO(elevation_data_in    , rgba32f,   0);
+IMAGE2D_RW(vel_out              , FLOW_FORMAT,   5);
+IMAGE2D_RW(elevation_mid        , rgba32f,  10);
+
+// rock + water of the group and its border at the start of the step
+SHARED float height[HALO_CELLS];
+
+NUM_THREADS(16u, 16u, 1u);
+
+void main() {
+    const ivec2 bounds = ivec2(imageSize(elevation_data_in));
+    const ivec2 origin = group_origin();
+    for (uint i = gl_LocalInvocationIndex; i < HALO_CELLS; i += GROUP_CELLS)
+        height[i] = cell_height(imageLoad(elevation_data_in, halo_cell(i, origin, bounds)) * terrain_elevation_scale);
+    barrier();
+
+    const ivec2 local = ivec2(gl_LocalInvocationID.xy);
+    const ivec2 pos = origin + local;
+    if (!inside(pos, bounds))
+        return;
+
+    vec4 elev = imageLoad(elevation_mid, pos);
+    vec4 wvel = imageLoad(vel_out, pos);
+
+    const float cell_area = cell_size * cell_size;
+    const float h = height[halo_index(local)] + rainfall * step_time_constant;
+
+    float dH[4];
+    for (int i = 0; i < 4; ++i) {
+        const ivec2 d = Dirmap[2 * i + 1];
+        dH[i] = 0;
+        if (inside(pos + d, bounds))
+            dH[i] = h - height[halo_index(local + d)];
+    }
+
+    // z component of the surface normal normalize(cross((2c, 0, dzx), (0, 2c, dzy)))
+    const float dzx = dH[3] - dH[1];
+    const float dzy = dH[0] - dH[2];
+    const float nz = 4 * cell_area / sqrt(4 * cell_area * (dzx * dzx + dzy * dzy) + 16 * cell_area * cell_area);
+    const float C = max(0, water_sediment_capacity * clamp((1.05 - nz), 0, 1) * length(wvel.xy) * lmax(elev.w));
+
+    if (elev.z < C) {
+        // elev.z is suspended_sediment
+        float delta = min(elev.x, step_time_constant * wvel.w * soil_suspension_rate * (C - elev.z));
+        elev.x -= delta; // soil uptake to suspended_sediment
+        elev.z += delta;
+    } else {
+        float delta = step_time_constant * sediment_deposition_rate * (elev.z - C);
+        elev.x += delta; // soil drop from suspended_sediment
+        elev.z -= delta;
+
+        // local softness modifier when soil is deposited
+        wvel.w += step_time_constant * 5 * soil_suspension_rate * (elev.z - C);
+    }
+    wvel.w = clamp(wvel.w, 0.05, soil_softness_max);
+
+    elev.w *= (1 - water_evaporation_rate * step_time_constant);
+
+    imageStore(elevation_mid, pos, elev);
+    imageStore(vel_out, pos, flow_store(wvel));
+}
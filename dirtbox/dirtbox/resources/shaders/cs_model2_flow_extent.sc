@@ -0,0 +1,49 @@
+// Erosion2 largest water speed and depth, for the adaptive time step. Each work group reduces
+// its cells in shared memory and merges them into flow_extent with an atomic max
+#include "bgfx_compute.sh"
+#include "cs_model2_params.sh"
+
+IMAGE2D_RO(elevation_data_in    , rgba32f,   0);
+IMAGE2D_RO(vel_in               , FLOW_FORMAT,   2);
+
+/*
+flow_extent, as float bits. Both values are >= 0, where the uint order matches the float order
+0: largest speed
+1: largest depth
+*/
+BUFFER_RW(flow_extent           , uint, 8);
+
+SHARED vec2 extent[256];
+
+NUM_THREADS(16u, 16u, 1u);
+
+void main() {
+    const ivec2 bounds = ivec2(imageSize(elevation_data_in));
+    const ivec2 pos = ivec2(gl_GlobalInvocationID.xy);
+    const uint i = gl_LocalInvocationIndex;
+
+    vec2 e = vec2(0, 0);
+    if (pos.x < bounds.x && pos.y < bounds.y) {
+        const float depth = imageLoad(elevation_data_in, pos).w * terrain_elevation_scale;
+        const float speed = length(imageLoad(vel_in, pos).xy);
+        // nearly dry cells and cells that drain completely in one step do not limit the step,
+        // see Erosion2ModelCPU::getFlowExtent
+        if (depth >= MIN_FLOW_DEPTH && speed < cell_size / step_time_constant)
+            e.x = speed;
+        e.y = max(depth, 0);
+    }
+    extent[i] = e;
+    barrier();
+
+    for (uint s = 128u; s > 0u; s >>= 1u) {
+        if (i < s)
+            extent[i] = max(extent[i], extent[i + s]);
+        barrier();
+    }
+
+    if (i == 0u) {
+        uint prev;
+        atomicFetchAndMax(flow_extent[0], floatBitsToUint(extent[0].x), prev);
+        atomicFetchAndMax(flow_extent[1], floatBitsToUint(extent[0].y), prev);
+    }
+}
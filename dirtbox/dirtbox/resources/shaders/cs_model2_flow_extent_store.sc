@@ -0,0 +1,18 @@
+// Erosion2 copy of the flow extent reduction into a texture that can be read back, resets the
+// reduction for the next update
+#include "bgfx_compute.sh"
+
+BUFFER_RW(flow_extent           , uint, 8);
+UIMAGE2D_WR(flow_extent_stats   , r32ui, 5);
+
+NUM_THREADS(1u, 1u, 1u);
+
+void main() {
+    uint speed;
+    uint depth;
+    atomicFetchAndExchange(flow_extent[0], 0u, speed);
+    atomicFetchAndExchange(flow_extent[1], 0u, depth);
+
+    imageStore(flow_extent_stats, ivec2(0, 0), uvec4(speed, 0u, 0u, 0u));
+    imageStore(flow_extent_stats, ivec2(1, 0), uvec4(depth, 0u, 0u, 0u));
+}
@@ -0,0 +1,48 @@
+// Erosion2 pass 1: pipe out flows from the height differences to the 4 neighbors, damped by
+// suspended sediment and scaled to not exceed the water in the cell
+#include "bgfx_compute.sh"
+#include "cs_model2_common.sh"
+
+IMAGE2D_RO(elevation_data_in    , rgba32f,   0);
+IMAGE2D_RO(out_flows_in         , FLOW_FORMAT,   1);
+IMAGE2D_WR(out_flows_out        , FLOW_FORMAT,   4);
+
+// rock + water of the group and its border
+SHARED float height[HALO_CELLS];
+
+NUM_THREADS(16u, 16u, 1u);
+
+void main() {
+    const ivec2 bounds = ivec2(imageSize(elevation_data_in));
+    const ivec2 origin = group_origin();
+    for (uint i = gl_LocalInvocationIndex; i < HALO_CELLS; i += GROUP_CELLS)
+        height[i] = cell_height(imageLoad(elevation_data_in, halo_cell(i, origin, bounds)) * terrain_elevation_scale);
+    barrier();
+
+    const ivec2 local = ivec2(gl_LocalInvocationID.xy);
+    const ivec2 pos = origin + local;
+    if (!inside(pos, bounds))
+        return;
+
+    vec4 elev = imageLoad(elevation_data_in, pos) * terrain_elevation_scale;
+    vec4 flow = imageLoad(out_flows_in, pos);
+
+    const float cell_area = cell_size * cell_size;
+    elev.w += rainfall * step_time_constant;
+    const float k = soil_k(elev.z, cell_area);
+    const float denom = (4 * (sqrt(virtual_pipe_area / 3.14)) * 9.8 * virtual_pipe_area * step_time_constant*step_time_constant);
+
+    float total_out_flow = 0;
+    for (int i = 0; i < 4; ++i) {
+        const ivec2 d = Dirmap[2 * i + 1];
+        float dH = 0;
+        if (inside(pos + d, bounds))
+            dH = cell_height(elev) - height[halo_index(local + d)];
+        flow[i] = max(0, flow[i] + step_time_constant * (virtual_pipe_area * 9.8 * dH / (cell_size) - 0.32 * k * flow[i]*flow[i] / denom));
+        total_out_flow += flow[i];
+    }
+
+    // rescale out flows to not exceed amount of water in cell
+    const float K = min(elev.w * cell_area / (total_out_flow + 1e-9), 1);
+    imageStore(out_flows_out, pos, flow_store(flow * K));
+}
@@ -0,0 +1,33 @@
+// Erosion2 copy of the tiles that just became inactive from the input to the output state, so
+// both state buffers hold the frozen tile. Also fills elevation_mid, active neighbors advect
+// sediment out of it. Dispatched indirectly by cs_model2_tiles_args
+#include "bgfx_compute.sh"
+#include "cs_model2_params.sh"
+#include "cs_model2_tiles_common.sh"
+
+IMAGE2D_RO(elevation_data_in    , rgba32f,   0);
+IMAGE2D_RO(out_flows_in         , FLOW_FORMAT,   1);
+IMAGE2D_RO(vel_in               , FLOW_FORMAT,   2);
+
+IMAGE2D_WR(elevation_data_out   , rgba32f,   3);
+IMAGE2D_WR(out_flows_out        , FLOW_FORMAT,   4);
+IMAGE2D_WR(vel_out              , FLOW_FORMAT,   5);
+IMAGE2D_WR(elevation_mid        , rgba32f,  10);
+
+BUFFER_RO(freeze_list           , uint, 8);
+
+NUM_THREADS(16u, 16u, 1u);
+
+void main() {
+    const ivec2 bounds = ivec2(imageSize(elevation_data_in));
+    const ivec2 origin = tile_group_origin(freeze_list[gl_WorkGroupID.x / GROUPS_PER_TILE], gl_WorkGroupID.xy);
+    const ivec2 pos = origin + ivec2(gl_LocalInvocationID.xy);
+    if (pos.x >= bounds.x || pos.y >= bounds.y)
+        return;
+
+    const vec4 elev = imageLoad(elevation_data_in, pos);
+    imageStore(elevation_data_out, pos, elev);
+    imageStore(elevation_mid, pos, elev * terrain_elevation_scale);
+    imageStore(out_flows_out, pos, imageLoad(out_flows_in, pos));
+    imageStore(vel_out, pos, imageLoad(vel_in, pos));
+}
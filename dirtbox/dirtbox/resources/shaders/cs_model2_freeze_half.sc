@@ -0,0 +1,3 @@
+// Erosion2 tile freeze with RGBA16F out flow, velocity and soil flow images
+#define MODEL2_HALF_STATE
+#include "cs_model2_freeze.sc"
@@ -0,0 +1,43 @@
+// Erosion2 parameters, layout of Erosion2Parameters
+
+uniform vec4 u_params[5];
+
+#define water_sediment_capacity         u_params[0].x
+#define maximal_erosion_depth           u_params[0].y
+#define step_time_constant              u_params[0].z
+#define cell_size                       u_params[0].w
+
+#define soil_absorption                 u_params[1].x
+#define bedrock_erosion_base_value      u_params[1].y
+#define rock_erosion_base_value         u_params[1].z
+#define iterations                      u_params[1].w
+
+#define rainfall                        u_params[2].x
+#define terrain_elevation_scale         u_params[2].y
+#define virtual_pipe_area               u_params[2].z
+#define soil_suspension_rate            u_params[2].w
+
+#define sediment_deposition_rate        u_params[3].x
+#define soil_softness_max               u_params[3].y
+#define water_evaporation_rate          u_params[3].z
+#define thermal_erosion_rate            u_params[3].w
+
+#define talus_angle_tangent_coef        u_params[4].x
+#define talus_angle_tangent_bias        u_params[4].y
+#define activity_threshold              u_params[4].z
+
+// water depth in m below which a cell is dry for the time step estimate, Erosion2Parameters::MinFlowDepth
+#define MIN_FLOW_DEPTH 0.01
+// lowest local soil hardness a step leaves, Erosion2Parameters::MinHardness
+#define MIN_HARDNESS 0.05
+
+// storage of the out flow, velocity and soil flow images. The *_half variants of the passes
+// define MODEL2_HALF_STATE and bind RGBA16F textures, see Erosion2Parameters::half_precision.
+// Stores to them saturate at the largest finite half instead of overflowing to infinity
+#ifdef MODEL2_HALF_STATE
+#define FLOW_FORMAT rgba16f
+#define flow_store(_v) clamp(_v, -65504.0, 65504.0)
+#else
+#define FLOW_FORMAT rgba32f
+#define flow_store(_v) (_v)
+#endif
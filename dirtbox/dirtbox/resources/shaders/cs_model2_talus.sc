@@ -0,0 +1,97 @@
+// Erosion2 standalone thermal weathering pass, runs between steps or on its own. Soil slides to
+// the 8 neighbors that are lower than the talus angle allows, without water flow. The out flows
+// of the group and its border are computed in shared memory and gathered in the same dispatch,
+// applied for step_time_constant seconds. Writes the new state, only the rock changes
+#include "bgfx_compute.sh"
+#include "cs_model2_common.sh"
+
+IMAGE2D_RO(elevation_data_in    , rgba32f,   0);
+IMAGE2D_RO(vel_in               , FLOW_FORMAT,   2);
+IMAGE2D_WR(elevation_data_out   , rgba32f,   3);
+
+// last step in which a tile changed. Tiles the pass changes are updated by the next step of a
+// sparse run, their frozen state no longer matches
+BUFFER_RW(tile_changed          , uint, 9);
+
+// cells of a work group and a two cell border
+#define WIDE_SIZE (GROUP_SIZE + 4u)
+#define WIDE_CELLS (WIDE_SIZE * WIDE_SIZE)
+
+// rock + water of the group and its two cell border
+SHARED float height[WIDE_CELLS];
+// soil out flows of the group and its one cell border, HALO_CELLS per direction in Dirmap order
+SHARED float soil_out[8u * HALO_CELLS];
+
+// height entry of a cell relative to the group origin, -2 to GROUP_SIZE + 1
+uint wide_index(in ivec2 local) {
+    return uint(local.y + 2) * WIDE_SIZE + uint(local.x + 2);
+}
+
+NUM_THREADS(16u, 16u, 1u);
+
+void main() {
+    const ivec2 bounds = ivec2(imageSize(elevation_data_in));
+    // always dispatched over the whole grid
+    const ivec2 origin = ivec2(gl_WorkGroupID.xy * GROUP_SIZE);
+    for (uint i = gl_LocalInvocationIndex; i < WIDE_CELLS; i += GROUP_CELLS) {
+        const ivec2 cell = border_clamp(origin - 2 + ivec2(i % WIDE_SIZE, i / WIDE_SIZE), bounds);
+        height[i] = cell_height(imageLoad(elevation_data_in, cell) * terrain_elevation_scale);
+    }
+    barrier();
+
+    const float cell_area = cell_size * cell_size;
+    for (uint i = gl_LocalInvocationIndex; i < HALO_CELLS; i += GROUP_CELLS) {
+        const ivec2 local = ivec2(i % HALO_SIZE, i / HALO_SIZE) - 1;
+        const ivec2 pos = origin + local;
+
+        float dHsf[8];
+        float totaldH = 0;
+        float dHm = 0;
+        float hardness = 0;
+        for (int d = 0; d < 8; ++d)
+            dHsf[d] = 0;
+        if (inside(pos, bounds)) {
+            // cells no step has run on yet have a hardness of 0
+            hardness = clamp(imageLoad(vel_in, pos).w, MIN_HARDNESS, soil_softness_max);
+            const float talus = hardness * talus_angle_tangent_coef + talus_angle_tangent_bias;
+            const float h = height[wide_index(local)];
+            for (int d = 0; d < 8; ++d) {
+                if (inside(pos + Dirmap[d], bounds)) {
+                    const float dh = h - height[wide_index(local + Dirmap[d])];
+                    if (dh > 0 && dh / cell_size > talus) {
+                        dHsf[d] = dh;
+                        dHm = max(dh, dHm);
+                        totaldH += dh;
+                    }
+                }
+            }
+        }
+        const float dS = cell_area * thermal_erosion_rate * hardness * dHm * 0.5;
+        for (int d = 0; d < 8; ++d)
+            soil_out[uint(d) * HALO_CELLS + i] = dHsf[d] > 0 ? dS * dHsf[d] / totaldH : 0;
+    }
+    barrier();
+
+    const ivec2 local = ivec2(gl_LocalInvocationID.xy);
+    const ivec2 pos = origin + local;
+    if (!inside(pos, bounds))
+        return;
+
+    const uint self = halo_index(local);
+    float total_out = 0;
+    float total_in = 0;
+    for (int d = 0; d < 8; ++d) {
+        total_out += soil_out[uint(d) * HALO_CELLS + self];
+        if (inside(pos + Dirmap[d], bounds))
+            total_in += soil_out[uint((d + 4) % 8) * HALO_CELLS + halo_index(local + Dirmap[d])];
+    }
+    const float change = (total_in - total_out) * step_time_constant / cell_area;
+
+    vec4 elev = imageLoad(elevation_data_in, pos);
+    elev.x += change / terrain_elevation_scale;
+    // every cell that changes writes the same value, the race is harmless
+    if (change != 0)
+        tile_changed[uint(pos.y) / TILE_SIZE * tiles_x + uint(pos.x) / TILE_SIZE] = tile_step;
+
+    imageStore(elevation_data_out, pos, elev);
+}
@@ -0,0 +1,3 @@
+// Erosion2 standalone thermal pass with an RGBA16F velocity image
+#define MODEL2_HALF_STATE
+#include "cs_model2_talus.sc"
@@ -0,0 +1,55 @@
+// Erosion2 pass 4: thermal soil out flows to the 8 neighbors that are lower than the talus angle
+// allows. The in flows are collected by cs_model2_advection
+#include "bgfx_compute.sh"
+#include "cs_model2_common.sh"
+
+IMAGE2D_RO(elevation_data_in    , rgba32f,   0);
+IMAGE2D_RO(vel_in               , FLOW_FORMAT,   2);
+IMAGE2D_WR(soil_flows_1         , FLOW_FORMAT,   6);
+IMAGE2D_WR(soil_flows_2         , FLOW_FORMAT,   7);
+
+// rock + water of the group and its border at the start of the step
+SHARED float height[HALO_CELLS];
+
+NUM_THREADS(16u, 16u, 1u);
+
+void main() {
+    const ivec2 bounds = ivec2(imageSize(elevation_data_in));
+    const ivec2 origin = group_origin();
+    for (uint i = gl_LocalInvocationIndex; i < HALO_CELLS; i += GROUP_CELLS)
+        height[i] = cell_height(imageLoad(elevation_data_in, halo_cell(i, origin, bounds)) * terrain_elevation_scale);
+    barrier();
+
+    const ivec2 local = ivec2(gl_LocalInvocationID.xy);
+    const ivec2 pos = origin + local;
+    if (!inside(pos, bounds))
+        return;
+
+    const float hardness = imageLoad(vel_in, pos).w;
+    const float cell_area = cell_size * cell_size;
+    const float h = height[halo_index(local)] + rainfall * step_time_constant;
+
+    float dHsf[8];
+    float totaldH = 0;
+    float dHm = 0;
+    for (int i = 0; i < 8; ++i) {
+        dHsf[i] = 0;
+        if (inside(pos + Dirmap[i], bounds)) {
+            const float dh = h - height[halo_index(local + Dirmap[i])];
+            const float alpha = tan(dh / cell_size);
+            if (dh > 0 && alpha > (hardness * talus_angle_tangent_coef + talus_angle_tangent_bias)) {
+                dHsf[i] = dh;
+                dHm = max(dh, dHm);
+                totaldH += dh;
+            }
+        }
+    }
+    const float dS = cell_area * thermal_erosion_rate * hardness * dHm / 2;
+
+    float soil_flows[8];
+    for (int i = 0; i < 8; ++i)
+        soil_flows[i] = dHsf[i] > 0 ? dS * dHsf[i] / totaldH : 0;
+
+    imageStore(soil_flows_1, pos, flow_store(vec4(soil_flows[0], soil_flows[1], soil_flows[2], soil_flows[3])));
+    imageStore(soil_flows_2, pos, flow_store(vec4(soil_flows[4], soil_flows[5], soil_flows[6], soil_flows[7])));
+}
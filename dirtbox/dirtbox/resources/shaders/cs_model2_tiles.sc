@@ -0,0 +1,40 @@
+// Erosion2 tile classification, one invocation per tile. A tile is active when it or one of its
+// 8 neighbors changed in the last step. Active tiles are appended to tile_list, tiles that just
+// became inactive to freeze_list
+#include "bgfx_compute.sh"
+#include "cs_model2_tiles_common.sh"
+
+BUFFER_WR(tile_list     , uint, 0);
+BUFFER_WR(freeze_list   , uint, 1);
+BUFFER_RO(tile_changed  , uint, 2);
+BUFFER_RW(tile_active   , uint, 3);
+/*
+tile_counters:
+0: active tiles
+1: frozen tiles
+2: skipped tile updates since init
+*/
+BUFFER_RW(tile_counters , uint, 4);
+
+NUM_THREADS(1u, 1u, 1u);
+
+void main() {
+    const ivec2 t = ivec2(gl_GlobalInvocationID.xy);
+    const uint index = uint(t.y) * tiles_x + uint(t.x);
+
+    // tile_changed starts at 0, so every tile is active in step 1
+    bool is_active = false;
+    for (int y = max(t.y - 1, 0); y <= min(t.y + 1, int(tiles_y) - 1); ++y)
+        for (int x = max(t.x - 1, 0); x <= min(t.x + 1, int(tiles_x) - 1); ++x)
+            is_active = is_active || tile_changed[uint(y) * tiles_x + uint(x)] + 1u == tile_step;
+
+    uint slot;
+    if (is_active) {
+        atomicFetchAndAdd(tile_counters[0], 1u, slot);
+        tile_list[slot] = index;
+    } else if (tile_active[index] != 0u) {
+        atomicFetchAndAdd(tile_counters[1], 1u, slot);
+        freeze_list[slot] = index;
+    }
+    tile_active[index] = is_active ? 1u : 0u;
+}
@@ -0,0 +1,26 @@
+// Erosion2 indirect dispatch arguments for the active and the frozen tiles. Resets the counters
+// of cs_model2_tiles and stores the active tiles and total skipped tiles in tile_stats
+#include "bgfx_compute.sh"
+#include "cs_model2_tiles_common.sh"
+
+BUFFER_RW(indirect_buffer   , uvec4, 0);
+BUFFER_RW(tile_counters     , uint, 4);
+UIMAGE2D_WR(tile_stats      , r32ui, 5);
+
+NUM_THREADS(1u, 1u, 1u);
+
+void main() {
+    uint num_active;
+    uint num_frozen;
+    atomicFetchAndExchange(tile_counters[0], 0u, num_active);
+    atomicFetchAndExchange(tile_counters[1], 0u, num_frozen);
+
+    const uint skipped = tile_counters[2] + tiles_x * tiles_y - num_active;
+    tile_counters[2] = skipped;
+
+    dispatchIndirect(indirect_buffer, 0u, num_active * GROUPS_PER_TILE, GROUPS_PER_TILE, 1u);
+    dispatchIndirect(indirect_buffer, 1u, num_frozen * GROUPS_PER_TILE, GROUPS_PER_TILE, 1u);
+
+    imageStore(tile_stats, ivec2(0, 0), uvec4(num_active, 0u, 0u, 0u));
+    imageStore(tile_stats, ivec2(1, 0), uvec4(skipped, 0u, 0u, 0u));
+}
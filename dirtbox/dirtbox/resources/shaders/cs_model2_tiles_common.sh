@@ -0,0 +1,26 @@
+// Erosion2 sparse active tiles. Tiles are TILE_SIZE x TILE_SIZE cells, numbered row major
+
+#define TILE_SIZE 32u
+// the passes of a step run in GROUP_SIZE x GROUP_SIZE work groups
+#define GROUP_SIZE 16u
+#define GROUPS_PER_TILE (TILE_SIZE / GROUP_SIZE)
+
+/*
+u_tile_params:
+x: step, starts at 1
+y: tiles in x
+z: tiles in y
+w: 1 when the work groups cover the tiles of a tile list, 0 when they cover the whole grid
+*/
+uniform vec4 u_tile_params;
+
+#define tile_step   uint(u_tile_params.x)
+#define tiles_x     uint(u_tile_params.y)
+#define tiles_y     uint(u_tile_params.z)
+#define tile_sparse (u_tile_params.w > 0.5)
+
+// first cell of a work group in a tile list dispatch, GROUPS_PER_TILE x GROUPS_PER_TILE groups per tile
+ivec2 tile_group_origin(uint tile, uvec2 group) {
+    uvec2 origin = uvec2(tile % tiles_x, tile / tiles_x) * TILE_SIZE;
+    return ivec2(origin + uvec2(group.x % GROUPS_PER_TILE, group.y) * GROUP_SIZE);
+}
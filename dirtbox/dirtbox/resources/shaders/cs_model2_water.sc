@@ -0,0 +1,61 @@
+// Erosion2 pass 2: new water level from the out flows of the cell and the in flows of its 4
+// neighbors, and the water velocity
+#include "bgfx_compute.sh"
+#include "cs_model2_common.sh"
+
+IMAGE2D_RO(elevation_data_in    , rgba32f,   0);
+IMAGE2D_RO(out_flows_in         , FLOW_FORMAT,   1);
+IMAGE2D_RO(vel_in               , FLOW_FORMAT,   2);
+IMAGE2D_RO(out_flows_out        , FLOW_FORMAT,   4);
+IMAGE2D_WR(vel_out              , FLOW_FORMAT,   5);
+IMAGE2D_WR(elevation_mid        , rgba32f,  10);
+
+// out flows of the group and its border at the start of the step
+SHARED vec4 flows[HALO_CELLS];
+
+NUM_THREADS(16u, 16u, 1u);
+
+void main() {
+    const ivec2 bounds = ivec2(imageSize(elevation_data_in));
+    const ivec2 origin = group_origin();
+    for (uint i = gl_LocalInvocationIndex; i < HALO_CELLS; i += GROUP_CELLS)
+        flows[i] = imageLoad(out_flows_in, halo_cell(i, origin, bounds));
+    barrier();
+
+    const ivec2 local = ivec2(gl_LocalInvocationID.xy);
+    const ivec2 pos = origin + local;
+    if (!inside(pos, bounds))
+        return;
+
+    vec4 elev = imageLoad(elevation_data_in, pos) * terrain_elevation_scale;
+    const vec4 flow = imageLoad(out_flows_out, pos);
+
+    const float cell_area = cell_size * cell_size;
+    elev.w += rainfall * step_time_constant;
+
+    float in_flow[4];
+    float total_in_flow = 0;
+    for (int i = 0; i < 4; ++i) {
+        const ivec2 d = Dirmap[2 * i + 1];
+        in_flow[i] = 0;
+        if (inside(pos + d, bounds))
+            in_flow[i] = flows[halo_index(local + d)][(i + 2) % 4];
+        total_in_flow += in_flow[i];
+    }
+    const float total_out_flow = flow.x + flow.y + flow.z + flow.w;
+
+    // compute new water level
+    const float net_flow = (total_in_flow - total_out_flow) / cell_area;
+    elev.w += net_flow;
+
+    // compute velocity. guard against cells that have run completely dry
+    const float vdenom = cell_size * max(min(1, elev.w), 1e-6) * step_time_constant;
+    vec4 wvel;
+    wvel.x = (in_flow[3] - flow[3] + flow[1] - in_flow[1]) / vdenom;
+    wvel.y = (in_flow[2] - flow[2] + flow[0] - in_flow[0]) / vdenom;
+    wvel.z = net_flow;
+    wvel.w = imageLoad(vel_in, pos).w;
+
+    imageStore(vel_out, pos, flow_store(wvel));
+    imageStore(elevation_mid, pos, elev);
+}
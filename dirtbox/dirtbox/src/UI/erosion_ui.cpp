@@ -7,6 +7,8 @@
 
 #include <app.h>
 
+#include <cfloat>
+
 namespace dirtbox {
 
 
@@ -21,7 +23,7 @@ void ErosionWindow::OnGUIUpdate() {
     );
     ImGui::Begin("Terrain Erosion Settings", &enabled);
 
-    const std::vector<std::string>& items = {"Erosion2SimulationGPU"};
+    const std::vector<std::string>& items = {"Erosion2SimulationGPU", "Erosion2SimulationCPU", "Erosion2PyramidSimulation", "EcosystemTerrainErosionSimulation", "EcosystemTerrainErosionSimulationGPU", "StreamPowerSimulation", "DropletErosionSimulation"};
     static int current_item = 0;
     bool selected_erosion_changed = false;
 
@@ -49,10 +51,40 @@ void ErosionWindow::OnGUIUpdate() {
     }
 
     if (erosion) {
+        if (was_running && !erosion->isRunning())
+            updateParamCache();
+        was_running = erosion->isRunning();
+
         if (!erosion->isRunning()) {
             if (ImGui::Button("Start")) {
+                erosion->setCheckpointing(checkpoint_file, checkpoint_interval);
                 erosion->startErosionTask();
+                resetStats();
             }
+            ImGui::SameLine();
+            if (ImGui::Button("Resume")) {
+                erosion->setCheckpointing(checkpoint_file, checkpoint_interval);
+                erosion->resumeFromCheckpoint(checkpoint_file);
+                resetStats();
+            }
+
+            ImGui::InputText("checkpoint file", checkpoint_file, sizeof(checkpoint_file));
+            if (ImGui::InputInt("checkpoint interval", &checkpoint_interval))
+                checkpoint_interval = std::max(checkpoint_interval, 0);
+
+            // re-erode only the cells around an edit
+            ImGui::InputInt4("region x y w h", incremental_region);
+            if (ImGui::Button("Erode region")) {
+                const int* r = incremental_region;
+                const bool started = erosion->startIncrementalErosion({r[0], r[1], r[0] + r[2], r[1] + r[3]});
+                incremental_status = started ? "" : "region erosion needs a region inside the terrain and an engine that supports it";
+                resetStats();
+            }
+            if (!incremental_status.empty())
+                ImGui::Text("%s", incremental_status.c_str());
+
+            if (erosion->getRunHash() != 0)
+                ImGui::Text("run hash %016llx", (unsigned long long)erosion->getRunHash());
 
             ImGui::Separator();
 
@@ -70,9 +102,26 @@ void ErosionWindow::OnGUIUpdate() {
             if (ImGui::Button("stop")) {
                 erosion->stopErosionTask();
             }
+            ImGui::SameLine();
+            if (ImGui::Button("checkpoint")) {
+                erosion->saveCheckpoint(checkpoint_file);
+            }
             erosion->update();
             ImGui::ProgressBar(erosion->getProgress());
         }
+
+        if (!erosion->getCheckpointStatus().empty()) {
+            ImGui::Text("%s", erosion->getCheckpointStatus().c_str());
+        }
+
+        if (erosion->getSimulatedTime() > 0)
+            ImGui::Text("simulated time %.1f s, time step %.4f s", erosion->getSimulatedTime(), erosion->getTimeStep());
+
+        if (erosion->getSkippedTiles() != 0)
+            ImGui::Text("skipped tiles %llu", (unsigned long long)erosion->getSkippedTiles());
+
+        drawStats();
+        drawDiagnostics();
     }
 
     ImGui::End();
@@ -82,4 +131,73 @@ void ErosionWindow::updateParamCache() {
     parameter_cache = erosion->getParams();
 }
 
+void ErosionWindow::drawStats() {
+    const terrain::ErosionStats stats = erosion->getStats();
+    if (stats.iterations == 0)
+        return;
+
+    // per step time of the engine, GPU time when it is measured
+    const float step_ms = stats.gpu_ms_per_step > 0 ? stats.gpu_ms_per_step : stats.cpu_ms_per_step;
+    if (erosion->isRunning() && ImGui::GetTime() - last_stats_sample >= StatsInterval) {
+        last_stats_sample = ImGui::GetTime();
+        rate_history[history_offset] = (float)stats.iterations_per_second;
+        step_ms_history[history_offset] = step_ms;
+        history_offset = (history_offset + 1) % StatsHistory;
+    }
+
+    ImGui::Separator();
+    ImGui::Text("%llu iterations, %.1f it/s, %.2f Mcells/s, %.1f MB/s", (unsigned long long)stats.iterations,
+        stats.iterations_per_second, stats.cells_per_second * 1e-6, stats.bytes_per_second / (1 << 20));
+    if (stats.particles_per_second > 0)
+        ImGui::Text("%.2f M droplets/s, %.2f M droplets/s per core", stats.particles_per_second * 1e-6, stats.particles_per_core_second * 1e-6);
+    ImGui::Text("CPU %.3f ms/step", stats.cpu_ms_per_step);
+    if (stats.gpu_ms_per_step > 0) {
+        ImGui::SameLine();
+        ImGui::Text("GPU %.3f ms/step, %.3f ms/dispatch", stats.gpu_ms_per_step, stats.gpu_ms_per_dispatch);
+    }
+    if (erosion->isRunning() && stats.eta_seconds >= 0)
+        ImGui::Text("ETA %.0f s", stats.eta_seconds);
+
+    // share of the run each pass took
+    double pass_seconds = 0;
+    for (const auto& pass : stats.passes)
+        pass_seconds += pass.seconds;
+    for (const auto& pass : stats.passes) {
+        ImGui::Text("%-12s %6llu runs  %8.2f ms/run  %5.1f%%  %llu items", pass.name.c_str(), (unsigned long long)pass.runs,
+            pass.runs > 0 ? pass.seconds * 1e3 / pass.runs : 0.0, pass_seconds > 0 ? pass.seconds * 100 / pass_seconds : 0.0, (unsigned long long)pass.items);
+    }
+
+    ImGui::PlotLines("it/s", rate_history.data(), StatsHistory, history_offset, nullptr, 0.0f, FLT_MAX, ImVec2(0, 60));
+    ImGui::PlotLines(stats.gpu_ms_per_step > 0 ? "GPU ms/step" : "CPU ms/step", step_ms_history.data(), StatsHistory, history_offset, nullptr, 0.0f, FLT_MAX, ImVec2(0, 60));
+}
+
+void ErosionWindow::drawDiagnostics() {
+    const terrain::ErosionDiagnosticsReport report = erosion->getDiagnostics();
+    if (!report.latest)
+        return;
+
+    const terrain::ErosionDiagnostics& d = *report.latest;
+    ImGui::Separator();
+    ImGui::Text("iteration %u: water %.4g m3, sediment %.4g m3, soil %.6g m3", d.iteration, d.water, d.sediment, d.soil);
+    ImGui::Text("height %.2f to %.2f m, soil and sediment drift %+.4f m", d.min_height, d.max_height, report.drift);
+    ImGui::Text("height change per interval: mean %.3g m, max %.3g m", d.change_mean, d.change_max);
+    if (report.converged_at) {
+        if (report.iterations_saved > 0)
+            ImGui::TextColored(ImVec4(0.4f, 1.0f, 0.4f, 1.0f), "converged at iteration %u, %llu iterations saved", *report.converged_at, (unsigned long long)report.iterations_saved);
+        else
+            ImGui::TextColored(ImVec4(0.4f, 1.0f, 0.4f, 1.0f), "converged at iteration %u, running at a reduced rate", *report.converged_at);
+    }
+    if (report.unstable())
+        ImGui::TextColored(ImVec4(1.0f, 0.3f, 0.3f, 1.0f), "stopped: %llu non-finite cells at iteration %u", (unsigned long long)d.non_finite, d.iteration);
+    else if (report.drifting)
+        ImGui::TextColored(ImVec4(1.0f, 0.8f, 0.2f, 1.0f), "soil and sediment are drifting, mean change %+.4f m since the start of the run", report.drift);
+}
+
+void ErosionWindow::resetStats() {
+    rate_history.fill(0);
+    step_ms_history.fill(0);
+    history_offset = 0;
+    last_stats_sample = 0;
+}
+
 }
\ No newline at end of file
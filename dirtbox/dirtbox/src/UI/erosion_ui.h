@@ -14,6 +14,8 @@
 #include <memory>
 #include <future>
 #include <atomic>
+#include <string>
+#include <array>
 
 #include <UI/ui_content.h>
 #include <util/parameter.h>
@@ -36,9 +38,31 @@ public:
 
 private:
     void updateParamCache();
+    // throughput of the run and a rolling graph of it
+    void drawStats();
+    void resetStats();
+    // conservation totals of the run, with a warning when they drift or the run went non-finite
+    void drawDiagnostics();
 
     std::shared_ptr<terrain::Erosion> erosion;
     util::ParameterList<float> parameter_cache;
+
+    char checkpoint_file[256] = "erosion.dbck";
+    int checkpoint_interval = 0;
+    // refresh the parameter cache when a run ends, resuming a checkpoint restores its parameters
+    bool was_running = false;
+
+    // x, y, width, height of the region re-eroded by an incremental run
+    int incremental_region[4] = {0, 0, 64, 64};
+    std::string incremental_status;
+
+    // iterations per second and ms per step, sampled every StatsInterval seconds while running
+    static constexpr int StatsHistory = 120;
+    static constexpr double StatsInterval = 0.25;
+    std::array<float, StatsHistory> rate_history{};
+    std::array<float, StatsHistory> step_ms_history{};
+    int history_offset = 0;
+    double last_stats_sample = 0;
 };
 
 }
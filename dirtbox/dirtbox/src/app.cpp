@@ -35,7 +35,8 @@ public:
         m_height = _height;
         m_ui_context.NotifyWindowSizeChanged({m_width, m_height});
         m_ui_context.SetUIScale(scale);
-        m_debug = BGFX_DEBUG_NONE;
+        // the profiler collects the per view GPU timings the erosion step scheduler uses
+        m_debug = BGFX_DEBUG_PROFILER;
         m_reset_flags = BGFX_RESET_NONE;
 
         bgfx::Init init;
@@ -30,11 +30,17 @@ public:
         return value;
     }
 
+    // value of the last fire, does not wait
+    const T last() const {
+        std::unique_lock<std::mutex> lck(mtx);
+        return value;
+    }
+
 private:
     mutable std::mutex mtx;
     mutable std::condition_variable cv;
-    int ready;
-    T value;
+    int ready = 0;
+    T value{};
 };
 
 }
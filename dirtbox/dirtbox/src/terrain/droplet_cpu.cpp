@@ -0,0 +1,283 @@
+#include <terrain/droplet_cpu.h>
+
+#include <cmath>
+#include <algorithm>
+
+#include <util/counter_rng.h>
+
+namespace dirtbox::terrain {
+
+DropletModelCPU::DropletModelCPU(const DropletParameters& params, float cell_size, float elevation_scale) :
+    params{params}, cell_size{cell_size}, elevation_scale{elevation_scale} {
+}
+
+void DropletModelCPU::init(int width, int height, const float* rgba) {
+    state.resize(width, height);
+    state.copyFromRGBA(rgba, {DropletField::Ground, DropletField::Sand, DropletField::Count, DropletField::Count}, elevation_scale);
+    for (int y = 0; y < height; ++y)
+        for (int x = 0; x < width; ++x)
+            state.at(DropletField::Ground, x, y) += state.at(DropletField::Sand, x, y);
+
+    const uint64_t cells = (uint64_t)width * height;
+    droplets_per_chunk = (int)std::max<uint64_t>(MinDropletsPerChunk, cells / ((uint64_t)Chunks * CellsPerDroplet));
+    tiles_x = (width + TileSize - 1) / TileSize;
+    tiles_y = (height + TileSize - 1) / TileSize;
+    change.resize(width, height);
+    touched_tiles.assign((std::size_t)tiles_x * tiles_y, 0);
+    held_tiles.assign((std::size_t)tiles_x * tiles_y, 0);
+    accumulators.assign(Chunks, {});
+    for (Accumulator& acc : accumulators)
+        acc.slot.assign((std::size_t)tiles_x * tiles_y, -1);
+    iteration = 0;
+    droplets = 0;
+    moves = 0;
+}
+
+uint32_t DropletModelCPU::getBatches() const {
+    const uint64_t total = (uint64_t)std::max(params.droplets, 0.0f);
+    return (uint32_t)((total + getBatchSize() - 1) / getBatchSize());
+}
+
+void DropletModelCPU::step() {
+    const uint64_t total = (uint64_t)std::max(params.droplets, 0.0f);
+    if (droplets >= total || state.getWidth() < 2 || state.getHeight() < 2)
+        return;
+    const int count = (int)std::min<uint64_t>(getBatchSize(), total - droplets);
+
+    pool->parallel_for(0, Chunks, [&](int c) {
+        const int first = c * droplets_per_chunk;
+        const int n = std::min(count - first, droplets_per_chunk);
+        if (n > 0)
+            run_chunk(accumulators[c], first, n);
+    });
+    pool->parallel_for(0, tiles_y, [&](int ty) {merge_tiles(ty);});
+    pool->parallel_for(0, tiles_y, [&](int ty) {apply_tiles(ty);});
+
+    for (Accumulator& acc : accumulators) {
+        for (int32_t t : acc.touched)
+            acc.slot[t] = -1;
+        acc.touched.clear();
+        acc.values.clear();
+        moves += acc.moves;
+        acc.moves = 0;
+    }
+    droplets += count;
+    ++iteration;
+}
+
+float* DropletModelCPU::Accumulator::tile(const DropletModelCPU& m, int x, int y) {
+    const int t = (y / TileSize) * m.tiles_x + x / TileSize;
+    if (slot[t] < 0) {
+        slot[t] = (int32_t)values.size();
+        touched.push_back(t);
+        values.resize(values.size() + TileSize * TileSize, 0.0f);
+    }
+    return values.data() + slot[t] + (y % TileSize) * TileSize + x % TileSize;
+}
+
+void DropletModelCPU::Accumulator::add(const DropletModelCPU& m, int32_t cell, float fx, float fy, float amount) {
+    const int stride = m.state.getStride();
+    const int x = cell % stride;
+    const int y = cell / stride;
+    const float weights[4] = {(1 - fx) * (1 - fy) * amount, fx * (1 - fy) * amount, (1 - fx) * fy * amount, fx * fy * amount};
+    // the 4 cells are in one tile unless the droplet is on its last row or column
+    if (x % TileSize < TileSize - 1 && y % TileSize < TileSize - 1) {
+        float* v = tile(m, x, y);
+        v[0] += weights[0];
+        v[1] += weights[1];
+        v[TileSize] += weights[2];
+        v[TileSize + 1] += weights[3];
+        return;
+    }
+    for (int k = 0; k < 4; ++k)
+        *tile(m, x + (k & 1), y + (k >> 1)) += weights[k];
+}
+
+void DropletModelCPU::run_chunk(Accumulator& acc, uint32_t first, int count) {
+    const int w = state.getWidth();
+    const int h = state.getHeight();
+    const int stride = state.getStride();
+    const DropletKernelArgs args{
+        state.data(DropletField::Ground), w, h, stride,
+        cell_size, params.inertia, params.capacity, params.min_slope,
+        params.erosion_rate, params.deposition_rate, params.evaporation_rate, params.gravity
+    };
+    const uint32_t seed = (uint32_t)params.seed;
+    const int lifetime = std::max(1, (int)params.lifetime);
+    // spawn strictly inside [0, size - 1) where the 4 cells around a droplet exist
+    const float max_x = std::nextafter((float)(w - 1), 0.0f);
+    const float max_y = std::nextafter((float)(h - 1), 0.0f);
+
+    DropletBatch batch{};
+    DropletDeposits deposits;
+    int age[DropletLanes] = {};
+    int next = 0;
+    for (;;) {
+        int alive = 0;
+        for (int l = 0; l < DropletLanes; ++l) {
+            if (!batch.alive[l] && next < count) {
+                util::CounterRNG rng{seed, iteration, first + next++};
+                batch.x[l] = std::min(rng.uniform() * (w - 1), max_x);
+                batch.y[l] = std::min(rng.uniform() * (h - 1), max_y);
+                batch.dir_x[l] = 0;
+                batch.dir_y[l] = 0;
+                batch.speed[l] = 1;
+                batch.water[l] = 1;
+                batch.sediment[l] = 0;
+                batch.alive[l] = -1;
+                age[l] = 0;
+            }
+            alive += batch.alive[l] != 0;
+        }
+        if (alive == 0)
+            break;
+
+        stepDroplets(args, batch, deposits, level);
+        acc.moves += alive;
+        for (int l = 0; l < DropletLanes; ++l) {
+            if (deposits.amount[l] != 0)
+                acc.add(*this, deposits.cell[l], deposits.fx[l], deposits.fy[l], deposits.amount[l]);
+            // droplets at the end of their life leave their sediment where they are
+            if (batch.alive[l] && ++age[l] >= lifetime) {
+                const int ix = (int)batch.x[l];
+                const int iy = (int)batch.y[l];
+                if (batch.sediment[l] != 0)
+                    acc.add(*this, iy * stride + ix, batch.x[l] - ix, batch.y[l] - iy, batch.sediment[l]);
+                batch.sediment[l] = 0;
+                batch.alive[l] = 0;
+            }
+        }
+    }
+}
+
+void DropletModelCPU::merge_tiles(int ty) {
+    float sum[TileSize * TileSize];
+    const int w = state.getWidth();
+    const int h = state.getHeight();
+    for (int tx = 0; tx < tiles_x; ++tx) {
+        const int tile = ty * tiles_x + tx;
+        bool touched = false;
+        for (const Accumulator& acc : accumulators) {
+            if (acc.slot[tile] < 0)
+                continue;
+            const float* values = acc.values.data() + acc.slot[tile];
+            if (!touched)
+                std::copy_n(values, TileSize * TileSize, sum);
+            else
+                for (int i = 0; i < TileSize * TileSize; ++i)
+                    sum[i] += values[i];
+            touched = true;
+        }
+        touched_tiles[tile] = touched || held_tiles[tile];
+        if (!touched_tiles[tile])
+            continue;
+        if (!touched)
+            std::fill_n(sum, TileSize * TileSize, 0.0f);
+
+        // droplets of a batch do not see each other, so together they could dig a cell far below
+        // or pile it far above its neighbors. A batch may not move a cell past the lowest or
+        // highest ground around it, what is cut off stays held at the cell for the next batches
+        bool held_any = false;
+        const int x0 = tx * TileSize;
+        const int y0 = ty * TileSize;
+        const int x1 = std::min(x0 + TileSize, w);
+        const int y1 = std::min(y0 + TileSize, h);
+        for (int y = y0; y < y1; ++y) {
+            const float* row = sum + (y - y0) * TileSize;
+            float* out = &change.at(ScalarField::Value, 0, y);
+            float* held = &state.at(DropletField::Held, 0, y);
+            for (int x = x0; x < x1; ++x) {
+                const float ground = state.at(DropletField::Ground, x, y);
+                float lo = ground;
+                float hi = ground;
+                for (int ny = std::max(y - 1, 0); ny <= std::min(y + 1, h - 1); ++ny) {
+                    for (int nx = std::max(x - 1, 0); nx <= std::min(x + 1, w - 1); ++nx) {
+                        const float n = state.at(DropletField::Ground, nx, ny);
+                        lo = std::min(lo, n);
+                        hi = std::max(hi, n);
+                    }
+                }
+                const float want = row[x - x0] + held[x];
+                out[x] = std::clamp(ground + want, lo, hi) - ground;
+                held[x] = want - out[x];
+                held_any |= held[x] != 0;
+            }
+        }
+        held_tiles[tile] = held_any;
+    }
+}
+
+void DropletModelCPU::apply_tiles(int ty) {
+    for (int tx = 0; tx < tiles_x; ++tx) {
+        if (!touched_tiles[ty * tiles_x + tx])
+            continue;
+        const int x0 = tx * TileSize;
+        const int x1 = std::min(x0 + TileSize, state.getWidth());
+        const int y1 = std::min((ty + 1) * TileSize, state.getHeight());
+        for (int y = ty * TileSize; y < y1; ++y) {
+            float* ground = &state.at(DropletField::Ground, 0, y);
+            float* sand = &state.at(DropletField::Sand, 0, y);
+            const float* delta = &change.at(ScalarField::Value, 0, y);
+            // erosion takes the sand first and the rock below it once the sand is gone
+            for (int x = x0; x < x1; ++x) {
+                ground[x] = ground[x] + delta[x];
+                sand[x] = std::max(sand[x] + delta[x], 0.0f);
+            }
+        }
+    }
+}
+
+ErosionDiagnostics DropletModelCPU::getDiagnostics() const {
+    struct Sums {
+        double soil = 0;
+        double held = 0;
+        float min_height = INFINITY;
+        float max_height = -INFINITY;
+        uint64_t non_finite = 0;
+    };
+    const int w = state.getWidth();
+    const Sums sums = pool->parallel_reduce(0, state.getHeight(), TileSize, Sums{}, [&](int y0, int y1) {
+        Sums s;
+        for (int y = y0; y < y1; ++y) {
+            const float* ground = &state.at(DropletField::Ground, 0, y);
+            const float* held = &state.at(DropletField::Held, 0, y);
+            for (int x = 0; x < w; ++x) {
+                if (!std::isfinite(ground[x]) || !std::isfinite(held[x])) {
+                    ++s.non_finite;
+                    continue;
+                }
+                s.soil += ground[x];
+                s.held += held[x];
+                s.min_height = std::min(s.min_height, ground[x]);
+                s.max_height = std::max(s.max_height, ground[x]);
+            }
+        }
+        return s;
+    }, [](const Sums& a, const Sums& b) {
+        return Sums{a.soil + b.soil, a.held + b.held, std::min(a.min_height, b.min_height), std::max(a.max_height, b.max_height), a.non_finite + b.non_finite};
+    });
+
+    const double cell_area = (double)cell_size * cell_size;
+    ErosionDiagnostics d;
+    d.iteration = iteration;
+    d.soil = sums.soil * cell_area;
+    d.sediment = sums.held * cell_area;
+    d.min_height = sums.min_height;
+    d.max_height = sums.max_height;
+    d.non_finite = sums.non_finite;
+    return d;
+}
+
+void DropletModelCPU::copyTo(float* rgba) const {
+    const float inv_scale = 1.0f / elevation_scale;
+    for (int y = 0; y < state.getHeight(); ++y) {
+        for (int x = 0; x < state.getWidth(); ++x) {
+            float* cell = rgba + 4 * ((std::size_t)y * state.getWidth() + x);
+            const float sand = state.at(DropletField::Sand, x, y);
+            cell[0] = (state.at(DropletField::Ground, x, y) - sand) * inv_scale;
+            cell[1] = sand * inv_scale;
+        }
+    }
+}
+
+}
@@ -0,0 +1,225 @@
+/**
+ * @author Hunter Borlik
+ * @brief particle based hydraulic erosion with droplets advanced in SIMD batches
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ */
+#pragma once
+#ifndef DIRTBOX_DROPLET_CPU_H
+#define DIRTBOX_DROPLET_CPU_H
+
+#include <vector>
+#include <cstdint>
+
+#include <util/parameter.h>
+#include <util/thread_pool.h>
+#include <terrain/soa_grid.h>
+#include <terrain/erosion_kernels.h>
+#include <terrain/erosion_diagnostics.h>
+
+namespace dirtbox::terrain {
+
+/**
+ * @brief settings of the droplet model. Cell size and elevation scale come from the engine
+ *
+ */
+struct DropletParameters {
+    // droplets of the whole run
+    float droplets          = 1000000;
+    // cells a droplet moves at most before it deposits what it carries
+    float lifetime          = 64;
+    // share of the last direction kept in each move, 0 follows the gradient
+    float inertia           = 0.05f;
+    // sediment a droplet of speed and water 1 carries on a slope of 1, m
+    float capacity          = 4;
+    // slope the capacity is computed with on flat ground
+    float min_slope         = 0.01f;
+    // share of the free capacity eroded per move
+    float erosion_rate      = 0.3f;
+    // share of the excess sediment deposited per move
+    float deposition_rate   = 0.3f;
+    // share of the water evaporating per move
+    float evaporation_rate  = 0.01f;
+    float gravity           = 4;
+    float seed              = 0;
+
+    void toParameterSet(util::ParameterCollection<float>& parameters) {
+        parameters.addParameter("droplets", 10000, 50000000, droplets);
+        parameters.addParameter("droplet_lifetime", 1, 256, lifetime);
+        parameters.addParameter("droplet_inertia", 0, 1, inertia);
+        parameters.addParameter("droplet_capacity", 0.1f, 32, capacity);
+        parameters.addParameter("droplet_min_slope", 0, 0.1f, min_slope);
+        parameters.addParameter("droplet_erosion", 0, 1, erosion_rate);
+        parameters.addParameter("droplet_deposition", 0, 1, deposition_rate);
+        parameters.addParameter("droplet_evaporation", 0, 0.5f, evaporation_rate);
+        parameters.addParameter("droplet_gravity", 0.1f, 20, gravity);
+        parameters.addParameter("droplet_seed", 0, 0, seed);
+    }
+
+    void fromParameterSet(const util::ParameterCollection<float>& p) {
+        droplets            = p.getParam("droplets");
+        lifetime            = p.getParam("droplet_lifetime");
+        inertia             = p.getParam("droplet_inertia");
+        capacity            = p.getParam("droplet_capacity");
+        min_slope           = p.getParam("droplet_min_slope");
+        erosion_rate        = p.getParam("droplet_erosion");
+        deposition_rate     = p.getParam("droplet_deposition");
+        evaporation_rate    = p.getParam("droplet_evaporation");
+        gravity             = p.getParam("droplet_gravity");
+        seed                = p.getParam("droplet_seed");
+    }
+};
+
+/**
+ * @brief droplet model state planes, elevations in meters
+ *
+ */
+enum class DropletField : uint8_t {
+    Ground,     // rock and sand, what the droplets run over
+    Sand,       // deposited sediment on top of the rock, eroded first
+    Held,       // ground change a batch could not apply, added to the next ones. Counts as sediment
+    Count
+};
+
+using DropletGrid = SoAGrid<DropletField>;
+
+/**
+ * @brief Droplet hydraulic erosion: each droplet spawns at a random cell, follows the bilinear
+ * height gradient one cell per move, erodes while it carries less than its capacity and deposits
+ * otherwise. Has no dependency on the renderer.
+ *
+ * A step runs one batch of getBatchSize() droplets, split into Chunks fixed chunks. A chunk
+ * keeps DropletLanes droplets in flight in the SoA lanes of stepDroplets and refills lanes as
+ * droplets finish. Every droplet of a batch reads the ground as it was at the start of the batch;
+ * chunks add their deposits to their own sparse tile accumulators, which are merged into the grid
+ * in chunk order at the end of the batch. Since the droplets of a batch cannot see each other's
+ * erosion, the merge keeps every cell within the lowest and highest ground around it and holds
+ * back the rest in the Held plane, so the ground and held sediment together are conserved. The split
+ * does not depend on the thread count, so results are bit identical for any pool size and every
+ * SimdLevel.
+ *
+ */
+class DropletModelCPU {
+public:
+    // independent droplet streams of a batch, the unit of parallel work
+    static constexpr int Chunks = 16;
+    static constexpr int MinDropletsPerChunk = 1024;
+    // a batch has a droplet per CellsPerDroplet cells or more, so merging the accumulators, which
+    // costs about a grid per chunk once droplets cover the grid, stays small against the moves
+    static constexpr int CellsPerDroplet = 4;
+    // cells per side of an accumulator tile
+    static constexpr int TileSize = 16;
+    // bytes read and written per droplet move, 8 height reads and 4 deposits, for throughput stats
+    static constexpr int MoveBytes = sizeof(float) * 12;
+
+    DropletModelCPU(const DropletParameters& params, float cell_size, float elevation_scale);
+
+    /**
+     * @brief initialize from terrain data
+     *
+     * @param width at least 2
+     * @param height at least 2
+     * @param rgba terrain RGBA32F texture data, width * height * 4 floats
+     */
+    void init(int width, int height, const float* rgba);
+
+    /**
+     * @brief run the next batch of droplets, fewer than getBatchSize() for the last one
+     *
+     */
+    void step();
+
+    /**
+     * @brief write the rock and sand layers into the terrain RGBA32F texture layout. Water and
+     * sediment are left unchanged.
+     *
+     * @param rgba width * height * 4 floats
+     */
+    void copyTo(float* rgba) const;
+
+    /**
+     * @brief pool the chunks run on. Results do not depend on the pool size
+     *
+     * @param pool
+     */
+    void setThreadPool(util::ThreadPool& pool) {this->pool = &pool;}
+
+    /**
+     * @brief instruction set of stepDroplets. Results do not depend on it
+     *
+     * @param level
+     */
+    void setSimdLevel(SimdLevel level) {this->level = level;}
+
+    uint64_t getStateHash() const {return state.hash();}
+
+    int getWidth() const {return state.getWidth();}
+    int getHeight() const {return state.getHeight();}
+    // batches run
+    uint32_t getIteration() const {return iteration;}
+    uint32_t getBatches() const;
+    // droplets per batch, depends on the grid size only
+    int getBatchSize() const {return Chunks * droplets_per_chunk;}
+    // droplets of the batches run
+    uint64_t getDroplets() const {return droplets;}
+    // moves of all droplets run, the work a batch scales with
+    uint64_t getMoves() const {return moves;}
+    const DropletParameters& getParameters() const {return params;}
+
+    const DropletGrid& getState() const {return state;}
+
+    /**
+     * @brief soil and held sediment volumes and the height range of the current state. Held
+     * sediment is negative where a batch eroded more than the cell could give. Reduced in fixed
+     * bands, the result does not depend on the pool size
+     *
+     * @return ErosionDiagnostics
+     */
+    ErosionDiagnostics getDiagnostics() const;
+
+private:
+    // sum of the deposits of one chunk, 16x16 tiles allocated on first touch
+    struct Accumulator {
+        // offset of the tile in values, -1 while untouched
+        std::vector<int32_t> slot;
+        std::vector<int32_t> touched;
+        std::vector<float> values;
+        uint64_t moves = 0;
+
+        // value of cell (x, y), allocates its tile
+        float* tile(const DropletModelCPU& m, int x, int y);
+        void add(const DropletModelCPU& m, int32_t cell, float fx, float fy, float amount);
+    };
+
+    // droplets [first, first + count) of the current batch
+    void run_chunk(Accumulator& acc, uint32_t first, int count);
+    // sum the accumulated deposits and held sediment of the tiles of tile row ty into change
+    void merge_tiles(int ty);
+    // add change to the ground of the tiles of tile row ty
+    void apply_tiles(int ty);
+
+    DropletParameters params;
+    float cell_size;
+    float elevation_scale;
+    util::ThreadPool* pool = &util::ThreadPool::Get();
+    SimdLevel level = getSimdLevel();
+    uint32_t iteration = 0;
+    uint64_t droplets = 0;
+    uint64_t moves = 0;
+
+    DropletGrid state;
+    int droplets_per_chunk = MinDropletsPerChunk;
+    int tiles_x = 0;
+    int tiles_y = 0;
+    std::vector<Accumulator> accumulators;
+    // ground change of the batch after limiting, valid in touched tiles
+    SoAGrid<ScalarField> change;
+    std::vector<uint8_t> touched_tiles;
+    // tiles with held sediment, merged even when no droplet touched them
+    std::vector<uint8_t> held_tiles;
+};
+
+}
+
+#endif // DIRTBOX_DROPLET_CPU_H
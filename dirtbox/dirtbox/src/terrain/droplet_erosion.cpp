@@ -0,0 +1,58 @@
+#include <terrain/droplet_erosion.h>
+
+#include <limits>
+#include <chrono>
+
+#include <terrain/droplet_cpu.h>
+
+namespace dirtbox::terrain {
+
+DropletErosionSimulation::DropletErosionSimulation(std::shared_ptr<Terrain> target)
+    : CPUErosion{"DropletErosionSimulation", std::move(target)}
+{
+    DropletParameters{}.toParameterSet(parameters);
+    ErosionDiagnosticsParameters{}.toParameterSet(parameters);
+    // same names and ranges as the Erosion2 parameters
+    parameters.addParameter("cell_size", 0.5f, 150.0f, 30.0f);
+    parameters.addParameter("terrain_elevation_scale", 1, 500, 100);
+}
+
+// on task thread
+void DropletErosionSimulation::runErosion(resource::ImageData& terrain, std::atomic_uint32_t& progress, const std::future<void>& kill_me) {
+    DropletParameters params;
+    params.fromParameterSet(taskParameters());
+
+    DropletModelCPU model{params, taskParameters().getParam("cell_size"), taskParameters().getParam("terrain_elevation_scale")};
+    float* data = static_cast<float*>(terrain.get()->m_data);
+    model.init(terrain.getWidth(), terrain.getHeight(), data);
+
+    // the soil and held sediment drift shows the material lost off the border of the grid
+    ErosionDiagnosticsParameters checks;
+    checks.fromParameterSet(taskParameters());
+    const float cell_size = taskParameters().getParam("cell_size");
+    diagnostics.start((double)model.getWidth() * model.getHeight() * cell_size * cell_size, checks.drift_warning);
+    if (checks.enabled())
+        diagnostics.record(model.getDiagnostics());
+
+    const uint32_t batches = model.getBatches();
+    const unsigned int threads = util::ThreadPool::Get().getNumThreads();
+    while (model.getIteration() < batches && !stopRequested(kill_me)) {
+        const uint64_t droplets = model.getDroplets();
+        const uint64_t moves = model.getMoves();
+        const auto start = std::chrono::steady_clock::now();
+        model.step();
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        const float done_fraction = (float)model.getIteration() / batches;
+        progress.store(done_fraction * std::numeric_limits<uint32_t>::max());
+        // a droplet move updates the 4 cells around it
+        const uint64_t batch_moves = model.getMoves() - moves;
+        stats.addSteps(1, 4 * batch_moves, batch_moves * DropletModelCPU::MoveBytes, seconds, done_fraction, model.getDroplets() - droplets, threads);
+        if (checks.enabled() && (model.getIteration() % checks.interval() == 0 || model.getIteration() == batches))
+            diagnostics.record(model.getDiagnostics());
+        if (snapshotDue())
+            publishSnapshot([&](float* rgba) {model.copyTo(rgba);});
+    }
+    model.copyTo(data);
+}
+
+}
@@ -0,0 +1,32 @@
+/**
+ * @author Hunter Borlik
+ * @brief droplet hydraulic erosion engine
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ */
+#pragma once
+#ifndef DIRTBOX_DROPLET_EROSION_H
+#define DIRTBOX_DROPLET_EROSION_H
+
+#include <terrain/erosion_cpu.h>
+
+namespace dirtbox::terrain {
+
+/**
+ * @brief Erodes with millions of independent droplets on DropletModelCPU instead of the grid
+ * pipe model. Cuts sharp gullies quickly but carries no water or sediment between batches. Reports
+ * droplets per second and per core in its stats for sizing jobs
+ *
+ */
+class DropletErosionSimulation : public CPUErosion {
+public:
+    DropletErosionSimulation(std::shared_ptr<Terrain> target);
+
+protected:
+    void runErosion(resource::ImageData& terrain, std::atomic_uint32_t& progress, const std::future<void>& kill_me) override;
+};
+
+}
+
+#endif // DIRTBOX_DROPLET_EROSION_H
@@ -14,10 +14,15 @@
 
 #include <memory>
 #include <functional>
+#include <cstdint>
+#include <string>
 
 #include <graphics/texture.h>
 
 #include <util/parameter.h>
+#include <terrain/terrain_region.h>
+#include <terrain/erosion_stats.h>
+#include <terrain/erosion_diagnostics.h>
 
 namespace dirtbox::terrain {
 
@@ -25,6 +30,9 @@ class Terrain;
 
 class Erosion {
 public:
+    // bgfx view the GPU engines submit their compute passes to
+    static constexpr bgfx::ViewId ComputeView = 3;
+
     Erosion(const std::string& Name, std::shared_ptr<Terrain> target) : Name{Name}, target{std::move(target)} {}
     virtual ~Erosion() {}
 
@@ -38,12 +46,133 @@ public:
     virtual float getProgress() const = 0;
     virtual bool isRunning() const = 0;
     virtual void update() = 0;
+
+    /**
+     * @brief throughput, timings and ETA of the current or last run
+     * 
+     * @return ErosionStats 
+     */
+    ErosionStats getStats() const {return stats.get();}
+
+    /**
+     * @brief water, sediment and soil totals of the current or last run, reduced every
+     * diagnostics_interval iterations, and their drift since the start of the run. A run whose
+     * state goes non-finite is stopped, as is a run whose height stops changing with the
+     * convergence parameters set
+     * 
+     * @return ErosionDiagnosticsReport empty when the engine has no diagnostics
+     */
+    ErosionDiagnosticsReport getDiagnostics() const {return diagnostics.get();}
+
+    /**
+     * @brief re-erode the terrain around an edited region instead of the whole map. The region
+     * grown by the influence_margin parameter is simulated for incremental_iterations, seeded
+     * from the water and sediment in the terrain and the flow state of the last run, and blended
+     * back into the terrain. Cost follows the size of the edit, not of the map
+     * 
+     * @param dirty edited cells
+     * @return false when running, the region is empty or the engine does not support it
+     */
+    virtual bool startIncrementalErosion(const TerrainRegion& dirty) {return false;}
+
+    /**
+     * @brief xxHash64 of the terrain written by the last completed run. CPU engines produce the
+     * same hash for the same input, parameters and seed regardless of the thread count
+     * 
+     * @return uint64_t 0 when no run has completed or the engine does not support it
+     */
+    virtual uint64_t getRunHash() const {return 0;}
+
+    /**
+     * @brief tile updates skipped by the sparse active tile update of the current or last run
+     * 
+     * @return uint64_t 0 when the engine does not skip tiles
+     */
+    virtual uint64_t getSkippedTiles() const {return 0;}
+
+    /**
+     * @brief seconds of simulated time of the current or last run
+     * 
+     * @return double 0 when the engine does not track it
+     */
+    virtual double getSimulatedTime() const {return 0;}
+
+    /**
+     * @brief current time step in seconds, changes during the run with adaptive time steps
+     * 
+     * @return float 0 when the engine does not track it
+     */
+    virtual float getTimeStep() const {return 0;}
+
+    /**
+     * @brief write a checkpoint of the running simulation to filename. The state is captured at
+     * the next iteration boundary and written in the background
+     * 
+     * @param filename 
+     * @return false when not running or not supported by the engine
+     */
+    virtual bool saveCheckpoint(const std::string& filename) {return false;}
+
+    /**
+     * @brief load a checkpoint written by the same engine, restore its parameters and continue
+     * the run from its iteration. The checkpoint must match the terrain size
+     * 
+     * @param filename 
+     * @return false when a run is active or the engine does not support checkpoints
+     */
+    virtual bool resumeFromCheckpoint(const std::string& filename) {return false;}
+
+    /**
+     * @brief while running, write a checkpoint to filename every interval iterations. Applies to
+     * runs started after the call
+     * 
+     * @param filename 
+     * @param interval iterations between checkpoints, 0 disables periodic checkpoints
+     */
+    void setCheckpointing(const std::string& filename, uint32_t interval) {
+        checkpoint_file = filename;
+        checkpoint_interval = interval;
+    }
+
+    /**
+     * @brief result of the last checkpoint operation, empty if there was none
+     * 
+     * @return const std::string& 
+     */
+    const std::string& getCheckpointStatus() const {return checkpoint_status;}
     
     const std::string Name;
 
 protected:
+    /**
+     * @brief GPU time of the compute view in a recent frame
+     * 
+     * @return float ms, 0 when not available. View timings are only collected with BGFX_DEBUG_PROFILER
+     */
+    static float computeViewMs() {
+        const bgfx::Stats* stats = bgfx::getStats();
+        for (uint16_t i = 0; i < stats->numViews; ++i) {
+            const auto& view = stats->viewStats[i];
+            if (view.view == ComputeView && stats->gpuTimerFreq > 0)
+                return float(double(view.gpuTimeEnd - view.gpuTimeBegin) * 1000.0 / stats->gpuTimerFreq);
+        }
+        return 0;
+    }
+
+    void applyParams(const util::ParameterList<float>& params) {
+        for (const auto& p : params)
+            parameters.setParam(p.name, p.value);
+    }
+
     util::ParameterCollection<float> parameters;
     std::shared_ptr<Terrain> target;
+
+    std::string checkpoint_file;
+    uint32_t checkpoint_interval = 0;
+    std::string checkpoint_status;
+    // fed by the engines while running
+    ErosionStatsRecorder stats;
+    ErosionDiagnosticsMonitor diagnostics;
 };
 
 }
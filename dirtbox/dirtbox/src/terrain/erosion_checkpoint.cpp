@@ -0,0 +1,282 @@
+#include <terrain/erosion_checkpoint.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <algorithm>
+#include <utility>
+
+namespace dirtbox::terrain {
+
+namespace {
+
+constexpr char Magic[4] = {'D', 'B', 'C', 'K'};
+constexpr uint32_t Version = 1;
+
+class ChunkWriter {
+public:
+    explicit ChunkWriter(std::ofstream& out) : out{out} {}
+
+    void begin(const char (&tag)[5]) {
+        out.write(tag, 4);
+        size_pos = out.tellp();
+        put<uint64_t>(0);
+        start = out.tellp();
+    }
+
+    void end() {
+        const auto stop = out.tellp();
+        out.seekp(size_pos);
+        put<uint64_t>(stop - start);
+        out.seekp(stop);
+    }
+
+    template<typename T>
+    void put(T v) {
+        out.write(reinterpret_cast<const char*>(&v), sizeof(T));
+    }
+
+    void putString(const std::string& s) {
+        put<uint32_t>(s.size());
+        out.write(s.data(), s.size());
+    }
+
+    void putFloats(const float* v, std::size_t n) {
+        out.write(reinterpret_cast<const char*>(v), n * sizeof(float));
+    }
+
+private:
+    std::ofstream& out;
+    std::streampos size_pos;
+    std::streampos start;
+};
+
+class ChunkReader {
+public:
+    ChunkReader(const char* data, std::size_t size) : data{data}, size{size} {}
+
+    template<typename T>
+    bool get(T& v) {
+        if (size - pos < sizeof(T))
+            return false;
+        std::memcpy(&v, data + pos, sizeof(T));
+        pos += sizeof(T);
+        return true;
+    }
+
+    bool getString(std::string& s) {
+        uint32_t n;
+        if (!get(n) || size - pos < n)
+            return false;
+        s.assign(data + pos, n);
+        pos += n;
+        return true;
+    }
+
+    std::size_t remaining() const {return size - pos;}
+
+    bool getFloats(float* v, std::size_t n) {
+        if ((size - pos) / sizeof(float) < n)
+            return false;
+        if (n == 0)
+            return true;
+        std::memcpy(v, data + pos, n * sizeof(float));
+        pos += n * sizeof(float);
+        return true;
+    }
+
+private:
+    const char* data;
+    std::size_t size;
+    std::size_t pos = 0;
+};
+
+}
+
+void ErosionCheckpoint::addPlane(const std::string& name, int width, int height, int channels, const float* data, std::ptrdiff_t stride) {
+    const std::size_t row = (std::size_t)width * channels;
+    if (stride == 0)
+        stride = row;
+
+    Plane& p = planes.emplace_back();
+    p.name = name;
+    p.width = width;
+    p.height = height;
+    p.channels = channels;
+    p.data.resize(row * height);
+    for (int y = 0; y < height; ++y)
+        std::copy_n(data + y * stride, row, p.data.data() + y * row);
+}
+
+bool ErosionCheckpoint::readPlane(const std::string& name, int width, int height, int channels, float* data, std::ptrdiff_t stride) const {
+    const Plane* p = findPlane(name);
+    if (!p || p->width != width || p->height != height || p->channels != channels)
+        return false;
+
+    const std::size_t row = (std::size_t)width * channels;
+    if (stride == 0)
+        stride = row;
+    for (int y = 0; y < height; ++y)
+        std::copy_n(p->data.data() + y * row, row, data + y * stride);
+    return true;
+}
+
+const ErosionCheckpoint::Plane* ErosionCheckpoint::findPlane(const std::string& name) const {
+    auto it = std::find_if(planes.begin(), planes.end(), [&name](const Plane& p) {return p.name == name;});
+    return it != planes.end() ? &*it : nullptr;
+}
+
+bool ErosionCheckpoint::save(const std::string& filename) const {
+    const std::string tmp = filename + ".tmp";
+    {
+        std::ofstream out{tmp, std::ios::binary | std::ios::trunc};
+        if (!out)
+            return false;
+
+        out.write(Magic, 4);
+        ChunkWriter w{out};
+        w.put(Version);
+
+        w.begin("HEAD");
+        w.putString(engine);
+        w.put(iteration);
+        w.end();
+
+        w.begin("TIME");
+        w.put(simulated_time);
+        w.put(time_step);
+        w.end();
+
+        w.begin("PARM");
+        w.put<uint32_t>(parameters.size());
+        for (const auto& p : parameters) {
+            w.putString(p.name);
+            w.put(p.value);
+        }
+        w.end();
+
+        for (const auto& p : planes) {
+            w.begin("PLAN");
+            w.putString(p.name);
+            w.put<int32_t>(p.width);
+            w.put<int32_t>(p.height);
+            w.put<int32_t>(p.channels);
+            w.putFloats(p.data.data(), p.data.size());
+            w.end();
+        }
+
+        w.begin("END ");
+        w.end();
+
+        if (!out.good())
+            return false;
+    }
+    return std::rename(tmp.c_str(), filename.c_str()) == 0;
+}
+
+std::optional<ErosionCheckpoint> ErosionCheckpoint::load(const std::string& filename) {
+    // sizes come from the file, a cut short or corrupt file must not take the caller down
+    try {
+        return read(filename);
+    } catch (const std::exception&) {
+        return {};
+    }
+}
+
+std::optional<ErosionCheckpoint> ErosionCheckpoint::read(const std::string& filename) {
+    std::ifstream in{filename, std::ios::binary | std::ios::ate};
+    if (!in)
+        return {};
+    const std::streamoff file_size = in.tellg();
+    in.seekg(0);
+    char magic[4];
+    uint32_t version;
+    if (!in.read(magic, 4) || std::memcmp(magic, Magic, 4) != 0)
+        return {};
+    if (!in.read(reinterpret_cast<char*>(&version), sizeof(version)) || version != Version)
+        return {};
+
+    ErosionCheckpoint cp;
+    bool complete = false;
+    std::vector<char> payload;
+    char tag[4];
+    uint64_t size;
+    while (!complete && in.read(tag, 4) && in.read(reinterpret_cast<char*>(&size), sizeof(size))) {
+        // a chunk can not be larger than what is left of the file
+        const std::streamoff left = file_size - in.tellg();
+        if (left < 0 || size > (uint64_t)left)
+            return {};
+        payload.resize(size);
+        if (!in.read(payload.data(), size))
+            return {};
+        ChunkReader r{payload.data(), payload.size()};
+
+        if (std::memcmp(tag, "HEAD", 4) == 0) {
+            if (!r.getString(cp.engine) || !r.get(cp.iteration))
+                return {};
+        } else if (std::memcmp(tag, "TIME", 4) == 0) {
+            if (!r.get(cp.simulated_time) || !r.get(cp.time_step))
+                return {};
+        } else if (std::memcmp(tag, "PARM", 4) == 0) {
+            uint32_t n;
+            if (!r.get(n))
+                return {};
+            for (uint32_t i = 0; i < n; ++i) {
+                util::Parameter<float> p{};
+                if (!r.getString(p.name) || !r.get(p.value))
+                    return {};
+                cp.parameters.push_back(p);
+            }
+        } else if (std::memcmp(tag, "PLAN", 4) == 0) {
+            Plane p;
+            int32_t w, h, c;
+            if (!r.getString(p.name) || !r.get(w) || !r.get(h) || !r.get(c) || w < 0 || h < 0 || c <= 0)
+                return {};
+            p.width = w;
+            p.height = h;
+            p.channels = c;
+            // w * h fits 64 bits, check the channels by division so the product can not overflow
+            const uint64_t cells = (uint64_t)w * h;
+            const uint64_t floats = r.remaining() / sizeof(float);
+            if (cells > 0 && (uint64_t)c > floats / cells)
+                return {};
+            p.data.resize(cells * c);
+            if (!r.getFloats(p.data.data(), p.data.size()))
+                return {};
+            cp.planes.push_back(std::move(p));
+        } else if (std::memcmp(tag, "END ", 4) == 0) {
+            complete = true;
+        }
+    }
+
+    // a missing END chunk means the file was cut short
+    if (!complete)
+        return {};
+    return cp;
+}
+
+bool CheckpointWriter::submit(ErosionCheckpoint&& checkpoint, const std::string& filename) {
+    if (isBusy())
+        return false;
+    // keep the result of the last write until it is taken
+    if (pending.valid())
+        finished = pending.get();
+    pending = std::async(std::launch::async, [filename](ErosionCheckpoint cp) {
+        return cp.save(filename);
+    }, std::move(checkpoint));
+    return true;
+}
+
+std::optional<bool> CheckpointWriter::takeResult() {
+    if (pending.valid() && !isBusy())
+        finished = pending.get();
+    return std::exchange(finished, std::nullopt);
+}
+
+std::optional<bool> CheckpointWriter::wait() {
+    if (pending.valid())
+        finished = pending.get();
+    return std::exchange(finished, std::nullopt);
+}
+
+}
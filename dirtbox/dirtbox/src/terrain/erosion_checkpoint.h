@@ -0,0 +1,146 @@
+/**
+ * @author Hunter Borlik
+ * @brief erosion checkpoint files
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ */
+#pragma once
+#ifndef DIRTBOX_EROSION_CHECKPOINT_H
+#define DIRTBOX_EROSION_CHECKPOINT_H
+
+#include <string>
+#include <vector>
+#include <future>
+#include <cstdint>
+#include <cstddef>
+#include <optional>
+
+#include <util/parameter.h>
+
+namespace dirtbox::terrain {
+
+/**
+ * @brief Complete state of an erosion run: engine name, iteration counter, parameters and every
+ * state plane.
+ *
+ * Stored as a chunked file: the magic "DBCK" and a version, followed by chunks of a 4 character
+ * tag, a 64 bit payload size and the payload. Readers skip chunks they do not know. Values are
+ * in host byte order.
+ *
+ *  HEAD    engine name, iteration
+ *  TIME    simulated time in seconds (double), current time step (float)
+ *  PARM    parameter count, then name and value of each parameter
+ *  PLAN    plane name, width, height, channels, width * height * channels floats
+ *  END     end of file
+ *
+ */
+struct ErosionCheckpoint {
+    struct Plane {
+        std::string name;
+        int width = 0;
+        int height = 0;
+        int channels = 1;
+        std::vector<float> data;
+    };
+
+    std::string engine;
+    uint32_t iteration = 0;
+    // for models with adaptive time steps
+    double simulated_time = 0;
+    float time_step = 0;
+    util::ParameterList<float> parameters;
+    std::vector<Plane> planes;
+
+    /**
+     * @brief copy a plane into the checkpoint
+     *
+     * @param name
+     * @param width
+     * @param height
+     * @param channels interleaved values per cell
+     * @param data first row
+     * @param stride values between rows, width * channels when 0
+     */
+    void addPlane(const std::string& name, int width, int height, int channels, const float* data, std::ptrdiff_t stride = 0);
+
+    /**
+     * @brief copy a plane out of the checkpoint
+     *
+     * @param name
+     * @param width expected width
+     * @param height expected height
+     * @param channels expected channels
+     * @param data first row
+     * @param stride values between rows, width * channels when 0
+     * @return false if the plane is missing or has a different size
+     */
+    bool readPlane(const std::string& name, int width, int height, int channels, float* data, std::ptrdiff_t stride = 0) const;
+
+    const Plane* findPlane(const std::string& name) const;
+
+    /**
+     * @brief write to filename. Writes to a temporary file first and renames it, so an existing
+     * checkpoint is never left half written
+     *
+     * @param filename
+     * @return true on success
+     */
+    bool save(const std::string& filename) const;
+
+    /**
+     * @brief read a checkpoint written by save
+     *
+     * @param filename
+     * @return std::nullopt if the file is missing, cut short or corrupt
+     */
+    static std::optional<ErosionCheckpoint> load(const std::string& filename);
+
+private:
+    static std::optional<ErosionCheckpoint> read(const std::string& filename);
+};
+
+/**
+ * @brief Writes checkpoints on a background thread. Only one write is in flight; while it runs
+ * further checkpoints are dropped instead of queued, so the simulation never waits on the disk.
+ *
+ */
+class CheckpointWriter {
+public:
+    ~CheckpointWriter() {wait();}
+
+    bool isBusy() const {
+        return pending.valid() && pending.wait_for(std::chrono::seconds(0)) != std::future_status::ready;
+    }
+
+    /**
+     * @brief start writing checkpoint to filename
+     *
+     * @param checkpoint
+     * @param filename
+     * @return false when a write is still in flight and the checkpoint was dropped
+     */
+    bool submit(ErosionCheckpoint&& checkpoint, const std::string& filename);
+
+    /**
+     * @brief result of the last finished write, once
+     *
+     * @return std::nullopt while a write is in flight or no result is left to take
+     */
+    std::optional<bool> takeResult();
+
+    /**
+     * @brief wait for the write in flight
+     *
+     * @return result of the last write not taken yet, std::nullopt if there is none
+     */
+    std::optional<bool> wait();
+
+private:
+    std::future<bool> pending;
+    std::optional<bool> finished;
+};
+
+}
+
+#endif // DIRTBOX_EROSION_CHECKPOINT_H
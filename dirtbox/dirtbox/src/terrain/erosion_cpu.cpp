@@ -0,0 +1,246 @@
+#include <terrain/erosion_cpu.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include <terrain/terrain.h>
+#include <util/hash.h>
+
+namespace dirtbox::terrain {
+
+CPUErosion::CPUErosion(const std::string& Name, std::shared_ptr<Terrain> target)
+    : Erosion{Name, std::move(target)},
+    m_task{util::AsyncProgressTask::TaskFnType::create<CPUErosion, &CPUErosion::run_task>(this)} {
+}
+
+CPUErosion::~CPUErosion() {
+    if (!m_task.isDone()) {
+        stopErosionTask();
+        while (!m_task.waitFor(std::chrono::milliseconds{10}))
+            ;
+    }
+    m_task.join();
+}
+
+void CPUErosion::startErosionTask() {
+    if (!m_pending && m_task.isDone()) {
+        // task is started by update() once the readback has completed
+        m_input = target->getTerrainTexture().getImageData();
+        m_region.reset();
+        m_pending = true;
+        m_stopping = false;
+    }
+}
+
+bool CPUErosion::startIncremental(const TerrainRegion& dirty) {
+    if (m_pending || !m_task.isDone())
+        return false;
+    const vec2u size = target->getSize();
+    IncrementalErosionParameters incremental;
+    incremental.fromParameterSet(parameters);
+
+    IncrementalRegion region;
+    region.margin = (int)incremental.influence_margin;
+    region.dirty = dirty.clamped(size.x(), size.y());
+    region.window = region.dirty.grown(region.margin, size.x(), size.y());
+    region.width = size.x();
+    region.height = size.y();
+    if (region.dirty.empty())
+        return false;
+
+    m_input = target->getTerrainTexture().getImageData();
+    m_region = region;
+    m_pending = true;
+    m_stopping = false;
+    return true;
+}
+
+bool CPUErosion::resumeFromCheckpoint(const std::string& filename) {
+    if (m_pending || !m_task.isDone())
+        return false;
+    m_resume_input = std::async(std::launch::async, &ErosionCheckpoint::load, filename);
+    m_input = target->getTerrainTexture().getImageData();
+    m_region.reset();
+    m_pending = true;
+    m_stopping = false;
+    return true;
+}
+
+bool CPUErosion::saveCheckpoint(const std::string& filename) {
+    if (!m_pending || m_task.isDone())
+        return false;
+    std::lock_guard<std::mutex> lock{m_save_mutex};
+    m_save_request = filename;
+    return true;
+}
+
+void CPUErosion::stopErosionTask() {
+    if (m_pending && !m_stopping) {
+        m_stopping = true;
+        if (!m_task.isDone())
+            m_task.notifyStop();
+    }
+}
+
+float CPUErosion::getProgress() const {
+    return m_task.getProgress();
+}
+
+bool CPUErosion::isRunning() const {
+    return m_pending;
+}
+
+void CPUErosion::update() {
+    if (!m_pending)
+        return;
+
+    takeTaskStatus();
+
+    if (m_input.valid()) {
+        if (m_input.wait_for(std::chrono::seconds(0)) == std::future_status::timeout)
+            return;
+        if (m_resume_input.valid() && m_resume_input.wait_for(std::chrono::seconds(0)) == std::future_status::timeout)
+            return;
+        m_data.emplace(m_input.get());
+        if (m_resume_input.valid()) {
+            m_resume = m_resume_input.get();
+            if (!m_resume || m_resume->engine != Name) {
+                checkpoint_status = "checkpoint could not be loaded";
+                m_resume.reset();
+                m_stopping = true;
+            } else {
+                applyParams(m_resume->parameters);
+                checkpoint_status = "resuming from iteration " + std::to_string(m_resume->iteration);
+            }
+        }
+        if (m_stopping) {
+            m_data.reset();
+            m_region.reset();
+            m_pending = false;
+        } else {
+            m_task_parameters = parameters;
+            m_task_checkpoint_file = checkpoint_file;
+            m_task_checkpoint_interval = checkpoint_interval;
+            if (!m_region) {
+                // the task copies the input into the slots before its first snapshot
+                m_snapshots.reset();
+                for (auto& slot : m_snapshots.all())
+                    if (!slot || slot->getWidth() != m_data->getWidth() || slot->getHeight() != m_data->getHeight())
+                        slot.emplace(resource::ImageData::CreateImage({m_data->getWidth(), m_data->getHeight()}, bgfx::TextureFormat::RGBA32F));
+            }
+            m_task.start();
+        }
+    } else if (!m_task.isDone()) {
+        // at most one upload per frame, older snapshots have been dropped
+        if (auto* snapshot = m_snapshots.consume())
+            target->updateTerrainData(**snapshot);
+    } else if (m_task.join()) {
+        // statuses set after the check above
+        takeTaskStatus();
+        if (m_region) {
+            // only the window has changed
+            const TerrainRegion& window = m_region->window;
+            auto image = resource::ImageData::CreateImage({(uint32_t)window.width(), (uint32_t)window.height()}, bgfx::TextureFormat::RGBA32F);
+            const auto cells = cropRGBA(static_cast<const float*>(m_data->get()->m_data), m_data->getWidth(), window);
+            std::copy(cells.begin(), cells.end(), static_cast<float*>(image.get()->m_data));
+            target->updateTerrainRegion(image, window.x0, window.y0);
+        } else {
+            target->updateTerrainData(*m_data);
+        }
+        m_run_hash = m_task_hash;
+        m_data.reset();
+        m_region.reset();
+        m_pending = false;
+    }
+}
+
+// on task thread
+void CPUErosion::run_task(std::atomic_uint32_t& progress, std::future<void> kill_me) {
+    skipped_tiles.store(0);
+    stats.start();
+    diagnostics.start();
+    if (!m_region) {
+        for (auto& slot : m_snapshots.all())
+            std::memcpy(slot->get()->m_data, m_data->get()->m_data, m_data->getSize());
+        m_last_snapshot = std::chrono::steady_clock::now();
+    }
+    simulated_time.store(0);
+    time_step.store(0);
+    if (m_region) {
+        float* data = static_cast<float*>(m_data->get()->m_data);
+        std::vector<float> window = cropRGBA(data, m_data->getWidth(), m_region->window);
+        runIncrementalErosion(window, *m_region, progress, kill_me);
+        blendRGBA(data, m_data->getWidth(), *m_region, window.data());
+    } else {
+        runErosion(*m_data, progress, kill_me);
+    }
+    m_resume.reset();
+    // the last checkpoint may still be in flight
+    reportWrite(m_checkpoint_writer.wait());
+    m_task_hash = util::XXHash64::hash(m_data->get()->m_data, m_data->getSize());
+}
+
+// on task thread
+bool CPUErosion::snapshotDue() const {
+    return !m_region && std::chrono::steady_clock::now() - m_last_snapshot >= SnapshotInterval;
+}
+
+// on task thread
+void CPUErosion::publishSnapshot(const std::function<void(float* rgba)>& write) {
+    write(static_cast<float*>(m_snapshots.back()->get()->m_data));
+    m_snapshots.publish();
+    m_last_snapshot = std::chrono::steady_clock::now();
+}
+
+// on task thread
+bool CPUErosion::checkpointDue(uint32_t iteration) {
+    if (m_checkpoint_writer.isBusy())
+        return false;
+    reportWrite(m_checkpoint_writer.takeResult());
+    std::lock_guard<std::mutex> lock{m_save_mutex};
+    if (!m_save_request.empty())
+        return true;
+    return m_task_checkpoint_interval > 0 && !m_task_checkpoint_file.empty() && iteration % m_task_checkpoint_interval == 0;
+}
+
+// on task thread
+void CPUErosion::submitCheckpoint(ErosionCheckpoint&& checkpoint) {
+    std::string filename;
+    {
+        std::lock_guard<std::mutex> lock{m_save_mutex};
+        filename = m_save_request.empty() ? m_task_checkpoint_file : m_save_request;
+        m_save_request.clear();
+    }
+    checkpoint.engine = Name;
+    checkpoint.parameters = m_task_parameters.getParams();
+    m_checkpoint_writer.submit(std::move(checkpoint), filename);
+}
+
+// on task thread
+bool CPUErosion::reportRestore(const ErosionCheckpoint& checkpoint, bool restored) {
+    if (restored)
+        setTaskStatus("resumed at iteration " + std::to_string(checkpoint.iteration));
+    else
+        setTaskStatus("checkpoint does not match the terrain size");
+    return restored;
+}
+
+// on task thread
+void CPUErosion::reportWrite(std::optional<bool> written) {
+    if (written)
+        setTaskStatus(*written ? "checkpoint written" : "checkpoint failed");
+}
+
+void CPUErosion::takeTaskStatus() {
+    std::lock_guard<std::mutex> lock{m_save_mutex};
+    if (!m_task_status.empty())
+        checkpoint_status = std::move(m_task_status);
+    m_task_status.clear();
+}
+
+void CPUErosion::setTaskStatus(std::string status) {
+    std::lock_guard<std::mutex> lock{m_save_mutex};
+    m_task_status = std::move(status);
+}
+
+}
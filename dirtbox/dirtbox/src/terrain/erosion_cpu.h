@@ -0,0 +1,202 @@
+/**
+ * @brief base for erosion models that run on the CPU
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ */
+#pragma once
+#ifndef DIRTBOX_EROSION_CPU_H
+#define DIRTBOX_EROSION_CPU_H
+
+#include <future>
+#include <atomic>
+#include <optional>
+#include <mutex>
+#include <vector>
+#include <chrono>
+#include <functional>
+
+#include <terrain/erosion.h>
+#include <terrain/erosion_checkpoint.h>
+#include <util/task.h>
+#include <util/triple_buffer.h>
+
+namespace dirtbox::terrain {
+
+/**
+ * @brief Runs a CPU erosion model on a background task. Terrain data is read back from the
+ * Terrain texture when started, the task is launched by update() once the data arrives and the
+ * results are written back to the Terrain texture by update() after the task has finished.
+ *
+ * While running, models publish snapshots through a triple buffer and update() uploads the
+ * latest one, so the viewport follows the run without the task ever waiting on the render loop.
+ *
+ * Models that implement runIncrementalErosion can re-erode a window around an edit, see
+ * startIncremental. Only the window is simulated and written back to the texture.
+ *
+ * Implementations must not let scheduling or the thread count change their results, so the run
+ * hash of a completed run identifies its output.
+ *
+ */
+class CPUErosion : public Erosion {
+public:
+    CPUErosion(const std::string& Name, std::shared_ptr<Terrain> target);
+    virtual ~CPUErosion();
+
+    void startErosionTask() override;
+    void stopErosionTask() override;
+
+    float getProgress() const override;
+    bool isRunning() const override;
+    void update() override;
+    uint64_t getRunHash() const override {return m_run_hash;}
+    uint64_t getSkippedTiles() const override {return skipped_tiles.load();}
+    double getSimulatedTime() const override {return simulated_time.load();}
+    float getTimeStep() const override {return time_step.load();}
+
+    bool saveCheckpoint(const std::string& filename) override;
+    bool resumeFromCheckpoint(const std::string& filename) override;
+
+protected:
+    /**
+     * @brief run the erosion model on the task thread
+     *
+     * @param terrain terrain data in RGBA32F. Results are written back into it
+     * @param progress progress in [0, uint32_t max]
+     * @param kill_me becomes ready when the task should stop early
+     */
+    virtual void runErosion(resource::ImageData& terrain, std::atomic_uint32_t& progress, const std::future<void>& kill_me) = 0;
+
+    /**
+     * @brief run the erosion model on the window of an incremental run on the task thread
+     *
+     * @param window terrain data of region.window in RGBA32F. Results are written back into it
+     * and blended into the terrain afterwards
+     * @param region dirty and window region
+     * @param progress progress in [0, uint32_t max]
+     * @param kill_me becomes ready when the task should stop early
+     */
+    virtual void runIncrementalErosion(std::vector<float>& window, const IncrementalRegion& region, std::atomic_uint32_t& progress, const std::future<void>& kill_me) {}
+
+    /**
+     * @brief on task thread. True when the viewport can take a new snapshot of the run, at most
+     * every SnapshotInterval. Incremental runs take no snapshots
+     *
+     * @return true
+     */
+    bool snapshotDue() const;
+
+    /**
+     * @brief on task thread. Publish a snapshot of the run, which update() uploads to the
+     * Terrain texture. A snapshot that has not been uploaded yet is dropped
+     *
+     * @param write fills terrain RGBA32F data, which holds the input terrain with the channels of
+     * an older snapshot
+     */
+    void publishSnapshot(const std::function<void(float* rgba)>& write);
+
+    /**
+     * @brief start an incremental run around dirty, for models implementing
+     * runIncrementalErosion. The window margin is the influence_margin parameter
+     *
+     * @param dirty
+     * @return false when running or the region is empty
+     */
+    bool startIncremental(const TerrainRegion& dirty);
+
+    static bool stopRequested(const std::future<void>& kill_me) {
+        return kill_me.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+
+    /**
+     * @brief on task thread. Checkpoint to continue from when the run was started by
+     * resumeFromCheckpoint. Its parameters have already been applied
+     *
+     * @return std::optional<ErosionCheckpoint>
+     */
+    std::optional<ErosionCheckpoint> takeResumeCheckpoint() {return std::move(m_resume);}
+
+    /**
+     * @brief on task thread. Parameters of the run, copied when it started. The UI may change
+     * the engine parameters meanwhile, runs and their checkpoints only read this copy
+     *
+     * @return const util::ParameterCollection<float>&
+     */
+    const util::ParameterCollection<float>& taskParameters() const {return m_task_parameters;}
+
+    /**
+     * @brief on task thread. Report the outcome of restoring the resume checkpoint to
+     * checkpoint_status
+     *
+     * @param checkpoint from takeResumeCheckpoint
+     * @param restored result of the model's restoreState
+     * @return restored
+     */
+    bool reportRestore(const ErosionCheckpoint& checkpoint, bool restored);
+
+    /**
+     * @brief on task thread. True when a checkpoint should be taken after iteration, either
+     * periodic or requested by saveCheckpoint, and the previous one has been written
+     *
+     * @param iteration completed iterations
+     * @return true
+     */
+    bool checkpointDue(uint32_t iteration);
+
+    /**
+     * @brief on task thread. Fill in engine name and parameters and write checkpoint in the
+     * background. Call after checkpointDue returned true
+     *
+     * @param checkpoint state planes and iteration
+     */
+    void submitCheckpoint(ErosionCheckpoint&& checkpoint);
+
+    // set by models with sparse tile updates, reset when a run starts
+    std::atomic_uint64_t skipped_tiles{0};
+    // set by models that track simulated time, reset when a run starts
+    std::atomic<double> simulated_time{0};
+    std::atomic<float> time_step{0};
+
+private:
+    void run_task(std::atomic_uint32_t& progress, std::future<void> kill_me);
+    // on task thread, turn a finished background write into a status
+    void reportWrite(std::optional<bool> written);
+    void setTaskStatus(std::string status);
+    // on main thread
+    void takeTaskStatus();
+
+    std::future<resource::ImageData> m_input;
+    std::future<std::optional<ErosionCheckpoint>> m_resume_input;
+    // owned by the task thread while it is running
+    std::optional<resource::ImageData> m_data;
+    std::optional<ErosionCheckpoint> m_resume;
+    // set while an incremental run is pending
+    std::optional<IncrementalRegion> m_region;
+
+    // intermediate results for the viewport, the task publishes and update() uploads them
+    static constexpr std::chrono::milliseconds SnapshotInterval{50};
+    util::TripleBuffer<std::optional<resource::ImageData>> m_snapshots;
+    std::chrono::steady_clock::time_point m_last_snapshot;
+
+    // hash of m_data computed by the task, published to m_run_hash by update()
+    uint64_t m_task_hash = 0;
+    uint64_t m_run_hash = 0;
+
+    // parameters and checkpoint settings copied when the task starts
+    util::ParameterCollection<float> m_task_parameters;
+    std::string m_task_checkpoint_file;
+    uint32_t m_task_checkpoint_interval = 0;
+    std::mutex m_save_mutex;
+    std::string m_save_request;
+    // status from the task thread, moved to checkpoint_status by update()
+    std::string m_task_status;
+    CheckpointWriter m_checkpoint_writer;
+
+    bool m_pending = false;
+    bool m_stopping = false;
+    util::AsyncProgressTask m_task;
+};
+
+}
+
+#endif // DIRTBOX_EROSION_CPU_H
@@ -0,0 +1,226 @@
+/**
+ * @author Hunter Borlik
+ * @brief conservation and stability diagnostics of erosion runs
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ */
+#pragma once
+#ifndef DIRTBOX_EROSION_DIAGNOSTICS_H
+#define DIRTBOX_EROSION_DIAGNOSTICS_H
+
+#include <cstdint>
+#include <cmath>
+#include <mutex>
+#include <optional>
+
+#include <util/parameter.h>
+
+namespace dirtbox::terrain {
+
+/**
+ * @brief totals over the state of a run at one iteration. Cells with a non-finite layer are
+ * counted and left out of every other value
+ *
+ */
+struct ErosionDiagnostics {
+    uint32_t iteration = 0;
+    // volumes, m^3
+    double water = 0;
+    double sediment = 0;    // suspended
+    double soil = 0;        // rock and sand
+    // ground height, m. inf and -inf when no cell is finite
+    float min_height = INFINITY;
+    float max_height = -INFINITY;
+    // cells with a NaN or infinite layer
+    uint64_t non_finite = 0;
+    // ground height change since the previous reduction of the run, m. Mean and largest absolute
+    // change, 0 for the first reduction
+    double change_mean = 0;
+    float change_max = 0;
+
+    // erosion and deposition only move volume between these two
+    double solids() const {return soil + sediment;}
+};
+
+/**
+ * @brief settings of the diagnostics reductions, on top of the engine parameters
+ *
+ */
+struct ErosionDiagnosticsParameters {
+    // iterations between reductions, < 1 disables them
+    float diagnostics_interval  = 100;
+    // change of soil and suspended sediment since the start of the run, as a mean depth over
+    // the terrain in m, above which the run is reported as drifting
+    float drift_warning         = 0.01f;
+
+    void toParameterSet(util::ParameterCollection<float>& parameters) {
+        parameters.addParameter("diagnostics_interval", 0, 5000, diagnostics_interval);
+        parameters.addParameter("drift_warning", 0.0001f, 1.0f, drift_warning);
+    }
+
+    void fromParameterSet(const util::ParameterCollection<float>& p) {
+        diagnostics_interval    = p.getParam("diagnostics_interval");
+        drift_warning           = p.getParam("drift_warning");
+    }
+
+    bool enabled() const {return diagnostics_interval >= 1;}
+    uint32_t interval() const {return (uint32_t)diagnostics_interval;}
+};
+
+/**
+ * @brief When the ground height changes by less than the tolerances over convergence_windows
+ * consecutive diagnostics intervals, the run has converged and is stopped, or with
+ * converged_slowdown continues at a reduced rate. Needs diagnostics_interval
+ *
+ */
+struct ErosionConvergenceParameters {
+    // consecutive quiet intervals, < 1 disables the detection
+    float convergence_windows           = 0;
+    // mean (L1) and largest (L-inf) absolute change per interval, m
+    float convergence_tolerance         = 0.0001f;
+    float convergence_max_tolerance     = 0.01f;
+    // keep running at a reduced rate once converged, on when >= 0.5
+    float converged_slowdown            = 0;
+
+    void toParameterSet(util::ParameterCollection<float>& parameters) {
+        parameters.addParameter("convergence_windows", 0, 50, convergence_windows);
+        parameters.addParameter("convergence_tolerance", 0.000001f, 0.01f, convergence_tolerance);
+        parameters.addParameter("convergence_max_tolerance", 0.00001f, 1.0f, convergence_max_tolerance);
+        parameters.addParameter("converged_slowdown", 0, 1, converged_slowdown);
+    }
+
+    void fromParameterSet(const util::ParameterCollection<float>& p) {
+        convergence_windows         = p.getParam("convergence_windows");
+        convergence_tolerance       = p.getParam("convergence_tolerance");
+        convergence_max_tolerance   = p.getParam("convergence_max_tolerance");
+        converged_slowdown          = p.getParam("converged_slowdown");
+    }
+
+    bool enabled() const {return convergence_windows >= 1;}
+    bool slowdown() const {return converged_slowdown >= 0.5f;}
+
+    bool quiet(const ErosionDiagnostics& d) const {
+        return d.change_mean < convergence_tolerance && d.change_max < convergence_max_tolerance;
+    }
+};
+
+/**
+ * @brief what a run should do after a reduction
+ *
+ */
+enum class DiagnosticsVerdict {
+    Continue,
+    // the state has gone non-finite, stop
+    Unstable,
+    // the height has stopped changing, stop or slow down
+    Converged
+};
+
+/**
+ * @brief the first and latest diagnostics of a run
+ *
+ */
+struct ErosionDiagnosticsReport {
+    std::optional<ErosionDiagnostics> first;
+    std::optional<ErosionDiagnostics> latest;
+    // change of ErosionDiagnostics::solids from first to latest as a mean depth, m. Sediment
+    // carried over the terrain border leaves legitimately, any other change is numerical loss
+    double drift = 0;
+    bool drifting = false;
+
+    // iteration of the reduction that completed the quiet intervals
+    std::optional<uint32_t> converged_at;
+    // iterations a converged run skipped by stopping early, 0 while it runs on slowed down
+    uint64_t iterations_saved = 0;
+
+    // the run produced non-finite values and was stopped
+    bool unstable() const {return latest && latest->non_finite > 0;}
+};
+
+/**
+ * @brief Collects the diagnostics of a run and detects convergence. Recorded by the thread
+ * running the model, get() may be called from any thread.
+ *
+ */
+class ErosionDiagnosticsMonitor {
+public:
+    /**
+     * @brief forget the last run
+     *
+     * @param area terrain area, m^2. No drift is reported when 0
+     * @param drift_warning see ErosionDiagnosticsParameters
+     * @param convergence
+     */
+    void start(double area = 0, float drift_warning = 0, const ErosionConvergenceParameters& convergence = {}) {
+        std::lock_guard lock{mutex};
+        first.reset();
+        latest.reset();
+        converged_at.reset();
+        iterations_saved = 0;
+        quiet_windows = 0;
+        this->area = area;
+        this->drift_warning = drift_warning;
+        this->convergence = convergence;
+    }
+
+    /**
+     * @brief record a reduction
+     *
+     * @param diagnostics
+     * @return DiagnosticsVerdict Converged once, at the reduction that completes the quiet
+     * intervals
+     */
+    DiagnosticsVerdict record(const ErosionDiagnostics& diagnostics) {
+        std::lock_guard lock{mutex};
+        const bool has_change = first.has_value();
+        if (!first)
+            first = diagnostics;
+        latest = diagnostics;
+        if (diagnostics.non_finite > 0)
+            return DiagnosticsVerdict::Unstable;
+
+        if (!convergence.enabled() || !has_change || converged_at)
+            return DiagnosticsVerdict::Continue;
+        quiet_windows = convergence.quiet(diagnostics) ? quiet_windows + 1 : 0;
+        if (quiet_windows < (int)convergence.convergence_windows)
+            return DiagnosticsVerdict::Continue;
+        converged_at = diagnostics.iteration;
+        return DiagnosticsVerdict::Converged;
+    }
+
+    // iterations left when a converged run stopped
+    void setIterationsSaved(uint64_t iterations) {
+        std::lock_guard lock{mutex};
+        iterations_saved = iterations;
+    }
+
+    ErosionDiagnosticsReport get() const {
+        std::lock_guard lock{mutex};
+        ErosionDiagnosticsReport report;
+        report.first = first;
+        report.latest = latest;
+        report.converged_at = converged_at;
+        report.iterations_saved = iterations_saved;
+        if (first && latest && area > 0) {
+            report.drift = (latest->solids() - first->solids()) / area;
+            report.drifting = std::abs(report.drift) > drift_warning;
+        }
+        return report;
+    }
+
+private:
+    mutable std::mutex mutex;
+    std::optional<ErosionDiagnostics> first;
+    std::optional<ErosionDiagnostics> latest;
+    std::optional<uint32_t> converged_at;
+    uint64_t iterations_saved = 0;
+    int quiet_windows = 0;
+    double area = 0;
+    float drift_warning = 0;
+    ErosionConvergenceParameters convergence;
+};
+
+}
+
+#endif // DIRTBOX_EROSION_DIAGNOSTICS_H
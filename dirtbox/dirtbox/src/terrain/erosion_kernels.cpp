@@ -0,0 +1,1144 @@
+#include <terrain/erosion_kernels.h>
+
+#include <cmath>
+#include <atomic>
+#include <algorithm>
+
+#include <terrain/soa_grid.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define DIRTBOX_KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+namespace dirtbox::terrain {
+
+namespace {
+
+std::atomic<int> active_level{-1};
+
+SimdLevel supported_level() {
+    static const SimdLevel level = detectSimdLevel();
+    return level;
+}
+
+/**
+ * @brief per call constants shared by every kernel variant. Every variant evaluates the same
+ * expressions in the same order so results do not depend on the instruction set.
+ *
+ */
+struct OutflowConstants {
+    explicit OutflowConstants(const OutflowKernelArgs& a) :
+        dt{a.step_time_constant},
+        rain_dt{a.rainfall * a.step_time_constant},
+        cell_size{a.cell_size},
+        cell_area{a.cell_size * a.cell_size},
+        pressure{a.virtual_pipe_area * 9.8f},
+        capacity_area{a.water_sediment_capacity * (a.cell_size * a.cell_size)},
+        denom{4 * (std::sqrt(a.virtual_pipe_area / 3.14f)) * 9.8f * a.virtual_pipe_area * a.step_time_constant * a.step_time_constant}
+    {}
+
+    float dt;
+    float rain_dt;
+    float cell_size;
+    float cell_area;
+    float pressure;
+    float capacity_area;
+    float denom;
+};
+
+// neighbor offsets in flow order (0, 1), (1, 0), (0, -1), (-1, 0)
+constexpr int FlowDX[4] = {0, 1, 0, -1};
+constexpr int FlowDY[4] = {1, 0, -1, 0};
+
+inline void outflow_cell(const OutflowKernelArgs& a, const OutflowConstants& c, int x, int y) {
+    const std::ptrdiff_t i = (std::ptrdiff_t)y * a.stride + x;
+    const float water = a.water[i] + c.rain_dt;
+    const float height = a.rock[i] + water;
+    const float k = a.sediment[i] / c.capacity_area + 1;
+
+    float flow[4];
+    float flow_sum = 0;
+    for (int d = 0; d < 4; ++d) {
+        const int nx = x + FlowDX[d];
+        const int ny = y + FlowDY[d];
+        float dH = 0;
+        if (nx >= 0 && nx < a.width && ny >= 0 && ny < a.height) {
+            const std::ptrdiff_t ni = i + FlowDY[d] * a.stride + FlowDX[d];
+            dH = height - (a.rock[ni] + a.water[ni]);
+        }
+        const float f = a.flow_in[d][i];
+        flow[d] = std::max(0.0f, f + c.dt * (c.pressure * dH / c.cell_size - 0.32f * k * f * f / c.denom));
+        flow_sum += flow[d];
+    }
+
+    // rescale out flows to not exceed amount of water in cell
+    const float K = std::min(water * c.cell_area / (flow_sum + 1e-9f), 1.0f);
+    for (int d = 0; d < 4; ++d)
+        a.flow_out[d][i] = flow[d] * K;
+}
+
+void outflow_rows_scalar(const OutflowKernelArgs& a, int x0, int x1, int y0, int y1) {
+    const OutflowConstants c{a};
+    for (int y = y0; y < y1; ++y)
+        for (int x = x0; x < x1; ++x)
+            outflow_cell(a, c, x, y);
+}
+
+#ifdef DIRTBOX_KERNELS_X86
+
+/**
+ * @brief rows above and below y. Rows outside the grid alias row y and are masked out
+ *
+ */
+struct RowNeighbors {
+    RowNeighbors(const OutflowKernelArgs& a, int y) :
+        pos_y{y + 1 < a.height ? a.stride : 0},
+        neg_y{y > 0 ? -a.stride : 0}
+    {}
+
+    std::ptrdiff_t pos_y;
+    std::ptrdiff_t neg_y;
+};
+
+__attribute__((target("sse4.1")))
+void outflow_rows_sse41(const OutflowKernelArgs& a, int x0, int x1, int y0, int y1) {
+    constexpr int L = 4;
+    const OutflowConstants c{a};
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 v_eps = _mm_set1_ps(1e-9f);
+    const __m128 v_damp = _mm_set1_ps(0.32f);
+    const __m128 v_dt = _mm_set1_ps(c.dt);
+    const __m128 v_rain = _mm_set1_ps(c.rain_dt);
+    const __m128 v_cell_size = _mm_set1_ps(c.cell_size);
+    const __m128 v_cell_area = _mm_set1_ps(c.cell_area);
+    const __m128 v_pressure = _mm_set1_ps(c.pressure);
+    const __m128 v_capacity = _mm_set1_ps(c.capacity_area);
+    const __m128 v_denom = _mm_set1_ps(c.denom);
+
+    for (int y = y0; y < y1; ++y) {
+        const RowNeighbors rn{a, y};
+        const std::ptrdiff_t offset[4] = {rn.pos_y, 1, rn.neg_y, -1};
+        // all ones where the neighbor row exists
+        const __m128 valid[4] = {
+            _mm_castsi128_ps(_mm_set1_epi32(rn.pos_y != 0 ? -1 : 0)),
+            _mm_castsi128_ps(_mm_set1_epi32(-1)),
+            _mm_castsi128_ps(_mm_set1_epi32(rn.neg_y != 0 ? -1 : 0)),
+            _mm_castsi128_ps(_mm_set1_epi32(-1))
+        };
+
+        // first and last columns have missing x neighbors
+        int x = x0;
+        if (x == 0)
+            outflow_cell(a, c, x++, y);
+        for (; x + L <= std::min(x1, a.width - 1); x += L) {
+            const std::ptrdiff_t i = (std::ptrdiff_t)y * a.stride + x;
+            const __m128 water = _mm_add_ps(_mm_loadu_ps(a.water + i), v_rain);
+            const __m128 height = _mm_add_ps(_mm_loadu_ps(a.rock + i), water);
+            const __m128 k = _mm_add_ps(_mm_div_ps(_mm_loadu_ps(a.sediment + i), v_capacity), one);
+            const __m128 damp = _mm_mul_ps(v_damp, k);
+
+            __m128 flow[4];
+            __m128 flow_sum = zero;
+            for (int d = 0; d < 4; ++d) {
+                const std::ptrdiff_t ni = i + offset[d];
+                const __m128 nh = _mm_add_ps(_mm_loadu_ps(a.rock + ni), _mm_loadu_ps(a.water + ni));
+                const __m128 dH = _mm_blendv_ps(zero, _mm_sub_ps(height, nh), valid[d]);
+                const __m128 f = _mm_loadu_ps(a.flow_in[d] + i);
+                const __m128 drive = _mm_div_ps(_mm_mul_ps(v_pressure, dH), v_cell_size);
+                const __m128 drag = _mm_div_ps(_mm_mul_ps(_mm_mul_ps(damp, f), f), v_denom);
+                flow[d] = _mm_max_ps(_mm_add_ps(f, _mm_mul_ps(v_dt, _mm_sub_ps(drive, drag))), zero);
+                flow_sum = _mm_add_ps(flow_sum, flow[d]);
+            }
+
+            const __m128 K = _mm_min_ps(_mm_div_ps(_mm_mul_ps(water, v_cell_area), _mm_add_ps(flow_sum, v_eps)), one);
+            for (int d = 0; d < 4; ++d)
+                _mm_storeu_ps(a.flow_out[d] + i, _mm_mul_ps(flow[d], K));
+        }
+        for (; x < x1; ++x)
+            outflow_cell(a, c, x, y);
+    }
+}
+
+__attribute__((target("avx2")))
+void outflow_rows_avx2(const OutflowKernelArgs& a, int x0, int x1, int y0, int y1) {
+    constexpr int L = 8;
+    const OutflowConstants c{a};
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 v_eps = _mm256_set1_ps(1e-9f);
+    const __m256 v_damp = _mm256_set1_ps(0.32f);
+    const __m256 v_dt = _mm256_set1_ps(c.dt);
+    const __m256 v_rain = _mm256_set1_ps(c.rain_dt);
+    const __m256 v_cell_size = _mm256_set1_ps(c.cell_size);
+    const __m256 v_cell_area = _mm256_set1_ps(c.cell_area);
+    const __m256 v_pressure = _mm256_set1_ps(c.pressure);
+    const __m256 v_capacity = _mm256_set1_ps(c.capacity_area);
+    const __m256 v_denom = _mm256_set1_ps(c.denom);
+
+    for (int y = y0; y < y1; ++y) {
+        const RowNeighbors rn{a, y};
+        const std::ptrdiff_t offset[4] = {rn.pos_y, 1, rn.neg_y, -1};
+        const __m256 valid[4] = {
+            _mm256_castsi256_ps(_mm256_set1_epi32(rn.pos_y != 0 ? -1 : 0)),
+            _mm256_castsi256_ps(_mm256_set1_epi32(-1)),
+            _mm256_castsi256_ps(_mm256_set1_epi32(rn.neg_y != 0 ? -1 : 0)),
+            _mm256_castsi256_ps(_mm256_set1_epi32(-1))
+        };
+
+        int x = x0;
+        if (x == 0)
+            outflow_cell(a, c, x++, y);
+        for (; x + L <= std::min(x1, a.width - 1); x += L) {
+            const std::ptrdiff_t i = (std::ptrdiff_t)y * a.stride + x;
+            const __m256 water = _mm256_add_ps(_mm256_loadu_ps(a.water + i), v_rain);
+            const __m256 height = _mm256_add_ps(_mm256_loadu_ps(a.rock + i), water);
+            const __m256 k = _mm256_add_ps(_mm256_div_ps(_mm256_loadu_ps(a.sediment + i), v_capacity), one);
+            const __m256 damp = _mm256_mul_ps(v_damp, k);
+
+            __m256 flow[4];
+            __m256 flow_sum = zero;
+            for (int d = 0; d < 4; ++d) {
+                const std::ptrdiff_t ni = i + offset[d];
+                const __m256 nh = _mm256_add_ps(_mm256_loadu_ps(a.rock + ni), _mm256_loadu_ps(a.water + ni));
+                const __m256 dH = _mm256_blendv_ps(zero, _mm256_sub_ps(height, nh), valid[d]);
+                const __m256 f = _mm256_loadu_ps(a.flow_in[d] + i);
+                const __m256 drive = _mm256_div_ps(_mm256_mul_ps(v_pressure, dH), v_cell_size);
+                const __m256 drag = _mm256_div_ps(_mm256_mul_ps(_mm256_mul_ps(damp, f), f), v_denom);
+                flow[d] = _mm256_max_ps(_mm256_add_ps(f, _mm256_mul_ps(v_dt, _mm256_sub_ps(drive, drag))), zero);
+                flow_sum = _mm256_add_ps(flow_sum, flow[d]);
+            }
+
+            const __m256 K = _mm256_min_ps(_mm256_div_ps(_mm256_mul_ps(water, v_cell_area), _mm256_add_ps(flow_sum, v_eps)), one);
+            for (int d = 0; d < 4; ++d)
+                _mm256_storeu_ps(a.flow_out[d] + i, _mm256_mul_ps(flow[d], K));
+        }
+        for (; x < x1; ++x)
+            outflow_cell(a, c, x, y);
+    }
+}
+
+#endif // DIRTBOX_KERNELS_X86
+
+struct TalusConstants {
+    explicit TalusConstants(const TalusKernelArgs& a) :
+        cell_size{a.cell_size},
+        cell_area{a.cell_size * a.cell_size},
+        rate_area{a.cell_size * a.cell_size * a.thermal_erosion_rate},
+        dt{a.time_step}
+    {
+        for (int d = 0; d < 8; ++d)
+            offset[d] = DirmapDY[d] * a.stride + DirmapDX[d];
+    }
+
+    float cell_size;
+    float cell_area;
+    float rate_area;
+    float dt;
+    std::ptrdiff_t offset[8];
+};
+
+inline bool talus_neighbor(const TalusKernelArgs& a, int x, int y, int d) {
+    const int nx = x + DirmapDX[d];
+    const int ny = y + DirmapDY[d];
+    return nx >= 0 && nx < a.width && ny >= 0 && ny < a.height;
+}
+
+// max then min as _mm_max_ps and _mm_min_ps evaluate them, a non-finite hardness becomes min_hardness
+inline float talus_hardness(const TalusKernelArgs& a, float hardness) {
+    hardness = hardness > a.min_hardness ? hardness : a.min_hardness;
+    return hardness < a.max_hardness ? hardness : a.max_hardness;
+}
+
+inline void talus_flow_cell(const TalusKernelArgs& a, const TalusConstants& c, int x, int y) {
+    const std::ptrdiff_t i = (std::ptrdiff_t)y * a.stride + x;
+    const float height = a.rock[i] + a.water[i];
+    const float hardness = talus_hardness(a, a.hardness[i]);
+    const float talus = hardness * a.talus_angle_tangent_coef + a.talus_angle_tangent_bias;
+
+    float dh[8];
+    float total = 0;
+    float dmax = 0;
+    for (int d = 0; d < 8; ++d) {
+        dh[d] = 0;
+        if (talus_neighbor(a, x, y, d)) {
+            const std::ptrdiff_t ni = i + c.offset[d];
+            const float diff = height - (a.rock[ni] + a.water[ni]);
+            if (diff > 0 && diff / c.cell_size > talus) {
+                dh[d] = diff;
+                dmax = std::max(diff, dmax);
+                total += diff;
+            }
+        }
+    }
+    const float dS = c.rate_area * hardness * dmax * 0.5f;
+    for (int d = 0; d < 8; ++d)
+        a.flows[d][i] = dh[d] > 0 ? dS * dh[d] / total : 0.0f;
+}
+
+inline void talus_apply_cell(const TalusKernelArgs& a, const TalusConstants& c, int x, int y) {
+    const std::ptrdiff_t i = (std::ptrdiff_t)y * a.stride + x;
+    float out = 0;
+    float in = 0;
+    for (int d = 0; d < 8; ++d) {
+        out += a.flows[d][i];
+        if (talus_neighbor(a, x, y, d))
+            in += a.flows[(d + 4) % 8][i + c.offset[d]];
+    }
+    a.rock_out[i] = a.rock[i] + (in - out) * c.dt / c.cell_area;
+}
+
+// rows on the grid border have neighbors outside it in every column
+inline bool talus_border_row(const TalusKernelArgs& a, int y) {
+    return y == 0 || y == a.height - 1;
+}
+
+void talus_flow_rows_scalar(const TalusKernelArgs& a, int y0, int y1) {
+    const TalusConstants c{a};
+    for (int y = y0; y < y1; ++y)
+        for (int x = 0; x < a.width; ++x)
+            talus_flow_cell(a, c, x, y);
+}
+
+void talus_apply_rows_scalar(const TalusKernelArgs& a, int y0, int y1) {
+    const TalusConstants c{a};
+    for (int y = y0; y < y1; ++y)
+        for (int x = 0; x < a.width; ++x)
+            talus_apply_cell(a, c, x, y);
+}
+
+#ifdef DIRTBOX_KERNELS_X86
+
+// interior cells have all 8 neighbors, the first and last column and border rows run scalar
+__attribute__((target("sse4.1")))
+void talus_flow_rows_sse41(const TalusKernelArgs& a, int y0, int y1) {
+    constexpr int L = 4;
+    const TalusConstants c{a};
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 v_half = _mm_set1_ps(0.5f);
+    const __m128 v_cell_size = _mm_set1_ps(c.cell_size);
+    const __m128 v_rate_area = _mm_set1_ps(c.rate_area);
+    const __m128 v_coef = _mm_set1_ps(a.talus_angle_tangent_coef);
+    const __m128 v_bias = _mm_set1_ps(a.talus_angle_tangent_bias);
+    const __m128 v_min_hardness = _mm_set1_ps(a.min_hardness);
+    const __m128 v_max_hardness = _mm_set1_ps(a.max_hardness);
+
+    for (int y = y0; y < y1; ++y) {
+        int x = 0;
+        if (!talus_border_row(a, y)) {
+            talus_flow_cell(a, c, x++, y);
+            for (; x + L <= a.width - 1; x += L) {
+                const std::ptrdiff_t i = (std::ptrdiff_t)y * a.stride + x;
+                const __m128 height = _mm_add_ps(_mm_loadu_ps(a.rock + i), _mm_loadu_ps(a.water + i));
+                const __m128 hardness = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(a.hardness + i), v_min_hardness), v_max_hardness);
+                const __m128 talus = _mm_add_ps(_mm_mul_ps(hardness, v_coef), v_bias);
+
+                __m128 dh[8];
+                __m128 total = zero;
+                __m128 dmax = zero;
+                for (int d = 0; d < 8; ++d) {
+                    const std::ptrdiff_t ni = i + c.offset[d];
+                    const __m128 diff = _mm_sub_ps(height, _mm_add_ps(_mm_loadu_ps(a.rock + ni), _mm_loadu_ps(a.water + ni)));
+                    const __m128 steep = _mm_and_ps(_mm_cmpgt_ps(diff, zero), _mm_cmpgt_ps(_mm_div_ps(diff, v_cell_size), talus));
+                    dh[d] = _mm_and_ps(steep, diff);
+                    dmax = _mm_max_ps(dh[d], dmax);
+                    total = _mm_add_ps(total, dh[d]);
+                }
+                const __m128 dS = _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(v_rate_area, hardness), dmax), v_half);
+                for (int d = 0; d < 8; ++d) {
+                    const __m128 flow = _mm_div_ps(_mm_mul_ps(dS, dh[d]), total);
+                    _mm_storeu_ps(a.flows[d] + i, _mm_and_ps(_mm_cmpgt_ps(dh[d], zero), flow));
+                }
+            }
+        }
+        for (; x < a.width; ++x)
+            talus_flow_cell(a, c, x, y);
+    }
+}
+
+__attribute__((target("sse4.1")))
+void talus_apply_rows_sse41(const TalusKernelArgs& a, int y0, int y1) {
+    constexpr int L = 4;
+    const TalusConstants c{a};
+    const __m128 v_dt = _mm_set1_ps(c.dt);
+    const __m128 v_cell_area = _mm_set1_ps(c.cell_area);
+
+    for (int y = y0; y < y1; ++y) {
+        int x = 0;
+        if (!talus_border_row(a, y)) {
+            talus_apply_cell(a, c, x++, y);
+            for (; x + L <= a.width - 1; x += L) {
+                const std::ptrdiff_t i = (std::ptrdiff_t)y * a.stride + x;
+                __m128 out = _mm_setzero_ps();
+                __m128 in = _mm_setzero_ps();
+                for (int d = 0; d < 8; ++d) {
+                    out = _mm_add_ps(out, _mm_loadu_ps(a.flows[d] + i));
+                    in = _mm_add_ps(in, _mm_loadu_ps(a.flows[(d + 4) % 8] + i + c.offset[d]));
+                }
+                const __m128 change = _mm_div_ps(_mm_mul_ps(_mm_sub_ps(in, out), v_dt), v_cell_area);
+                _mm_storeu_ps(a.rock_out + i, _mm_add_ps(_mm_loadu_ps(a.rock + i), change));
+            }
+        }
+        for (; x < a.width; ++x)
+            talus_apply_cell(a, c, x, y);
+    }
+}
+
+__attribute__((target("avx2")))
+void talus_flow_rows_avx2(const TalusKernelArgs& a, int y0, int y1) {
+    constexpr int L = 8;
+    const TalusConstants c{a};
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 v_half = _mm256_set1_ps(0.5f);
+    const __m256 v_cell_size = _mm256_set1_ps(c.cell_size);
+    const __m256 v_rate_area = _mm256_set1_ps(c.rate_area);
+    const __m256 v_coef = _mm256_set1_ps(a.talus_angle_tangent_coef);
+    const __m256 v_bias = _mm256_set1_ps(a.talus_angle_tangent_bias);
+    const __m256 v_min_hardness = _mm256_set1_ps(a.min_hardness);
+    const __m256 v_max_hardness = _mm256_set1_ps(a.max_hardness);
+
+    for (int y = y0; y < y1; ++y) {
+        int x = 0;
+        if (!talus_border_row(a, y)) {
+            talus_flow_cell(a, c, x++, y);
+            for (; x + L <= a.width - 1; x += L) {
+                const std::ptrdiff_t i = (std::ptrdiff_t)y * a.stride + x;
+                const __m256 height = _mm256_add_ps(_mm256_loadu_ps(a.rock + i), _mm256_loadu_ps(a.water + i));
+                const __m256 hardness = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(a.hardness + i), v_min_hardness), v_max_hardness);
+                const __m256 talus = _mm256_add_ps(_mm256_mul_ps(hardness, v_coef), v_bias);
+
+                __m256 dh[8];
+                __m256 total = zero;
+                __m256 dmax = zero;
+                for (int d = 0; d < 8; ++d) {
+                    const std::ptrdiff_t ni = i + c.offset[d];
+                    const __m256 diff = _mm256_sub_ps(height, _mm256_add_ps(_mm256_loadu_ps(a.rock + ni), _mm256_loadu_ps(a.water + ni)));
+                    const __m256 steep = _mm256_and_ps(_mm256_cmp_ps(diff, zero, _CMP_GT_OQ),
+                                                       _mm256_cmp_ps(_mm256_div_ps(diff, v_cell_size), talus, _CMP_GT_OQ));
+                    dh[d] = _mm256_and_ps(steep, diff);
+                    dmax = _mm256_max_ps(dh[d], dmax);
+                    total = _mm256_add_ps(total, dh[d]);
+                }
+                const __m256 dS = _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(v_rate_area, hardness), dmax), v_half);
+                for (int d = 0; d < 8; ++d) {
+                    const __m256 flow = _mm256_div_ps(_mm256_mul_ps(dS, dh[d]), total);
+                    _mm256_storeu_ps(a.flows[d] + i, _mm256_and_ps(_mm256_cmp_ps(dh[d], zero, _CMP_GT_OQ), flow));
+                }
+            }
+        }
+        for (; x < a.width; ++x)
+            talus_flow_cell(a, c, x, y);
+    }
+}
+
+__attribute__((target("avx2")))
+void talus_apply_rows_avx2(const TalusKernelArgs& a, int y0, int y1) {
+    constexpr int L = 8;
+    const TalusConstants c{a};
+    const __m256 v_dt = _mm256_set1_ps(c.dt);
+    const __m256 v_cell_area = _mm256_set1_ps(c.cell_area);
+
+    for (int y = y0; y < y1; ++y) {
+        int x = 0;
+        if (!talus_border_row(a, y)) {
+            talus_apply_cell(a, c, x++, y);
+            for (; x + L <= a.width - 1; x += L) {
+                const std::ptrdiff_t i = (std::ptrdiff_t)y * a.stride + x;
+                __m256 out = _mm256_setzero_ps();
+                __m256 in = _mm256_setzero_ps();
+                for (int d = 0; d < 8; ++d) {
+                    out = _mm256_add_ps(out, _mm256_loadu_ps(a.flows[d] + i));
+                    in = _mm256_add_ps(in, _mm256_loadu_ps(a.flows[(d + 4) % 8] + i + c.offset[d]));
+                }
+                const __m256 change = _mm256_div_ps(_mm256_mul_ps(_mm256_sub_ps(in, out), v_dt), v_cell_area);
+                _mm256_storeu_ps(a.rock_out + i, _mm256_add_ps(_mm256_loadu_ps(a.rock + i), change));
+            }
+        }
+        for (; x < a.width; ++x)
+            talus_apply_cell(a, c, x, y);
+    }
+}
+
+#endif // DIRTBOX_KERNELS_X86
+
+// max and min as _mm_max_ps and _mm_min_ps evaluate them, the second operand when either is NaN
+inline float lane_max(float a, float b) {
+    return a > b ? a : b;
+}
+
+inline float lane_min(float a, float b) {
+    return a < b ? a : b;
+}
+
+struct DropletConstants {
+    explicit DropletConstants(const DropletKernelArgs& a) :
+        max_x{(float)(a.width - 1)},
+        max_y{(float)(a.height - 1)},
+        keep{a.inertia},
+        follow{1 - a.inertia},
+        evaporation{1 - a.evaporation_rate}
+    {}
+
+    // droplets stay in [0, max) so the 4 cells around them are in the grid
+    float max_x;
+    float max_y;
+    float keep;
+    float follow;
+    float evaporation;
+};
+
+inline float droplet_bilinear(const float* g, std::ptrdiff_t i, std::ptrdiff_t stride, float fx, float fy) {
+    return (g[i] * (1 - fx) + g[i + 1] * fx) * (1 - fy) + (g[i + stride] * (1 - fx) + g[i + stride + 1] * fx) * fy;
+}
+
+void droplet_lane(const DropletKernelArgs& a, const DropletConstants& c, DropletBatch& b, DropletDeposits& out, int l) {
+    const float* g = a.ground;
+    const float x = b.x[l];
+    const float y = b.y[l];
+    const int ix = (int)x;
+    const int iy = (int)y;
+    const float fx = x - (float)ix;
+    const float fy = y - (float)iy;
+    const int32_t i = iy * (int32_t)a.stride + ix;
+    out.cell[l] = i;
+    out.fx[l] = fx;
+    out.fy[l] = fy;
+    out.amount[l] = 0;
+    if (!b.alive[l])
+        return;
+
+    const float h00 = g[i];
+    const float h10 = g[i + 1];
+    const float h01 = g[i + a.stride];
+    const float h11 = g[i + a.stride + 1];
+    const float gx = (h10 - h00) * (1 - fy) + (h11 - h01) * fy;
+    const float gy = (h01 - h00) * (1 - fx) + (h11 - h10) * fx;
+    const float height = (h00 * (1 - fx) + h10 * fx) * (1 - fy) + (h01 * (1 - fx) + h11 * fx) * fy;
+
+    float dx = b.dir_x[l] * c.keep - gx * c.follow;
+    float dy = b.dir_y[l] * c.keep - gy * c.follow;
+    const float len = std::sqrt(dx * dx + dy * dy);
+    dx = dx / len;
+    dy = dy / len;
+    const float nx = x + dx;
+    const float ny = y + dy;
+    const bool moving = len > 0;
+    if (!(moving && nx >= 0 && nx < c.max_x && ny >= 0 && ny < c.max_y)) {
+        // a droplet in a pit leaves its sediment there, one that runs off the grid takes it along
+        if (!moving)
+            out.amount[l] = b.sediment[l];
+        b.sediment[l] = 0;
+        b.alive[l] = 0;
+        return;
+    }
+
+    const int jx = (int)nx;
+    const int jy = (int)ny;
+    const float new_height = droplet_bilinear(g, jy * (int32_t)a.stride + jx, a.stride, nx - (float)jx, ny - (float)jy);
+    const float dh = new_height - height;
+    const float slope = dh / a.cell_size;
+    const float sediment = b.sediment[l];
+    const float capacity = lane_max(-slope, a.min_slope) * b.speed[l] * b.water[l] * a.capacity;
+
+    // uphill the droplet fills the step it climbs, on a slope it erodes up to its capacity but
+    // never below the cell it moves to
+    float amount;
+    if (sediment > capacity || dh > 0)
+        amount = dh > 0 ? lane_min(dh, sediment) : (sediment - capacity) * a.deposition_rate;
+    else
+        amount = -lane_min((capacity - sediment) * a.erosion_rate, -dh);
+    out.amount[l] = amount;
+
+    b.sediment[l] = sediment - amount;
+    b.speed[l] = std::sqrt(lane_max(b.speed[l] * b.speed[l] - slope * a.gravity, 0.0f));
+    b.water[l] = b.water[l] * c.evaporation;
+    b.x[l] = nx;
+    b.y[l] = ny;
+    b.dir_x[l] = dx;
+    b.dir_y[l] = dy;
+}
+
+void droplets_scalar(const DropletKernelArgs& a, DropletBatch& b, DropletDeposits& out) {
+    const DropletConstants c{a};
+    for (int l = 0; l < DropletLanes; ++l)
+        droplet_lane(a, c, b, out, l);
+}
+
+#ifdef DIRTBOX_KERNELS_X86
+
+// four lanes of a droplet batch starting at lane l
+__attribute__((target("sse4.1")))
+void droplets_sse41_half(const DropletKernelArgs& a, const DropletConstants& c, DropletBatch& b, DropletDeposits& out, int l) {
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    const __m128i stride = _mm_set1_epi32((int32_t)a.stride);
+    const float* g = a.ground;
+
+    const __m128 x = _mm_loadu_ps(b.x + l);
+    const __m128 y = _mm_loadu_ps(b.y + l);
+    const __m128i ix = _mm_cvttps_epi32(x);
+    const __m128i iy = _mm_cvttps_epi32(y);
+    const __m128 fx = _mm_sub_ps(x, _mm_cvtepi32_ps(ix));
+    const __m128 fy = _mm_sub_ps(y, _mm_cvtepi32_ps(iy));
+    const __m128i i = _mm_add_epi32(_mm_mullo_epi32(iy, stride), ix);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out.cell + l), i);
+    _mm_storeu_ps(out.fx + l, fx);
+    _mm_storeu_ps(out.fy + l, fy);
+    const __m128 alive = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b.alive + l)));
+
+    // no gathers before AVX2, the corners are loaded lane by lane
+    alignas(16) int32_t idx[4];
+    alignas(16) float c00[4], c10[4], c01[4], c11[4];
+    auto corners = [&](__m128i index) {
+        _mm_store_si128(reinterpret_cast<__m128i*>(idx), index);
+        for (int k = 0; k < 4; ++k) {
+            c00[k] = g[idx[k]];
+            c10[k] = g[idx[k] + 1];
+            c01[k] = g[idx[k] + a.stride];
+            c11[k] = g[idx[k] + a.stride + 1];
+        }
+    };
+
+    corners(i);
+    const __m128 h00 = _mm_load_ps(c00);
+    const __m128 h10 = _mm_load_ps(c10);
+    const __m128 h01 = _mm_load_ps(c01);
+    const __m128 h11 = _mm_load_ps(c11);
+    const __m128 rx = _mm_sub_ps(one, fx);
+    const __m128 ry = _mm_sub_ps(one, fy);
+    const __m128 gx = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(h10, h00), ry), _mm_mul_ps(_mm_sub_ps(h11, h01), fy));
+    const __m128 gy = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(h01, h00), rx), _mm_mul_ps(_mm_sub_ps(h11, h10), fx));
+    const __m128 height = _mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(h00, rx), _mm_mul_ps(h10, fx)), ry),
+                                     _mm_mul_ps(_mm_add_ps(_mm_mul_ps(h01, rx), _mm_mul_ps(h11, fx)), fy));
+
+    __m128 dx = _mm_sub_ps(_mm_mul_ps(_mm_loadu_ps(b.dir_x + l), _mm_set1_ps(c.keep)), _mm_mul_ps(gx, _mm_set1_ps(c.follow)));
+    __m128 dy = _mm_sub_ps(_mm_mul_ps(_mm_loadu_ps(b.dir_y + l), _mm_set1_ps(c.keep)), _mm_mul_ps(gy, _mm_set1_ps(c.follow)));
+    const __m128 len = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)));
+    dx = _mm_div_ps(dx, len);
+    dy = _mm_div_ps(dy, len);
+    const __m128 nx = _mm_add_ps(x, dx);
+    const __m128 ny = _mm_add_ps(y, dy);
+    const __m128 moving = _mm_cmpgt_ps(len, zero);
+    const __m128 inside = _mm_and_ps(_mm_and_ps(moving, _mm_and_ps(_mm_cmpge_ps(nx, zero), _mm_cmplt_ps(nx, _mm_set1_ps(c.max_x)))),
+                                     _mm_and_ps(_mm_cmpge_ps(ny, zero), _mm_cmplt_ps(ny, _mm_set1_ps(c.max_y))));
+    const __m128 go = _mm_and_ps(alive, inside);
+    const __m128 stopped = _mm_andnot_ps(moving, alive);
+
+    // lanes that do not move on read the cell at index 0
+    const __m128i jx = _mm_cvttps_epi32(_mm_and_ps(go, nx));
+    const __m128i jy = _mm_cvttps_epi32(_mm_and_ps(go, ny));
+    const __m128 gfx = _mm_sub_ps(nx, _mm_cvtepi32_ps(jx));
+    const __m128 gfy = _mm_sub_ps(ny, _mm_cvtepi32_ps(jy));
+    corners(_mm_and_si128(_mm_castps_si128(go), _mm_add_epi32(_mm_mullo_epi32(jy, stride), jx)));
+    const __m128 grx = _mm_sub_ps(one, gfx);
+    const __m128 gry = _mm_sub_ps(one, gfy);
+    const __m128 new_height = _mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_load_ps(c00), grx), _mm_mul_ps(_mm_load_ps(c10), gfx)), gry),
+                                         _mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_load_ps(c01), grx), _mm_mul_ps(_mm_load_ps(c11), gfx)), gfy));
+
+    const __m128 dh = _mm_sub_ps(new_height, height);
+    const __m128 slope = _mm_div_ps(dh, _mm_set1_ps(a.cell_size));
+    const __m128 sediment = _mm_loadu_ps(b.sediment + l);
+    const __m128 speed = _mm_loadu_ps(b.speed + l);
+    const __m128 water = _mm_loadu_ps(b.water + l);
+    const __m128 capacity = _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(_mm_max_ps(_mm_xor_ps(slope, sign), _mm_set1_ps(a.min_slope)), speed), water), _mm_set1_ps(a.capacity));
+
+    const __m128 uphill = _mm_cmpgt_ps(dh, zero);
+    const __m128 deposit = _mm_or_ps(_mm_cmpgt_ps(sediment, capacity), uphill);
+    const __m128 dropped = _mm_blendv_ps(_mm_mul_ps(_mm_sub_ps(sediment, capacity), _mm_set1_ps(a.deposition_rate)), _mm_min_ps(dh, sediment), uphill);
+    const __m128 eroded = _mm_xor_ps(_mm_min_ps(_mm_mul_ps(_mm_sub_ps(capacity, sediment), _mm_set1_ps(a.erosion_rate)), _mm_xor_ps(dh, sign)), sign);
+    const __m128 amount = _mm_blendv_ps(eroded, dropped, deposit);
+    _mm_storeu_ps(out.amount + l, _mm_or_ps(_mm_and_ps(go, amount), _mm_and_ps(stopped, sediment)));
+
+    const __m128 new_speed = _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(_mm_mul_ps(speed, speed), _mm_mul_ps(slope, _mm_set1_ps(a.gravity))), zero));
+    _mm_storeu_ps(b.sediment + l, _mm_and_ps(go, _mm_sub_ps(sediment, amount)));
+    _mm_storeu_ps(b.speed + l, _mm_blendv_ps(speed, new_speed, go));
+    _mm_storeu_ps(b.water + l, _mm_blendv_ps(water, _mm_mul_ps(water, _mm_set1_ps(c.evaporation)), go));
+    _mm_storeu_ps(b.x + l, _mm_blendv_ps(x, nx, go));
+    _mm_storeu_ps(b.y + l, _mm_blendv_ps(y, ny, go));
+    _mm_storeu_ps(b.dir_x + l, _mm_blendv_ps(_mm_loadu_ps(b.dir_x + l), dx, go));
+    _mm_storeu_ps(b.dir_y + l, _mm_blendv_ps(_mm_loadu_ps(b.dir_y + l), dy, go));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(b.alive + l), _mm_castps_si128(go));
+}
+
+__attribute__((target("sse4.1")))
+void droplets_sse41(const DropletKernelArgs& a, DropletBatch& b, DropletDeposits& out) {
+    const DropletConstants c{a};
+    static_assert(DropletLanes == 8);
+    droplets_sse41_half(a, c, b, out, 0);
+    droplets_sse41_half(a, c, b, out, 4);
+}
+
+__attribute__((target("avx2")))
+void droplets_avx2(const DropletKernelArgs& a, DropletBatch& b, DropletDeposits& out) {
+    const DropletConstants c{a};
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    const __m256i stride = _mm256_set1_epi32((int32_t)a.stride);
+    const __m256i right = _mm256_set1_epi32(1);
+    const __m256i up = stride;
+    const __m256i up_right = _mm256_add_epi32(stride, right);
+    const float* g = a.ground;
+
+    const __m256 x = _mm256_loadu_ps(b.x);
+    const __m256 y = _mm256_loadu_ps(b.y);
+    const __m256i ix = _mm256_cvttps_epi32(x);
+    const __m256i iy = _mm256_cvttps_epi32(y);
+    const __m256 fx = _mm256_sub_ps(x, _mm256_cvtepi32_ps(ix));
+    const __m256 fy = _mm256_sub_ps(y, _mm256_cvtepi32_ps(iy));
+    const __m256i i = _mm256_add_epi32(_mm256_mullo_epi32(iy, stride), ix);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out.cell), i);
+    _mm256_storeu_ps(out.fx, fx);
+    _mm256_storeu_ps(out.fy, fy);
+    const __m256 alive = _mm256_castsi256_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(b.alive)));
+
+    const __m256 h00 = _mm256_i32gather_ps(g, i, 4);
+    const __m256 h10 = _mm256_i32gather_ps(g, _mm256_add_epi32(i, right), 4);
+    const __m256 h01 = _mm256_i32gather_ps(g, _mm256_add_epi32(i, up), 4);
+    const __m256 h11 = _mm256_i32gather_ps(g, _mm256_add_epi32(i, up_right), 4);
+    const __m256 rx = _mm256_sub_ps(one, fx);
+    const __m256 ry = _mm256_sub_ps(one, fy);
+    const __m256 gx = _mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(h10, h00), ry), _mm256_mul_ps(_mm256_sub_ps(h11, h01), fy));
+    const __m256 gy = _mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(h01, h00), rx), _mm256_mul_ps(_mm256_sub_ps(h11, h10), fx));
+    const __m256 height = _mm256_add_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(h00, rx), _mm256_mul_ps(h10, fx)), ry),
+                                        _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(h01, rx), _mm256_mul_ps(h11, fx)), fy));
+
+    __m256 dx = _mm256_sub_ps(_mm256_mul_ps(_mm256_loadu_ps(b.dir_x), _mm256_set1_ps(c.keep)), _mm256_mul_ps(gx, _mm256_set1_ps(c.follow)));
+    __m256 dy = _mm256_sub_ps(_mm256_mul_ps(_mm256_loadu_ps(b.dir_y), _mm256_set1_ps(c.keep)), _mm256_mul_ps(gy, _mm256_set1_ps(c.follow)));
+    const __m256 len = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)));
+    dx = _mm256_div_ps(dx, len);
+    dy = _mm256_div_ps(dy, len);
+    const __m256 nx = _mm256_add_ps(x, dx);
+    const __m256 ny = _mm256_add_ps(y, dy);
+    const __m256 moving = _mm256_cmp_ps(len, zero, _CMP_GT_OQ);
+    const __m256 inside = _mm256_and_ps(
+        _mm256_and_ps(moving, _mm256_and_ps(_mm256_cmp_ps(nx, zero, _CMP_GE_OQ), _mm256_cmp_ps(nx, _mm256_set1_ps(c.max_x), _CMP_LT_OQ))),
+        _mm256_and_ps(_mm256_cmp_ps(ny, zero, _CMP_GE_OQ), _mm256_cmp_ps(ny, _mm256_set1_ps(c.max_y), _CMP_LT_OQ)));
+    const __m256 go = _mm256_and_ps(alive, inside);
+    const __m256 stopped = _mm256_andnot_ps(moving, alive);
+
+    // lanes that do not move on read the cell at index 0
+    const __m256i jx = _mm256_cvttps_epi32(_mm256_and_ps(go, nx));
+    const __m256i jy = _mm256_cvttps_epi32(_mm256_and_ps(go, ny));
+    const __m256 gfx = _mm256_sub_ps(nx, _mm256_cvtepi32_ps(jx));
+    const __m256 gfy = _mm256_sub_ps(ny, _mm256_cvtepi32_ps(jy));
+    const __m256i j = _mm256_and_si256(_mm256_castps_si256(go), _mm256_add_epi32(_mm256_mullo_epi32(jy, stride), jx));
+    const __m256 grx = _mm256_sub_ps(one, gfx);
+    const __m256 gry = _mm256_sub_ps(one, gfy);
+    const __m256 new_height = _mm256_add_ps(
+        _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_i32gather_ps(g, j, 4), grx), _mm256_mul_ps(_mm256_i32gather_ps(g, _mm256_add_epi32(j, right), 4), gfx)), gry),
+        _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_i32gather_ps(g, _mm256_add_epi32(j, up), 4), grx), _mm256_mul_ps(_mm256_i32gather_ps(g, _mm256_add_epi32(j, up_right), 4), gfx)), gfy));
+
+    const __m256 dh = _mm256_sub_ps(new_height, height);
+    const __m256 slope = _mm256_div_ps(dh, _mm256_set1_ps(a.cell_size));
+    const __m256 sediment = _mm256_loadu_ps(b.sediment);
+    const __m256 speed = _mm256_loadu_ps(b.speed);
+    const __m256 water = _mm256_loadu_ps(b.water);
+    const __m256 capacity = _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(_mm256_max_ps(_mm256_xor_ps(slope, sign), _mm256_set1_ps(a.min_slope)), speed), water), _mm256_set1_ps(a.capacity));
+
+    const __m256 uphill = _mm256_cmp_ps(dh, zero, _CMP_GT_OQ);
+    const __m256 deposit = _mm256_or_ps(_mm256_cmp_ps(sediment, capacity, _CMP_GT_OQ), uphill);
+    const __m256 dropped = _mm256_blendv_ps(_mm256_mul_ps(_mm256_sub_ps(sediment, capacity), _mm256_set1_ps(a.deposition_rate)), _mm256_min_ps(dh, sediment), uphill);
+    const __m256 eroded = _mm256_xor_ps(_mm256_min_ps(_mm256_mul_ps(_mm256_sub_ps(capacity, sediment), _mm256_set1_ps(a.erosion_rate)), _mm256_xor_ps(dh, sign)), sign);
+    const __m256 amount = _mm256_blendv_ps(eroded, dropped, deposit);
+    _mm256_storeu_ps(out.amount, _mm256_or_ps(_mm256_and_ps(go, amount), _mm256_and_ps(stopped, sediment)));
+
+    const __m256 new_speed = _mm256_sqrt_ps(_mm256_max_ps(_mm256_sub_ps(_mm256_mul_ps(speed, speed), _mm256_mul_ps(slope, _mm256_set1_ps(a.gravity))), zero));
+    _mm256_storeu_ps(b.sediment, _mm256_and_ps(go, _mm256_sub_ps(sediment, amount)));
+    _mm256_storeu_ps(b.speed, _mm256_blendv_ps(speed, new_speed, go));
+    _mm256_storeu_ps(b.water, _mm256_blendv_ps(water, _mm256_mul_ps(water, _mm256_set1_ps(c.evaporation)), go));
+    _mm256_storeu_ps(b.x, _mm256_blendv_ps(x, nx, go));
+    _mm256_storeu_ps(b.y, _mm256_blendv_ps(y, ny, go));
+    _mm256_storeu_ps(b.dir_x, _mm256_blendv_ps(_mm256_loadu_ps(b.dir_x), dx, go));
+    _mm256_storeu_ps(b.dir_y, _mm256_blendv_ps(_mm256_loadu_ps(b.dir_y), dy, go));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(b.alive), _mm256_castps_si256(go));
+}
+
+#endif // DIRTBOX_KERNELS_X86
+
+// lanes of the diagnostics sums, cell x of a row adds to lane x % DiagLanes
+constexpr int DiagLanes = 8;
+
+struct DiagnosticsLanes {
+    double water[DiagLanes] = {};
+    double sediment[DiagLanes] = {};
+    double soil[DiagLanes] = {};
+    double change[DiagLanes] = {};
+
+    void add(const DiagnosticsLanes& row) {
+        for (int l = 0; l < DiagLanes; ++l) {
+            water[l] += row.water[l];
+            sediment[l] += row.sediment[l];
+            soil[l] += row.soil[l];
+            change[l] += row.change[l];
+        }
+    }
+};
+
+// fixed combine order of the lanes
+inline double lane_sum(const double* l) {
+    return ((l[0] + l[4]) + (l[2] + l[6])) + ((l[1] + l[5]) + (l[3] + l[7]));
+}
+
+// a non-finite cell adds 0 to its lanes, as the masked SIMD variants do
+template<bool Change>
+inline void diagnostics_cell(const DiagnosticsKernelArgs& a, std::ptrdiff_t i, int lane, DiagnosticsLanes& row, DiagnosticsSums& s) {
+    const float rock = a.rock[i];
+    const float sand = a.sand[i];
+    const float sediment = a.sediment[i];
+    const float water = a.water[i];
+    const bool finite = std::isfinite(rock) && std::isfinite(sand) && std::isfinite(sediment) && std::isfinite(water);
+    const float height = rock + sand;
+    if (finite) {
+        s.min_height = std::min(s.min_height, height);
+        s.max_height = std::max(s.max_height, height);
+    } else {
+        s.non_finite++;
+    }
+    row.water[lane] += finite ? (double)water : 0.0;
+    row.sediment[lane] += finite ? (double)sediment : 0.0;
+    row.soil[lane] += finite ? (double)height : 0.0;
+    if constexpr (Change) {
+        const float change = finite ? std::abs(height - a.reference[i]) : 0.0f;
+        row.change[lane] += (double)change;
+        s.change_max = std::max(s.change_max, change);
+        a.reference[i] = height;
+    }
+}
+
+template<bool Change>
+void diagnostics_rows_scalar(const DiagnosticsKernelArgs& a, int y0, int y1, DiagnosticsLanes& lanes, DiagnosticsSums& s) {
+    for (int y = y0; y < y1; ++y) {
+        DiagnosticsLanes row;
+        for (int x = 0; x < a.width; ++x)
+            diagnostics_cell<Change>(a, (std::ptrdiff_t)y * a.stride + x, x % DiagLanes, row, s);
+        lanes.add(row);
+    }
+}
+
+#ifdef DIRTBOX_KERNELS_X86
+
+template<bool Change>
+__attribute__((target("sse4.1")))
+void diagnostics_rows_sse41(const DiagnosticsKernelArgs& a, int y0, int y1, DiagnosticsLanes& lanes, DiagnosticsSums& s) {
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    const __m128 v_inf = _mm_set1_ps(INFINITY);
+    const __m128 v_ninf = _mm_set1_ps(-INFINITY);
+    __m128 v_min = v_inf;
+    __m128 v_max = v_ninf;
+    __m128 v_change_max = zero;
+    const int simd_end = a.width - a.width % DiagLanes;
+
+    for (int y = y0; y < y1; ++y) {
+        const std::ptrdiff_t row_start = (std::ptrdiff_t)y * a.stride;
+        // lanes 0-1, 2-3, 4-5 and 6-7
+        __m128d water[4], sediment[4], soil[4], change[4];
+        for (int k = 0; k < 4; ++k)
+            water[k] = sediment[k] = soil[k] = change[k] = _mm_setzero_pd();
+
+        for (int x = 0; x < simd_end; x += DiagLanes) {
+            for (int half = 0; half < 2; ++half) {
+                const std::ptrdiff_t i = row_start + x + 4 * half;
+                const __m128 rock = _mm_loadu_ps(a.rock + i);
+                const __m128 sand = _mm_loadu_ps(a.sand + i);
+                const __m128 sed = _mm_loadu_ps(a.sediment + i);
+                const __m128 wat = _mm_loadu_ps(a.water + i);
+                // v * 0 is 0 for finite v and NaN otherwise
+                const __m128 probe = _mm_add_ps(_mm_add_ps(_mm_mul_ps(rock, zero), _mm_mul_ps(sand, zero)),
+                                                _mm_add_ps(_mm_mul_ps(sed, zero), _mm_mul_ps(wat, zero)));
+                const __m128 finite = _mm_cmpeq_ps(probe, zero);
+                s.non_finite += 4 - __builtin_popcount(_mm_movemask_ps(finite));
+
+                const __m128 height = _mm_add_ps(rock, sand);
+                v_min = _mm_min_ps(v_min, _mm_blendv_ps(v_inf, height, finite));
+                v_max = _mm_max_ps(v_max, _mm_blendv_ps(v_ninf, height, finite));
+
+                const __m128 w = _mm_blendv_ps(zero, wat, finite);
+                const __m128 d = _mm_blendv_ps(zero, sed, finite);
+                const __m128 h = _mm_blendv_ps(zero, height, finite);
+                water[2 * half] = _mm_add_pd(water[2 * half], _mm_cvtps_pd(w));
+                water[2 * half + 1] = _mm_add_pd(water[2 * half + 1], _mm_cvtps_pd(_mm_movehl_ps(w, w)));
+                sediment[2 * half] = _mm_add_pd(sediment[2 * half], _mm_cvtps_pd(d));
+                sediment[2 * half + 1] = _mm_add_pd(sediment[2 * half + 1], _mm_cvtps_pd(_mm_movehl_ps(d, d)));
+                soil[2 * half] = _mm_add_pd(soil[2 * half], _mm_cvtps_pd(h));
+                soil[2 * half + 1] = _mm_add_pd(soil[2 * half + 1], _mm_cvtps_pd(_mm_movehl_ps(h, h)));
+
+                if constexpr (Change) {
+                    const __m128 diff = _mm_andnot_ps(sign, _mm_sub_ps(height, _mm_loadu_ps(a.reference + i)));
+                    const __m128 c = _mm_blendv_ps(zero, diff, finite);
+                    change[2 * half] = _mm_add_pd(change[2 * half], _mm_cvtps_pd(c));
+                    change[2 * half + 1] = _mm_add_pd(change[2 * half + 1], _mm_cvtps_pd(_mm_movehl_ps(c, c)));
+                    v_change_max = _mm_max_ps(v_change_max, c);
+                    _mm_storeu_ps(a.reference + i, height);
+                }
+            }
+        }
+
+        DiagnosticsLanes row;
+        for (int k = 0; k < 4; ++k) {
+            _mm_storeu_pd(row.water + 2 * k, water[k]);
+            _mm_storeu_pd(row.sediment + 2 * k, sediment[k]);
+            _mm_storeu_pd(row.soil + 2 * k, soil[k]);
+            _mm_storeu_pd(row.change + 2 * k, change[k]);
+        }
+        for (int x = simd_end; x < a.width; ++x)
+            diagnostics_cell<Change>(a, row_start + x, x % DiagLanes, row, s);
+        lanes.add(row);
+    }
+
+    float mins[4], maxs[4], change_maxs[4];
+    _mm_storeu_ps(mins, v_min);
+    _mm_storeu_ps(maxs, v_max);
+    _mm_storeu_ps(change_maxs, v_change_max);
+    for (int l = 0; l < 4; ++l) {
+        s.min_height = std::min(s.min_height, mins[l]);
+        s.max_height = std::max(s.max_height, maxs[l]);
+        s.change_max = std::max(s.change_max, change_maxs[l]);
+    }
+}
+
+template<bool Change>
+__attribute__((target("avx2")))
+void diagnostics_rows_avx2(const DiagnosticsKernelArgs& a, int y0, int y1, DiagnosticsLanes& lanes, DiagnosticsSums& s) {
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    const __m256 v_inf = _mm256_set1_ps(INFINITY);
+    const __m256 v_ninf = _mm256_set1_ps(-INFINITY);
+    __m256 v_min = v_inf;
+    __m256 v_max = v_ninf;
+    __m256 v_change_max = zero;
+    const int simd_end = a.width - a.width % DiagLanes;
+
+    for (int y = y0; y < y1; ++y) {
+        const std::ptrdiff_t row_start = (std::ptrdiff_t)y * a.stride;
+        // lanes 0-3 and 4-7
+        __m256d water[2], sediment[2], soil[2], change[2];
+        for (int k = 0; k < 2; ++k)
+            water[k] = sediment[k] = soil[k] = change[k] = _mm256_setzero_pd();
+
+        for (int x = 0; x < simd_end; x += DiagLanes) {
+            const std::ptrdiff_t i = row_start + x;
+            const __m256 rock = _mm256_loadu_ps(a.rock + i);
+            const __m256 sand = _mm256_loadu_ps(a.sand + i);
+            const __m256 sed = _mm256_loadu_ps(a.sediment + i);
+            const __m256 wat = _mm256_loadu_ps(a.water + i);
+            const __m256 probe = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(rock, zero), _mm256_mul_ps(sand, zero)),
+                                               _mm256_add_ps(_mm256_mul_ps(sed, zero), _mm256_mul_ps(wat, zero)));
+            const __m256 finite = _mm256_cmp_ps(probe, zero, _CMP_EQ_OQ);
+            s.non_finite += 8 - __builtin_popcount(_mm256_movemask_ps(finite));
+
+            const __m256 height = _mm256_add_ps(rock, sand);
+            v_min = _mm256_min_ps(v_min, _mm256_blendv_ps(v_inf, height, finite));
+            v_max = _mm256_max_ps(v_max, _mm256_blendv_ps(v_ninf, height, finite));
+
+            const __m256 w = _mm256_blendv_ps(zero, wat, finite);
+            const __m256 d = _mm256_blendv_ps(zero, sed, finite);
+            const __m256 h = _mm256_blendv_ps(zero, height, finite);
+            water[0] = _mm256_add_pd(water[0], _mm256_cvtps_pd(_mm256_castps256_ps128(w)));
+            water[1] = _mm256_add_pd(water[1], _mm256_cvtps_pd(_mm256_extractf128_ps(w, 1)));
+            sediment[0] = _mm256_add_pd(sediment[0], _mm256_cvtps_pd(_mm256_castps256_ps128(d)));
+            sediment[1] = _mm256_add_pd(sediment[1], _mm256_cvtps_pd(_mm256_extractf128_ps(d, 1)));
+            soil[0] = _mm256_add_pd(soil[0], _mm256_cvtps_pd(_mm256_castps256_ps128(h)));
+            soil[1] = _mm256_add_pd(soil[1], _mm256_cvtps_pd(_mm256_extractf128_ps(h, 1)));
+
+            if constexpr (Change) {
+                const __m256 diff = _mm256_andnot_ps(sign, _mm256_sub_ps(height, _mm256_loadu_ps(a.reference + i)));
+                const __m256 c = _mm256_blendv_ps(zero, diff, finite);
+                change[0] = _mm256_add_pd(change[0], _mm256_cvtps_pd(_mm256_castps256_ps128(c)));
+                change[1] = _mm256_add_pd(change[1], _mm256_cvtps_pd(_mm256_extractf128_ps(c, 1)));
+                v_change_max = _mm256_max_ps(v_change_max, c);
+                _mm256_storeu_ps(a.reference + i, height);
+            }
+        }
+
+        DiagnosticsLanes row;
+        for (int k = 0; k < 2; ++k) {
+            _mm256_storeu_pd(row.water + 4 * k, water[k]);
+            _mm256_storeu_pd(row.sediment + 4 * k, sediment[k]);
+            _mm256_storeu_pd(row.soil + 4 * k, soil[k]);
+            _mm256_storeu_pd(row.change + 4 * k, change[k]);
+        }
+        for (int x = simd_end; x < a.width; ++x)
+            diagnostics_cell<Change>(a, row_start + x, x % DiagLanes, row, s);
+        lanes.add(row);
+    }
+
+    float mins[8], maxs[8], change_maxs[8];
+    _mm256_storeu_ps(mins, v_min);
+    _mm256_storeu_ps(maxs, v_max);
+    _mm256_storeu_ps(change_maxs, v_change_max);
+    for (int l = 0; l < 8; ++l) {
+        s.min_height = std::min(s.min_height, mins[l]);
+        s.max_height = std::max(s.max_height, maxs[l]);
+        s.change_max = std::max(s.change_max, change_maxs[l]);
+    }
+}
+
+#endif // DIRTBOX_KERNELS_X86
+
+template<bool Change>
+void diagnostics_rows(const DiagnosticsKernelArgs& a, int y0, int y1, SimdLevel level, DiagnosticsLanes& lanes, DiagnosticsSums& s) {
+    switch (std::min(level, supported_level())) {
+#ifdef DIRTBOX_KERNELS_X86
+    case SimdLevel::AVX2:
+        diagnostics_rows_avx2<Change>(a, y0, y1, lanes, s);
+        return;
+    case SimdLevel::SSE41:
+        diagnostics_rows_sse41<Change>(a, y0, y1, lanes, s);
+        return;
+#endif
+    default:
+        diagnostics_rows_scalar<Change>(a, y0, y1, lanes, s);
+        return;
+    }
+}
+
+}
+
+const char* toString(SimdLevel level) {
+    switch (level) {
+    case SimdLevel::Scalar:
+        return "scalar";
+    case SimdLevel::SSE41:
+        return "sse4.1";
+    case SimdLevel::AVX2:
+        return "avx2";
+    }
+    return "unknown";
+}
+
+SimdLevel detectSimdLevel() {
+#ifdef DIRTBOX_KERNELS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return SimdLevel::AVX2;
+    if (__builtin_cpu_supports("sse4.1"))
+        return SimdLevel::SSE41;
+#endif
+    return SimdLevel::Scalar;
+}
+
+SimdLevel getSimdLevel() {
+    const int level = active_level.load(std::memory_order_relaxed);
+    return level < 0 ? supported_level() : static_cast<SimdLevel>(level);
+}
+
+void setSimdLevel(SimdLevel level) {
+    active_level.store(static_cast<int>(std::min(level, supported_level())), std::memory_order_relaxed);
+}
+
+void computeOutflows(const OutflowKernelArgs& args, int y0, int y1, SimdLevel level) {
+    computeOutflows(args, 0, args.width, y0, y1, level);
+}
+
+void computeOutflows(const OutflowKernelArgs& args, int x0, int x1, int y0, int y1, SimdLevel level) {
+    x0 = std::max(x0, 0);
+    x1 = std::min(x1, args.width);
+    y0 = std::max(y0, 0);
+    y1 = std::min(y1, args.height);
+    if (x0 >= x1 || y0 >= y1)
+        return;
+#ifdef DIRTBOX_KERNELS_X86
+    switch (std::min(level, supported_level())) {
+    case SimdLevel::AVX2:
+        outflow_rows_avx2(args, x0, x1, y0, y1);
+        return;
+    case SimdLevel::SSE41:
+        outflow_rows_sse41(args, x0, x1, y0, y1);
+        return;
+    default:
+        break;
+    }
+#endif
+    outflow_rows_scalar(args, x0, x1, y0, y1);
+}
+
+void computeTalusFlows(const TalusKernelArgs& args, int y0, int y1, SimdLevel level) {
+    y0 = std::max(y0, 0);
+    y1 = std::min(y1, args.height);
+    if (y0 >= y1 || args.width <= 0)
+        return;
+#ifdef DIRTBOX_KERNELS_X86
+    switch (std::min(level, supported_level())) {
+    case SimdLevel::AVX2:
+        talus_flow_rows_avx2(args, y0, y1);
+        return;
+    case SimdLevel::SSE41:
+        talus_flow_rows_sse41(args, y0, y1);
+        return;
+    default:
+        break;
+    }
+#endif
+    talus_flow_rows_scalar(args, y0, y1);
+}
+
+void applyTalusFlows(const TalusKernelArgs& args, int y0, int y1, SimdLevel level) {
+    y0 = std::max(y0, 0);
+    y1 = std::min(y1, args.height);
+    if (y0 >= y1 || args.width <= 0)
+        return;
+#ifdef DIRTBOX_KERNELS_X86
+    switch (std::min(level, supported_level())) {
+    case SimdLevel::AVX2:
+        talus_apply_rows_avx2(args, y0, y1);
+        return;
+    case SimdLevel::SSE41:
+        talus_apply_rows_sse41(args, y0, y1);
+        return;
+    default:
+        break;
+    }
+#endif
+    talus_apply_rows_scalar(args, y0, y1);
+}
+
+void stepDroplets(const DropletKernelArgs& args, DropletBatch& batch, DropletDeposits& deposits, SimdLevel level) {
+#ifdef DIRTBOX_KERNELS_X86
+    switch (std::min(level, supported_level())) {
+    case SimdLevel::AVX2:
+        droplets_avx2(args, batch, deposits);
+        return;
+    case SimdLevel::SSE41:
+        droplets_sse41(args, batch, deposits);
+        return;
+    default:
+        break;
+    }
+#endif
+    droplets_scalar(args, batch, deposits);
+}
+
+DiagnosticsSums mergeDiagnostics(const DiagnosticsSums& a, const DiagnosticsSums& b) {
+    DiagnosticsSums s;
+    s.water = a.water + b.water;
+    s.sediment = a.sediment + b.sediment;
+    s.soil = a.soil + b.soil;
+    s.min_height = std::min(a.min_height, b.min_height);
+    s.max_height = std::max(a.max_height, b.max_height);
+    s.non_finite = a.non_finite + b.non_finite;
+    s.change = a.change + b.change;
+    s.change_max = std::max(a.change_max, b.change_max);
+    return s;
+}
+
+DiagnosticsSums reduceDiagnostics(const DiagnosticsKernelArgs& args, int y0, int y1, SimdLevel level) {
+    DiagnosticsLanes lanes;
+    DiagnosticsSums sums;
+    if (y0 < y1 && args.width > 0) {
+        if (args.reference)
+            diagnostics_rows<true>(args, y0, y1, level, lanes, sums);
+        else
+            diagnostics_rows<false>(args, y0, y1, level, lanes, sums);
+    }
+    sums.water = lane_sum(lanes.water);
+    sums.sediment = lane_sum(lanes.sediment);
+    sums.soil = lane_sum(lanes.soil);
+    sums.change = lane_sum(lanes.change);
+    return sums;
+}
+
+}
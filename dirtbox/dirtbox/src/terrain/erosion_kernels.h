@@ -0,0 +1,300 @@
+/**
+ * @brief SIMD kernels for the CPU erosion models
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ */
+#pragma once
+#ifndef DIRTBOX_EROSION_KERNELS_H
+#define DIRTBOX_EROSION_KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+
+namespace dirtbox::terrain {
+
+/**
+ * @brief instruction set used by the CPU kernels
+ *
+ */
+enum class SimdLevel {
+    Scalar,
+    SSE41,
+    AVX2
+};
+
+const char* toString(SimdLevel level);
+
+/**
+ * @brief best instruction set supported by this CPU, from cpuid
+ *
+ * @return SimdLevel
+ */
+SimdLevel detectSimdLevel();
+
+/**
+ * @brief instruction set the kernels dispatch to by default. Starts as detectSimdLevel()
+ *
+ * @return SimdLevel
+ */
+SimdLevel getSimdLevel();
+
+/**
+ * @brief override the default dispatch, clamped to what the CPU supports
+ *
+ * @param level
+ */
+void setSimdLevel(SimdLevel level);
+
+/**
+ * @brief inputs to the pipe model outflow step, one SoA plane per layer. All planes share the same
+ * stride. Elevation layers are in meters.
+ *
+ */
+struct OutflowKernelArgs {
+    const float* rock;
+    const float* water;
+    const float* sediment;
+    // out flows towards (0, 1), (1, 0), (0, -1), (-1, 0)
+    const float* flow_in[4];
+    float* flow_out[4];
+
+    int width;
+    int height;
+    std::ptrdiff_t stride;
+
+    float step_time_constant;
+    float rainfall;
+    float cell_size;
+    float virtual_pipe_area;
+    float water_sediment_capacity;
+};
+
+/**
+ * @brief compute new out flows for rows [y0, y1) as in cs_model2_flux.sc: pipe pressure from
+ * the 4 neighbor height differences, damping by suspended sediment and a rescale so the flows do
+ * not exceed the water in the cell. Results are identical for every SimdLevel.
+ *
+ * @param args
+ * @param y0
+ * @param y1
+ * @param level
+ */
+void computeOutflows(const OutflowKernelArgs& args, int y0, int y1, SimdLevel level);
+
+inline void computeOutflows(const OutflowKernelArgs& args, int y0, int y1) {
+    computeOutflows(args, y0, y1, getSimdLevel());
+}
+
+/**
+ * @brief compute new out flows for the cells in columns [x0, x1) of rows [y0, y1)
+ *
+ * @param args
+ * @param x0
+ * @param x1
+ * @param y0
+ * @param y1
+ * @param level
+ */
+void computeOutflows(const OutflowKernelArgs& args, int x0, int x1, int y0, int y1, SimdLevel level);
+
+inline void computeOutflows(const OutflowKernelArgs& args, int x0, int x1, int y0, int y1) {
+    computeOutflows(args, x0, x1, y0, y1, getSimdLevel());
+}
+
+/**
+ * @brief inputs to the thermal weathering pass, one SoA plane per layer with a shared stride.
+ * Elevation layers are in meters.
+ *
+ */
+struct TalusKernelArgs {
+    const float* rock;
+    const float* water;
+    const float* hardness;
+    // soil out flows in the Dirmap order of cs_model2_common.sh, written by computeTalusFlows and
+    // read by applyTalusFlows
+    float* flows[8];
+    // rock after the pass, may be rock
+    float* rock_out;
+
+    int width;
+    int height;
+    std::ptrdiff_t stride;
+
+    float cell_size;
+    float time_step;
+    float thermal_erosion_rate;
+    float talus_angle_tangent_coef;
+    float talus_angle_tangent_bias;
+    // hardness is clamped to the range the hydraulic step keeps it in, cells no step has run on
+    // yet have a hardness of 0
+    float min_hardness;
+    float max_hardness;
+};
+
+/**
+ * @brief compute the soil out flows of rows [y0, y1) towards the 8 neighbors whose slope is
+ * steeper than the talus angle, hardness * talus_angle_tangent_coef + talus_angle_tangent_bias.
+ * Results are identical for every SimdLevel.
+ *
+ * @param args
+ * @param y0
+ * @param y1
+ * @param level
+ */
+void computeTalusFlows(const TalusKernelArgs& args, int y0, int y1, SimdLevel level);
+
+inline void computeTalusFlows(const TalusKernelArgs& args, int y0, int y1) {
+    computeTalusFlows(args, y0, y1, getSimdLevel());
+}
+
+/**
+ * @brief move the soil flows of computeTalusFlows for rows [y0, y1), rock_out = rock + (in - out)
+ * * time_step / cell area. Every flow must have been computed before any row is applied. Results
+ * are identical for every SimdLevel.
+ *
+ * @param args
+ * @param y0
+ * @param y1
+ * @param level
+ */
+void applyTalusFlows(const TalusKernelArgs& args, int y0, int y1, SimdLevel level);
+
+inline void applyTalusFlows(const TalusKernelArgs& args, int y0, int y1) {
+    applyTalusFlows(args, y0, y1, getSimdLevel());
+}
+
+// droplets advanced together by stepDroplets, one SIMD lane each. The same at every SimdLevel
+// so the order droplets deposit in does not depend on it
+constexpr int DropletLanes = 8;
+
+/**
+ * @brief state of DropletLanes droplets, one lane each. Positions are in cells
+ *
+ */
+struct DropletBatch {
+    float x[DropletLanes];
+    float y[DropletLanes];
+    // unit direction of the last move
+    float dir_x[DropletLanes];
+    float dir_y[DropletLanes];
+    float speed[DropletLanes];
+    float water[DropletLanes];
+    // carried sediment, m of height over one cell
+    float sediment[DropletLanes];
+    // -1 while the droplet moves, 0 once it has left the grid or stopped
+    int32_t alive[DropletLanes];
+};
+
+/**
+ * @brief height map the droplets run over and the droplet constants
+ *
+ */
+struct DropletKernelArgs {
+    // rock and sand, m
+    const float* ground;
+    int width;
+    int height;
+    std::ptrdiff_t stride;
+
+    float cell_size;
+    // share of the last direction kept in each move
+    float inertia;
+    float capacity;
+    float min_slope;
+    float erosion_rate;
+    float deposition_rate;
+    float evaporation_rate;
+    float gravity;
+};
+
+/**
+ * @brief height a droplet step deposits (> 0) or erodes (< 0), to be spread bilinearly over the
+ * 4 cells around the position the droplet moved from
+ *
+ */
+struct DropletDeposits {
+    // index of the cell with the lowest x and y of the 4
+    int32_t cell[DropletLanes];
+    float fx[DropletLanes];
+    float fy[DropletLanes];
+    // 0 for lanes that were not alive
+    float amount[DropletLanes];
+};
+
+/**
+ * @brief move every live droplet of batch one cell down the bilinear height gradient. A droplet
+ * erodes while it carries less sediment than its capacity, which grows with slope, speed and
+ * water, and deposits otherwise. Droplets that leave the grid lose their sediment, droplets that
+ * stop deposit it. Results are identical for every SimdLevel.
+ *
+ * @param args
+ * @param batch
+ * @param deposits
+ * @param level
+ */
+void stepDroplets(const DropletKernelArgs& args, DropletBatch& batch, DropletDeposits& deposits, SimdLevel level);
+
+inline void stepDroplets(const DropletKernelArgs& args, DropletBatch& batch, DropletDeposits& deposits) {
+    stepDroplets(args, batch, deposits, getSimdLevel());
+}
+
+/**
+ * @brief elevation layers reduced by reduceDiagnostics, one SoA plane per layer with a shared
+ * stride
+ *
+ */
+struct DiagnosticsKernelArgs {
+    const float* rock;
+    const float* sand;
+    const float* sediment;
+    const float* water;
+    // ground height of an earlier reduction, the change to the current one is summed and it is
+    // overwritten with the current height. nullptr to skip
+    float* reference;
+
+    int width;
+    std::ptrdiff_t stride;
+};
+
+/**
+ * @brief column sums, in the units of the layers. Cells with a non-finite layer are only counted
+ *
+ */
+struct DiagnosticsSums {
+    double water = 0;
+    double sediment = 0;
+    // rock and sand
+    double soil = 0;
+    // of rock and sand
+    float min_height = INFINITY;
+    float max_height = -INFINITY;
+    uint64_t non_finite = 0;
+    // absolute ground height change against the reference
+    double change = 0;
+    float change_max = 0;
+};
+
+DiagnosticsSums mergeDiagnostics(const DiagnosticsSums& a, const DiagnosticsSums& b);
+
+/**
+ * @brief reduce rows [y0, y1). Sums are accumulated in 8 double lanes by column, lane x % 8,
+ * and combined in a fixed tree, so results are identical for every SimdLevel. Merge the results
+ * of bands in a fixed order for results that do not depend on the thread count.
+ *
+ * @param args
+ * @param y0
+ * @param y1
+ * @param level
+ * @return DiagnosticsSums
+ */
+DiagnosticsSums reduceDiagnostics(const DiagnosticsKernelArgs& args, int y0, int y1, SimdLevel level);
+
+inline DiagnosticsSums reduceDiagnostics(const DiagnosticsKernelArgs& args, int y0, int y1) {
+    return reduceDiagnostics(args, y0, y1, getSimdLevel());
+}
+
+}
+
+#endif // DIRTBOX_EROSION_KERNELS_H
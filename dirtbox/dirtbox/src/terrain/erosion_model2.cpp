@@ -1,8 +1,18 @@
 #include <terrain/erosion_model2.h>
+#include <terrain/erosion_model2_params.h>
+#include <terrain/erosion_model2_cpu.h>
+#include <terrain/erosion_pyramid_cpu.h>
+#include <terrain/stream_power_cpu.h>
 
+#include <array>
+#include <vector>
 #include <cmath>
 #include <algorithm>
 #include <iostream>
+#include <cstring>
+#include <iterator>
+#include <utility>
+#include <chrono>
 
 #include <bgfx/bgfx.h>
 #include <bimg/bimg.h>
@@ -10,30 +20,14 @@
 #include <resource/image.h>
 #include <graphics/texture.h>
 #include <terrain/terrain.h>
+#include <core/core.h>
 #include <util/box_utils.h>
+#include <util/half.h>
 
 namespace dirtbox::terrain {
 
-struct Erosion2GPUUniforms {
-    Erosion2GPUUniforms() : 
-        water_sediment_capacity         {1.f},
-        maximal_erosion_depth           {10.0f},
-        step_time_constant              {0.05f},
-        cell_size                       {30.0f},
-        // soil_absorption                 {0.0f},
-        // bedrock_erosion_base_value      {0.05f},
-        rock_erosion_base_value         {0.05f},
-        iterations                      {1000},
-        rainfall                        {0.01f},
-        terrain_elevation_scale         {100},
-        virtual_pipe_area               {10},
-        soil_suspension_rate            {0.5f},
-        sediment_deposition_rate        {1},
-        soil_softness_max               {0.1f},
-        water_evaporation_rate          {0.015f},
-        thermal_erosion_rate            {0.15f},
-        talus_angle_tangent_coef        {0.8f},
-        talus_angle_tangent_bias        {0.1f} {
+struct Erosion2GPUUniforms : Erosion2Parameters {
+    Erosion2GPUUniforms() {
         u_params = bgfx::createUniform("u_params", bgfx::UniformType::Vec4, 5);
     }
 
@@ -41,93 +35,31 @@ struct Erosion2GPUUniforms {
         bgfx::setUniform(u_params, params, 5);
     }
 
-    void toParameterSet(util::ParameterCollection<float>& parameters) {
-        parameters.addParameter("water_sediment_capacity", 0.1f, 3.f, water_sediment_capacity);
-        parameters.addParameter("maximal_erosion_depth", 0, 40, maximal_erosion_depth);
-        parameters.addParameter("iterations", 1, 1, iterations);
-        parameters.addParameter("step_time_constant", 0.01f, 10.0f, step_time_constant);
-        // rainfall in meters per year
-        parameters.addParameter("rainfall", 0.0001f, 0.5f, rainfall);
-        parameters.addParameter("cell_size", 0.5f, 150.0f, cell_size);
-
-        // soil absorbtion coef
-        // parameters.addParameter("soil_absorption", 0.0f, 1.0f, soil_absorption);
-
-        // layer parameters
-        parameters.addParameter("rock_erosion_base_value", 0.0001f, 0.1f, rock_erosion_base_value);
-        // parameters.addParameter("bedrock_erosion_base_value", 0.0001f, 0.1f, bedrock_erosion_base_value);
-
-        parameters.addParameter("terrain_elevation_scale", 1, 500, terrain_elevation_scale);
-        parameters.addParameter("virtual_pipe_area", 0.1, 60, virtual_pipe_area);
-        parameters.addParameter("soil_suspension_rate", 0.1f, 2.f, soil_suspension_rate);
-        parameters.addParameter("sediment_deposition_rate", 0.1f, 3.f, sediment_deposition_rate);
-        parameters.addParameter("soil_softness_max", 0.1, 1, soil_softness_max);
-        parameters.addParameter("water_evaporation_rate", 0, 0.05f, water_evaporation_rate);
-        parameters.addParameter("thermal_erosion_rate", 0, 3, thermal_erosion_rate);
-        parameters.addParameter("talus_angle_tangent_coef", 0, 1, talus_angle_tangent_coef);
-        parameters.addParameter("talus_angle_tangent_bias", 0, 1, talus_angle_tangent_bias);
-    }
-
-    void fromParameterSet(const util::ParameterCollection<float>& p) {
-        water_sediment_capacity     = p.getParam("water_sediment_capacity");
-        maximal_erosion_depth       = p.getParam("maximal_erosion_depth");
-        iterations                  = p.getParam("iterations");
-        step_time_constant          = p.getParam("step_time_constant");
-        rainfall                    = p.getParam("rainfall");
-        cell_size                   = p.getParam("cell_size");
-        // soil_absorption             = p.getParam("soil_absorption");
-        rock_erosion_base_value     = p.getParam("rock_erosion_base_value");
-        // bedrock_erosion_base_value  = p.getParam("bedrock_erosion_base_value");
-        terrain_elevation_scale     = p.getParam("terrain_elevation_scale");
-        virtual_pipe_area           = p.getParam("virtual_pipe_area");
-        soil_suspension_rate        = p.getParam("soil_suspension_rate");
-        sediment_deposition_rate    = p.getParam("sediment_deposition_rate");
-        soil_softness_max           = p.getParam("soil_softness_max");
-        water_evaporation_rate      = p.getParam("water_evaporation_rate");
-        thermal_erosion_rate        = p.getParam("thermal_erosion_rate");
-        talus_angle_tangent_coef    = p.getParam("talus_angle_tangent_coef");
-        talus_angle_tangent_bias    = p.getParam("talus_angle_tangent_bias");
-    }
-
     bgfx::UniformHandle u_params;
-
-    union
-    {
-        struct
-        {
-            float water_sediment_capacity;
-            float maximal_erosion_depth;
-            float step_time_constant;
-            float cell_size;
-
-            float unused;
-            float bedrock_erosion_base_value;
-            float rock_erosion_base_value;
-            float iterations;
-
-            float rainfall;
-            float terrain_elevation_scale;
-            float virtual_pipe_area;
-            float soil_suspension_rate;
-
-            float sediment_deposition_rate;
-            float soil_softness_max;
-            float water_evaporation_rate;
-            float thermal_erosion_rate;
-
-            float talus_angle_tangent_coef;
-            float talus_angle_tangent_bias;
-        };
-
-        float params[20];
-    };
 };
 
 class Erosion2GPUImpl {
 public:
+    // cells per side of an activity tile, TILE_SIZE in cs_model2_tiles_common.sh
+    static constexpr int TileSize = 32;
+    // cells per side of the work groups of the passes, GROUP_SIZE in cs_model2_tiles_common.sh
+    static constexpr int GroupSize = 16;
+
     bool A_B = true;
 
-    bgfx::ProgramHandle erosion_program;
+    // passes of a step in dispatch order, see cs_model2_common.sh
+    bgfx::ProgramHandle flux_program;
+    bgfx::ProgramHandle water_program;
+    bgfx::ProgramHandle erosion_deposition_program;
+    bgfx::ProgramHandle thermal_program;
+    bgfx::ProgramHandle advection_program;
+    // standalone thermal pass between the steps
+    bgfx::ProgramHandle talus_program;
+    bgfx::ProgramHandle tiles_program;
+    bgfx::ProgramHandle tiles_args_program;
+    bgfx::ProgramHandle freeze_program;
+    bgfx::ProgramHandle flow_extent_program;
+    bgfx::ProgramHandle flow_extent_store_program;
 
     bgfx::TextureHandle elevation_data_a    {bgfx::kInvalidHandle};
     bgfx::TextureHandle outflows_data_a     {bgfx::kInvalidHandle};
@@ -139,11 +71,65 @@ public:
 
     bgfx::TextureHandle soil_flows_1        {bgfx::kInvalidHandle};
     bgfx::TextureHandle soil_flows_2        {bgfx::kInvalidHandle};
+    // elevation between the passes of a step
+    bgfx::TextureHandle elevation_mid       {bgfx::kInvalidHandle};
+
+    // sparse active tiles, see cs_model2_tiles.sc
+    bgfx::DynamicIndexBufferHandle tile_list        {bgfx::kInvalidHandle};
+    bgfx::DynamicIndexBufferHandle freeze_list      {bgfx::kInvalidHandle};
+    bgfx::DynamicIndexBufferHandle tile_changed     {bgfx::kInvalidHandle};
+    bgfx::DynamicIndexBufferHandle tile_active      {bgfx::kInvalidHandle};
+    bgfx::DynamicIndexBufferHandle tile_counters    {bgfx::kInvalidHandle};
+    bgfx::IndirectBufferHandle tile_dispatch        {bgfx::kInvalidHandle};
+    // x = 0: active tiles in the last step, x = 1: skipped tile updates since init
+    bgfx::TextureHandle tile_stats                  {bgfx::kInvalidHandle};
+    bgfx::UniformHandle u_tile_params;
+
+    int tiles_x = 0, tiles_y = 0;
+    uint32_t tile_step = 0;
+    uint32_t tile_stats_data[2] = {};
+    // frame the pending tile_stats read completes in, 0 when there is none
+    uint32_t tile_stats_frame = 0;
+    uint64_t skipped_tiles = 0;
+
+    // adaptive time step, see cs_model2_flow_extent.sc
+    bgfx::DynamicIndexBufferHandle flow_extent      {bgfx::kInvalidHandle};
+    // x = 0: largest speed, x = 1: largest depth, as float bits
+    bgfx::TextureHandle flow_extent_stats           {bgfx::kInvalidHandle};
+    uint32_t flow_extent_data[2] = {};
+    // frame the pending flow_extent_stats read completes in, 0 when there is none
+    uint32_t flow_extent_frame = 0;
+
+    // conservation diagnostics, see cs_model2_diagnostics.sc. Level 0 holds two texels per work
+    // group of the grid, each further level two per work group of the level before, down to 2x1
+    bgfx::ProgramHandle diagnostics_program;
+    bgfx::ProgramHandle diagnostics_reduce_program;
+    std::vector<bgfx::TextureHandle> diagnostics_levels;
+    // ground height of the last reduction, for the change between them
+    bgfx::TextureHandle height_reference            {bgfx::kInvalidHandle};
+    // the two texels of the last level
+    float diagnostics_data[8] = {};
+    // frame the pending diagnostics read completes in, 0 when there is none
+    uint32_t diagnostics_frame = 0;
+    uint32_t diagnostics_iteration = 0;
+    // reductions since loadDiagnosticsLevels, the first has no reference height
+    uint32_t diagnostics_count = 0;
 
     Erosion2GPUUniforms uniforms;
 
     int w, h;
 
+    // out flow, velocity and soil flow storage, the programs bind it in the matching format
+    bool half_precision = false;
+    bgfx::TextureFormat::Enum flow_format = bgfx::TextureFormat::RGBA32F;
+
+    // compute dispatches submitted so far, for the GPU time per dispatch
+    uint32_t dispatches = 0;
+
+    Erosion2GPUImpl() {
+        u_tile_params = bgfx::createUniform("u_tile_params", bgfx::UniformType::Vec4);
+    }
+
     ~Erosion2GPUImpl() {
         if (bgfx::isValid(elevation_data_a))
             bgfx::destroy(elevation_data_a);
@@ -163,6 +149,42 @@ public:
             bgfx::destroy(soil_flows_1);
         if (bgfx::isValid(soil_flows_2))
             bgfx::destroy(soil_flows_2);
+        if (bgfx::isValid(elevation_mid))
+            bgfx::destroy(elevation_mid);
+
+        destroyTileBuffers();
+        destroyDiagnosticsLevels();
+        bgfx::destroy(u_tile_params);
+    }
+
+    void destroyDiagnosticsLevels() {
+        for (auto level : diagnostics_levels)
+            bgfx::destroy(level);
+        diagnostics_levels.clear();
+        if (bgfx::isValid(height_reference))
+            bgfx::destroy(height_reference);
+        height_reference = BGFX_INVALID_HANDLE;
+    }
+
+    void destroyTileBuffers() {
+        if (bgfx::isValid(tile_list))
+            bgfx::destroy(tile_list);
+        if (bgfx::isValid(freeze_list))
+            bgfx::destroy(freeze_list);
+        if (bgfx::isValid(tile_changed))
+            bgfx::destroy(tile_changed);
+        if (bgfx::isValid(tile_active))
+            bgfx::destroy(tile_active);
+        if (bgfx::isValid(tile_counters))
+            bgfx::destroy(tile_counters);
+        if (bgfx::isValid(tile_dispatch))
+            bgfx::destroy(tile_dispatch);
+        if (bgfx::isValid(tile_stats))
+            bgfx::destroy(tile_stats);
+        if (bgfx::isValid(flow_extent))
+            bgfx::destroy(flow_extent);
+        if (bgfx::isValid(flow_extent_stats))
+            bgfx::destroy(flow_extent_stats);
     }
 
     bgfx::TextureHandle getOutputElevationData() {
@@ -170,7 +192,82 @@ public:
     }
 
     void loadPrograms() {
-        erosion_program = bgfx::createProgram(loadShader("cs_model2_erosion"), true);
+        loadStatePrograms();
+        tiles_program = bgfx::createProgram(loadShader("cs_model2_tiles"), true);
+        tiles_args_program = bgfx::createProgram(loadShader("cs_model2_tiles_args"), true);
+        flow_extent_store_program = bgfx::createProgram(loadShader("cs_model2_flow_extent_store"), true);
+        diagnostics_program = bgfx::createProgram(loadShader("cs_model2_diagnostics"), true);
+        diagnostics_reduce_program = bgfx::createProgram(loadShader("cs_model2_diagnostics_reduce"), true);
+    }
+
+    // programs that bind the out flow, velocity or soil flow images, the *_half variants for
+    // RGBA16F storage
+    void loadStatePrograms() {
+        const std::string suffix = half_precision ? "_half" : "";
+        flux_program = bgfx::createProgram(loadShader("cs_model2_flux" + suffix), true);
+        water_program = bgfx::createProgram(loadShader("cs_model2_water" + suffix), true);
+        erosion_deposition_program = bgfx::createProgram(loadShader("cs_model2_erosion_deposition" + suffix), true);
+        thermal_program = bgfx::createProgram(loadShader("cs_model2_thermal" + suffix), true);
+        advection_program = bgfx::createProgram(loadShader("cs_model2_advection" + suffix), true);
+        talus_program = bgfx::createProgram(loadShader("cs_model2_talus" + suffix), true);
+        freeze_program = bgfx::createProgram(loadShader("cs_model2_freeze" + suffix), true);
+        flow_extent_program = bgfx::createProgram(loadShader("cs_model2_flow_extent" + suffix), true);
+    }
+
+    /**
+     * @brief select the storage of the out flow, velocity and soil flow textures. Takes effect
+     * with the next loadTextures
+     * 
+     * @param half RGBA16F instead of RGBA32F
+     */
+    void setHalfPrecision(bool half) {
+        if (half == half_precision)
+            return;
+        half_precision = half;
+        flow_format = half ? bgfx::TextureFormat::RGBA16F : bgfx::TextureFormat::RGBA32F;
+        for (auto program : {flux_program, water_program, erosion_deposition_program, thermal_program, advection_program, talus_program, freeze_program, flow_extent_program})
+            bgfx::destroy(program);
+        loadStatePrograms();
+    }
+
+    // every tile starts active with no skipped updates
+    void loadTileBuffers() {
+        destroyTileBuffers();
+
+        tiles_x = (w + TileSize - 1) / TileSize;
+        tiles_y = (h + TileSize - 1) / TileSize;
+        const uint32_t num_tiles = tiles_x * tiles_y;
+        const std::vector<uint32_t> zeros(num_tiles, 0);
+        const uint16_t flags = BGFX_BUFFER_COMPUTE_READ_WRITE | BGFX_BUFFER_INDEX32;
+
+        tile_list = bgfx::createDynamicIndexBuffer(num_tiles, flags);
+        freeze_list = bgfx::createDynamicIndexBuffer(num_tiles, flags);
+        tile_changed = bgfx::createDynamicIndexBuffer(bgfx::copy(zeros.data(), num_tiles * sizeof(uint32_t)), flags);
+        tile_active = bgfx::createDynamicIndexBuffer(bgfx::copy(zeros.data(), num_tiles * sizeof(uint32_t)), flags);
+        tile_counters = bgfx::createDynamicIndexBuffer(bgfx::copy(zeros.data(), 3 * sizeof(uint32_t)), flags);
+        tile_dispatch = bgfx::createIndirectBuffer(2);
+        tile_stats = bgfx::createTexture2D(2, 1, false, 1, bgfx::TextureFormat::R32U, BGFX_TEXTURE_READ_BACK | BGFX_TEXTURE_COMPUTE_WRITE);
+
+        flow_extent = bgfx::createDynamicIndexBuffer(bgfx::copy(zeros.data(), 2 * sizeof(uint32_t)), flags);
+        flow_extent_stats = bgfx::createTexture2D(2, 1, false, 1, bgfx::TextureFormat::R32U, BGFX_TEXTURE_READ_BACK | BGFX_TEXTURE_COMPUTE_WRITE);
+
+        tile_step = 0;
+        tile_stats_frame = 0;
+        skipped_tiles = 0;
+        flow_extent_frame = 0;
+    }
+
+    void loadDiagnosticsLevels() {
+        destroyDiagnosticsLevels();
+        int gx = w, gy = h;
+        do {
+            gx = (gx + GroupSize - 1) / GroupSize;
+            gy = (gy + GroupSize - 1) / GroupSize;
+            diagnostics_levels.push_back(bgfx::createTexture2D(2 * gx, gy, false, 1, bgfx::TextureFormat::RGBA32F, BGFX_TEXTURE_READ_BACK | BGFX_TEXTURE_COMPUTE_WRITE));
+        } while (gx > 1 || gy > 1);
+        height_reference = bgfx::createTexture2D(w, h, false, 1, bgfx::TextureFormat::R32F, BGFX_TEXTURE_COMPUTE_WRITE);
+        diagnostics_frame = 0;
+        diagnostics_count = 0;
     }
 
     void loadTextures() {
@@ -182,12 +279,12 @@ public:
         if (bgfx::isValid(outflows_data_a)) {
             bgfx::destroy(outflows_data_a);
         }
-        outflows_data_a = bgfx::createTexture2D(w, h, false, 1, bgfx::TextureFormat::RGBA32F, BGFX_TEXTURE_READ_BACK | BGFX_TEXTURE_COMPUTE_WRITE);
+        outflows_data_a = bgfx::createTexture2D(w, h, false, 1, flow_format, BGFX_TEXTURE_READ_BACK | BGFX_TEXTURE_COMPUTE_WRITE);
 
         if (bgfx::isValid(velocity_data_a)) {
             bgfx::destroy(velocity_data_a);
         }
-        velocity_data_a = bgfx::createTexture2D(w, h, false, 1, bgfx::TextureFormat::RGBA32F, BGFX_TEXTURE_READ_BACK | BGFX_TEXTURE_COMPUTE_WRITE);
+        velocity_data_a = bgfx::createTexture2D(w, h, false, 1, flow_format, BGFX_TEXTURE_READ_BACK | BGFX_TEXTURE_COMPUTE_WRITE);
 
         if (bgfx::isValid(elevation_data_b)) {
             bgfx::destroy(elevation_data_b);
@@ -197,80 +294,386 @@ public:
         if (bgfx::isValid(outflows_data_b)) {
             bgfx::destroy(outflows_data_b);
         }
-        outflows_data_b = bgfx::createTexture2D(w, h, false, 1, bgfx::TextureFormat::RGBA32F, BGFX_TEXTURE_READ_BACK | BGFX_TEXTURE_COMPUTE_WRITE);
+        outflows_data_b = bgfx::createTexture2D(w, h, false, 1, flow_format, BGFX_TEXTURE_READ_BACK | BGFX_TEXTURE_COMPUTE_WRITE);
 
         if (bgfx::isValid(velocity_data_b)) {
             bgfx::destroy(velocity_data_b);
         }
-        velocity_data_b = bgfx::createTexture2D(w, h, false, 1, bgfx::TextureFormat::RGBA32F, BGFX_TEXTURE_READ_BACK | BGFX_TEXTURE_COMPUTE_WRITE);
+        velocity_data_b = bgfx::createTexture2D(w, h, false, 1, flow_format, BGFX_TEXTURE_READ_BACK | BGFX_TEXTURE_COMPUTE_WRITE);
 
         if (bgfx::isValid(soil_flows_1)) {
             bgfx::destroy(soil_flows_1);
         }
-        soil_flows_1 = bgfx::createTexture2D(w, h, false, 1, bgfx::TextureFormat::RGBA32F, BGFX_TEXTURE_READ_BACK | BGFX_TEXTURE_COMPUTE_WRITE);
+        soil_flows_1 = bgfx::createTexture2D(w, h, false, 1, flow_format, BGFX_TEXTURE_READ_BACK | BGFX_TEXTURE_COMPUTE_WRITE);
 
         if (bgfx::isValid(soil_flows_2)) {
             bgfx::destroy(soil_flows_2);
         }
-        soil_flows_2 = bgfx::createTexture2D(w, h, false, 1, bgfx::TextureFormat::RGBA32F, BGFX_TEXTURE_READ_BACK | BGFX_TEXTURE_COMPUTE_WRITE);
+        soil_flows_2 = bgfx::createTexture2D(w, h, false, 1, flow_format, BGFX_TEXTURE_READ_BACK | BGFX_TEXTURE_COMPUTE_WRITE);
+
+        if (bgfx::isValid(elevation_mid)) {
+            bgfx::destroy(elevation_mid);
+        }
+        elevation_mid = bgfx::createTexture2D(w, h, false, 1, bgfx::TextureFormat::RGBA32F, BGFX_TEXTURE_COMPUTE_WRITE);
     }
 
     void init(const graphics::Texture& terr) {
         w = terr.getWidth();
         h = terr.getHeight();
         loadTextures();
-        bgfx::blit(3, elevation_data_a, 0, 0, terr.getHandle());
+        loadTileBuffers();
+        loadDiagnosticsLevels();
+        bgfx::blit(Erosion::ComputeView, elevation_data_a, 0, 0, terr.getHandle());
+    }
+
+    // state textures holding the result of the last dispatch, in CheckpointPlanes order
+    std::array<bgfx::TextureHandle, 5> getStateTextures() const {
+        if (A_B)
+            return {elevation_data_a, outflows_data_a, velocity_data_a, soil_flows_1, soil_flows_2};
+        return {elevation_data_b, outflows_data_b, velocity_data_b, soil_flows_1, soil_flows_2};
+    }
+
+    /**
+     * @brief queue a read of every state texture into planes of checkpoint
+     * 
+     * @return uint32_t frame number when the data is available
+     */
+    uint32_t readState(ErosionCheckpoint& checkpoint) const {
+        const auto textures = getStateTextures();
+        uint32_t frame = 0;
+        for (std::size_t i = 0; i < textures.size(); ++i) {
+            auto& plane = checkpoint.planes.emplace_back();
+            plane.name = CheckpointPlanes[i];
+            plane.width = w;
+            plane.height = h;
+            plane.channels = 4;
+            plane.data.resize((std::size_t)w * h * 4);
+            frame = std::max(frame, bgfx::readTexture(textures[i], plane.data.data()));
+        }
+        return frame;
     }
 
+    /**
+     * @brief convert the planes read by readState from half precision textures to floats, once
+     * the read has completed
+     * 
+     * @param checkpoint 
+     */
+    static void expandHalfPlanes(ErosionCheckpoint& checkpoint) {
+        // every state texture except the elevation
+        for (std::size_t i = 1; i < std::size(CheckpointPlanes); ++i) {
+            auto& data = checkpoint.planes[i].data;
+            util::expandHalfInPlace(data.data(), data.size());
+        }
+    }
+
+    /**
+     * @brief create state textures from checkpoint, the next dispatch continues from it
+     * 
+     * @return false if a plane is missing or has the wrong size
+     */
+    bool writeState(const ErosionCheckpoint& checkpoint) {
+        for (const char* name : CheckpointPlanes) {
+            const auto* plane = checkpoint.findPlane(name);
+            if (!plane || plane->width != w || plane->height != h || plane->channels != 4)
+                return false;
+        }
+
+        // frozen tiles are not saved, every tile starts active again
+        loadTextures();
+        loadTileBuffers();
+        loadDiagnosticsLevels();
+        A_B = true;
+        const auto textures = getStateTextures();
+        for (std::size_t i = 0; i < textures.size(); ++i) {
+            const auto& data = checkpoint.findPlane(CheckpointPlanes[i])->data;
+            if (i > 0 && half_precision) {
+                const bgfx::Memory* mem = bgfx::alloc(data.size() * sizeof(uint16_t));
+                util::packHalf(data.data(), reinterpret_cast<uint16_t*>(mem->data), data.size());
+                bgfx::updateTexture2D(textures[i], 0, 0, 0, 0, w, h, mem);
+            } else {
+                bgfx::updateTexture2D(textures[i], 0, 0, 0, 0, w, h, bgfx::copy(data.data(), data.size() * sizeof(float)));
+            }
+        }
+        return true;
+    }
+
+    static constexpr const char* CheckpointPlanes[5] = {"elevation", "outflows", "velocity", "soil_flows_1", "soil_flows_2"};
+
     bool copyTerrainTo(const graphics::Texture& terr) {
-        bgfx::blit(3, terr.getHandle(), 0, 0, getOutputElevationData());
+        bgfx::blit(Erosion::ComputeView, terr.getHandle(), 0, 0, getOutputElevationData());
+    }
+
+    void bindImage(uint8_t stage, bgfx::TextureHandle texture, bgfx::Access::Enum access) const {
+        const bool elevation = texture.idx == elevation_data_a.idx || texture.idx == elevation_data_b.idx || texture.idx == elevation_mid.idx;
+        bgfx::setImage(stage, texture, 0, access, elevation ? bgfx::TextureFormat::RGBA32F : flow_format);
     }
 
     void submit() {
-        if (A_B) {
-            bgfx::setImage(0, elevation_data_a, 0,        bgfx::Access::Read, bgfx::TextureFormat::RGBA32F);
-            bgfx::setImage(3, elevation_data_b, 0,        bgfx::Access::ReadWrite, bgfx::TextureFormat::RGBA32F);
-            
-            bgfx::setImage(1, outflows_data_a, 0,        bgfx::Access::Read, bgfx::TextureFormat::RGBA32F);
-            bgfx::setImage(4, outflows_data_b, 0,        bgfx::Access::Write, bgfx::TextureFormat::RGBA32F);
-
-            bgfx::setImage(2, velocity_data_a, 0,        bgfx::Access::Read, bgfx::TextureFormat::RGBA32F);
-            bgfx::setImage(5, velocity_data_b, 0,        bgfx::Access::Write, bgfx::TextureFormat::RGBA32F);
-        } else {
-            bgfx::setImage(0, elevation_data_b, 0,        bgfx::Access::Read, bgfx::TextureFormat::RGBA32F);
-            bgfx::setImage(3, elevation_data_a, 0,        bgfx::Access::ReadWrite, bgfx::TextureFormat::RGBA32F);
-            
-            bgfx::setImage(1, outflows_data_b, 0,        bgfx::Access::Read, bgfx::TextureFormat::RGBA32F);
-            bgfx::setImage(4, outflows_data_a, 0,        bgfx::Access::Write, bgfx::TextureFormat::RGBA32F);
-
-            bgfx::setImage(2, velocity_data_b, 0,        bgfx::Access::Read, bgfx::TextureFormat::RGBA32F);
-            bgfx::setImage(5, velocity_data_a, 0,        bgfx::Access::Write, bgfx::TextureFormat::RGBA32F);
-        }
+        const bool sparse = uniforms.activity_threshold > 0;
+        if (sparse)
+            tile_step++;
+        const float tile_params[4] = {(float)tile_step, (float)tiles_x, (float)tiles_y, sparse ? 1.0f : 0.0f};
+        if (sparse)
+            submitTiles(tile_params);
 
-        bgfx::setImage(6, soil_flows_1, 0,        bgfx::Access::ReadWrite, bgfx::TextureFormat::RGBA32F);
-        bgfx::setImage(7, soil_flows_2, 0,        bgfx::Access::ReadWrite, bgfx::TextureFormat::RGBA32F);
+        const auto in = getStateTextures();
+        const bgfx::TextureHandle elevation_out = A_B ? elevation_data_b : elevation_data_a;
+        const bgfx::TextureHandle outflows_out = A_B ? outflows_data_b : outflows_data_a;
+        const bgfx::TextureHandle velocity_out = A_B ? velocity_data_b : velocity_data_a;
 
-        uniforms.submit();
-        bgfx::dispatch(3, erosion_program, w, h);
+        // every pass covers the active tiles or the whole grid in 16x16 groups
+        auto dispatch = [&](bgfx::ProgramHandle program) {
+            bgfx::setBuffer(8, tile_list, bgfx::Access::Read);
+            bgfx::setUniform(u_tile_params, tile_params);
+            uniforms.submit();
+            dispatches++;
+            if (sparse)
+                bgfx::dispatch(Erosion::ComputeView, program, tile_dispatch, 0);
+            else
+                bgfx::dispatch(Erosion::ComputeView, program, (w + GroupSize - 1) / GroupSize, (h + GroupSize - 1) / GroupSize);
+        };
+
+        bindImage(0, in[0],              bgfx::Access::Read);
+        bindImage(1, in[1],              bgfx::Access::Read);
+        bindImage(4, outflows_out,       bgfx::Access::Write);
+        dispatch(flux_program);
+
+        bindImage(0, in[0],              bgfx::Access::Read);
+        bindImage(1, in[1],              bgfx::Access::Read);
+        bindImage(2, in[2],              bgfx::Access::Read);
+        bindImage(4, outflows_out,       bgfx::Access::Read);
+        bindImage(5, velocity_out,       bgfx::Access::Write);
+        bindImage(10, elevation_mid,     bgfx::Access::Write);
+        dispatch(water_program);
+
+        bindImage(0, in[0],              bgfx::Access::Read);
+        bindImage(5, velocity_out,       bgfx::Access::ReadWrite);
+        bindImage(10, elevation_mid,     bgfx::Access::ReadWrite);
+        dispatch(erosion_deposition_program);
+
+        bindImage(0, in[0],              bgfx::Access::Read);
+        bindImage(2, in[2],              bgfx::Access::Read);
+        bindImage(6, soil_flows_1,       bgfx::Access::Write);
+        bindImage(7, soil_flows_2,       bgfx::Access::Write);
+        dispatch(thermal_program);
+
+        bindImage(0, in[0],              bgfx::Access::Read);
+        bindImage(3, elevation_out,      bgfx::Access::Write);
+        bindImage(5, velocity_out,       bgfx::Access::Read);
+        bindImage(6, soil_flows_1,       bgfx::Access::Read);
+        bindImage(7, soil_flows_2,       bgfx::Access::Read);
+        bindImage(10, elevation_mid,     bgfx::Access::Read);
+        bgfx::setBuffer(9, tile_changed, bgfx::Access::ReadWrite);
+        dispatch(advection_program);
 
         A_B = !A_B;
     }
+
+    /**
+     * @brief standalone thermal pass over the whole grid, see cs_model2_talus.sc. Only the
+     * elevation textures are swapped, the out flows and velocity stay in place
+     *
+     * @param time_step seconds the soil flows apply for
+     */
+    void submitThermal(float time_step) {
+        const float tile_params[4] = {(float)tile_step, (float)tiles_x, (float)tiles_y, 0.0f};
+        Erosion2Parameters params = uniforms;
+        params.step_time_constant = time_step;
+
+        const auto in = getStateTextures();
+        bindImage(0, in[0],                                      bgfx::Access::Read);
+        bindImage(2, in[2],                                      bgfx::Access::Read);
+        bindImage(3, A_B ? elevation_data_b : elevation_data_a,  bgfx::Access::Write);
+        bgfx::setBuffer(8, tile_list,       bgfx::Access::Read);
+        bgfx::setBuffer(9, tile_changed,    bgfx::Access::ReadWrite);
+        bgfx::setUniform(u_tile_params, tile_params);
+        bgfx::setUniform(uniforms.u_params, params.params, 5);
+        bgfx::dispatch(Erosion::ComputeView, talus_program, (w + GroupSize - 1) / GroupSize, (h + GroupSize - 1) / GroupSize);
+        dispatches++;
+
+        std::swap(elevation_data_a, elevation_data_b);
+    }
+
+    // classify tiles and freeze the newly inactive ones. The passes of the step then update the
+    // active tiles with an indirect dispatch sized on the GPU
+    void submitTiles(const float* tile_params) {
+        bgfx::setBuffer(0, tile_list,       bgfx::Access::Write);
+        bgfx::setBuffer(1, freeze_list,     bgfx::Access::Write);
+        bgfx::setBuffer(2, tile_changed,    bgfx::Access::Read);
+        bgfx::setBuffer(3, tile_active,     bgfx::Access::ReadWrite);
+        bgfx::setBuffer(4, tile_counters,   bgfx::Access::ReadWrite);
+        bgfx::setUniform(u_tile_params, tile_params);
+        bgfx::dispatch(Erosion::ComputeView, tiles_program, tiles_x, tiles_y);
+
+        bgfx::setBuffer(0, tile_dispatch,   bgfx::Access::ReadWrite);
+        bgfx::setBuffer(4, tile_counters,   bgfx::Access::ReadWrite);
+        bgfx::setImage(5, tile_stats, 0,    bgfx::Access::Write, bgfx::TextureFormat::R32U);
+        bgfx::setUniform(u_tile_params, tile_params);
+        bgfx::dispatch(Erosion::ComputeView, tiles_args_program, 1, 1);
+
+        const auto in = getStateTextures();
+        bindImage(0, in[0],                                      bgfx::Access::Read);
+        bindImage(1, in[1],                                      bgfx::Access::Read);
+        bindImage(2, in[2],                                      bgfx::Access::Read);
+        bindImage(3, A_B ? elevation_data_b : elevation_data_a,  bgfx::Access::Write);
+        bindImage(4, A_B ? outflows_data_b : outflows_data_a,    bgfx::Access::Write);
+        bindImage(5, A_B ? velocity_data_b : velocity_data_a,    bgfx::Access::Write);
+        bindImage(10, elevation_mid,                             bgfx::Access::Write);
+        bgfx::setBuffer(8, freeze_list,     bgfx::Access::Read);
+        bgfx::setUniform(u_tile_params, tile_params);
+        uniforms.submit();
+        bgfx::dispatch(Erosion::ComputeView, freeze_program, tile_dispatch, 1);
+        dispatches += 3;
+    }
+
+    /**
+     * @brief reduce the largest water speed and depth of the current state and start reading
+     * them back. Does nothing while a read is pending
+     * 
+     */
+    void submitFlowExtent() {
+        if (flow_extent_frame != 0)
+            return;
+
+        const auto state = getStateTextures();
+        bgfx::setImage(0, state[0], 0,          bgfx::Access::Read, bgfx::TextureFormat::RGBA32F);
+        bgfx::setImage(2, state[2], 0,          bgfx::Access::Read, flow_format);
+        bgfx::setBuffer(8, flow_extent,         bgfx::Access::ReadWrite);
+        uniforms.submit();
+        bgfx::dispatch(Erosion::ComputeView, flow_extent_program, (w + 15) / 16, (h + 15) / 16);
+
+        bgfx::setBuffer(8, flow_extent,         bgfx::Access::ReadWrite);
+        bgfx::setImage(5, flow_extent_stats, 0, bgfx::Access::Write, bgfx::TextureFormat::R32U);
+        bgfx::dispatch(Erosion::ComputeView, flow_extent_store_program, 1, 1);
+        dispatches += 2;
+
+        flow_extent_frame = bgfx::readTexture(flow_extent_stats, flow_extent_data);
+    }
+
+    /**
+     * @brief apply the stable time step once the flow extent read has arrived
+     * 
+     * @param frame last completed frame
+     * @return true when the time step was updated
+     */
+    bool updateTimeStep(uint32_t frame) {
+        if (flow_extent_frame == 0 || frame < flow_extent_frame)
+            return false;
+        float extent[2];
+        std::memcpy(extent, flow_extent_data, sizeof(extent));
+        uniforms.step_time_constant = uniforms.stableTimeStep(extent[0], extent[1]);
+        flow_extent_frame = 0;
+        return true;
+    }
+
+    /**
+     * @brief reduce the diagnostics of the current state level by level and start reading the
+     * totals back. Does nothing while a read is pending
+     * 
+     * @param iteration of the current state
+     * @return false when a read is pending
+     */
+    bool submitDiagnostics(uint32_t iteration) {
+        if (diagnostics_frame != 0)
+            return false;
+
+        int gx = w, gy = h;
+        for (std::size_t l = 0; l < diagnostics_levels.size(); ++l) {
+            gx = (gx + GroupSize - 1) / GroupSize;
+            gy = (gy + GroupSize - 1) / GroupSize;
+            if (l == 0) {
+                bgfx::setImage(0, getStateTextures()[0], 0, bgfx::Access::Read, bgfx::TextureFormat::RGBA32F);
+                bgfx::setImage(2, height_reference, 0, bgfx::Access::ReadWrite, bgfx::TextureFormat::R32F);
+                uniforms.submit();
+            } else {
+                bgfx::setImage(0, diagnostics_levels[l - 1], 0, bgfx::Access::Read, bgfx::TextureFormat::RGBA32F);
+            }
+            bgfx::setImage(1, diagnostics_levels[l], 0, bgfx::Access::Write, bgfx::TextureFormat::RGBA32F);
+            bgfx::dispatch(Erosion::ComputeView, l == 0 ? diagnostics_program : diagnostics_reduce_program, gx, gy);
+        }
+        dispatches += (uint32_t)diagnostics_levels.size();
+
+        diagnostics_iteration = iteration;
+        diagnostics_count++;
+        diagnostics_frame = bgfx::readTexture(diagnostics_levels.back(), diagnostics_data);
+        return true;
+    }
+
+    /**
+     * @brief the diagnostics submitted last, once their read has arrived
+     * 
+     * @param frame last completed frame
+     * @return std::optional<ErosionDiagnostics> 
+     */
+    std::optional<ErosionDiagnostics> readDiagnostics(uint32_t frame) {
+        if (diagnostics_frame == 0 || frame < diagnostics_frame)
+            return std::nullopt;
+        diagnostics_frame = 0;
+
+        // column sums in m, the non-finite count is exact up to 2^24 cells
+        const double cell_area = (double)uniforms.cell_size * uniforms.cell_size;
+        ErosionDiagnostics d;
+        d.iteration = diagnostics_iteration;
+        d.water = diagnostics_data[0] * cell_area;
+        d.sediment = diagnostics_data[1] * cell_area;
+        d.soil = diagnostics_data[2] * cell_area;
+        d.non_finite = (uint64_t)diagnostics_data[3];
+        d.min_height = diagnostics_data[4];
+        d.max_height = diagnostics_data[5];
+        const double finite = (double)w * h - d.non_finite;
+        if (diagnostics_count > 1 && finite > 0) {
+            d.change_mean = diagnostics_data[6] / finite;
+            d.change_max = diagnostics_data[7];
+        }
+        return d;
+    }
+
+    /**
+     * @brief collect the tile counters once the last read has arrived and start the next read
+     * 
+     * @param frame last completed frame
+     */
+    void readTileStats(uint32_t frame) {
+        if (tile_stats_frame != 0 && frame >= tile_stats_frame) {
+            skipped_tiles = tile_stats_data[1];
+            tile_stats_frame = 0;
+        }
+        if (tile_stats_frame == 0 && tile_step > 0)
+            tile_stats_frame = bgfx::readTexture(tile_stats, tile_stats_data);
+    }
 };
 
 Erosion2SimulationGPU::Erosion2SimulationGPU(std::shared_ptr<Terrain> target)
     : Erosion{"Erosion2SimulationGPU", std::move(target)}, m_gpu{std::make_unique<Erosion2GPUImpl>()}
 {
     m_gpu->uniforms.toParameterSet(parameters);
+    // GPU time per frame the erosion steps may take, more steps run per frame while it allows
+    parameters.addParameter("gpu_budget_ms", 1, 50, 8);
+    ErosionDiagnosticsParameters{}.toParameterSet(parameters);
+    ErosionConvergenceParameters{}.toParameterSet(parameters);
+    ThermalPassParameters{}.toParameterSet(parameters);
+
+    bgfx::setViewName(ComputeView, "erosion");
+    bgfx::setViewMode(ComputeView, bgfx::ViewMode::Sequential);
 
     m_gpu->loadPrograms();
     
 }
 
 void Erosion2SimulationGPU::startErosionTask() {
-    if (!m_isRunning) {
+    if (!m_isRunning && !m_resume_input.valid()) {
         m_gpu->uniforms.fromParameterSet(parameters);
+        m_gpu->setHalfPrecision(m_gpu->uniforms.isHalfPrecision());
+        m_thermal.fromParameterSet(parameters);
         m_gpu->init(target->getTerrainTexture());
         m_itercounter = 0;
+        m_simulated_time = 0;
+        m_next_time_step_update = 0;
+        start_diagnostics();
+        m_scheduler.reset();
+        stats.start();
+        m_frame_steps = 0;
         m_gpu->A_B = true;
         m_isRunning = true;
     }
@@ -280,24 +683,90 @@ void Erosion2SimulationGPU::stopErosionTask() {
     m_isRunning = false;
 }
 
+bool Erosion2SimulationGPU::saveCheckpoint(const std::string& filename) {
+    if (!m_isRunning)
+        return false;
+    m_save_request = filename;
+    return true;
+}
+
+bool Erosion2SimulationGPU::resumeFromCheckpoint(const std::string& filename) {
+    if (m_isRunning || m_resume_input.valid())
+        return false;
+    m_resume_input = std::async(std::launch::async, &ErosionCheckpoint::load, filename);
+    return true;
+}
+
 float Erosion2SimulationGPU::getProgress() const {
-    return m_itercounter / (m_gpu->uniforms.iterations);
+    const double done = m_gpu->uniforms.isAdaptive()
+        ? m_simulated_time / m_gpu->uniforms.simulated_time
+        : (double)m_itercounter / m_gpu->uniforms.iterations;
+    return (float)std::clamp(done, 0.0, 1.0);
 }
 
 bool Erosion2SimulationGPU::isRunning() const {
-    return m_isRunning;
+    return m_isRunning || m_resume_input.valid();
 }
 
 void Erosion2SimulationGPU::update() {
+    if (m_resume_input.valid()) {
+        if (m_resume_input.wait_for(std::chrono::seconds(0)) == std::future_status::timeout)
+            return;
+        resume(m_resume_input.get());
+    }
+
     if (m_isRunning) {
-        if (m_itercounter > m_gpu->uniforms.iterations) {
+        // a run whose state went non-finite or that has converged stops here
+        if (!check_diagnostics()) {
             m_isRunning = false;
-        } else {
+            return;
+        }
+
+        const float gpu_ms = computeViewMs();
+        stats.addGPUTime(gpu_ms, m_frame_steps, m_frame_dispatches);
+        m_scheduler.setBudget(getParam("gpu_budget_ms"));
+
+        const auto start = std::chrono::steady_clock::now();
+        const uint32_t dispatches = m_gpu->dispatches;
+        // a converged run with converged_slowdown runs one step per frame
+        const int batch = m_slowed ? 1 : m_scheduler.getBatch();
+        int submitted = 0;
+        while (submitted < batch && !run_done()) {
+            adapt_time_step();
+            diagnose();
             run_erosion();
+            submitted++;
+            // checkpoints are read back at the end of the frame, so one ends the batch
+            if (checkpoint())
+                break;
         }
+
+        if (submitted > 0) {
+            const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            const uint64_t cells = (uint64_t)m_gpu->w * m_gpu->h * submitted;
+            stats.addSteps(submitted, cells, cells * m_gpu->uniforms.gpuStateBytesPerCell(), seconds, getProgress());
+            m_gpu->copyTerrainTo(target->getTerrainTexture());
+            m_gpu->readTileStats(Core::Get().FrameEvent.last());
+        }
+        m_frame_steps = submitted;
+        m_frame_dispatches = m_gpu->dispatches - dispatches;
+        m_scheduler.update(gpu_ms, submitted);
+
+        if (run_done())
+            m_isRunning = false;
     }
 }
 
+bool Erosion2SimulationGPU::run_done() const {
+    if (m_gpu->uniforms.isAdaptive())
+        return m_simulated_time >= m_gpu->uniforms.simulated_time;
+    return m_itercounter > m_gpu->uniforms.iterations;
+}
+
+uint64_t Erosion2SimulationGPU::getSkippedTiles() const {
+    return m_gpu->skipped_tiles;
+}
+
 bgfx::TextureHandle Erosion2SimulationGPU::getDisplayHeightmap() {
     return m_gpu->A_B ? m_gpu->elevation_data_a : m_gpu->elevation_data_b;
 }
@@ -306,10 +775,337 @@ void Erosion2SimulationGPU::run_erosion() {
     if (m_isRunning) {
         //bgfx::touch(3);
         
+        m_simulated_time += m_gpu->uniforms.step_time_constant;
         m_gpu->submit();
-        m_gpu->copyTerrainTo(target->getTerrainTexture());
         m_itercounter++;
+        for (int i = m_thermal.passesAfter(m_itercounter); i > 0; --i)
+            m_gpu->submitThermal(m_thermal.time_step);
+    }
+}
+
+void Erosion2SimulationGPU::adapt_time_step() {
+    if (!m_gpu->uniforms.isAdaptive())
+        return;
+
+    // the reduction is read back a few frames later and applies to the steps from then on
+    m_gpu->updateTimeStep(Core::Get().FrameEvent.last());
+    if (m_itercounter >= m_next_time_step_update) {
+        m_gpu->submitFlowExtent();
+        m_next_time_step_update = m_itercounter + std::max(1, (int)m_gpu->uniforms.time_step_interval);
+    }
+}
+
+void Erosion2SimulationGPU::start_diagnostics() {
+    m_diagnostics.fromParameterSet(parameters);
+    m_convergence.fromParameterSet(parameters);
+    const double cell_size = m_gpu->uniforms.cell_size;
+    diagnostics.start((double)m_gpu->w * m_gpu->h * cell_size * cell_size, m_diagnostics.drift_warning, m_convergence);
+    m_next_diagnostics = m_itercounter;
+    m_slowed = false;
+}
+
+void Erosion2SimulationGPU::diagnose() {
+    // while a read is pending the reduction is retried at the next step
+    if (m_diagnostics.enabled() && m_itercounter >= m_next_diagnostics && m_gpu->submitDiagnostics(m_itercounter))
+        m_next_diagnostics = m_itercounter + m_diagnostics.interval();
+}
+
+bool Erosion2SimulationGPU::check_diagnostics() {
+    const auto d = m_gpu->readDiagnostics(Core::Get().FrameEvent.last());
+    if (!d)
+        return true;
+    switch (diagnostics.record(*d)) {
+    case DiagnosticsVerdict::Unstable:
+        return false;
+    case DiagnosticsVerdict::Converged:
+        if (m_convergence.slowdown()) {
+            m_slowed = true;
+            return true;
+        }
+        diagnostics.setIterationsSaved(m_gpu->uniforms.remainingIterations(m_itercounter, m_simulated_time));
+        return false;
+    default:
+        return true;
+    }
+}
+
+double Erosion2SimulationGPU::getSimulatedTime() const {
+    return m_simulated_time;
+}
+
+float Erosion2SimulationGPU::getTimeStep() const {
+    return m_gpu->uniforms.step_time_constant;
+}
+
+bool Erosion2SimulationGPU::checkpoint() {
+    std::string filename = m_save_request;
+    if (filename.empty() && checkpoint_interval > 0 && m_itercounter % checkpoint_interval == 0)
+        filename = checkpoint_file;
+    if (filename.empty())
+        return false;
+
+    // the previous checkpoint is still being read back or written, try again next frame
+    if (m_checkpoint_write.valid() && m_checkpoint_write.wait_for(std::chrono::seconds(0)) == std::future_status::timeout)
+        return false;
+    if (m_checkpoint_write.valid())
+        checkpoint_status = m_checkpoint_write.get() ? "checkpoint written" : "checkpoint failed";
+    m_save_request.clear();
+
+    ErosionCheckpoint cp;
+    cp.engine = Name;
+    cp.iteration = m_itercounter;
+    cp.simulated_time = m_simulated_time;
+    cp.time_step = m_gpu->uniforms.step_time_constant;
+    cp.parameters = getParams();
+    const uint32_t frame = m_gpu->readState(cp);
+    const bool half = m_gpu->half_precision;
+
+    // plane buffers are heap allocated and keep their address when the checkpoint is moved
+    m_checkpoint_write = std::async(std::launch::async, [frame, filename, half](ErosionCheckpoint cp) {
+        while (Core::Get().FrameEvent.wait() < frame)
+            ;
+        if (half)
+            Erosion2GPUImpl::expandHalfPlanes(cp);
+        return cp.save(filename);
+    }, std::move(cp));
+    return true;
+}
+
+void Erosion2SimulationGPU::resume(std::optional<ErosionCheckpoint> cp) {
+    const auto& terrain = target->getTerrainTexture();
+    if (!cp || cp->engine != Name) {
+        checkpoint_status = "checkpoint could not be loaded";
+        return;
     }
+
+    applyParams(cp->parameters);
+    m_gpu->uniforms.fromParameterSet(parameters);
+    m_gpu->setHalfPrecision(m_gpu->uniforms.isHalfPrecision());
+    m_thermal.fromParameterSet(parameters);
+    m_gpu->w = terrain.getWidth();
+    m_gpu->h = terrain.getHeight();
+    if (!m_gpu->writeState(*cp)) {
+        checkpoint_status = "checkpoint does not match the terrain size";
+        return;
+    }
+
+    m_itercounter = cp->iteration;
+    m_simulated_time = cp->simulated_time;
+    m_next_time_step_update = m_itercounter;
+    start_diagnostics();
+    m_scheduler.reset();
+    stats.start();
+    m_frame_steps = 0;
+    if (cp->time_step > 0)
+        m_gpu->uniforms.step_time_constant = cp->time_step;
+    m_isRunning = true;
+    checkpoint_status = "resumed at iteration " + std::to_string(m_itercounter);
+}
+
+namespace {
+
+// step interval of a converged run that continues at a reduced rate
+constexpr std::chrono::milliseconds ConvergedStepInterval{50};
+
+// record a step of model that took seconds. Tiles skipped by the sparse update do not count
+void record_step(ErosionStatsRecorder& stats, const Erosion2ModelCPU& model, double seconds, float progress) {
+    const uint64_t tile_cells = (uint64_t)model.getActiveTiles() * Erosion2ModelCPU::TileSize * Erosion2ModelCPU::TileSize;
+    const uint64_t cells = std::min(tile_cells, (uint64_t)model.getWidth() * model.getHeight());
+    stats.addSteps(1, cells, cells * Erosion2ModelCPU::StepBytesPerCell, seconds, progress);
+}
+
+/**
+ * @brief carve the coarse drainage network into terrain with the stream_power_sweeps parameter
+ * before the pipe model adds the detail
+ *
+ * @return false when stopped
+ */
+bool stream_power_pass(const util::ParameterCollection<float>& parameters, const Erosion2Parameters& params, resource::ImageData& terrain, const std::future<void>& kill_me) {
+    StreamPowerParameters stream_power;
+    stream_power.fromParameterSet(parameters);
+    if ((int)stream_power.sweeps < 1)
+        return true;
+    float* data = static_cast<float*>(terrain.get()->m_data);
+    StreamPowerModelCPU model{stream_power, params.cell_size, params.terrain_elevation_scale};
+    model.init(terrain.getWidth(), terrain.getHeight(), data);
+    while ((int)model.getIteration() < (int)stream_power.sweeps) {
+        if (kill_me.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+            return false;
+        model.step();
+    }
+    model.copyTo(data);
+    return true;
+}
+
+}
+
+Erosion2SimulationCPU::Erosion2SimulationCPU(std::shared_ptr<Terrain> target)
+    : CPUErosion{"Erosion2SimulationCPU", std::move(target)}
+{
+    Erosion2Parameters{}.toParameterSet(parameters);
+    IncrementalErosionParameters{}.toParameterSet(parameters);
+    ErosionDiagnosticsParameters{}.toParameterSet(parameters);
+    ErosionConvergenceParameters{}.toParameterSet(parameters);
+    ThermalPassParameters{}.toParameterSet(parameters);
+    // off unless set, see stream_power_pass
+    StreamPowerParameters stream_power;
+    stream_power.sweeps = 0;
+    stream_power.toParameterSet(parameters);
 }
 
-}
\ No newline at end of file
+// on task thread
+void Erosion2SimulationCPU::runErosion(resource::ImageData& terrain, std::atomic_uint32_t& progress, const std::future<void>& kill_me) {
+    Erosion2Parameters params;
+    params.fromParameterSet(taskParameters());
+
+    // a resumed run has passed the stream power sweeps already
+    auto resume = takeResumeCheckpoint();
+    if (!resume && !stream_power_pass(taskParameters(), params, terrain, kill_me))
+        return;
+
+    Erosion2ModelCPU model{params};
+    float* data = static_cast<float*>(terrain.get()->m_data);
+    model.init(terrain.getWidth(), terrain.getHeight(), data);
+
+    if (resume && !reportRestore(*resume, model.restoreState(*resume)))
+        return;
+
+    ErosionDiagnosticsParameters checks;
+    checks.fromParameterSet(taskParameters());
+    ErosionConvergenceParameters convergence;
+    convergence.fromParameterSet(taskParameters());
+    ThermalPassParameters thermal;
+    thermal.fromParameterSet(taskParameters());
+    diagnostics.start((double)model.getWidth() * model.getHeight() * params.cell_size * params.cell_size, checks.drift_warning, convergence);
+    // ground height of the last reduction, for the change between them
+    SoAGrid<ScalarField> last_height;
+    auto diagnose = [&]() {return diagnostics.record(model.getDiagnostics(&last_height));};
+    DiagnosticsVerdict verdict = checks.enabled() ? diagnose() : DiagnosticsVerdict::Continue;
+    // converged with converged_slowdown
+    bool slowed = false;
+
+    // adaptive runs are measured in simulated time, fixed step runs in iterations
+    const bool adaptive = params.isAdaptive();
+    const int iterations = (int)params.iterations;
+    auto done = [&]() {
+        return adaptive ? model.getSimulatedTime() >= params.simulated_time : (int)model.getIteration() >= iterations;
+    };
+    while (verdict == DiagnosticsVerdict::Continue && !done()) {
+        // a slowed down run steps at most every ConvergedStepInterval
+        if (slowed ? kill_me.wait_for(ConvergedStepInterval) == std::future_status::ready : stopRequested(kill_me))
+            break;
+        const auto start = std::chrono::steady_clock::now();
+        model.step();
+        for (int i = thermal.passesAfter(model.getIteration()); i > 0; --i)
+            model.thermalStep(thermal.time_step);
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (checks.enabled() && model.getIteration() % checks.interval() == 0)
+            verdict = diagnose();
+        if (verdict == DiagnosticsVerdict::Converged && convergence.slowdown()) {
+            verdict = DiagnosticsVerdict::Continue;
+            slowed = true;
+        }
+        skipped_tiles.store(model.getSkippedTiles());
+        simulated_time.store(model.getSimulatedTime());
+        time_step.store(model.getTimeStep());
+        if (checkpointDue(model.getIteration())) {
+            ErosionCheckpoint checkpoint;
+            model.saveState(checkpoint);
+            submitCheckpoint(std::move(checkpoint));
+        }
+        const float done_fraction = adaptive
+            ? std::min(1.0, model.getSimulatedTime() / params.simulated_time)
+            : (float)model.getIteration() / iterations;
+        progress.store(done_fraction * std::numeric_limits<uint32_t>::max());
+        record_step(stats, model, seconds, done_fraction);
+        if (snapshotDue())
+            publishSnapshot([&](float* rgba) {model.copyTo(rgba);});
+    }
+
+    // a run that went non-finite leaves the terrain as it was
+    if (verdict == DiagnosticsVerdict::Unstable)
+        return;
+    if (verdict == DiagnosticsVerdict::Converged)
+        diagnostics.setIterationsSaved(model.getParameters().remainingIterations(model.getIteration(), model.getSimulatedTime()));
+    model.copyTo(data);
+    m_state = std::as_const(model).getState();
+}
+
+// on task thread
+void Erosion2SimulationCPU::runIncrementalErosion(std::vector<float>& window, const IncrementalRegion& region, std::atomic_uint32_t& progress, const std::future<void>& kill_me) {
+    Erosion2Parameters params;
+    params.fromParameterSet(taskParameters());
+    IncrementalErosionParameters incremental;
+    incremental.fromParameterSet(taskParameters());
+
+    const TerrainRegion& w = region.window;
+    Erosion2ModelCPU model{params};
+    model.init(w.width(), w.height(), window.data());
+
+    // water and sediment come with the terrain data, the flow state from the last run. Without
+    // one, or after the terrain was resized, the window starts from still water
+    const bool seeded = m_state && seedIncrementalRun(model, *m_state, region);
+
+    const int iterations = (int)incremental.incremental_iterations;
+    while ((int)model.getIteration() < iterations && !stopRequested(kill_me)) {
+        const auto start = std::chrono::steady_clock::now();
+        model.step();
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        simulated_time.store(model.getSimulatedTime());
+        time_step.store(model.getTimeStep());
+        const float done_fraction = (float)model.getIteration() / iterations;
+        progress.store(done_fraction * std::numeric_limits<uint32_t>::max());
+        record_step(stats, model, seconds, done_fraction);
+    }
+    model.copyTo(window.data());
+
+    // the dirty cells carry the new flow state, the rest of the window is blended back from
+    // the old terrain and keeps its flows. State of another terrain size is stale, dropped
+    if (seeded)
+        storeIncrementalRun(std::as_const(model), *m_state, region);
+    else
+        m_state.reset();
+}
+
+Erosion2PyramidSimulation::Erosion2PyramidSimulation(std::shared_ptr<Terrain> target)
+    : CPUErosion{"Erosion2PyramidSimulation", std::move(target)}
+{
+    Erosion2Parameters{}.toParameterSet(parameters);
+    Erosion2PyramidParameters{}.toParameterSet(parameters);
+    // off unless set, see stream_power_pass
+    StreamPowerParameters stream_power;
+    stream_power.sweeps = 0;
+    stream_power.toParameterSet(parameters);
+}
+
+// on task thread
+void Erosion2PyramidSimulation::runErosion(resource::ImageData& terrain, std::atomic_uint32_t& progress, const std::future<void>& kill_me) {
+    Erosion2Parameters params;
+    params.fromParameterSet(taskParameters());
+    Erosion2PyramidParameters pyramid;
+    pyramid.fromParameterSet(taskParameters());
+    if (!stream_power_pass(taskParameters(), params, terrain, kill_me))
+        return;
+
+    Erosion2PyramidCPU model{params, pyramid};
+    float* data = static_cast<float*>(terrain.get()->m_data);
+
+    // the callback reports the share of cell updates done, see Erosion2PyramidCPU::run
+    double total_cells = 0;
+    for (const auto& level : Erosion2PyramidCPU::schedule(terrain.getWidth(), terrain.getHeight(), (int)params.iterations, pyramid))
+        total_cells += (double)level.width * level.height * level.iterations;
+    double last_done = 0;
+    auto last = std::chrono::steady_clock::now();
+
+    model.run(terrain.getWidth(), terrain.getHeight(), data, [&](float done) {
+        const auto now = std::chrono::steady_clock::now();
+        const uint64_t cells = (uint64_t)std::llround((done - last_done) * total_cells);
+        stats.addSteps(1, cells, cells * Erosion2ModelCPU::StepBytesPerCell, std::chrono::duration<double>(now - last).count(), done);
+        last_done = done;
+        last = now;
+        progress.store(done * std::numeric_limits<uint32_t>::max());
+        return !stopRequested(kill_me);
+    });
+}
+
+}
@@ -11,10 +11,19 @@
 #define STAVA_EROSION_H
 
 #include <terrain/erosion.h>
+#include <terrain/erosion_cpu.h>
+#include <terrain/erosion_checkpoint.h>
+#include <terrain/erosion_model2_cpu.h>
+#include <terrain/gpu_step_scheduler.h>
 #include <bgfx/bgfx.h>
 
 namespace dirtbox::terrain {
 
+/**
+ * @brief Erosion2 model on the GPU. Every update submits as many iterations to the compute view
+ * as fit in the gpu_budget_ms parameter, see GPUStepScheduler
+ * 
+ */
 class Erosion2SimulationGPU : public Erosion {
 public:
     Erosion2SimulationGPU(std::shared_ptr<Terrain> target);
@@ -26,14 +35,85 @@ public:
     bool isRunning() const override;
     void update() override;
 
+    bool saveCheckpoint(const std::string& filename) override;
+    bool resumeFromCheckpoint(const std::string& filename) override;
+    uint64_t getSkippedTiles() const override;
+    double getSimulatedTime() const override;
+    float getTimeStep() const override;
+
     bgfx::TextureHandle getDisplayHeightmap();
 
 private:
     void run_erosion();
+    bool run_done() const;
+    // with adaptive time steps, start a flow extent reduction every time_step_interval
+    // iterations and apply the result once it has been read back
+    void adapt_time_step();
+    // read back the state textures and write them in the background when a checkpoint is due.
+    // Returns true when a read back was queued
+    bool checkpoint();
+    void resume(std::optional<ErosionCheckpoint> cp);
+    // reset the diagnostics for a run starting at the current iteration
+    void start_diagnostics();
+    // start a diagnostics reduction every diagnostics_interval iterations
+    void diagnose();
+    // record diagnostics that have been read back, false when the state has gone non-finite or
+    // the run has converged and stops
+    bool check_diagnostics();
 
     bool m_isRunning = false;
     uint32_t m_itercounter = 0;
+    double m_simulated_time = 0;
+    uint32_t m_next_time_step_update = 0;
+    ErosionDiagnosticsParameters m_diagnostics;
+    ErosionConvergenceParameters m_convergence;
+    // standalone thermal passes between the steps
+    ThermalPassParameters m_thermal;
+    uint32_t m_next_diagnostics = 0;
+    // converged with converged_slowdown
+    bool m_slowed = false;
+    GPUStepScheduler m_scheduler;
+    // iterations and dispatches of the last frame, the GPU timings arrive a frame late
+    uint32_t m_frame_steps = 0;
+    uint32_t m_frame_dispatches = 0;
     std::shared_ptr<class Erosion2GPUImpl> m_gpu;
+
+    std::string m_save_request;
+    std::future<bool> m_checkpoint_write;
+    std::future<std::optional<ErosionCheckpoint>> m_resume_input;
+};
+
+/**
+ * @brief Erosion2 model on the CPU, uses the same parameter names as Erosion2SimulationGPU.
+ * Supports incremental runs around edits
+ * 
+ */
+class Erosion2SimulationCPU : public CPUErosion {
+public:
+    Erosion2SimulationCPU(std::shared_ptr<Terrain> target);
+
+    bool startIncrementalErosion(const TerrainRegion& dirty) override {return startIncremental(dirty);}
+
+protected:
+    void runErosion(resource::ImageData& terrain, std::atomic_uint32_t& progress, const std::future<void>& kill_me) override;
+    void runIncrementalErosion(std::vector<float>& window, const IncrementalRegion& region, std::atomic_uint32_t& progress, const std::future<void>& kill_me) override;
+
+private:
+    // state after the last run, seeds the out flows, velocity and hardness of incremental runs.
+    // Only used by the task thread
+    std::optional<Erosion2Grid> m_state;
+};
+
+/**
+ * @brief Erosion2 model on the CPU, run coarse to fine. See Erosion2PyramidCPU
+ * 
+ */
+class Erosion2PyramidSimulation : public CPUErosion {
+public:
+    Erosion2PyramidSimulation(std::shared_ptr<Terrain> target);
+
+protected:
+    void runErosion(resource::ImageData& terrain, std::atomic_uint32_t& progress, const std::future<void>& kill_me) override;
 };
 
 } // namespace dirtbox::terrain
@@ -0,0 +1,553 @@
+// references: https://old.cescg.org/CESCG-2011/papers/TUBudapest-Jako-Balazs.pdf
+#include <terrain/erosion_model2_cpu.h>
+
+#include <cmath>
+#include <algorithm>
+#include <iterator>
+#include <array>
+
+#include <util/thread_pool.h>
+#include <util/half.h>
+#include <terrain/erosion_kernels.h>
+
+namespace dirtbox::terrain {
+
+namespace {
+
+// terrain texture channel layout
+const std::array<Erosion2Field, 4> TerrainChannels {
+    Erosion2Field::Rock,
+    Erosion2Field::Sand,
+    Erosion2Field::Sediment,
+    Erosion2Field::Water
+};
+
+// checkpoint plane names, in Erosion2Field order
+const char* const FieldNames[] = {
+    "rock",
+    "sand",
+    "sediment",
+    "water",
+    "outflow_pos_y",
+    "outflow_pos_x",
+    "outflow_neg_y",
+    "outflow_neg_x",
+    "velocity_x",
+    "velocity_y",
+    "hardness"
+};
+static_assert(std::size(FieldNames) == Erosion2Grid::NumFields, "missing Erosion2Field name");
+
+inline Erosion2Field out_flow_field(int d) {
+    return static_cast<Erosion2Field>(static_cast<int>(Erosion2Field::OutFlowPosY) + d);
+}
+
+}
+
+void Erosion2ModelCPU::init(int width, int height, const float* rgba) {
+    w = width;
+    h = height;
+    iteration = 0;
+    simulated_time = 0;
+    current = 0;
+
+    state[0].resize(w, h);
+    state[1].resize(w, h);
+    sediment_mid.resize(w, h);
+    soil_flows.resize(w, h);
+
+    tiles_x = (w + TileSize - 1) / TileSize;
+    tiles_y = (h + TileSize - 1) / TileSize;
+    tile_changed.assign(tiles_x * tiles_y, 0);
+    tile_list.reserve(tiles_x * tiles_y);
+    skipped_tiles = 0;
+    wake_all();
+
+    state[current].copyFromRGBA(rgba, TerrainChannels, params.terrain_elevation_scale);
+}
+
+void Erosion2ModelCPU::wake_all() {
+    tile_active.assign(tiles_x * tiles_y, 1);
+}
+
+void Erosion2ModelCPU::copyTo(float* rgba) const {
+    state[current].copyToRGBA(rgba, TerrainChannels, 1.0f / params.terrain_elevation_scale);
+}
+
+void Erosion2ModelCPU::saveState(ErosionCheckpoint& checkpoint) const {
+    const Erosion2Grid& cur = state[current];
+    checkpoint.iteration = iteration;
+    checkpoint.simulated_time = simulated_time;
+    checkpoint.time_step = params.step_time_constant;
+    for (std::size_t f = 0; f < Erosion2Grid::NumFields; ++f)
+        checkpoint.addPlane(FieldNames[f], w, h, 1, cur.data(static_cast<Erosion2Field>(f)), cur.getStride());
+}
+
+bool Erosion2ModelCPU::restoreState(const ErosionCheckpoint& checkpoint) {
+    Erosion2Grid& cur = state[current];
+    for (std::size_t f = 0; f < Erosion2Grid::NumFields; ++f)
+        if (!checkpoint.readPlane(FieldNames[f], w, h, 1, cur.data(static_cast<Erosion2Field>(f)), cur.getStride()))
+            return false;
+    iteration = checkpoint.iteration;
+    simulated_time = checkpoint.simulated_time;
+    if (checkpoint.time_step > 0)
+        params.step_time_constant = checkpoint.time_step;
+    // the thermal flows of frozen tiles are not saved, start over with every tile active
+    wake_all();
+    return true;
+}
+
+void Erosion2ModelCPU::step() {
+    if (params.isAdaptive() && iteration % std::max(1, (int)params.time_step_interval) == 0) {
+        const FlowExtent flow = getFlowExtent();
+        params.step_time_constant = params.stableTimeStep(flow.max_speed, flow.max_depth);
+    }
+
+    const float dt = params.step_time_constant;
+    if (params.activity_threshold > 0)
+        step_tiles();
+    else
+        step_dense();
+
+    current = 1 - current;
+    iteration++;
+    simulated_time += dt;
+}
+
+void Erosion2ModelCPU::thermalStep(float time_step) {
+    Erosion2Grid& cur = state[current];
+    TalusKernelArgs args{};
+    args.rock = cur.data(Erosion2Field::Rock);
+    args.water = cur.data(Erosion2Field::Water);
+    args.hardness = cur.data(Erosion2Field::Hardness);
+    // the next step computes the soil flows again, every tile is woken below
+    for (int d = 0; d < 8; ++d)
+        args.flows[d] = soil_flows.data(static_cast<Erosion2SoilFlow>(d));
+    args.rock_out = cur.data(Erosion2Field::Rock);
+    args.width = w;
+    args.height = h;
+    args.stride = cur.getStride();
+    args.cell_size = params.cell_size;
+    args.time_step = time_step;
+    args.thermal_erosion_rate = params.thermal_erosion_rate;
+    args.talus_angle_tangent_coef = params.talus_angle_tangent_coef;
+    args.talus_angle_tangent_bias = params.talus_angle_tangent_bias;
+    args.min_hardness = Erosion2Parameters::MinHardness;
+    args.max_hardness = params.soil_softness_max;
+
+    // the flows of every band are needed before a band can apply its in flows
+    const int bands = (h + BandRows - 1) / BandRows;
+    pool->parallel_for(0, bands, [&](int b) {
+        computeTalusFlows(args, b * BandRows, std::min(h, (b + 1) * BandRows));
+    });
+    pool->parallel_for(0, bands, [&](int b) {
+        applyTalusFlows(args, b * BandRows, std::min(h, (b + 1) * BandRows));
+    });
+
+    // the other state of frozen tiles no longer matches
+    wake_all();
+}
+
+Erosion2ModelCPU::FlowExtent Erosion2ModelCPU::getFlowExtent() const {
+    const Erosion2Grid& cur = state[current];
+    const float* velx = cur.data(Erosion2Field::VelocityX);
+    const float* vely = cur.data(Erosion2Field::VelocityY);
+    const float* water = cur.data(Erosion2Field::Water);
+    // the velocity of nearly dry cells divides by the vanishing depth. Cells that drain
+    // completely in one step move at cell_size / dt whatever the step, their speed is set by the
+    // out flow scaling and not by the time step. Neither limits the step
+    const float drain_speed = params.cell_size / params.step_time_constant;
+
+    return pool->parallel_reduce(0, h, BandRows, FlowExtent{}, [&](int y0, int y1) {
+        FlowExtent e;
+        for (int y = y0; y < y1; ++y) {
+            for (int x = 0; x < w; ++x) {
+                const std::size_t i = cur.index(x, y);
+                const float speed = std::sqrt(velx[i] * velx[i] + vely[i] * vely[i]);
+                if (water[i] >= Erosion2Parameters::MinFlowDepth && speed < drain_speed)
+                    e.max_speed = std::max(e.max_speed, speed);
+                e.max_depth = std::max(e.max_depth, water[i]);
+            }
+        }
+        return e;
+    }, [](const FlowExtent& a, const FlowExtent& b) {
+        return FlowExtent{std::max(a.max_speed, b.max_speed), std::max(a.max_depth, b.max_depth)};
+    });
+}
+
+ErosionDiagnostics Erosion2ModelCPU::getDiagnostics(SoAGrid<ScalarField>* reference) const {
+    const Erosion2Grid& cur = state[current];
+    // without an earlier height there is no change to measure yet
+    const bool first = reference && (reference->getWidth() != w || reference->getHeight() != h);
+    if (first)
+        reference->resize(w, h);
+    const DiagnosticsKernelArgs args{
+        cur.data(Erosion2Field::Rock),
+        cur.data(Erosion2Field::Sand),
+        cur.data(Erosion2Field::Sediment),
+        cur.data(Erosion2Field::Water),
+        reference ? reference->data(ScalarField::Value) : nullptr,
+        w, cur.getStride()
+    };
+    const DiagnosticsSums sums = pool->parallel_reduce(0, h, BandRows, DiagnosticsSums{}, [&](int y0, int y1) {
+        return reduceDiagnostics(args, y0, y1);
+    }, mergeDiagnostics);
+
+    const double cell_area = (double)params.cell_size * params.cell_size;
+    ErosionDiagnostics d;
+    d.iteration = iteration;
+    d.water = sums.water * cell_area;
+    d.sediment = sums.sediment * cell_area;
+    d.soil = sums.soil * cell_area;
+    d.min_height = sums.min_height;
+    d.max_height = sums.max_height;
+    d.non_finite = sums.non_finite;
+    const uint64_t finite = (uint64_t)w * h - sums.non_finite;
+    if (reference && !first && finite > 0) {
+        d.change_mean = sums.change / finite;
+        d.change_max = sums.change_max;
+    }
+    return d;
+}
+
+void Erosion2ModelCPU::step_dense() {
+    const int bands = (h + BandRows - 1) / BandRows;
+
+    pool->parallel_for(0, bands, [this](int b) {
+        flow_pass(0, w, b * BandRows, std::min(h, (b + 1) * BandRows));
+    });
+    pool->parallel_for(0, bands, [this](int b) {
+        transport_pass(0, w, b * BandRows, std::min(h, (b + 1) * BandRows));
+    });
+
+    active_tiles = tiles_x * tiles_y;
+}
+
+void Erosion2ModelCPU::step_tiles() {
+    tile_list.clear();
+    for (int t = 0; t < tiles_x * tiles_y; ++t)
+        if (tile_active[t])
+            tile_list.push_back(t);
+
+    auto bounds = [this](int t) {
+        const int x0 = (t % tiles_x) * TileSize;
+        const int y0 = (t / tiles_x) * TileSize;
+        return std::array<int, 4>{x0, std::min(w, x0 + TileSize), y0, std::min(h, y0 + TileSize)};
+    };
+
+    pool->parallel_for(0, tile_list.size(), [&](int i) {
+        const auto [x0, x1, y0, y1] = bounds(tile_list[i]);
+        tile_changed[tile_list[i]] = flow_pass(x0, x1, y0, y1) > params.activity_threshold;
+    });
+    pool->parallel_for(0, tile_list.size(), [&](int i) {
+        const auto [x0, x1, y0, y1] = bounds(tile_list[i]);
+        tile_changed[tile_list[i]] |= transport_pass(x0, x1, y0, y1) > params.activity_threshold;
+    });
+
+    active_tiles = tile_list.size();
+    skipped_tiles += tiles_x * tiles_y - active_tiles;
+
+    // a tile stays active while it or a neighbor changed. Skipped tiles keep their changed flag
+    // from the last step they ran in, which is always false
+    tile_list.clear();
+    for (int ty = 0; ty < tiles_y; ++ty) {
+        for (int tx = 0; tx < tiles_x; ++tx) {
+            bool active = false;
+            for (int ny = std::max(0, ty - 1); ny <= std::min(tiles_y - 1, ty + 1); ++ny)
+                for (int nx = std::max(0, tx - 1); nx <= std::min(tiles_x - 1, tx + 1); ++nx)
+                    active |= tile_changed[ny * tiles_x + nx] != 0;
+
+            const int t = ty * tiles_x + tx;
+            // both buffers of a frozen tile must hold its state, steps no longer write it
+            if (tile_active[t] && !active)
+                tile_list.push_back(t);
+            tile_active[t] = active;
+        }
+    }
+    pool->parallel_for(0, tile_list.size(), [this](int i) {
+        freeze_tile(tile_list[i]);
+    });
+}
+
+void Erosion2ModelCPU::freeze_tile(int tile) {
+    // called before the buffers are swapped, copies the new state over the old one
+    const Erosion2Grid& src = state[1 - current];
+    Erosion2Grid& dst = state[current];
+    const int x0 = (tile % tiles_x) * TileSize;
+    const int y0 = (tile / tiles_x) * TileSize;
+    const int x1 = std::min(w, x0 + TileSize);
+    const int y1 = std::min(h, y0 + TileSize);
+
+    for (std::size_t f = 0; f < Erosion2Grid::NumFields; ++f) {
+        const auto field = static_cast<Erosion2Field>(f);
+        for (int y = y0; y < y1; ++y) {
+            const std::size_t i = src.index(x0, y);
+            std::copy(src.data(field) + i, src.data(field) + i + (x1 - x0), dst.data(field) + i);
+        }
+    }
+}
+
+float Erosion2ModelCPU::bilinear_sediment(float x, float y) const {
+    const auto sediment = sediment_mid.plane(ScalarField::Value);
+    const float fx = std::floor(x);
+    const float fy = std::floor(y);
+    const float wx = x - fx;
+    const float wy = y - fy;
+    const int cx = (int)fx;
+    const int cy = (int)fy;
+
+    const float bot = sediment.clampedAt(cx, cy)     * (1 - wx) + sediment.clampedAt(cx + 1, cy)     * wx;
+    const float top = sediment.clampedAt(cx, cy + 1) * (1 - wx) + sediment.clampedAt(cx + 1, cy + 1) * wx;
+    return bot * (1 - wy) + top * wy;
+}
+
+float Erosion2ModelCPU::flow_pass(int x0, int x1, int y0, int y1) {
+    const Erosion2Grid& in = state[current];
+    Erosion2Grid& out = state[1 - current];
+    const int stride = in.getStride();
+
+    const float dt = params.step_time_constant;
+    const float cell_size = params.cell_size;
+    const float cell_area = cell_size * cell_size;
+
+    auto lmax = [this](float x) {
+        const float m = params.maximal_erosion_depth;
+        if (x <= 0)
+            return 0.0f;
+        else if (x >= m)
+            return 1.0f;
+        else
+            return 1 - (m - x) / m;
+    };
+
+    const float* rock_in     = in.data(Erosion2Field::Rock);
+    const float* sand_in     = in.data(Erosion2Field::Sand);
+    const float* sediment_in = in.data(Erosion2Field::Sediment);
+    const float* water_in    = in.data(Erosion2Field::Water);
+    const float* hard_in     = in.data(Erosion2Field::Hardness);
+
+    // outflow calculation, vectorized over the band
+    OutflowKernelArgs outflow{};
+    outflow.rock = rock_in;
+    outflow.water = water_in;
+    outflow.sediment = sediment_in;
+    for (int d = 0; d < 4; ++d) {
+        outflow.flow_in[d] = in.data(out_flow_field(d));
+        outflow.flow_out[d] = out.data(out_flow_field(d));
+    }
+    outflow.width = w;
+    outflow.height = h;
+    outflow.stride = stride;
+    outflow.step_time_constant = dt;
+    outflow.rainfall = params.rainfall;
+    outflow.cell_size = cell_size;
+    outflow.virtual_pipe_area = params.virtual_pipe_area;
+    outflow.water_sediment_capacity = params.water_sediment_capacity;
+    computeOutflows(outflow, x0, x1, y0, y1);
+
+    // half precision runs round the out flows, velocity, hardness and soil flows where the GPU
+    // passes store them in RGBA16F
+    const bool half = params.isHalfPrecision();
+    auto store = [half](float v) {return half ? util::roundToHalf(v) : v;};
+    if (half) {
+        for (int d = 0; d < 4; ++d) {
+            for (int y = y0; y < y1; ++y) {
+                float* row = outflow.flow_out[d] + in.index(0, y);
+                std::transform(row + x0, row + x1, row + x0, util::roundToHalf);
+            }
+        }
+    }
+
+    const float* const* flow_in = outflow.flow_in;
+    float* const* flow_out = outflow.flow_out;
+    float* sf_out[8];
+    for (int d = 0; d < 8; ++d)
+        sf_out[d] = soil_flows.data(static_cast<Erosion2SoilFlow>(d));
+
+    float* rock_out     = out.data(Erosion2Field::Rock);
+    float* sand_out     = out.data(Erosion2Field::Sand);
+    float* water_out    = out.data(Erosion2Field::Water);
+    float* velx_out     = out.data(Erosion2Field::VelocityX);
+    float* vely_out     = out.data(Erosion2Field::VelocityY);
+    float* hard_out     = out.data(Erosion2Field::Hardness);
+    float* sediment_out = sediment_mid.data(ScalarField::Value);
+
+    float max_flow = 0;
+    for (int y = y0; y < y1; ++y) {
+        for (int x = x0; x < x1; ++x) {
+            const std::size_t i = in.index(x, y);
+            float rock = rock_in[i];
+            float sediment = sediment_in[i];
+            float water = water_in[i] + params.rainfall * dt;
+            float hardness = hard_in[i];
+            const float height = rock + water;
+
+            // get neighbor height and in flow
+            float dH[4];
+            float total_in_flow = 0;
+            float in_flow[4];
+            for (int d = 0, j = 1; d < 4; ++d, j += 2) {
+                const int nfi = (d + 2) % 4;
+                const int nx = x + DirmapDX[j];
+                const int ny = y + DirmapDY[j];
+                if (nx >= 0 && nx < w && ny >= 0 && ny < h) {
+                    const std::size_t ni = i + DirmapDY[j] * stride + DirmapDX[j];
+                    in_flow[d] = flow_in[nfi][ni];
+                    total_in_flow += in_flow[d];
+                    dH[d] = height - (rock_in[ni] + water_in[ni]);
+                } else {
+                    dH[d] = 0;
+                    in_flow[d] = 0;
+                }
+            }
+
+            float flow[4];
+            float total_out_flow = 0;
+            for (int d = 0; d < 4; ++d) {
+                flow[d] = flow_out[d][i];
+                total_out_flow += flow[d];
+            }
+
+            // soil flows
+            float dHsf[8];
+            float totaldH = 0;
+            float dHm = 0;
+            for (int d = 0; d < 8; ++d) {
+                const int nx = x + DirmapDX[d];
+                const int ny = y + DirmapDY[d];
+                dHsf[d] = 0;
+                if (nx >= 0 && nx < w && ny >= 0 && ny < h) {
+                    const std::size_t ni = i + DirmapDY[d] * stride + DirmapDX[d];
+                    const float dh = height - (rock_in[ni] + water_in[ni]);
+                    const float alpha = std::tan(dh / cell_size);
+                    if (dh > 0 && alpha > (hardness * params.talus_angle_tangent_coef + params.talus_angle_tangent_bias)) {
+                        dHsf[d] = dh;
+                        dHm = std::max(dh, dHm);
+                        totaldH += dh;
+                    }
+                }
+            }
+            const float dS = cell_area * params.thermal_erosion_rate * hardness * dHm / 2;
+            for (int d = 0; d < 8; ++d)
+                sf_out[d][i] = store(dHsf[d] > 0 ? dS * dHsf[d] / totaldH : 0.0f);
+
+            // compute new water level
+            const float net_flow = (total_in_flow - total_out_flow) / cell_area;
+            water += net_flow;
+            max_flow = std::max(max_flow, std::abs(net_flow));
+
+            // compute velocity. guard against cells that have run completely dry
+            const float vdenom = cell_size * std::max(std::min(1.0f, water), 1e-6f) * dt;
+            const float velx = store((in_flow[3] - flow[3] + flow[1] - in_flow[1]) / vdenom);
+            const float vely = store((in_flow[2] - flow[2] + flow[0] - in_flow[0]) / vdenom);
+
+            // erosion deposition
+            // normal of the surface, z component of normalize(cross((2c, 0, dzx), (0, 2c, dzy)))
+            const float dzx = dH[3] - dH[1];
+            const float dzy = dH[0] - dH[2];
+            const float nz = 4 * cell_area / std::sqrt(4 * cell_area * (dzx * dzx + dzy * dzy) + 16 * cell_area * cell_area);
+            const float speed = std::sqrt(velx * velx + vely * vely);
+            const float C = std::max(0.0f, params.water_sediment_capacity * std::clamp(1.05f - nz, 0.0f, 1.0f) * speed * lmax(water));
+
+            if (sediment < C) {
+                const float delta = std::min(rock, dt * hardness * params.soil_suspension_rate * (C - sediment));
+                rock -= delta; // soil uptake to suspended_sediment
+                sediment += delta;
+            } else {
+                const float delta = dt * params.sediment_deposition_rate * (sediment - C);
+                rock += delta; // soil drop from suspended_sediment
+                sediment -= delta;
+
+                // local softness modifier when soil is deposited
+                hardness += dt * 5 * params.soil_suspension_rate * (sediment - C);
+            }
+            hardness = std::clamp(hardness, Erosion2Parameters::MinHardness, params.soil_softness_max);
+
+            water *= (1 - params.water_evaporation_rate * dt);
+
+            rock_out[i] = rock;
+            sand_out[i] = sand_in[i];
+            water_out[i] = water;
+            velx_out[i] = velx;
+            vely_out[i] = vely;
+            hard_out[i] = store(hardness);
+            sediment_out[i] = sediment;
+        }
+    }
+    return max_flow;
+}
+
+float Erosion2ModelCPU::transport_pass(int x0, int x1, int y0, int y1) {
+    const Erosion2Grid& in = state[current];
+    Erosion2Grid& out = state[1 - current];
+    const int stride = out.getStride();
+
+    const float dt = params.step_time_constant;
+    const float cell_size = params.cell_size;
+    const float cell_area = cell_size * cell_size;
+
+    const float* velx = out.data(Erosion2Field::VelocityX);
+    const float* vely = out.data(Erosion2Field::VelocityY);
+    float* rock = out.data(Erosion2Field::Rock);
+    float* sediment = out.data(Erosion2Field::Sediment);
+    const float* sf[8];
+    for (int d = 0; d < 8; ++d)
+        sf[d] = soil_flows.data(static_cast<Erosion2SoilFlow>(d));
+    const float* rock_in = in.data(Erosion2Field::Rock);
+    const float* sediment_in = in.data(Erosion2Field::Sediment);
+
+    float max_change = 0;
+    for (int y = y0; y < y1; ++y) {
+        for (int x = x0; x < x1; ++x) {
+            const std::size_t i = out.index(x, y);
+
+            // sediment transport
+            sediment[i] = bilinear_sediment(x - velx[i] / cell_size * dt, y - vely[i] / cell_size * dt);
+
+            // soil flow accum
+            float total_soil_out_flow = 0;
+            float total_soil_in_flow = 0;
+            for (int d = 0; d < 8; ++d) {
+                total_soil_out_flow += sf[d][i];
+                const int nfi = (d + 4) % 8;
+                const int nx = x + DirmapDX[d];
+                const int ny = y + DirmapDY[d];
+                if (nx >= 0 && nx < w && ny >= 0 && ny < h)
+                    total_soil_in_flow += sf[nfi][i + DirmapDY[d] * stride + DirmapDX[d]];
+            }
+            rock[i] += (total_soil_in_flow - total_soil_out_flow) * dt / cell_area;
+
+            max_change = std::max({max_change, std::abs(rock[i] - rock_in[i]), std::abs(sediment[i] - sediment_in[i])});
+        }
+    }
+    return max_change;
+}
+
+bool seedIncrementalRun(Erosion2ModelCPU& model, const Erosion2Grid& terrain, const IncrementalRegion& region) {
+    // the positions of a resized terrain do not match the old state
+    if (terrain.getWidth() != region.width || terrain.getHeight() != region.height)
+        return false;
+    const TerrainRegion& w = region.window;
+    Erosion2Grid& state = model.getState();
+    for (auto field : {Erosion2Field::OutFlowPosY, Erosion2Field::OutFlowPosX, Erosion2Field::OutFlowNegY, Erosion2Field::OutFlowNegX,
+                       Erosion2Field::VelocityX, Erosion2Field::VelocityY, Erosion2Field::Hardness})
+        for (int y = 0; y < w.height(); ++y)
+            std::copy_n(&terrain.at(field, w.x0, w.y0 + y), w.width(), &state.at(field, 0, y));
+    return true;
+}
+
+bool storeIncrementalRun(const Erosion2ModelCPU& model, Erosion2Grid& terrain, const IncrementalRegion& region) {
+    if (terrain.getWidth() != region.width || terrain.getHeight() != region.height)
+        return false;
+    const Erosion2Grid& state = model.getState();
+    const TerrainRegion& w = region.window;
+    const TerrainRegion& d = region.dirty;
+    for (std::size_t f = 0; f < Erosion2Grid::NumFields; ++f) {
+        const auto field = static_cast<Erosion2Field>(f);
+        for (int y = d.y0; y < d.y1; ++y)
+            std::copy_n(&state.at(field, d.x0 - w.x0, y - w.y0), d.width(), &terrain.at(field, d.x0, y));
+    }
+    return true;
+}
+
+}
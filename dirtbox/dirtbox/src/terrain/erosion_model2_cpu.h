@@ -0,0 +1,275 @@
+/**
+ * @brief CPU implementation of the virtual pipe erosion model in the cs_model2_* shaders
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ */
+#pragma once
+#ifndef DIRTBOX_EROSION_MODEL2_CPU_H
+#define DIRTBOX_EROSION_MODEL2_CPU_H
+
+#include <vector>
+#include <cstdint>
+
+#include <util/vec.h>
+#include <util/thread_pool.h>
+#include <terrain/erosion_model2_params.h>
+#include <terrain/soa_grid.h>
+#include <terrain/erosion_checkpoint.h>
+#include <terrain/erosion_diagnostics.h>
+#include <terrain/terrain_region.h>
+
+namespace dirtbox::terrain {
+
+/**
+ * @brief Erosion2 state planes. The elevation layers are in meters.
+ *
+ */
+enum class Erosion2Field : uint8_t {
+    Rock,
+    Sand,
+    Sediment,   // suspended sediment
+    Water,
+
+    // out flows, in the order of the 4 neighbors (0, 1), (1, 0), (0, -1), (-1, 0)
+    OutFlowPosY,
+    OutFlowPosX,
+    OutFlowNegY,
+    OutFlowNegX,
+
+    VelocityX,
+    VelocityY,
+    Hardness,   // local soil hardness
+
+    Count
+};
+
+/**
+ * @brief outgoing thermal soil flows, in cs_model2_common.sh Dirmap order
+ *
+ */
+enum class Erosion2SoilFlow : uint8_t {
+    Dir0, Dir1, Dir2, Dir3, Dir4, Dir5, Dir6, Dir7,
+    Count
+};
+
+using Erosion2Grid = SoAGrid<Erosion2Field>;
+using Erosion2SoilFlowGrid = SoAGrid<Erosion2SoilFlow>;
+
+/**
+ * @brief Multithreaded CPU version of the Erosion2 model. Has no dependency on the renderer so it
+ * can be used without a GPU. State is kept in SoAGrid planes.
+ *
+ * The grid is split into bands of rows that are processed on util::ThreadPool. Each pass only
+ * reads buffers written by the previous pass, so a band reads its one row halo above and below
+ * directly from the shared input buffers without any locking.
+ *
+ * Every cell is written by exactly one work item and no pass reduces over cells, so results are
+ * bit identical for any number of threads.
+ *
+ * With a positive activity_threshold only active tiles of TileSize x TileSize cells are updated.
+ * A tile is stable when in a step its rock, sediment and the water moved by flow all changed by
+ * less than the threshold in every cell; rainfall and evaporation alone do not keep a tile
+ * active. A tile stays active while it or one of its 8 neighbors is not stable. Stable tiles are
+ * frozen with their last state and out flows, so the skipped regions are approximated as being in
+ * steady state.
+ *
+ */
+class Erosion2ModelCPU {
+public:
+    // rows per work item
+    static constexpr int BandRows = 32;
+    // cells per side of an activity tile
+    static constexpr int TileSize = 32;
+    // estimated bytes a step reads and writes per cell: both state grids, and the soil flows and
+    // sediment_mid, which are written and read again
+    static constexpr int StepBytesPerCell = sizeof(float) * (2 * Erosion2Grid::NumFields + 2 * (Erosion2SoilFlowGrid::NumFields + 1));
+
+    explicit Erosion2ModelCPU(const Erosion2Parameters& params) : params{params} {}
+
+    /**
+     * @brief initialize model state from terrain data
+     *
+     * @param width
+     * @param height
+     * @param rgba terrain RGBA32F texture data, width * height * 4 floats
+     */
+    void init(int width, int height, const float* rgba);
+
+    /**
+     * @brief run a single iteration of the model. With adaptive time steps the step is updated
+     * to Erosion2Parameters::stableTimeStep every time_step_interval iterations
+     *
+     */
+    void step();
+
+    /**
+     * @brief run a thermal weathering pass on its own: soil slides from every cell to the 8
+     * neighbors whose slope is steeper than the talus angle, without water flow or a step of
+     * simulated time. Much cheaper than step, many passes can run between two steps. Marks every
+     * tile active
+     *
+     * @param time_step seconds the soil flows apply for
+     */
+    void thermalStep(float time_step);
+
+    /**
+     * @brief write elevation state in the terrain RGBA32F texture layout
+     *
+     * @param rgba width * height * 4 floats
+     */
+    void copyTo(float* rgba) const;
+
+    /**
+     * @brief pool the passes run on. Results do not depend on the pool size
+     *
+     * @param pool
+     */
+    void setThreadPool(util::ThreadPool& pool) {this->pool = &pool;}
+
+    /**
+     * @brief xxHash64 of the current state planes
+     *
+     * @return uint64_t
+     */
+    uint64_t getStateHash() const {return state[current].hash();}
+
+    /**
+     * @brief add the state planes and iteration counter to checkpoint
+     *
+     * @param checkpoint
+     */
+    void saveState(ErosionCheckpoint& checkpoint) const;
+
+    /**
+     * @brief continue from checkpoint. Call after init with the same size
+     *
+     * @param checkpoint
+     * @return false if a plane is missing or has the wrong size, the state is then undefined
+     */
+    bool restoreState(const ErosionCheckpoint& checkpoint);
+
+    /**
+     * @brief number of tiles updated by the last step
+     *
+     * @return int
+     */
+    int getActiveTiles() const {return active_tiles;}
+
+    /**
+     * @brief number of tile updates skipped since init
+     *
+     * @return uint64_t
+     */
+    uint64_t getSkippedTiles() const {return skipped_tiles;}
+
+    int getNumTiles() const {return tiles_x * tiles_y;}
+
+    struct FlowExtent {
+        float max_speed = 0;    // m/s
+        float max_depth = 0;    // m
+    };
+
+    /**
+     * @brief largest water speed and depth of the current state. Reduced in fixed chunks, the
+     * result does not depend on the pool size
+     *
+     * @return FlowExtent
+     */
+    FlowExtent getFlowExtent() const;
+
+    /**
+     * @brief water, sediment and soil totals, height range and non-finite cells of the current
+     * state. Reduced with reduceDiagnostics in fixed bands, the result does not depend on the
+     * pool size or SimdLevel
+     *
+     * @param reference when given, the ground height of the previous call to measure the change
+     * against. Overwritten with the current height, and sized on the first call
+     * @return ErosionDiagnostics
+     */
+    ErosionDiagnostics getDiagnostics(SoAGrid<ScalarField>* reference = nullptr) const;
+
+    // seconds of simulated time since init
+    double getSimulatedTime() const {return simulated_time;}
+    // time step of the next step
+    float getTimeStep() const {return params.step_time_constant;}
+
+    int getWidth() const {return w;}
+    int getHeight() const {return h;}
+    uint32_t getIteration() const {return iteration;}
+    const Erosion2Parameters& getParameters() const {return params;}
+
+    // current state
+    const Erosion2Grid& getState() const {return state[current];}
+    // current state, for drivers that seed the model from another run. Call between steps only,
+    // marks every tile active
+    Erosion2Grid& getState() {
+        wake_all();
+        return state[current];
+    }
+
+private:
+    // flux, water, velocity, erosion/deposition and thermal out flows. in -> out, sediment_mid
+    // returns the largest change of water by flow
+    float flow_pass(int x0, int x1, int y0, int y1);
+    // semi-Lagrangian sediment transport and thermal in flows. sediment_mid -> out
+    // returns the largest change of rock or sediment
+    float transport_pass(int x0, int x1, int y0, int y1);
+
+    void step_dense();
+    void step_tiles();
+    void wake_all();
+    // copy the cells of tile from the state written by the step to the other state
+    void freeze_tile(int tile);
+
+    float bilinear_sediment(float x, float y) const;
+
+    Erosion2Parameters params;
+    util::ThreadPool* pool = &util::ThreadPool::Get();
+    int w = 0, h = 0;
+    uint32_t iteration = 0;
+    double simulated_time = 0;
+
+    Erosion2Grid state[2];
+    int current = 0;
+    // suspended sediment after erosion/deposition, before transport
+    SoAGrid<ScalarField> sediment_mid;
+    // thermal out flows of step, and of thermalStep between the steps
+    Erosion2SoilFlowGrid soil_flows;
+
+    int tiles_x = 0, tiles_y = 0;
+    // per tile, updated in the next step
+    std::vector<uint8_t> tile_active;
+    // per tile, changed by more than activity_threshold in the last step
+    std::vector<uint8_t> tile_changed;
+    std::vector<int> tile_list;
+    int active_tiles = 0;
+    uint64_t skipped_tiles = 0;
+};
+
+/**
+ * @brief seed the out flows, velocity and hardness of a model initialized over region.window
+ * from the state of an earlier run over the whole terrain
+ *
+ * @param model
+ * @param terrain state of the last full run
+ * @param region
+ * @return false, leaving the model as it is, when terrain is not the size of the terrain the
+ * region is in
+ */
+bool seedIncrementalRun(Erosion2ModelCPU& model, const Erosion2Grid& terrain, const IncrementalRegion& region);
+
+/**
+ * @brief write the state of the dirty cells of an incremental run back into the state of the
+ * whole terrain, so the next incremental run starts from it
+ *
+ * @param model
+ * @param terrain state of the last full run
+ * @param region
+ * @return false, leaving terrain as it is, when it is not the size of the terrain the region is in
+ */
+bool storeIncrementalRun(const Erosion2ModelCPU& model, Erosion2Grid& terrain, const IncrementalRegion& region);
+
+}
+
+#endif // DIRTBOX_EROSION_MODEL2_CPU_H
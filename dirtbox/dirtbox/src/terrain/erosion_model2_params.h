@@ -0,0 +1,245 @@
+/**
+ * @brief parameters shared by the GPU and CPU implementations of the virtual pipe erosion model
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ */
+#pragma once
+#ifndef DIRTBOX_EROSION_MODEL2_PARAMS_H
+#define DIRTBOX_EROSION_MODEL2_PARAMS_H
+
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+
+#include <util/parameter.h>
+
+namespace dirtbox::terrain {
+
+/**
+ * @brief Erosion2 model parameters. Layout matches u_params[5] in cs_model2_params.sh
+ *
+ */
+struct Erosion2Parameters {
+    Erosion2Parameters() :
+        water_sediment_capacity         {1.f},
+        maximal_erosion_depth           {10.0f},
+        step_time_constant              {0.05f},
+        cell_size                       {30.0f},
+        unused                          {0.0f},
+        bedrock_erosion_base_value      {0.05f},
+        rock_erosion_base_value         {0.05f},
+        iterations                      {1000},
+        rainfall                        {0.01f},
+        terrain_elevation_scale         {100},
+        virtual_pipe_area               {10},
+        soil_suspension_rate            {0.5f},
+        sediment_deposition_rate        {1},
+        soil_softness_max               {0.1f},
+        water_evaporation_rate          {0.015f},
+        thermal_erosion_rate            {0.15f},
+        talus_angle_tangent_coef        {0.8f},
+        talus_angle_tangent_bias        {0.1f},
+        activity_threshold              {0.0f} {}
+
+    void toParameterSet(util::ParameterCollection<float>& parameters) {
+        parameters.addParameter("water_sediment_capacity", 0.1f, 3.f, water_sediment_capacity);
+        parameters.addParameter("maximal_erosion_depth", 0, 40, maximal_erosion_depth);
+        parameters.addParameter("iterations", 1, 1, iterations);
+        parameters.addParameter("step_time_constant", 0.01f, 10.0f, step_time_constant);
+        // rainfall in meters per year
+        parameters.addParameter("rainfall", 0.0001f, 0.5f, rainfall);
+        parameters.addParameter("cell_size", 0.5f, 150.0f, cell_size);
+
+        // soil absorbtion coef
+        // parameters.addParameter("soil_absorption", 0.0f, 1.0f, soil_absorption);
+
+        // layer parameters
+        parameters.addParameter("rock_erosion_base_value", 0.0001f, 0.1f, rock_erosion_base_value);
+        // parameters.addParameter("bedrock_erosion_base_value", 0.0001f, 0.1f, bedrock_erosion_base_value);
+
+        parameters.addParameter("terrain_elevation_scale", 1, 500, terrain_elevation_scale);
+        parameters.addParameter("virtual_pipe_area", 0.1, 60, virtual_pipe_area);
+        parameters.addParameter("soil_suspension_rate", 0.1f, 2.f, soil_suspension_rate);
+        parameters.addParameter("sediment_deposition_rate", 0.1f, 3.f, sediment_deposition_rate);
+        parameters.addParameter("soil_softness_max", 0.1, 1, soil_softness_max);
+        parameters.addParameter("water_evaporation_rate", 0, 0.05f, water_evaporation_rate);
+        parameters.addParameter("thermal_erosion_rate", 0, 3, thermal_erosion_rate);
+        parameters.addParameter("talus_angle_tangent_coef", 0, 1, talus_angle_tangent_coef);
+        parameters.addParameter("talus_angle_tangent_bias", 0, 1, talus_angle_tangent_bias);
+        // largest change per step, in meters, of a tile that is considered stable. 0 updates every tile
+        parameters.addParameter("activity_threshold", 0, 0.01f, activity_threshold);
+
+        // adaptive time steps, on when >= 0.5. Runs for simulated_time seconds instead of a
+        // number of iterations, with the largest step that satisfies the CFL condition
+        parameters.addParameter("adaptive_time_step", 0, 1, adaptive_time_step);
+        parameters.addParameter("courant_number", 0.05f, 2.0f, courant_number);
+        parameters.addParameter("max_time_step", 0.01f, 10.0f, max_time_step);
+        parameters.addParameter("time_step_interval", 1, 100, time_step_interval);
+        parameters.addParameter("simulated_time", 1, 5000, simulated_time);
+
+        // half precision out flows, velocity and soil flows, on when >= 0.5. Halves the memory
+        // and bandwidth of those textures, the elevation layers stay in full precision
+        parameters.addParameter("half_precision", 0, 1, half_precision);
+    }
+
+    void fromParameterSet(const util::ParameterCollection<float>& p) {
+        water_sediment_capacity     = p.getParam("water_sediment_capacity");
+        maximal_erosion_depth       = p.getParam("maximal_erosion_depth");
+        iterations                  = p.getParam("iterations");
+        step_time_constant          = p.getParam("step_time_constant");
+        rainfall                    = p.getParam("rainfall");
+        cell_size                   = p.getParam("cell_size");
+        // soil_absorption             = p.getParam("soil_absorption");
+        rock_erosion_base_value     = p.getParam("rock_erosion_base_value");
+        // bedrock_erosion_base_value  = p.getParam("bedrock_erosion_base_value");
+        terrain_elevation_scale     = p.getParam("terrain_elevation_scale");
+        virtual_pipe_area           = p.getParam("virtual_pipe_area");
+        soil_suspension_rate        = p.getParam("soil_suspension_rate");
+        sediment_deposition_rate    = p.getParam("sediment_deposition_rate");
+        soil_softness_max           = p.getParam("soil_softness_max");
+        water_evaporation_rate      = p.getParam("water_evaporation_rate");
+        thermal_erosion_rate        = p.getParam("thermal_erosion_rate");
+        talus_angle_tangent_coef    = p.getParam("talus_angle_tangent_coef");
+        talus_angle_tangent_bias    = p.getParam("talus_angle_tangent_bias");
+        activity_threshold          = p.getParam("activity_threshold");
+        adaptive_time_step          = p.getParam("adaptive_time_step");
+        courant_number              = p.getParam("courant_number");
+        max_time_step               = p.getParam("max_time_step");
+        time_step_interval          = p.getParam("time_step_interval");
+        simulated_time              = p.getParam("simulated_time");
+        half_precision              = p.getParam("half_precision");
+    }
+
+    bool isAdaptive() const {return adaptive_time_step >= 0.5f;}
+    bool isHalfPrecision() const {return half_precision >= 0.5f;}
+
+    /**
+     * @brief iterations left in a run, estimated at the current time step in adaptive mode
+     *
+     * @param iteration completed iterations
+     * @param time simulated seconds
+     * @return uint64_t
+     */
+    uint64_t remainingIterations(uint32_t iteration, double time) const {
+        if (isAdaptive())
+            return step_time_constant > 0 ? (uint64_t)std::ceil(std::max(0.0, simulated_time - time) / step_time_constant) : 0;
+        return iteration < iterations ? (uint64_t)iterations - iteration : 0;
+    }
+
+    /**
+     * @brief bytes per cell of the GPU state: two elevation, out flow and velocity buffers, two
+     * soil flow textures and the scaled elevation between the passes, 4 channels each
+     *
+     * @return int
+     */
+    int gpuStateBytesPerCell() const {
+        const int flow_bytes = isHalfPrecision() ? 8 : 16;
+        return 3 * 16 + 6 * flow_bytes;
+    }
+
+    // water depth in m below which a cell is dry for the time step estimate
+    static constexpr float MinFlowDepth = 0.01f;
+    // lowest local soil hardness a step leaves, the highest is soil_softness_max
+    static constexpr float MinHardness = 0.05f;
+
+    /**
+     * @brief largest time step at which water and gravity waves move at most courant_number
+     * cells per step, capped at max_time_step
+     *
+     * @param max_speed largest water speed, m/s
+     * @param max_depth largest water depth, m
+     * @return float the current step_time_constant if the inputs are not finite
+     */
+    float stableTimeStep(float max_speed, float max_depth) const {
+        const float wave_speed = max_speed + std::sqrt(9.8f * max_depth);
+        if (!std::isfinite(wave_speed))
+            return step_time_constant;
+        if (wave_speed <= 0)
+            return max_time_step;
+        return std::min(max_time_step, courant_number * cell_size / wave_speed);
+    }
+
+    union
+    {
+        struct
+        {
+            float water_sediment_capacity;
+            float maximal_erosion_depth;
+            float step_time_constant;
+            float cell_size;
+
+            float unused;
+            float bedrock_erosion_base_value;
+            float rock_erosion_base_value;
+            float iterations;
+
+            float rainfall;
+            float terrain_elevation_scale;
+            float virtual_pipe_area;
+            float soil_suspension_rate;
+
+            float sediment_deposition_rate;
+            float soil_softness_max;
+            float water_evaporation_rate;
+            float thermal_erosion_rate;
+
+            float talus_angle_tangent_coef;
+            float talus_angle_tangent_bias;
+            float activity_threshold;
+        };
+
+        float params[20];
+    };
+
+    // not part of the shader parameters
+    float adaptive_time_step = 0;
+    float courant_number = 1.0f;
+    float max_time_step = 2.0f;
+    // steps between time step updates
+    float time_step_interval = 10;
+    // run length in seconds of simulated time, adaptive mode only
+    float simulated_time = 50;
+    float half_precision = 0;
+};
+
+/**
+ * @brief standalone thermal weathering passes between the steps of the Erosion2 engines, see
+ * Erosion2ModelCPU::thermalStep and cs_model2_talus.sc
+ *
+ */
+struct ThermalPassParameters {
+    // passes after every thermal_interval steps, 0 disables them
+    float passes        = 0;
+    float interval      = 10;
+    // seconds each pass applies the soil flows for
+    float time_step     = 1;
+
+    void toParameterSet(util::ParameterCollection<float>& parameters) {
+        parameters.addParameter("thermal_passes", 0, 500, passes);
+        parameters.addParameter("thermal_interval", 1, 1000, interval);
+        parameters.addParameter("thermal_time_step", 0.01f, 10.0f, time_step);
+    }
+
+    void fromParameterSet(const util::ParameterCollection<float>& p) {
+        passes      = p.getParam("thermal_passes");
+        interval    = p.getParam("thermal_interval");
+        time_step   = p.getParam("thermal_time_step");
+    }
+
+    bool enabled() const {return passes >= 1;}
+
+    /**
+     * @brief passes to run after a step
+     *
+     * @param iteration completed steps
+     * @return int
+     */
+    int passesAfter(uint32_t iteration) const {
+        return enabled() && iteration % std::max(1u, (uint32_t)interval) == 0 ? (int)passes : 0;
+    }
+};
+
+}
+
+#endif // DIRTBOX_EROSION_MODEL2_PARAMS_H
@@ -0,0 +1,175 @@
+#include <terrain/erosion_pyramid_cpu.h>
+
+#include <cmath>
+#include <chrono>
+#include <memory>
+#include <utility>
+#include <algorithm>
+
+namespace dirtbox::terrain {
+
+namespace {
+
+/**
+ * @brief box filter interleaved RGBA data by factor. Blocks cut off by the edge average the cells
+ * they cover
+ *
+ */
+std::vector<float> downsample_rgba(const float* rgba, int w, int h, int factor, int cw, int ch) {
+    std::vector<float> out((std::size_t)cw * ch * 4, 0.0f);
+    for (int cy = 0; cy < ch; ++cy) {
+        for (int cx = 0; cx < cw; ++cx) {
+            float sum[4] = {};
+            int n = 0;
+            for (int y = cy * factor; y < std::min(h, (cy + 1) * factor); ++y) {
+                for (int x = cx * factor; x < std::min(w, (cx + 1) * factor); ++x) {
+                    for (int c = 0; c < 4; ++c)
+                        sum[c] += rgba[4 * ((std::size_t)y * w + x) + c];
+                    n++;
+                }
+            }
+            for (int c = 0; c < 4; ++c)
+                out[4 * ((std::size_t)cy * cw + cx) + c] = sum[c] / n;
+        }
+    }
+    return out;
+}
+
+/**
+ * @brief bilinear sample of src at the center of every dst cell. dst is factor times finer than
+ * src. When add is set the samples are added to dst instead of replacing it
+ *
+ */
+void upsample(PlaneView<const float> src, PlaneView<float> dst, int factor, bool add) {
+    const float inv = 1.0f / factor;
+    for (int y = 0; y < dst.getHeight(); ++y) {
+        const float sy = (y + 0.5f) * inv - 0.5f;
+        const float fy = std::floor(sy);
+        const float wy = sy - fy;
+        const int y0 = (int)fy;
+        float* row = dst.row(y);
+        for (int x = 0; x < dst.getWidth(); ++x) {
+            const float sx = (x + 0.5f) * inv - 0.5f;
+            const float fx = std::floor(sx);
+            const float wx = sx - fx;
+            const int x0 = (int)fx;
+            const float bot = src.clampedAt(x0, y0)     * (1 - wx) + src.clampedAt(x0 + 1, y0)     * wx;
+            const float top = src.clampedAt(x0, y0 + 1) * (1 - wx) + src.clampedAt(x0 + 1, y0 + 1) * wx;
+            const float v = bot * (1 - wy) + top * wy;
+            row[x] = add ? row[x] + v : v;
+        }
+    }
+}
+
+/**
+ * @brief seed fine from a finished coarse run. coarse_rgba is the input the coarse run started from
+ *
+ */
+void seed_from_coarse(Erosion2ModelCPU& fine, const Erosion2ModelCPU& coarse, const std::vector<float>& coarse_rgba, int factor, float elevation_scale) {
+    const Erosion2Grid& cs = coarse.getState();
+    Erosion2Grid& fs = fine.getState();
+
+    // change of the layers during the coarse run
+    SoAGrid<ScalarField> delta{cs.getWidth(), cs.getHeight()};
+    for (auto [field, channel] : {std::pair{Erosion2Field::Rock, 0}, std::pair{Erosion2Field::Sand, 1}}) {
+        for (int y = 0; y < cs.getHeight(); ++y)
+            for (int x = 0; x < cs.getWidth(); ++x)
+                delta.at(ScalarField::Value, x, y) = cs.at(field, x, y) - coarse_rgba[4 * ((std::size_t)y * cs.getWidth() + x) + channel] * elevation_scale;
+        upsample(std::as_const(delta).plane(ScalarField::Value), fs.plane(field), factor, true);
+    }
+
+    for (auto field : {Erosion2Field::Sediment, Erosion2Field::Water, Erosion2Field::Hardness, Erosion2Field::VelocityX, Erosion2Field::VelocityY})
+        upsample(cs.plane(field), fs.plane(field), factor, false);
+}
+
+}
+
+Erosion2PyramidCPU::Erosion2PyramidCPU(const Erosion2Parameters& params, const Erosion2PyramidParameters& pyramid) :
+    params{params}, pyramid{pyramid} {
+}
+
+std::vector<Erosion2PyramidCPU::Level> Erosion2PyramidCPU::schedule(int width, int height, int iterations, const Erosion2PyramidParameters& pyramid) {
+    constexpr int MinLevelSize = 16;
+
+    std::vector<Level> out;
+    const int num_levels = std::clamp((int)pyramid.levels, 1, 4);
+    for (int k = num_levels - 1; k > 0; --k) {
+        const int factor = 1 << k;
+        const int w = (width + factor - 1) / factor;
+        const int h = (height + factor - 1) / factor;
+        if (w >= MinLevelSize && h >= MinLevelSize)
+            out.push_back({w, h, factor, 0});
+    }
+    out.push_back({width, height, 1, 0});
+
+    const float fine_fraction = out.size() > 1 ? std::clamp(pyramid.fine_iteration_fraction, 0.0f, 1.0f) : 1.0f;
+    const int fine = (int)std::round(iterations * fine_fraction);
+    const int coarse = iterations - fine;
+    const int coarse_levels = out.size() - 1;
+    for (int i = 0; i < coarse_levels; ++i)
+        out[i].iterations = coarse / coarse_levels + (i < coarse % coarse_levels ? 1 : 0);
+    out.back().iterations = fine;
+    return out;
+}
+
+void Erosion2PyramidCPU::run(int width, int height, float* rgba, const std::function<bool(float)>& progress) {
+    using clock = std::chrono::steady_clock;
+
+    levels = schedule(width, height, (int)params.iterations, pyramid);
+
+    // progress is measured in cell updates
+    double total_work = 0;
+    for (const auto& l : levels)
+        total_work += (double)l.width * l.height * l.iterations;
+    double work = 0;
+
+    std::unique_ptr<Erosion2ModelCPU> coarse;
+    std::vector<float> coarse_rgba;
+    int coarse_factor = 1;
+    bool stopped = false;
+
+    for (auto& level : levels) {
+        const auto start = clock::now();
+
+        Erosion2Parameters lp = params;
+        lp.cell_size *= level.factor;
+
+        std::vector<float> level_rgba;
+        if (level.factor > 1)
+            level_rgba = downsample_rgba(rgba, width, height, level.factor, level.width, level.height);
+        const float* input = level.factor > 1 ? level_rgba.data() : rgba;
+
+        auto model = std::make_unique<Erosion2ModelCPU>(lp);
+        model->setThreadPool(*pool);
+        model->init(level.width, level.height, input);
+        if (coarse)
+            seed_from_coarse(*model, *coarse, coarse_rgba, coarse_factor / level.factor, params.terrain_elevation_scale);
+
+        for (int i = 0; i < level.iterations && !stopped; ++i) {
+            model->step();
+            work += (double)level.width * level.height;
+            if (progress && !progress(total_work > 0 ? work / total_work : 1.0f))
+                stopped = true;
+        }
+
+        level.seconds = std::chrono::duration<double>(clock::now() - start).count();
+        coarse = std::move(model);
+        coarse_rgba = std::move(level_rgba);
+        coarse_factor = level.factor;
+        if (stopped)
+            break;
+    }
+
+    // a stopped run may end on a coarse level, upsample it so the result has full resolution
+    if (coarse_factor > 1) {
+        Erosion2ModelCPU fine{params};
+        fine.setThreadPool(*pool);
+        fine.init(width, height, rgba);
+        seed_from_coarse(fine, *coarse, coarse_rgba, coarse_factor, params.terrain_elevation_scale);
+        fine.copyTo(rgba);
+    } else {
+        coarse->copyTo(rgba);
+    }
+}
+
+}
@@ -0,0 +1,98 @@
+/**
+ * @author Hunter Borlik
+ * @brief coarse to fine scheduling of the Erosion2 CPU model
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ */
+#pragma once
+#ifndef DIRTBOX_EROSION_PYRAMID_CPU_H
+#define DIRTBOX_EROSION_PYRAMID_CPU_H
+
+#include <vector>
+#include <functional>
+
+#include <util/parameter.h>
+#include <util/thread_pool.h>
+#include <terrain/erosion_model2_cpu.h>
+
+namespace dirtbox::terrain {
+
+/**
+ * @brief pyramid settings on top of the Erosion2 parameters
+ *
+ */
+struct Erosion2PyramidParameters {
+    // number of resolutions, the coarsest is 1 / 2^(levels - 1)
+    float levels                    = 3;
+    // share of the iterations run at full resolution, the rest is split evenly over the coarse levels
+    float fine_iteration_fraction   = 0.2f;
+
+    void toParameterSet(util::ParameterCollection<float>& parameters) {
+        parameters.addParameter("pyramid_levels", 1, 4, levels);
+        parameters.addParameter("fine_iteration_fraction", 0.05f, 1.0f, fine_iteration_fraction);
+    }
+
+    void fromParameterSet(const util::ParameterCollection<float>& p) {
+        levels                  = p.getParam("pyramid_levels");
+        fine_iteration_fraction = p.getParam("fine_iteration_fraction");
+    }
+};
+
+/**
+ * @brief Runs the Erosion2 model coarse to fine. Water moves about one cell per iteration, so
+ * drainage patterns need many iterations to form at full resolution. Most iterations run on a
+ * box filtered terrain at 1/4 and 1/2 resolution, where an iteration costs 1/16 and 1/4 as much.
+ * Cell size scales with the level, the time step does not; scaling it as well made the coarse
+ * levels overshoot the converged result.
+ *
+ * Between levels water, suspended sediment, hardness and velocity are bilinearly upsampled. The
+ * rock and sand layers start from the full detail input plus the upsampled change of the coarser
+ * run, so coarse erosion is carried over without blurring the terrain. Out flows restart at zero.
+ * Has no dependency on the renderer.
+ *
+ */
+class Erosion2PyramidCPU {
+public:
+    struct Level {
+        int width;
+        int height;
+        int factor;         // downsampling factor from full resolution
+        int iterations;
+        double seconds = 0; // wall clock time spent in this level
+    };
+
+    Erosion2PyramidCPU(const Erosion2Parameters& params, const Erosion2PyramidParameters& pyramid);
+
+    /**
+     * @brief run all levels on terrain and write the result back into it
+     *
+     * @param width
+     * @param height
+     * @param rgba terrain RGBA32F texture data, width * height * 4 floats
+     * @param progress called after every iteration with the fraction of work done, returns false to stop
+     */
+    void run(int width, int height, float* rgba, const std::function<bool(float)>& progress = {});
+
+    void setThreadPool(util::ThreadPool& pool) {this->pool = &pool;}
+
+    // schedule of the last run, coarsest first
+    const std::vector<Level>& getLevels() const {return levels;}
+
+    /**
+     * @brief iterations per level for a run at width x height, coarsest first. Levels smaller than
+     * 16 cells on a side are skipped
+     *
+     */
+    static std::vector<Level> schedule(int width, int height, int iterations, const Erosion2PyramidParameters& pyramid);
+
+private:
+    Erosion2Parameters params;
+    Erosion2PyramidParameters pyramid;
+    util::ThreadPool* pool = &util::ThreadPool::Get();
+    std::vector<Level> levels;
+};
+
+}
+
+#endif // DIRTBOX_EROSION_PYRAMID_CPU_H
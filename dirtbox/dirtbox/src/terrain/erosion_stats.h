@@ -0,0 +1,201 @@
+/**
+ * @author Hunter Borlik
+ * @brief throughput and timing counters of erosion runs
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ */
+#pragma once
+#ifndef DIRTBOX_EROSION_STATS_H
+#define DIRTBOX_EROSION_STATS_H
+
+#include <cstdint>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+namespace dirtbox::terrain {
+
+/**
+ * @brief totals of one pass of an engine that runs several on their own schedules
+ *
+ */
+struct ErosionPassStats {
+    std::string name;
+    // times the pass ran
+    uint64_t runs = 0;
+    // cells or events the pass worked on
+    uint64_t items = 0;
+    double seconds = 0;
+};
+
+/**
+ * @brief Throughput of the current or last run. Rates are averaged over the last
+ * ErosionStatsRecorder::Window seconds.
+ *
+ */
+struct ErosionStats {
+    // iterations completed in the run
+    uint64_t iterations = 0;
+    double iterations_per_second = 0;
+    // cells updated per second, skipped tiles and halos do not count
+    double cells_per_second = 0;
+    // estimated simulation state read and written per second
+    double bytes_per_second = 0;
+    // particles simulated per second by particle engines, 0 for grid engines
+    double particles_per_second = 0;
+    // particles per second of one core, for sizing particle jobs
+    double particles_per_core_second = 0;
+    // wall clock time of a step on the CPU engines, the time to submit one on the GPU engines
+    float cpu_ms_per_step = 0;
+    // measured GPU time of the compute view, 0 when not measured. Needs BGFX_DEBUG_PROFILER
+    float gpu_ms_per_step = 0;
+    float gpu_ms_per_dispatch = 0;
+    // seconds until the run completes, < 0 when unknown
+    double eta_seconds = -1;
+    // totals of the run per pass in the order they first ran, empty for single pass engines
+    std::vector<ErosionPassStats> passes;
+};
+
+/**
+ * @brief Collects the counters of a run. Steps are recorded by the thread running the model,
+ * get() may be called from any thread.
+ *
+ */
+class ErosionStatsRecorder {
+public:
+    using clock = std::chrono::steady_clock;
+    // seconds the rates are averaged over
+    static constexpr double Window = 2.0;
+
+    // forget the last run
+    void start() {
+        std::lock_guard lock{mutex};
+        samples.clear();
+        passes.clear();
+        total = {};
+        gpu_ms_per_step = 0;
+        gpu_ms_per_dispatch = 0;
+    }
+
+    /**
+     * @brief record completed steps
+     *
+     * @param steps iterations
+     * @param cells cell updates of all steps
+     * @param bytes estimated state bytes read and written by all steps
+     * @param cpu_seconds time the steps took on the CPU
+     * @param progress of the run after the steps, in [0, 1]
+     * @param particles particles simulated by all steps
+     * @param threads threads the steps ran on
+     */
+    void addSteps(uint32_t steps, uint64_t cells, uint64_t bytes, double cpu_seconds, float progress, uint64_t particles = 0, unsigned int threads = 1) {
+        std::lock_guard lock{mutex};
+        total.iterations += steps;
+        total.cells += cells;
+        total.bytes += bytes;
+        total.particles += particles;
+        total.cpu_seconds += cpu_seconds;
+        total.core_seconds += cpu_seconds * std::max(threads, 1u);
+        const auto now = clock::now();
+        samples.push_back({now, total, progress});
+        // keep one sample older than the window as its start
+        while (samples.size() > 2 && std::chrono::duration<double>(now - samples[1].time).count() > Window)
+            samples.pop_front();
+    }
+
+    /**
+     * @brief record runs of a pass. Steps still need addSteps, the pass time is part of theirs
+     *
+     * @param name
+     * @param runs times the pass ran
+     * @param items cells or events the runs worked on
+     * @param seconds time the runs took
+     */
+    void addPass(const std::string& name, uint32_t runs, uint64_t items, double seconds) {
+        std::lock_guard lock{mutex};
+        auto it = std::find_if(passes.begin(), passes.end(), [&](const ErosionPassStats& p) {return p.name == name;});
+        if (it == passes.end())
+            it = passes.insert(passes.end(), ErosionPassStats{name});
+        it->runs += runs;
+        it->items += items;
+        it->seconds += seconds;
+    }
+
+    /**
+     * @brief record a GPU timing of the compute view
+     *
+     * @param ms GPU time of a frame, ignored when <= 0
+     * @param steps iterations the frame ran, a fraction for engines that spread one over frames
+     * @param dispatches compute dispatches the frame ran
+     */
+    void addGPUTime(float ms, float steps, uint32_t dispatches) {
+        if (ms <= 0 || steps <= 0 || dispatches == 0)
+            return;
+        std::lock_guard lock{mutex};
+        gpu_ms_per_step = ms / steps;
+        gpu_ms_per_dispatch = ms / dispatches;
+    }
+
+    ErosionStats get() const {
+        std::lock_guard lock{mutex};
+        ErosionStats stats;
+        stats.iterations = total.iterations;
+        stats.gpu_ms_per_step = gpu_ms_per_step;
+        stats.gpu_ms_per_dispatch = gpu_ms_per_dispatch;
+        stats.passes = passes;
+        if (samples.size() < 2)
+            return stats;
+
+        const Sample& a = samples.front();
+        const Sample& b = samples.back();
+        const double seconds = std::chrono::duration<double>(b.time - a.time).count();
+        const uint64_t steps = b.total.iterations - a.total.iterations;
+        if (seconds <= 0 || steps == 0)
+            return stats;
+
+        stats.iterations_per_second = steps / seconds;
+        stats.cells_per_second = (b.total.cells - a.total.cells) / seconds;
+        stats.bytes_per_second = (b.total.bytes - a.total.bytes) / seconds;
+        stats.particles_per_second = (b.total.particles - a.total.particles) / seconds;
+        const double core_seconds = b.total.core_seconds - a.total.core_seconds;
+        if (core_seconds > 0)
+            stats.particles_per_core_second = (b.total.particles - a.total.particles) / core_seconds;
+        stats.cpu_ms_per_step = (float)((b.total.cpu_seconds - a.total.cpu_seconds) * 1000.0 / steps);
+        const double progress_rate = (b.progress - a.progress) / seconds;
+        if (progress_rate > 0)
+            stats.eta_seconds = std::max(0.0, (1.0 - b.progress) / progress_rate);
+        return stats;
+    }
+
+private:
+    struct Totals {
+        uint64_t iterations = 0;
+        uint64_t cells = 0;
+        uint64_t bytes = 0;
+        uint64_t particles = 0;
+        double cpu_seconds = 0;
+        // cpu_seconds times the threads of each step
+        double core_seconds = 0;
+    };
+
+    struct Sample {
+        clock::time_point time;
+        Totals total;
+        float progress;
+    };
+
+    mutable std::mutex mutex;
+    std::deque<Sample> samples;
+    std::vector<ErosionPassStats> passes;
+    Totals total;
+    float gpu_ms_per_step = 0;
+    float gpu_ms_per_dispatch = 0;
+};
+
+}
+
+#endif // DIRTBOX_EROSION_STATS_H
@@ -0,0 +1,465 @@
+#include <terrain/erosion_sweep.h>
+
+#include <cmath>
+#include <chrono>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <numeric>
+#include <filesystem>
+
+#include <nlohmann/json.hpp>
+
+#include <util/parameter.h>
+#include <util/thread_pool.h>
+#include <util/counter_rng.h>
+#include <terrain/erosion_model2_cpu.h>
+#include <terrain/etes_model_cpu.h>
+
+using namespace nlohmann;
+
+namespace dirtbox::terrain {
+
+namespace {
+
+// parameter defaults of an engine, empty for an unknown engine
+std::optional<util::ParameterCollection<float>> engine_parameters(const std::string& engine) {
+    util::ParameterCollection<float> parameters;
+    if (engine == "erosion2") {
+        Erosion2Parameters{}.toParameterSet(parameters);
+    } else if (engine == "etes") {
+        ETESModelParameters{}.toParameterSet(parameters);
+        ETESEcosystemParameters{}.toParameterSet(parameters);
+    } else {
+        return {};
+    }
+    return parameters;
+}
+
+bool has_parameter(const util::ParameterCollection<float>& parameters, const std::string& name) {
+    const auto list = parameters.getParams();
+    return std::any_of(list.begin(), list.end(), [&](const auto& p) {return p.name == name;});
+}
+
+// ridged noise, the same terrain as the benchmarks
+std::vector<float> make_terrain(int w, int h) {
+    std::vector<float> rgba((std::size_t)w * h * 4, 0.0f);
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            float e = 0;
+            float amp = 0.5f;
+            float freq = 4.0f / w;
+            for (int o = 0; o < 5; ++o, amp *= 0.5f, freq *= 2.0f)
+                e += amp * std::sin(x * freq * 6.283f + o) * std::cos(y * freq * 6.283f + 2 * o);
+            rgba[4 * ((std::size_t)y * w + x)] = 1.0f + e;
+        }
+    }
+    return rgba;
+}
+
+std::optional<SweepAxis> parse_axis(const std::string& name, const json& j, std::string& error) {
+    SweepAxis axis;
+    axis.name = name;
+    if (j.is_array()) {
+        for (const auto& v : j)
+            axis.values.push_back(v.get<float>());
+        if (axis.values.empty()) {
+            error = "parameter " + name + " has no values";
+            return {};
+        }
+        return axis;
+    }
+    if (j.is_object() && j.count("min") && j.count("max")) {
+        axis.min = j.at("min").get<float>();
+        axis.max = j.at("max").get<float>();
+        const int steps = j.value("steps", 0);
+        // a grid needs the values, a random sweep samples the range
+        for (int i = 0; i < steps; ++i)
+            axis.values.push_back(steps == 1 ? axis.min : axis.min + (axis.max - axis.min) * i / (steps - 1));
+        return axis;
+    }
+    if (j.is_number()) {
+        axis.values.push_back(j.get<float>());
+        return axis;
+    }
+    error = "parameter " + name + " must be a number, a list of values or {\"min\", \"max\"}";
+    return {};
+}
+
+std::string csv_escape(const std::string& s) {
+    if (s.find_first_of(",\"\n") == std::string::npos)
+        return s;
+    std::string out = "\"";
+    for (char c : s)
+        out += c == '"' ? std::string("\"\"") : std::string(1, c);
+    return out + "\"";
+}
+
+}
+
+std::optional<SweepSpec> SweepSpec::fromJson(const std::string& text, std::string& error) {
+    json j;
+    try {
+        j = json::parse(text);
+    } catch (const json::exception& e) {
+        error = e.what();
+        return {};
+    }
+    if (!j.is_object()) {
+        error = "sweep must be a JSON object";
+        return {};
+    }
+
+    SweepSpec spec;
+    try {
+        spec.engine = j.value("engine", spec.engine);
+        const std::string mode = j.value("mode", std::string("grid"));
+        if (mode == "grid") {
+            spec.mode = Mode::Grid;
+        } else if (mode == "random") {
+            spec.mode = Mode::Random;
+        } else {
+            error = "unknown mode " + mode;
+            return {};
+        }
+        spec.samples = j.value("samples", spec.samples);
+        spec.seed = j.value("seed", spec.seed);
+        spec.jobs = j.value("jobs", spec.jobs);
+        spec.size = j.value("size", spec.size);
+        spec.terrain = j.value("terrain", spec.terrain);
+        spec.output = j.value("output", spec.output);
+        spec.channel_threshold = j.value("channel_threshold", spec.channel_threshold);
+
+        if (j.count("parameters")) {
+            for (const auto& [name, value] : j.at("parameters").items()) {
+                auto axis = parse_axis(name, value, error);
+                if (!axis)
+                    return {};
+                if (spec.mode == Mode::Grid && axis->values.empty()) {
+                    error = "grid parameter " + name + " needs values or steps";
+                    return {};
+                }
+                spec.axes.push_back(std::move(*axis));
+            }
+        }
+    } catch (const json::exception& e) {
+        error = e.what();
+        return {};
+    }
+
+    if (spec.samples <= 0 || spec.size <= 0 || spec.channel_threshold <= 0) {
+        error = "samples, size and channel_threshold must be positive";
+        return {};
+    }
+    return spec;
+}
+
+std::vector<SweepConfig> planSweep(const SweepSpec& spec) {
+    std::vector<SweepConfig> configs;
+    if (spec.mode == SweepSpec::Mode::Random) {
+        for (int s = 0; s < spec.samples; ++s) {
+            SweepConfig config;
+            for (std::size_t a = 0; a < spec.axes.size(); ++a) {
+                const SweepAxis& axis = spec.axes[a];
+                // one stream per sample and axis, adding an axis does not change the others
+                util::CounterRNG rng{spec.seed, (uint32_t)s, (uint32_t)a};
+                const float value = axis.values.empty()
+                    ? axis.min + (axis.max - axis.min) * rng.uniform()
+                    : axis.values[rng.uniformInt(axis.values.size())];
+                config.emplace_back(axis.name, value);
+            }
+            configs.push_back(std::move(config));
+        }
+        return configs;
+    }
+
+    // every combination, the last axis changes fastest
+    std::vector<std::size_t> at(spec.axes.size(), 0);
+    while (true) {
+        SweepConfig config;
+        for (std::size_t a = 0; a < spec.axes.size(); ++a)
+            config.emplace_back(spec.axes[a].name, spec.axes[a].values[at[a]]);
+        configs.push_back(std::move(config));
+
+        std::size_t a = spec.axes.size();
+        while (a > 0 && ++at[a - 1] == spec.axes[a - 1].values.size())
+            at[--a] = 0;
+        if (a == 0)
+            break;
+    }
+    return configs;
+}
+
+double drainageDensity(int width, int height, const float* elevation, float cell_size, int threshold) {
+    const std::size_t cells = (std::size_t)width * height;
+    static const int dx[8] = {0, 1, 1, 1, 0, -1, -1, -1};
+    static const int dy[8] = {-1, -1, 0, 1, 1, 1, 0, -1};
+    static const float dist[8] = {1, std::sqrt(2.0f), 1, std::sqrt(2.0f), 1, std::sqrt(2.0f), 1, std::sqrt(2.0f)};
+
+    // steepest descent receiver of each cell, -1 for pits, flats and the grid border
+    std::vector<int> receiver(cells, -1);
+    std::vector<float> receiver_dist(cells, 0);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            const std::size_t i = (std::size_t)y * width + x;
+            float steepest = 0;
+            for (int d = 0; d < 8; ++d) {
+                const int nx = x + dx[d];
+                const int ny = y + dy[d];
+                if (nx < 0 || nx >= width || ny < 0 || ny >= height)
+                    continue;
+                const std::size_t n = (std::size_t)ny * width + nx;
+                const float slope = (elevation[i] - elevation[n]) / dist[d];
+                if (slope > steepest) {
+                    steepest = slope;
+                    receiver[i] = (int)n;
+                    receiver_dist[i] = dist[d] * cell_size;
+                }
+            }
+        }
+    }
+
+    // accumulate from the highest cell down, every receiver is lower than its donors
+    std::vector<int> order(cells);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](int a, int b) {
+        return elevation[a] > elevation[b] || (elevation[a] == elevation[b] && a < b);
+    });
+    std::vector<int> upstream(cells, 1);
+    double length = 0;
+    for (int i : order) {
+        if (receiver[i] < 0)
+            continue;
+        upstream[receiver[i]] += upstream[i];
+        if (upstream[i] >= threshold)
+            length += receiver_dist[i];
+    }
+    return length / ((double)cells * cell_size * cell_size);
+}
+
+bool savePFM(const std::string& filename, int width, int height, const float* data, int channels) {
+    std::ofstream out{filename, std::ios::binary | std::ios::trunc};
+    if (!out)
+        return false;
+    // negative scale: little endian. Rows are stored bottom to top
+    out << "Pf\n" << width << " " << height << "\n-1.0\n";
+    std::vector<float> row(width);
+    for (int y = height - 1; y >= 0; --y) {
+        for (int x = 0; x < width; ++x)
+            row[x] = data[((std::size_t)y * width + x) * channels];
+        out.write(reinterpret_cast<const char*>(row.data()), width * sizeof(float));
+    }
+    return (bool)out;
+}
+
+std::optional<std::vector<float>> loadPFM(const std::string& filename, int& width, int& height) {
+    std::ifstream in{filename, std::ios::binary};
+    std::string magic;
+    float scale = 0;
+    if (!(in >> magic >> width >> height >> scale) || (magic != "Pf" && magic != "PF") || width <= 0 || height <= 0)
+        return {};
+    in.get();
+
+    const int channels = magic == "PF" ? 3 : 1;
+    std::vector<float> row((std::size_t)width * channels);
+    std::vector<float> rgba((std::size_t)width * height * 4, 0.0f);
+    for (int y = height - 1; y >= 0; --y) {
+        if (!in.read(reinterpret_cast<char*>(row.data()), row.size() * sizeof(float)))
+            return {};
+        for (int x = 0; x < width; ++x) {
+            float v = row[(std::size_t)x * channels];
+            if (scale > 0) {
+                // big endian file
+                char* b = reinterpret_cast<char*>(&v);
+                std::reverse(b, b + sizeof(float));
+            }
+            rgba[4 * ((std::size_t)y * width + x)] = v;
+        }
+    }
+    return rgba;
+}
+
+bool ErosionSweep::prepare(std::string& error) {
+    const auto defaults = engine_parameters(spec.engine);
+    if (!defaults) {
+        error = "unknown engine " + spec.engine;
+        return false;
+    }
+    for (const auto& axis : spec.axes) {
+        if (!has_parameter(*defaults, axis.name)) {
+            error = spec.engine + " has no parameter " + axis.name;
+            return false;
+        }
+    }
+
+    if (!spec.terrain.empty()) {
+        auto terrain = loadPFM(spec.terrain, width, height);
+        if (!terrain) {
+            error = "could not read terrain " + spec.terrain;
+            return false;
+        }
+        input = std::move(*terrain);
+    } else {
+        width = height = spec.size;
+        input = make_terrain(width, height);
+    }
+
+    std::error_code ec;
+    std::filesystem::create_directories(spec.output, ec);
+    if (ec) {
+        error = "could not create " + spec.output + ": " + ec.message();
+        return false;
+    }
+    return true;
+}
+
+std::vector<SweepRun> ErosionSweep::run(const std::function<void(const SweepRun&)>& done) {
+    const auto configs = planSweep(spec);
+    std::vector<SweepRun> runs(configs.size());
+    for (std::size_t i = 0; i < runs.size(); ++i) {
+        runs[i].index = (int)i;
+        runs[i].config = configs[i];
+    }
+
+    const int jobs = std::clamp(spec.jobs > 0 ? spec.jobs : (int)std::thread::hardware_concurrency(), 1, std::max(1, (int)runs.size()));
+    std::atomic_int next{0};
+    std::mutex done_mutex;
+    auto worker = [&]() {
+        for (int i = next++; i < (int)runs.size(); i = next++) {
+            run_one(runs[i]);
+            if (done) {
+                std::lock_guard lock{done_mutex};
+                done(runs[i]);
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int j = 1; j < jobs; ++j)
+        threads.emplace_back(worker);
+    worker();
+    for (auto& t : threads)
+        t.join();
+    return runs;
+}
+
+void ErosionSweep::run_one(SweepRun& run) const {
+    auto parameters = *engine_parameters(spec.engine);
+    for (const auto& [name, value] : run.config) {
+        if (!parameters.setParam(name, value)) {
+            run.error = name + " = " + std::to_string(value) + " is out of range";
+            return;
+        }
+    }
+
+    // each run is single threaded, the sweep runs several at once
+    util::ThreadPool serial{0};
+    std::vector<float> rgba = input;
+    float elevation_scale = 1;
+    float cell_size = 1;
+
+    const auto start = std::chrono::steady_clock::now();
+    if (spec.engine == "erosion2") {
+        Erosion2Parameters params;
+        params.fromParameterSet(parameters);
+        Erosion2ModelCPU model{params};
+        model.setThreadPool(serial);
+        model.init(width, height, rgba.data());
+        auto finished = [&]() {
+            return params.isAdaptive() ? model.getSimulatedTime() >= params.simulated_time : model.getIteration() >= params.iterations;
+        };
+        while (!finished())
+            model.step();
+        model.copyTo(rgba.data());
+        elevation_scale = params.terrain_elevation_scale;
+        cell_size = params.cell_size;
+    } else {
+        ETESModelParameters params;
+        params.fromParameterSet(parameters);
+        ETESEcosystemParameters ecosystem;
+        ecosystem.fromParameterSet(parameters);
+        ETESModelCPU model{params, (uint32_t)params.seed, ecosystem};
+        model.setThreadPool(serial);
+        model.init(width, height, rgba.data());
+        for (int i = 0; i < params.iterations; ++i)
+            model.step();
+        model.copyTo(rgba.data());
+        elevation_scale = params.terrain_elevation_scale;
+        cell_size = params.cell_size;
+    }
+    run.metrics.runtime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // the red channel holds the ground elevation of both engines
+    const std::size_t cells = (std::size_t)width * height;
+    std::vector<float> ground(cells);
+    for (std::size_t i = 0; i < cells; ++i) {
+        ground[i] = rgba[4 * i] * elevation_scale;
+        const double change = ((double)rgba[4 * i] - input[4 * i]) * elevation_scale * cell_size * cell_size;
+        if (change < 0)
+            run.metrics.eroded_volume -= change;
+        else
+            run.metrics.deposited_volume += change;
+    }
+    run.metrics.drainage_density = drainageDensity(width, height, ground.data(), cell_size, spec.channel_threshold);
+
+    std::ostringstream name;
+    name << "run_" << std::setw(4) << std::setfill('0') << run.index << ".pfm";
+    run.heightmap = name.str();
+    if (!savePFM((std::filesystem::path{spec.output} / run.heightmap).string(), width, height, rgba.data(), 4)) {
+        run.error = "could not write " + run.heightmap;
+        return;
+    }
+    run.ok = true;
+}
+
+bool ErosionSweep::writeManifest(const std::vector<SweepRun>& runs) const {
+    const std::filesystem::path dir{spec.output};
+
+    std::ofstream csv{dir / "manifest.csv", std::ios::trunc};
+    csv << "run,status,heightmap,runtime_s,eroded_volume_m3,deposited_volume_m3,drainage_density_per_m";
+    for (const auto& axis : spec.axes)
+        csv << "," << csv_escape(axis.name);
+    csv << "\n" << std::setprecision(9);
+    for (const auto& run : runs) {
+        csv << run.index << "," << csv_escape(run.ok ? "ok" : run.error) << "," << run.heightmap << ","
+            << run.metrics.runtime << "," << run.metrics.eroded_volume << "," << run.metrics.deposited_volume << ","
+            << run.metrics.drainage_density;
+        for (const auto& [name, value] : run.config)
+            csv << "," << value;
+        csv << "\n";
+    }
+
+    json manifest;
+    manifest["engine"] = spec.engine;
+    manifest["width"] = width;
+    manifest["height"] = height;
+    manifest["terrain"] = spec.terrain;
+    manifest["channel_threshold"] = spec.channel_threshold;
+    manifest["runs"] = json::array();
+    for (const auto& run : runs) {
+        json r;
+        r["run"] = run.index;
+        r["ok"] = run.ok;
+        if (!run.ok)
+            r["error"] = run.error;
+        r["heightmap"] = run.heightmap;
+        json params = json::object();
+        for (const auto& [name, value] : run.config)
+            params[name] = value;
+        r["parameters"] = params;
+        r["runtime_s"] = run.metrics.runtime;
+        r["eroded_volume_m3"] = run.metrics.eroded_volume;
+        r["deposited_volume_m3"] = run.metrics.deposited_volume;
+        r["drainage_density_per_m"] = run.metrics.drainage_density;
+        manifest["runs"].push_back(r);
+    }
+    std::ofstream out{dir / "manifest.json", std::ios::trunc};
+    out << manifest.dump(2) << "\n";
+    return (bool)csv && (bool)out;
+}
+
+}
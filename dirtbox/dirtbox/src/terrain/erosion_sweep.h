@@ -0,0 +1,187 @@
+/**
+ * @author Hunter Borlik
+ * @brief headless parameter sweeps over the CPU erosion engines
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ */
+#pragma once
+#ifndef DIRTBOX_EROSION_SWEEP_H
+#define DIRTBOX_EROSION_SWEEP_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <optional>
+#include <functional>
+#include <cstdint>
+
+namespace dirtbox::terrain {
+
+/**
+ * @brief values of one parameter in a sweep
+ *
+ */
+struct SweepAxis {
+    std::string name;
+    // grid: every value. random: values to pick from, the range [min, max) when empty
+    std::vector<float> values;
+    float min = 0;
+    float max = 0;
+};
+
+/**
+ * @brief A parameter sweep, read from JSON:
+ *
+ *  {
+ *      "engine": "erosion2",           erosion2 or etes
+ *      "mode": "grid",                 grid: every combination of the axes, random: samples draws
+ *      "samples": 16,
+ *      "seed": 0,                      random draws, the same seed gives the same configurations
+ *      "jobs": 0,                      runs in parallel, 0 for one per core
+ *      "size": 256,                    generated terrain size, when no terrain is given
+ *      "terrain": "input.pfm",
+ *      "output": "sweep",              directory of the heightmaps and the manifest
+ *      "channel_threshold": 100,       upstream cells of a drainage channel
+ *      "parameters": {
+ *          "rainfall": [0.005, 0.01, 0.02],
+ *          "water_sediment_capacity": {"min": 0.5, "max": 2.5, "steps": 5}
+ *      }
+ *  }
+ *
+ * Parameters are the names of the engine's ParameterCollection. Unlisted parameters keep their
+ * defaults. In random mode a {"min", "max"} axis is sampled uniformly and steps is ignored.
+ *
+ */
+struct SweepSpec {
+    enum class Mode {Grid, Random};
+
+    std::string engine = "erosion2";
+    Mode mode = Mode::Grid;
+    int samples = 16;
+    uint32_t seed = 0;
+    int jobs = 0;
+    int size = 256;
+    std::string terrain;
+    std::string output = "sweep";
+    int channel_threshold = 100;
+    std::vector<SweepAxis> axes;
+
+    /**
+     * @brief parse a sweep
+     *
+     * @param text JSON
+     * @param error reason when parsing fails
+     * @return std::optional<SweepSpec>
+     */
+    static std::optional<SweepSpec> fromJson(const std::string& text, std::string& error);
+};
+
+using SweepConfig = std::vector<std::pair<std::string, float>>;
+
+/**
+ * @brief parameter values of every run of spec, in run order
+ *
+ * @param spec
+ * @return std::vector<SweepConfig>
+ */
+std::vector<SweepConfig> planSweep(const SweepSpec& spec);
+
+struct SweepMetrics {
+    // ground removed and added, m^3
+    double eroded_volume = 0;
+    double deposited_volume = 0;
+    // length of the drainage channels per area, 1/m
+    double drainage_density = 0;
+    // wall clock seconds of the simulation
+    double runtime = 0;
+};
+
+struct SweepRun {
+    int index = 0;
+    SweepConfig config;
+    bool ok = false;
+    std::string error;
+    std::string heightmap;
+    SweepMetrics metrics;
+};
+
+/**
+ * @brief D8 drainage density of a heightmap. Every cell drains to its steepest lower neighbor;
+ * cells with at least threshold cells upstream, themselves included, are channels.
+ *
+ * @param width
+ * @param height
+ * @param elevation meters, width * height
+ * @param cell_size meters
+ * @param threshold
+ * @return double channel length per area, 1/m
+ */
+double drainageDensity(int width, int height, const float* elevation, float cell_size, int threshold);
+
+/**
+ * @brief write a single channel portable float map
+ *
+ * @param filename
+ * @param width
+ * @param height
+ * @param data top row first, channels values per cell, only the first is written
+ * @param channels
+ * @return true on success
+ */
+bool savePFM(const std::string& filename, int width, int height, const float* data, int channels = 1);
+
+/**
+ * @brief read a portable float map into the red channel of terrain RGBA32F data
+ *
+ * @param filename
+ * @param width
+ * @param height
+ * @return std::optional<std::vector<float>> width * height * 4 floats, top row first
+ */
+std::optional<std::vector<float>> loadPFM(const std::string& filename, int& width, int& height);
+
+/**
+ * @brief Runs every configuration of a sweep on a CPU erosion engine. Runs are spread over
+ * spec.jobs threads, each run is single threaded, so results do not depend on the job count.
+ *
+ */
+class ErosionSweep {
+public:
+    explicit ErosionSweep(SweepSpec spec) : spec{std::move(spec)} {}
+
+    /**
+     * @brief load or generate the input terrain and check the engine and parameter names
+     *
+     * @param error reason when the sweep cannot run
+     * @return false when the sweep cannot run
+     */
+    bool prepare(std::string& error);
+
+    /**
+     * @brief run every configuration and write its heightmap to the output directory
+     *
+     * @param done called after each run, from the job threads one at a time
+     * @return std::vector<SweepRun> in run order
+     */
+    std::vector<SweepRun> run(const std::function<void(const SweepRun&)>& done = {});
+
+    /**
+     * @brief write manifest.csv and manifest.json to the output directory
+     *
+     * @param runs
+     * @return true on success
+     */
+    bool writeManifest(const std::vector<SweepRun>& runs) const;
+
+private:
+    void run_one(SweepRun& run) const;
+
+    SweepSpec spec;
+    int width = 0, height = 0;
+    std::vector<float> input;
+};
+
+}
+
+#endif // DIRTBOX_EROSION_SWEEP_H
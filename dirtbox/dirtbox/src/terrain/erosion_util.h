@@ -10,12 +10,16 @@
  */
 #pragma once
 #ifndef DIRTBOX_EROSION_UTIL
+#define DIRTBOX_EROSION_UTIL
 
+#include <array>
+#include <cmath>
 #include <vector>
 #include <algorithm>
 #include <memory>
 
 #include <util/vec.h>
+#include <util/counter_rng.h>
 
 namespace dirtbox::terrain {
 
@@ -92,17 +96,19 @@ inline float logistic_between(float x, float min, float max, float mul = 1.0f) {
 }
 
 /**
- * @brief random pick index of weights with proportional probability
- * 
- * @param weights 
- * @return int 
+ * @brief pick an index of weights with proportional probability
+ *
+ * @param weights non negative weights
+ * @param u uniform random number in [0, 1)
+ * @return int -1 if all weights are zero
  */
-inline int random_weighted_pick(const std::vector<float>& weights) {
+template<std::size_t N>
+int weighted_pick(const std::array<float, N>& weights, float u) {
     float total = .0f;
     for (auto w : weights)
         total += w;
-    float r = total * ((float)random() / RAND_MAX);
-    for (int i = 0; i < weights.size(); ++i) {
+    float r = total * u;
+    for (int i = 0; i < (int)N; ++i) {
         if (r < weights[i])
             return i;
         r -= weights[i];
@@ -110,6 +116,19 @@ inline int random_weighted_pick(const std::vector<float>& weights) {
     return -1;
 }
 
+/**
+ * @brief random pick index of weights with proportional probability. Each call draws exactly one
+ * value from rng
+ *
+ * @param weights non negative weights
+ * @param rng per thread or per event generator
+ * @return int -1 if all weights are zero
+ */
+template<std::size_t N>
+int random_weighted_pick(const std::array<float, N>& weights, util::CounterRNG& rng) {
+    return weighted_pick(weights, rng.uniform());
+}
+
 
 // requires T to define float Sz for elevation
 template<typename T>
@@ -190,23 +209,6 @@ struct ModelSubstate {
         n.north_west() =    safeGet(x - 1, y - 1);
         return n;
     }
-
-    void copyElevation(std::shared_ptr<Terrain> terr) {
-        for(int j = 0; j < height; ++j)
-            for(int i = 0; i < width; ++i) {
-                float elevation = elevationMax * terr->at(i, j) / (float)std::numeric_limits<uint16_t>::max();
-                at(i, j).Sz = elevation;
-            }
-    }
-
-    void copyElevationTo(std::shared_ptr<Terrain> terr) {
-        for(int j = 0; j < height; ++j)
-            for(int i = 0; i < width; ++i) {
-                auto& t = at(i, j);
-                // t.Sd - t.SE
-                terr->at(i, j) = std::clamp(t.Sz / elevationMax * (float)std::numeric_limits<uint16_t>::max(), 0.0f, (float)std::numeric_limits<uint16_t>::max());
-            }
-    }
 };
 
 template<typename T>
@@ -3,12 +3,16 @@
 #include <cmath>
 #include <algorithm>
 #include <iostream>
+#include <chrono>
 
 #include <bgfx/bgfx.h>
 #include <bimg/bimg.h>
 
 #include <resource/image.h>
 #include <graphics/texture.h>
+#include <terrain/terrain.h>
+#include <terrain/halo_tiles.h>
+#include <core/core.h>
 #include <util/box_utils.h>
 
 using namespace util;
@@ -74,29 +78,75 @@ struct ETESGPUUniforms {
 
 class ETESGPUImpl {
 public:
-    // bgfx::Encoder* m_encoder;
+    // cells per side of the work groups of cs_etes_init
+    static constexpr int GroupSize = 16;
+    // invocations per work group of the event passes, EVENT_GROUP in cs_etes_common.sh
+    static constexpr uint32_t EventGroup = 256;
+    // dispatches per event cycle: cs_etes_init, then one step per runoff step. The step count is
+    // even, so every cycle starts with the same A_B
+    static constexpr int CycleIterations = 25;
+    // cells around a tile interior in tiled mode. Events move one cell and look one cell ahead
+    // per step and start over every cycle, so nothing outside the halo reaches the interior
+    static constexpr int Halo = 32;
+    // bytes a step moves per live event: its data read and written by cs_etes_erosion and copied
+    // by cs_etes_scatter, its info written once and read by the scan and scatter passes, and the
+    // elevation and ground of its cell
+    static constexpr int StateBytesPerEvent = 4 * 16 + 4 * 16 + 2 * 16;
+
     bool A_B = true;
 
     bgfx::ProgramHandle etes_erosion_program;
     bgfx::ProgramHandle etes_erosion_init;
+    bgfx::ProgramHandle scan_blocks_program;
+    bgfx::ProgramHandle scan_sums_program;
+    bgfx::ProgramHandle scan_finish_program;
+    bgfx::ProgramHandle scatter_program;
+    bgfx::ProgramHandle args_program;
 
     bgfx::VertexLayout computeVertexLayoutEvent;
 
-    bgfx::DynamicVertexBufferHandle computeEventBufferA {bgfx::kInvalidHandle};
-    bgfx::DynamicVertexBufferHandle computeEventBufferB {bgfx::kInvalidHandle};
+    // live events, compact and grouped by cell. A holds the events of the even steps
+    bgfx::DynamicVertexBufferHandle event_data_a    {bgfx::kInvalidHandle};
+    bgfx::DynamicVertexBufferHandle event_data_b    {bgfx::kInvalidHandle};
+    bgfx::DynamicVertexBufferHandle event_info      {bgfx::kInvalidHandle};
+    // cells with live events and the range of their events
+    bgfx::DynamicVertexBufferHandle active_cells    {bgfx::kInvalidHandle};
+    // per cell, events moving in during a step and the slot of its first event after the scan.
+    // The scan clears the counts it reads, so they stay 0 between steps
+    bgfx::DynamicIndexBufferHandle cell_count       {bgfx::kInvalidHandle};
+    bgfx::DynamicIndexBufferHandle cell_offset      {bgfx::kInvalidHandle};
+    bgfx::DynamicIndexBufferHandle scan_sums        {bgfx::kInvalidHandle};
+    bgfx::DynamicIndexBufferHandle event_counters   {bgfx::kInvalidHandle};
+    // 0: one invocation per active cell, 1: one per live event
+    bgfx::IndirectBufferHandle event_dispatch       {bgfx::kInvalidHandle};
 
     bgfx::TextureHandle elevation_data  {bgfx::kInvalidHandle};
     bgfx::TextureHandle ground_data     {bgfx::kInvalidHandle};
-    bgfx::TextureHandle cell_data_a     {bgfx::kInvalidHandle};
-    bgfx::TextureHandle cell_data_b     {bgfx::kInvalidHandle};
     bgfx::TextureHandle rand_data       {bgfx::kInvalidHandle};
-    bgfx::TextureHandle computeListBufferA  {bgfx::kInvalidHandle};
-    bgfx::TextureHandle computeListBufferB  {bgfx::kInvalidHandle};
+    // events stepped in the current cycle and live events, read back for the stats
+    bgfx::TextureHandle event_stats     {bgfx::kInvalidHandle};
 
     ETESGPUUniforms uniforms;
 
-    resource::ImageDataRef data;
-    int w, h;
+    // size of the GPU resources, the whole terrain or one tile window
+    int w = 0, h = 0;
+
+    // frame the pending event_stats read completes in, 0 when there is none
+    uint32_t event_stats_frame = 0;
+    uint32_t event_stats_data[2] = {};
+    // events stepped in the last cycle read back, before the first read every event of a cycle
+    uint64_t cycle_events = 0;
+
+    // run state on the CPU. elevation is bedrock, rock, sand, humus and ground is moisture and
+    // 3 unused channels, both 4 floats per terrain cell. next receives the tile interiors of
+    // the current cycle
+    int terrain_w = 0, terrain_h = 0;
+    std::vector<float> elevation, ground;
+    std::vector<float> next_elevation, next_ground;
+    // read back of the window of the current tile
+    std::vector<float> window_elevation, window_ground;
+    std::vector<HaloTile> tiles;
+    std::size_t current_tile = 0;
 
     ETESGPUImpl() {
         computeVertexLayoutEvent.begin()
@@ -105,166 +155,301 @@ public:
     }
 
     ~ETESGPUImpl() {
-        bgfx::destroy(etes_erosion_program);
-        bgfx::destroy(elevation_data);
-        bgfx::destroy(ground_data);
-        bgfx::destroy(cell_data_a);
-        bgfx::destroy(cell_data_b);
-        bgfx::destroy(rand_data);
-        bgfx::destroy(computeEventBufferA);
-        bgfx::destroy(computeEventBufferB);
-        bgfx::destroy(computeListBufferA);
-        bgfx::destroy(computeListBufferB);
-    }
-
-    void begin() {
-        //m_encoder = bgfx::begin(true);
+        for (auto p : {etes_erosion_program, etes_erosion_init, scan_blocks_program, scan_sums_program, scan_finish_program, scatter_program, args_program})
+            bgfx::destroy(p);
+        destroyResources();
     }
 
-    void end() {
-        //bgfx::end(m_encoder);
-        //m_encoder = nullptr;
+    void destroyResources() {
+        for (auto* t : {&elevation_data, &ground_data, &rand_data, &event_stats}) {
+            if (bgfx::isValid(*t))
+                bgfx::destroy(*t);
+            *t = BGFX_INVALID_HANDLE;
+        }
+        for (auto* b : {&event_data_a, &event_data_b, &event_info, &active_cells}) {
+            if (bgfx::isValid(*b))
+                bgfx::destroy(*b);
+            *b = BGFX_INVALID_HANDLE;
+        }
+        for (auto* b : {&cell_count, &cell_offset, &scan_sums, &event_counters}) {
+            if (bgfx::isValid(*b))
+                bgfx::destroy(*b);
+            *b = BGFX_INVALID_HANDLE;
+        }
+        if (bgfx::isValid(event_dispatch))
+            bgfx::destroy(event_dispatch);
+        event_dispatch = BGFX_INVALID_HANDLE;
     }
 
     void loadPrograms() {
         etes_erosion_program = bgfx::createProgram(loadShader("cs_etes_erosion"), true);
         etes_erosion_init = bgfx::createProgram(loadShader("cs_etes_init"), true);
+        scan_blocks_program = bgfx::createProgram(loadShader("cs_etes_scan_blocks"), true);
+        scan_sums_program = bgfx::createProgram(loadShader("cs_etes_scan_sums"), true);
+        scan_finish_program = bgfx::createProgram(loadShader("cs_etes_scan_finish"), true);
+        scatter_program = bgfx::createProgram(loadShader("cs_etes_scatter"), true);
+        args_program = bgfx::createProgram(loadShader("cs_etes_args"), true);
     }
 
-    void updateTextures() {
-        bgfx::updateTexture2D(elevation_data,
-            0, 0, 0, 0,
-            (uint16_t)data->getWidth(),
-            (uint16_t)data->getHeight(),
-            bgfx::makeRef(data->get()->m_data, data->getSize()));
-        // bgfx::updateTexture2D(ground_data,
-        //     0, 0, 0, 0,
-        //     (uint16_t)data->getWidth(),
-        //     (uint16_t)data->getHeight(),
-        //     bgfx::makeRef(data->get()->m_data, data->getSize()));
+    /**
+     * @brief largest side of the GPU resources, the device texture limit
+     * 
+     * @return int 
+     */
+    static int maxSize() {
+        return (int)bgfx::getCaps()->limits.maxTextureSize;
+    }
+
+    /**
+     * @brief create the textures and buffers for a width x height grid, keeps them when the
+     * size has not changed
+     * 
+     * @param width 
+     * @param height 
+     */
+    void resize(int width, int height) {
+        if (width == w && height == h && bgfx::isValid(elevation_data))
+            return;
+        destroyResources();
+        w = width;
+        h = height;
+        loadTextures();
+        loadBuffers();
     }
 
     void loadTextures() {
-        if (!bgfx::isValid(elevation_data)) {
-            elevation_data = bgfx::createTexture2D(512, 512, false, 1, bgfx::TextureFormat::RGBA32F, BGFX_TEXTURE_READ_BACK | BGFX_TEXTURE_COMPUTE_WRITE);
-                // bgfx::makeRef(data->get()->m_data, data->getSize())};
+        elevation_data = bgfx::createTexture2D(w, h, false, 1, bgfx::TextureFormat::RGBA32F, BGFX_TEXTURE_READ_BACK | BGFX_TEXTURE_COMPUTE_WRITE);
+        ground_data = bgfx::createTexture2D(w, h, false, 1, bgfx::TextureFormat::RGBA32F, BGFX_TEXTURE_READ_BACK | BGFX_TEXTURE_COMPUTE_WRITE);
+        event_stats = bgfx::createTexture2D(2, 1, false, 1, bgfx::TextureFormat::R32U, BGFX_TEXTURE_READ_BACK | BGFX_TEXTURE_COMPUTE_WRITE);
+
+        std::vector<float> randdat;
+        randdat.resize((std::size_t)w * h);
+        for (auto& d : randdat) {
+            d = rand() / (float)RAND_MAX;
         }
+        rand_data = bgfx::createTexture2D(w, h, false, 1, bgfx::TextureFormat::R32F, 0, bgfx::copy(randdat.data(), randdat.size() * sizeof(float)));
+    }
 
-        if (!bgfx::isValid(ground_data)) {
-            ground_data = bgfx::createTexture2D(512, 512, false, 1, bgfx::TextureFormat::RGBA32F, BGFX_TEXTURE_READ_BACK | BGFX_TEXTURE_COMPUTE_WRITE);
-                // bgfx::makeRef(data->get()->m_data, data->getSize())};
-        }
+    // a cycle starts with one event per cell and events never split, so no buffer needs more
+    void loadBuffers() {
+        const uint32_t cells = (uint32_t)w * h;
+        const uint32_t groups = (cells + EventGroup - 1) / EventGroup;
+        const std::vector<uint32_t> zeros(cells, 0);
+        const uint16_t flags = BGFX_BUFFER_COMPUTE_READ_WRITE | BGFX_BUFFER_INDEX32;
+
+        event_data_a = bgfx::createDynamicVertexBuffer(cells, computeVertexLayoutEvent, BGFX_BUFFER_COMPUTE_READ_WRITE);
+        event_data_b = bgfx::createDynamicVertexBuffer(cells, computeVertexLayoutEvent, BGFX_BUFFER_COMPUTE_READ_WRITE);
+        event_info = bgfx::createDynamicVertexBuffer(cells, computeVertexLayoutEvent, BGFX_BUFFER_COMPUTE_READ_WRITE);
+        active_cells = bgfx::createDynamicVertexBuffer(cells, computeVertexLayoutEvent, BGFX_BUFFER_COMPUTE_READ_WRITE);
+        cell_count = bgfx::createDynamicIndexBuffer(bgfx::copy(zeros.data(), cells * sizeof(uint32_t)), flags);
+        cell_offset = bgfx::createDynamicIndexBuffer(cells, flags);
+        // a uvec2 per work group
+        scan_sums = bgfx::createDynamicIndexBuffer(2 * groups, flags);
+        event_counters = bgfx::createDynamicIndexBuffer(bgfx::copy(zeros.data(), 5 * sizeof(uint32_t)), flags);
+        event_dispatch = bgfx::createIndirectBuffer(2);
+        event_stats_frame = 0;
+        cycle_events = (uint64_t)cells * (CycleIterations - 1);
+    }
 
-        if (!bgfx::isValid(cell_data_a)) {
-            cell_data_a = bgfx::createTexture2D(512, 512, false, 1, bgfx::TextureFormat::RGBA32U, BGFX_TEXTURE_COMPUTE_WRITE);
-        }
+    /**
+     * @brief set up a run on terrain. Tiles the terrain when it does not fit in max_size
+     * 
+     * @param terrain RGBA32F terrain data, elevation in the red channel
+     * @param terrain_elevation_scale 
+     * @param max_size largest window side, clamped to the device limit
+     */
+    void begin(const resource::ImageData& terrain, float terrain_elevation_scale, int max_size) {
+        terrain_w = terrain.getWidth();
+        terrain_h = terrain.getHeight();
+        const std::size_t cells = (std::size_t)terrain_w * terrain_h;
+        const float* rgba = static_cast<const float*>(terrain.get()->m_data);
+
+        // the terrain elevation starts as bedrock, as in ETESModelCPU::init
+        elevation.assign(cells * 4, 0.0f);
+        ground.assign(cells * 4, 0.0f);
+        for (std::size_t i = 0; i < cells; ++i)
+            elevation[4 * i] = rgba[4 * i] * terrain_elevation_scale;
+        next_elevation = elevation;
+        next_ground = ground;
+
+        max_size = std::clamp(max_size, 2 * Halo + GroupSize, maxSize());
+        tiles = planHaloTiles(terrain_w, terrain_h, max_size, Halo);
+        current_tile = 0;
+        const auto [ww, wh] = haloWindowSize(terrain_w, terrain_h, max_size);
+        resize(ww, wh);
+        window_elevation.resize((std::size_t)w * h * 4);
+        window_ground.resize((std::size_t)w * h * 4);
+        A_B = true;
+    }
 
-        if (!bgfx::isValid(cell_data_b)) {
-            cell_data_b = bgfx::createTexture2D(512, 512, false, 1, bgfx::TextureFormat::RGBA32U, BGFX_TEXTURE_COMPUTE_WRITE);
-        }
+    // the terrain fits in one window, the state stays on the GPU between cycles
+    bool isResident() const {return tiles.size() == 1;}
 
-        if (!bgfx::isValid(rand_data)) {
-            std::vector<float> randdat;
-            randdat.resize(512*512);
-            for (auto& d : randdat) {
-                d = rand() / (float)RAND_MAX;
-            }
-            rand_data = bgfx::createTexture2D(512, 512, false, 1, bgfx::TextureFormat::R32F, 0, bgfx::copy(randdat.data(), randdat.size() * sizeof(float)));
+    // copy the window of the current tile from the state to the GPU
+    void uploadWindow() {
+        const HaloTile& t = tiles[current_tile];
+        for (int y = 0; y < h; ++y) {
+            const std::size_t src = 4 * ((std::size_t)(t.wy + y) * terrain_w + t.wx);
+            std::copy_n(elevation.data() + src, 4 * w, window_elevation.data() + 4 * (std::size_t)y * w);
+            std::copy_n(ground.data() + src, 4 * w, window_ground.data() + 4 * (std::size_t)y * w);
         }
+        bgfx::updateTexture2D(elevation_data, 0, 0, 0, 0, w, h, bgfx::copy(window_elevation.data(), window_elevation.size() * sizeof(float)));
+        bgfx::updateTexture2D(ground_data, 0, 0, 0, 0, w, h, bgfx::copy(window_ground.data(), window_ground.size() * sizeof(float)));
+    }
 
-        if (!bgfx::isValid(computeListBufferA)) {
-            computeListBufferA = bgfx::createTexture2D(512, 512, false, 1, bgfx::TextureFormat::R32U, BGFX_TEXTURE_COMPUTE_WRITE);
-        }
+    /**
+     * @brief queue a read of the window of the current tile
+     * 
+     * @return uint32_t frame number when the data is available
+     */
+    uint32_t readWindow() {
+        return std::max(bgfx::readTexture(elevation_data, window_elevation.data()), bgfx::readTexture(ground_data, window_ground.data()));
+    }
 
-        if (!bgfx::isValid(computeListBufferB)) {
-            computeListBufferB = bgfx::createTexture2D(512, 512, false, 1, bgfx::TextureFormat::R32U, BGFX_TEXTURE_COMPUTE_WRITE);
+    // copy the interior of the current tile from the read back window to next
+    void storeInterior() {
+        const HaloTile& t = tiles[current_tile];
+        const int n = t.x1 - t.x0;
+        for (int y = t.y0; y < t.y1; ++y) {
+            const std::size_t src = 4 * ((std::size_t)(y - t.wy) * w + (t.x0 - t.wx));
+            const std::size_t dst = 4 * ((std::size_t)y * terrain_w + t.x0);
+            std::copy_n(window_elevation.data() + src, 4 * n, next_elevation.data() + dst);
+            std::copy_n(window_ground.data() + src, 4 * n, next_ground.data() + dst);
         }
     }
 
-    void loadBuffers() {
-        if (!bgfx::isValid(computeEventBufferA)) {
-            computeEventBufferA = bgfx::createDynamicVertexBuffer(512*512, computeVertexLayoutEvent, BGFX_BUFFER_COMPUTE_READ_WRITE);
-        }
-        if (!bgfx::isValid(computeEventBufferB)) {
-            computeEventBufferB = bgfx::createDynamicVertexBuffer(512*512, computeVertexLayoutEvent, BGFX_BUFFER_COMPUTE_READ_WRITE);
-        }
+    // every tile has run the cycle
+    void finishCycle() {
+        elevation.swap(next_elevation);
+        ground.swap(next_ground);
     }
 
-    void downloadTextures() {
-        if (bgfx::isValid(elevation_data)) {
-            bgfx::readTexture(elevation_data, data->get()->m_data);
-            //void* d = bgfx::getDirectAccessPtr(data_b.getHandle());
-        }
+    /**
+     * @brief write the total elevation to the red channel of terrain, as ETESModelCPU::copyTo
+     * 
+     * @param terrain same size as the terrain passed to begin
+     * @param terrain_elevation_scale 
+     */
+    void copyTo(resource::ImageData& terrain, float terrain_elevation_scale) const {
+        float* rgba = static_cast<float*>(terrain.get()->m_data);
+        for (std::size_t i = 0; i < (std::size_t)terrain_w * terrain_h; ++i)
+            rgba[4 * i] = (elevation[4 * i] + elevation[4 * i + 1] + elevation[4 * i + 2] + elevation[4 * i + 3]) / terrain_elevation_scale;
+    }
+
+    // event data of the current step
+    bgfx::DynamicVertexBufferHandle currentEvents() const {return A_B ? event_data_a : event_data_b;}
+
+    // start a new event cycle: one event with rainfall in every cell
+    void submitInit() {
+        bgfx::setImage(0, elevation_data, 0,     bgfx::Access::Read, bgfx::TextureFormat::RGBA32F);
+        bgfx::setBuffer(2, active_cells,        bgfx::Access::Write);
+        bgfx::setBuffer(3, event_counters,      bgfx::Access::ReadWrite);
+        bgfx::setBuffer(7, currentEvents(),     bgfx::Access::Write);
+        bgfx::setBuffer(11, event_dispatch,     bgfx::Access::ReadWrite);
+        uniforms.submit();
+        bgfx::dispatch(Erosion::ComputeView, etes_erosion_init, (w + GroupSize - 1) / GroupSize, (h + GroupSize - 1) / GroupSize);
+    }
+
+    /**
+     * @brief move every live event one cell. The events of each active cell run, then the events
+     * moving on are counted per cell, scanned and scattered into the other event buffer. The
+     * passes are dispatched indirectly, sized by the previous step
+     * 
+     */
+    void submitStep() {
+        const auto next = A_B ? event_data_b : event_data_a;
+
+        bgfx::setImage(0, elevation_data, 0,     bgfx::Access::ReadWrite, bgfx::TextureFormat::RGBA32F);
+        bgfx::setImage(1, ground_data, 0,        bgfx::Access::ReadWrite, bgfx::TextureFormat::RGBA32F);
+        bgfx::setImage(4, rand_data, 0,          bgfx::Access::Read, bgfx::TextureFormat::R32F);
+        bgfx::setBuffer(2, active_cells,        bgfx::Access::Read);
+        bgfx::setBuffer(3, event_counters,      bgfx::Access::Read);
+        bgfx::setBuffer(5, cell_count,          bgfx::Access::ReadWrite);
+        bgfx::setBuffer(7, currentEvents(),     bgfx::Access::ReadWrite);
+        bgfx::setBuffer(8, event_info,          bgfx::Access::Write);
+        uniforms.rand_offset[0] = rand() / (float)RAND_MAX;
+        uniforms.rand_offset[1] = rand() / (float)RAND_MAX;
+        uniforms.submit();
+        bgfx::dispatch(Erosion::ComputeView, etes_erosion_program, event_dispatch, 0);
+
+        bgfx::setBuffer(3, event_counters,      bgfx::Access::Read);
+        bgfx::setBuffer(5, cell_count,          bgfx::Access::Read);
+        bgfx::setBuffer(8, event_info,          bgfx::Access::ReadWrite);
+        bgfx::setBuffer(10, scan_sums,          bgfx::Access::Write);
+        bgfx::dispatch(Erosion::ComputeView, scan_blocks_program, event_dispatch, 1);
+
+        bgfx::setBuffer(3, event_counters,      bgfx::Access::ReadWrite);
+        bgfx::setBuffer(10, scan_sums,          bgfx::Access::ReadWrite);
+        bgfx::dispatch(Erosion::ComputeView, scan_sums_program, 1, 1);
+
+        bgfx::setBuffer(2, active_cells,        bgfx::Access::Write);
+        bgfx::setBuffer(3, event_counters,      bgfx::Access::Read);
+        bgfx::setBuffer(5, cell_count,          bgfx::Access::ReadWrite);
+        bgfx::setBuffer(6, cell_offset,         bgfx::Access::Write);
+        bgfx::setBuffer(8, event_info,          bgfx::Access::Read);
+        bgfx::setBuffer(10, scan_sums,          bgfx::Access::Read);
+        bgfx::dispatch(Erosion::ComputeView, scan_finish_program, event_dispatch, 1);
+
+        bgfx::setBuffer(3, event_counters,      bgfx::Access::Read);
+        bgfx::setBuffer(6, cell_offset,         bgfx::Access::Read);
+        bgfx::setBuffer(7, currentEvents(),     bgfx::Access::Read);
+        bgfx::setBuffer(8, event_info,          bgfx::Access::Read);
+        bgfx::setBuffer(9, next,                bgfx::Access::Write);
+        bgfx::dispatch(Erosion::ComputeView, scatter_program, event_dispatch, 1);
+
+        bgfx::setBuffer(3, event_counters,      bgfx::Access::ReadWrite);
+        bgfx::setBuffer(11, event_dispatch,     bgfx::Access::ReadWrite);
+        bgfx::setImage(12, event_stats, 0,      bgfx::Access::Write, bgfx::TextureFormat::R32U);
+        bgfx::dispatch(Erosion::ComputeView, args_program, 1, 1);
+
+        A_B = !A_B;
     }
 
-    // void copyTerrain(const std::shared_ptr<graphics::Texture> terr, float s) {
-    //     w = terr->getWidth();
-    //     h = terr->getHeight();
-    //     bimg::ImageContainer* image = bimg::imageAlloc(getAllocator(), bimg::TextureFormat::RGBA32F, w, h, 0, 1, false, false);
-    //     float* dmap = (float*)image->m_data;
-    //     // copy data into local image
-    //     for (int x = 0; x < w; ++x) {
-    //         for (int y = 0; y < h; ++y) {
-    //             float h = s * terr->at(x, y);
-    //             dmap[0 + 4 * (x + w * y)] = h; // red channel is height
-    //             dmap[1 + 4 * (x + w * y)] = 0;
-    //             dmap[2 + 4 * (x + w * y)] = 0;
-    //             dmap[3 + 4 * (x + w * y)] = 0;
-    //         }
-    //     }
-    //     data = std::make_shared<resource::ImageData>(image);
-    // }
-
-    // bool copyTerrainTo(std::shared_ptr<graphics::Texture> terr, float s, const ETESModelParameters& parameters) {
-    //     if (data) {
-    //         float* dmap = (float*)data->get()->m_data;
-    //         for (int x = 0; x < w; ++x) {
-    //             for (int y = 0; y < h; ++y) {
-    //                 float h =   dmap[0 + 4 * (x + w * y)] + 
-    //                             dmap[1 + 4 * (x + w * y)] + 
-    //                             dmap[2 + 4 * (x + w * y)] + 
-    //                             dmap[3 + 4 * (x + w * y)]; // red channel is height
-    //                 h = h / s;
-    //                 terr->at(x, y) = h;
-    //             }
-    //         }
-    //         return true;
-    //     }
-    //     return false;
-    // }
+    /**
+     * @brief collect the events of the last cycle once the last read has arrived and start the
+     * next read
+     * 
+     * @param frame last completed frame
+     */
+    void readEventStats(uint32_t frame) {
+        if (event_stats_frame != 0 && frame >= event_stats_frame) {
+            cycle_events = event_stats_data[0];
+            event_stats_frame = 0;
+        }
+        if (event_stats_frame == 0)
+            event_stats_frame = bgfx::readTexture(event_stats, event_stats_data);
+    }
 };
 
 EcosystemTerrainErosionSimulationGPU::EcosystemTerrainErosionSimulationGPU(std::shared_ptr<Terrain> target)
-    : Erosion{"EcosystemTerrainErosionSimulationGPU", std::move(target)}, m_etesgpu{std::make_unique<ETESGPUImpl>()}
+    : Erosion{"EcosystemTerrainErosionSimulationGPU", std::move(target)}, m_etesgpu{std::make_shared<ETESGPUImpl>()}
 {
     params.toParameterSet(parameters);
+    // largest side of the GPU textures, larger terrains run in tiles. Clamped to the device limit
+    parameters.addParameter("max_tile_size", 128, 16384, 16384);
 
     m_etesgpu->loadPrograms();
     
 }
 
-void EcosystemTerrainErosionSimulationGPU::init() {
+void EcosystemTerrainErosionSimulationGPU::startErosionTask() {
     if (!m_isRunning) {
         params.fromParameterSet(parameters);
         m_etesgpu->uniforms.applyParameter(params);
-
-        m_etesgpu->loadTextures();
-        m_etesgpu->loadBuffers();
-
+        // the run starts in update() once the terrain has been read back
+        m_input = target->getTerrainTexture().getImageData();
+        m_readback_frame = 0;
+        m_resident_pending = false;
         m_itercounter = 0;
+        m_frame_tiles = 0;
+        stats.start();
+        m_isRunning = true;
     }
 }
 
-void EcosystemTerrainErosionSimulationGPU::startErosionTask() {
-    // if (!m_isRunning) {
-    //     m_etesgpu->copyTerrain(terr, 500);
-    //     m_etesgpu->updateTextures();
-    //     m_isRunning = true;
-    // }
-}
-
 float EcosystemTerrainErosionSimulationGPU::getProgress() const {
-    return m_itercounter / (params.iterations * 25.0f);
+    const std::size_t tiles = std::max<std::size_t>(1, m_etesgpu->tiles.size());
+    return std::min(1.0f, (m_itercounter + (float)m_etesgpu->current_tile / tiles) / params.iterations);
 }
 
 bool EcosystemTerrainErosionSimulationGPU::isRunning() const {
@@ -272,69 +457,97 @@ bool EcosystemTerrainErosionSimulationGPU::isRunning() const {
 }
 
 void EcosystemTerrainErosionSimulationGPU::stopErosionTask() {
-    // TODO
+    // the last completed cycle is written to the terrain once the run is read back
+    if (m_isRunning)
+        m_itercounter = std::max<uint32_t>(m_itercounter, params.iterations);
 }
 
 void EcosystemTerrainErosionSimulationGPU::update() {
-    if (m_isRunning) {
-        run_erosion();
+    if (!m_isRunning)
+        return;
+
+    // a frame runs the cycle of one tile
+    const std::size_t tiles = std::max<std::size_t>(1, m_etesgpu->tiles.size());
+    stats.addGPUTime(computeViewMs(), (float)m_frame_tiles / tiles, m_frame_tiles * ETESGPUImpl::CycleIterations);
+    m_frame_tiles = 0;
+
+    if (m_input.valid()) {
+        if (m_input.wait_for(std::chrono::seconds(0)) == std::future_status::timeout)
+            return;
+        m_data.emplace(m_input.get());
+        m_etesgpu->begin(*m_data, params.terrain_elevation_scale, (int)getParam("max_tile_size"));
+    }
+
+    if (m_readback_frame != 0) {
+        if (Core::Get().FrameEvent.last() < m_readback_frame)
+            return;
+        m_readback_frame = 0;
+        read_back();
+    }
+
+    if (m_itercounter >= (uint32_t)params.iterations) {
+        if (m_resident_pending) {
+            // the state is still on the GPU
+            m_resident_pending = false;
+            m_readback_frame = m_etesgpu->readWindow();
+            return;
+        }
+        m_etesgpu->copyTo(*m_data, params.terrain_elevation_scale);
+        target->updateTerrainData(*m_data);
+        m_data.reset();
+        m_isRunning = false;
+        return;
     }
+
+    run_cycle();
 }
 
-void EcosystemTerrainErosionSimulationGPU::read() {
-    m_etesgpu->downloadTextures();
+void EcosystemTerrainErosionSimulationGPU::run_cycle() {
+    const auto start = std::chrono::steady_clock::now();
+
+    // a resident terrain is uploaded for the first cycle only and read back at the end
+    const bool resident = m_etesgpu->isResident();
+    if (!resident || m_itercounter == 0)
+        m_etesgpu->uploadWindow();
+
+    m_etesgpu->submitInit();
+    for (int i = 1; i < ETESGPUImpl::CycleIterations; ++i)
+        m_etesgpu->submitStep();
+
+    m_etesgpu->readEventStats(Core::Get().FrameEvent.last());
+
+    // the interior counts as updated cells, the live events of the whole window as traffic, from
+    // the last cycle read back. Iterations are counted once every tile has run
+    const HaloTile& tile = m_etesgpu->tiles[m_etesgpu->current_tile];
+    const uint64_t cells = (uint64_t)(tile.x1 - tile.x0) * (tile.y1 - tile.y0);
+    const uint64_t bytes = m_etesgpu->cycle_events * ETESGPUImpl::StateBytesPerEvent;
+
+    if (resident) {
+        m_resident_pending = true;
+        m_itercounter++;
+    } else {
+        m_readback_frame = m_etesgpu->readWindow();
+    }
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    stats.addSteps(resident ? 1 : 0, cells, bytes, seconds, getProgress());
+    m_frame_tiles++;
 }
 
-void EcosystemTerrainErosionSimulationGPU::run_erosion() {
-    if (m_isRunning) {
-        if (m_itercounter % 25 == 0) {
-            // reset events
-            if (m_etesgpu->A_B) {
-                bgfx::setImage(2, m_etesgpu->computeListBufferA, 0,    bgfx::Access::Write, bgfx::TextureFormat::R32U);
-            } else {
-                bgfx::setImage(2, m_etesgpu->computeListBufferB, 0,    bgfx::Access::Write, bgfx::TextureFormat::R32U);
-            }
-            //m_etesgpu->begin();
-            bgfx::setImage(0, m_etesgpu->cell_data_a, 0,          bgfx::Access::Write, bgfx::TextureFormat::RGBA32U);
-            bgfx::setBuffer(1, m_etesgpu->computeEventBufferA,   bgfx::Access::ReadWrite);
-            m_etesgpu->uniforms.submit();
-            bgfx::dispatch(3, m_etesgpu->etes_erosion_init, 512, 512);
-        } else {
-            //bgfx::touch(3);
-            bgfx::setImage(0, m_etesgpu->elevation_data, 0,     bgfx::Access::ReadWrite, bgfx::TextureFormat::RGBA32F);
-            bgfx::setImage(1, m_etesgpu->ground_data, 0,        bgfx::Access::ReadWrite, bgfx::TextureFormat::RGBA32F);
-            
-            if (m_etesgpu->A_B) {
-                bgfx::setImage(2, m_etesgpu->cell_data_a, 0,        bgfx::Access::ReadWrite, bgfx::TextureFormat::RGBA32U);
-                bgfx::setImage(3, m_etesgpu->cell_data_b, 0,        bgfx::Access::ReadWrite, bgfx::TextureFormat::RGBA32U);
-            } else {
-                bgfx::setImage(2, m_etesgpu->cell_data_b, 0,        bgfx::Access::ReadWrite, bgfx::TextureFormat::RGBA32U);
-                bgfx::setImage(3, m_etesgpu->cell_data_a, 0,        bgfx::Access::ReadWrite, bgfx::TextureFormat::RGBA32U);
-            }
-            
-            bgfx::setImage(4, m_etesgpu->rand_data, 0,          bgfx::Access::Read, bgfx::TextureFormat::RGBA32F);
-            bgfx::setBuffer(7, m_etesgpu->computeEventBufferA,   bgfx::Access::ReadWrite);
-            bgfx::setBuffer(8, m_etesgpu->computeEventBufferB,  bgfx::Access::ReadWrite);
-            
-            if (m_etesgpu->A_B) {
-                bgfx::setImage(5, m_etesgpu->computeListBufferA, 0,    bgfx::Access::Read, bgfx::TextureFormat::R32I);
-                bgfx::setImage(6, m_etesgpu->computeListBufferB, 0,   bgfx::Access::Write, bgfx::TextureFormat::R32I);
-            } else {
-                bgfx::setImage(5, m_etesgpu->computeListBufferB, 0,   bgfx::Access::Read, bgfx::TextureFormat::R32I);
-                bgfx::setImage(6, m_etesgpu->computeListBufferA, 0,   bgfx::Access::Write, bgfx::TextureFormat::R32I);
-            }
-            m_etesgpu->uniforms.rand_offset[0] = rand() / (float)RAND_MAX;
-            m_etesgpu->uniforms.rand_offset[1] = rand() / (float)RAND_MAX;
-            m_etesgpu->uniforms.submit();
-            bgfx::dispatch(3, m_etesgpu->etes_erosion_program, 512, 512);
-
-            m_etesgpu->A_B = !m_etesgpu->A_B;
-        }
-        
+void EcosystemTerrainErosionSimulationGPU::read_back() {
+    m_etesgpu->storeInterior();
+    if (m_etesgpu->isResident()) {
+        m_etesgpu->finishCycle();
+        return;
+    }
+    if (++m_etesgpu->current_tile == m_etesgpu->tiles.size()) {
+        m_etesgpu->current_tile = 0;
+        m_etesgpu->finishCycle();
         m_itercounter++;
-        if (m_itercounter > params.iterations * 25) {
-            m_isRunning = false;
-        }
+        stats.addSteps(1, 0, 0, 0, getProgress());
+        // show the progress of the tiled run, the terrain is only updated between cycles
+        m_etesgpu->copyTo(*m_data, params.terrain_elevation_scale);
+        target->updateTerrainData(*m_data);
     }
 }
 
@@ -0,0 +1,251 @@
+/**
+ * @author Hunter Borlik
+ * @brief cell data and parameters shared by the GPU and CPU ETES implementations
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ */
+#pragma once
+#ifndef DIRTBOX_ETES_EROSION_PARAMS_H
+#define DIRTBOX_ETES_EROSION_PARAMS_H
+
+#include <cmath>
+#include <algorithm>
+
+#include <util/parameter.h>
+
+namespace dirtbox::terrain {
+
+struct ETESCellData {
+    float R;    // rock
+    float C;    // sand
+    float H;    // humus
+    float Sz;   // bedrock elevation, initialized by ModelSubstate
+
+    // trees canopy cover [0, 1], age in years, height in m
+    float Tc, Ta, Th;
+
+    // shrubs canopy cover [0, 1], age in years, height in m
+    float Sc, Sa, Sh;
+
+    // grass density
+    float Gd; // [0, 1]
+
+    // moisture content
+    float M;
+
+    // average daily sunlight exposure
+    //float I;
+
+    // dead vegitation, and share of runoff erosion held back by vegetation [0, 1]
+    float D, V;
+    float pad[2];
+
+    bool isNanOrInf() const {
+        //float v = R+C+H+Sz+Tc+Ta+Th+Sc+Sa+Sh+Gd+M+I+D+V;
+        float v = R+C+H+Sz+Tc+Ta+Th+Sc+Sa+Sh+Gd+M+D+V;
+        return std::isnan(v) && std::isinf(v);
+    }
+
+    bool isValid() const {
+        return 
+            R >= 0.0f &&
+            C >= 0.0f &&
+            H >= 0.0f &&
+            Sz >= 0.0f &&
+            Tc >= 0.0f &&
+            Ta >= 0.0f &&
+            Th >= 0.0f &&
+            Sc >= 0.0f &&
+            Sa >= 0.0f &&
+            Sh >= 0.0f &&
+            Gd >= 0.0f &&
+            M >= 0.0f &&
+            // I >= 0.0f &&
+            D >= 0.0f &&
+            V >= 0.0f;
+    }
+
+    void clamp() {
+        R  = std::max(R , 0.f);
+        C  = std::max(C , 0.f);
+        H  = std::max(H , 0.f);
+        Sz = std::max(Sz, 0.f);
+        Tc = std::max(Tc, 0.f);
+        Ta = std::max(Ta, 0.f);
+        Th = std::max(Th, 0.f);
+        Sc = std::max(Sc, 0.f);
+        Sa = std::max(Sa, 0.f);
+        Sh = std::max(Sh, 0.f);
+        Gd = std::max(Gd, 0.f);
+        M  = std::max(M , 0.f);
+        // I  = std::max(I , 0.f);
+        D  = std::max(D , 0.f);
+        V  = std::max(V , 0.f);
+    }
+};
+
+struct ETESModelParameters {
+    int   iterations                  = 5;
+    float time_step_years             = 1.0f;
+    float rainfall                    = 10.0f;
+    float cell_size                   = 30.0f;
+    float water_sediment_capacity_p   = 0.05f;
+    float soil_absorption             = 0.2f;
+    float slope_threshold_sediment_lift= 0.1f;
+    float runoff_time_step_hours      = 1.0f;
+
+    float humus_water_capacity_p      = 0.8f;
+    float sand_water_capacity_p       = 0.3f;
+    float rock_water_capacity_p       = 0.05f;
+    float rock_erosion_base_value     = 0.0005f;
+    float bedrock_water_capacity_p    = 0.01f;
+    float bedrock_erosion_base_value  = 0.0005f;
+    float terrain_elevation_scale     = 100.0f;
+    float seed                        = 0.0f;
+
+
+
+    void toParameterSet(util::ParameterCollection<float>& parameters) {
+        parameters.addParameter("iterations", 1, 100, iterations);
+        parameters.addParameter("time_step_years", 0.05f, 10.0f, time_step_years);
+        // rainfall in meters per year
+        parameters.addParameter("rainfall", 0.0f, 15.0f, rainfall);
+        parameters.addParameter("cell_size", 0.5f, 150.0f, cell_size);
+
+        // percentage of water volume that can be sediment
+        parameters.addParameter("water_sediment_capacity_p", 0.0f, 1.0f, water_sediment_capacity_p);
+        // soil absorbtion coef
+        parameters.addParameter("soil_absorption", 0.0f, 1.0f, soil_absorption);
+        // threshold for sediment lift on a slope (grade) 
+        parameters.addParameter("slope_threshold_sediment_lift", 0.01f, 1.0f, slope_threshold_sediment_lift);
+
+        parameters.addParameter("runoff_time_step_hours", 0.01f, 100.0f, runoff_time_step_hours);
+
+        // layer parameters
+        parameters.addParameter("humus_water_capacity_p", 0.01f, 1.0f, humus_water_capacity_p);
+        parameters.addParameter("sand_water_capacity_p", 0.01f, 1.0f, sand_water_capacity_p);
+        parameters.addParameter("rock_water_capacity_p", 0.01f, 1.0f, rock_water_capacity_p);
+        parameters.addParameter("rock_erosion_base_value", 0.0001f, 0.1f, rock_erosion_base_value);
+        parameters.addParameter("bedrock_water_capacity_p", 0.01f, 1.0f, bedrock_water_capacity_p);
+        parameters.addParameter("bedrock_erosion_base_value", 0.0001f, 0.1f, bedrock_erosion_base_value);
+
+        // meters per unit of terrain texture elevation
+        parameters.addParameter("terrain_elevation_scale", 1.0f, 1000.0f, terrain_elevation_scale);
+
+        // random stream key, runs with the same seed and parameters give identical results
+        parameters.addParameter("seed", 0, 0, seed);
+    }
+
+    void fromParameterSet(const util::ParameterCollection<float>& p) {
+        iterations                  = p.getParam("iterations");
+        time_step_years             = p.getParam("time_step_years");
+        rainfall                    = p.getParam("rainfall");
+        cell_size                   = p.getParam("cell_size");
+        water_sediment_capacity_p   = p.getParam("water_sediment_capacity_p");
+        soil_absorption             = p.getParam("soil_absorption");
+        humus_water_capacity_p      = p.getParam("humus_water_capacity_p");
+        sand_water_capacity_p       = p.getParam("sand_water_capacity_p");
+        rock_water_capacity_p       = p.getParam("rock_water_capacity_p");
+        rock_erosion_base_value     = p.getParam("rock_erosion_base_value");
+        bedrock_water_capacity_p    = p.getParam("bedrock_water_capacity_p");
+        bedrock_erosion_base_value  = p.getParam("bedrock_erosion_base_value");
+        slope_threshold_sediment_lift=p.getParam("slope_threshold_sediment_lift");
+        runoff_time_step_hours      = p.getParam("runoff_time_step_hours");
+        terrain_elevation_scale     = p.getParam("terrain_elevation_scale");
+        seed                        = p.getParam("seed");
+    }
+
+    float getCellElevation(const ETESCellData& cell) const {return cell.Sz + cell.R + cell.C + cell.H;}
+
+    float getCellGranularDepth(const ETESCellData& cell) const {return cell.R + cell.C + cell.H;}
+
+    // water the layers of a cell can hold, m
+    float getCellMoistureCapacity(const ETESCellData& cell) const {
+        return humus_water_capacity_p * cell.H +
+            sand_water_capacity_p * cell.C +
+            rock_water_capacity_p * cell.R +
+            bedrock_water_capacity_p * cell.Sz;
+    }
+
+    /**
+     * @brief Get the Cell Vegitation Density, the share of runoff erosion the grass, shrubs and
+     * trees of the cell hold back. Updated by the vegetation pass
+     * 
+     * @param  cell
+     * @return float [0, 1]
+     */
+    float getCellVegitationDensity(const ETESCellData& cell) const {
+        return cell.V;
+    }
+};
+
+/**
+ * @brief vegetation and landslide passes of the CPU ETES model. Each runs on its own time scale,
+ * independent of the runoff time step
+ *
+ */
+struct ETESEcosystemParameters {
+    // simulated years between vegetation updates and between landslide slope scans, 0 disables
+    float vegetation_interval_years   = 1.0f;
+    float landslide_interval_years    = 1.0f;
+
+    // per year rates the cover of each plant type approaches what the cell can support
+    float grass_growth_rate           = 0.5f;
+    float shrub_growth_rate           = 0.2f;
+    float tree_growth_rate            = 0.05f;
+    // water used per year by a full cover of trees, m
+    float transpiration               = 0.2f;
+    // grade above which nothing grows
+    float vegetation_max_slope        = 1.0f;
+    // share of runoff erosion held back by a full mature cover
+    float vegetation_protection       = 0.6f;
+    // share of the dead vegetation decaying into humus per year, and m of humus per unit decayed
+    float dead_vegetation_decay       = 0.2f;
+    float humus_per_dead_vegetation   = 0.01f;
+
+    // grade at which each material slides
+    float humus_repose_slope          = 0.5f;
+    float sand_repose_slope           = 0.6f;
+    float rock_repose_slope           = 1.0f;
+    // raise of the repose slope under full vegetation density
+    float root_reinforcement          = 0.5f;
+
+    void toParameterSet(util::ParameterCollection<float>& parameters) {
+        parameters.addParameter("vegetation_interval_years", 0.0f, 10.0f, vegetation_interval_years);
+        parameters.addParameter("landslide_interval_years", 0.0f, 100.0f, landslide_interval_years);
+        parameters.addParameter("grass_growth_rate", 0.0f, 2.0f, grass_growth_rate);
+        parameters.addParameter("shrub_growth_rate", 0.0f, 1.0f, shrub_growth_rate);
+        parameters.addParameter("tree_growth_rate", 0.0f, 1.0f, tree_growth_rate);
+        parameters.addParameter("transpiration", 0.0f, 2.0f, transpiration);
+        parameters.addParameter("vegetation_max_slope", 0.1f, 3.0f, vegetation_max_slope);
+        parameters.addParameter("vegetation_protection", 0.0f, 1.0f, vegetation_protection);
+        parameters.addParameter("dead_vegetation_decay", 0.0f, 1.0f, dead_vegetation_decay);
+        parameters.addParameter("humus_per_dead_vegetation", 0.0f, 0.1f, humus_per_dead_vegetation);
+        parameters.addParameter("humus_repose_slope", 0.1f, 2.0f, humus_repose_slope);
+        parameters.addParameter("sand_repose_slope", 0.1f, 2.0f, sand_repose_slope);
+        parameters.addParameter("rock_repose_slope", 0.1f, 3.0f, rock_repose_slope);
+        parameters.addParameter("root_reinforcement", 0.0f, 2.0f, root_reinforcement);
+    }
+
+    void fromParameterSet(const util::ParameterCollection<float>& p) {
+        vegetation_interval_years   = p.getParam("vegetation_interval_years");
+        landslide_interval_years    = p.getParam("landslide_interval_years");
+        grass_growth_rate           = p.getParam("grass_growth_rate");
+        shrub_growth_rate           = p.getParam("shrub_growth_rate");
+        tree_growth_rate            = p.getParam("tree_growth_rate");
+        transpiration               = p.getParam("transpiration");
+        vegetation_max_slope        = p.getParam("vegetation_max_slope");
+        vegetation_protection       = p.getParam("vegetation_protection");
+        dead_vegetation_decay       = p.getParam("dead_vegetation_decay");
+        humus_per_dead_vegetation   = p.getParam("humus_per_dead_vegetation");
+        humus_repose_slope          = p.getParam("humus_repose_slope");
+        sand_repose_slope           = p.getParam("sand_repose_slope");
+        rock_repose_slope           = p.getParam("rock_repose_slope");
+        root_reinforcement          = p.getParam("root_reinforcement");
+    }
+};
+
+}
+
+#endif // DIRTBOX_ETES_EROSION_PARAMS_H
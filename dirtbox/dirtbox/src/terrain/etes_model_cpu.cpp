@@ -0,0 +1,521 @@
+/*
+    based on https://dl.acm.org/doi/pdf/10.1145/3072959.3073667
+*/
+#include <terrain/etes_model_cpu.h>
+
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+#include <assert.h>
+
+#include <util/vec.h>
+#include <util/thread_pool.h>
+#include <util/counter_rng.h>
+
+using namespace std;
+
+namespace dirtbox::terrain {
+
+namespace {
+
+class RunoffEvent {
+public:
+    RunoffEvent(const ETESModelParameters& params, float step_time_constant) :
+        params{params}, step_time_constant{step_time_constant} {}
+
+    const ETESModelParameters& params;
+    const float step_time_constant;
+
+    // water volume
+    float w;
+    float sediment_humus;
+    float sediment_sand;
+    float sediment_rock;
+
+    void reset() {
+        w = 0;
+        sediment_humus = 0;
+        sediment_sand = 0;
+        sediment_rock = 0;
+    }
+
+    float sedimentCapacity() const {
+        return w * params.water_sediment_capacity_p;
+    }
+
+    float currentSediment() const {
+        return sediment_humus + sediment_sand + sediment_rock;
+    }
+
+    float sedimentSaturation() const {
+        return currentSediment() / sedimentCapacity();
+    }
+
+    float cellMoistureCapacity(const ETESCellData& cell) {
+        return params.getCellMoistureCapacity(cell);
+    }
+
+    /**
+     * @brief deposition does not depend on the vegetation, which only holds back lift and erosion
+     *
+     * @param available_material    suspended sediment
+     * @param slope                 grade logistic value
+     * @return float
+     */
+    float sedimentDepositionCalculation(float available_material, float slope) {
+        float deposit = step_time_constant * (1.f - slope);
+        deposit *= available_material;
+        deposit = min(deposit, available_material);
+        return deposit;
+    }
+
+    /**
+     * @brief
+     *
+     * @param available_material    maximum erodable sediment
+     * @param slope                 grade logistic value
+     * @param veg_density           vegitation density scalar
+     * @return float
+     */
+    float sedimentLiftCalculation(float available_material, float slope, float veg_density) {
+        float lift = step_time_constant * slope;
+        lift *= available_material * (1.f - veg_density);
+        lift = min(lift, available_material);
+        return lift;
+    }
+
+    /**
+     * @brief solid material erosion
+     *
+     *
+     * @param erosion_base
+     * @param available_material
+     * @param slope
+     * @param w
+     * @param sediment_saturation       [0, 1]
+     * @return float    meters of erosion
+     */
+    float erosion(float erosion_base, float available_material, float slope, float w, float sediment_saturation, float veg_density, float granular_depth) {
+        float erosion = step_time_constant * erosion_base * w *
+            (slope + 0.2f * logistic_between(sediment_saturation, 0.f, 1.f)) *
+            (1.f - logistic_between(granular_depth, 0.1f, 2.f)) *
+            (1.f - veg_density);
+        erosion = min(available_material, erosion);
+        return erosion;
+    }
+
+    /**
+     * @brief performs single step of the runoff event
+     *
+     * @param p cell to run the event on
+     * @param N neighborhood of target cell
+     * @param rng generator of this event
+     * @return int next cell direction
+     */
+    int stepRunoffEvent(ETESCellData& p, const ETESN& N, util::CounterRNG& rng) {
+        const float ctcd = sqrt(params.cell_size*params.cell_size);
+        float c_elevation = params.getCellElevation(p);
+        std::array<float, 8> slopes{};
+        // eliminate cells that are higher
+        for (uint32_t i = 0; i < N.adjacent.size(); ++i) {
+            const auto& cell = N.adjacent[i];
+            if (cell) {
+                float n_z = params.getCellElevation(*cell);
+                if (n_z < c_elevation)
+                    slopes[i] = slope(c_elevation, n_z, ctcd);
+            }
+        }
+        int r_dir = random_weighted_pick(slopes, rng);
+        if (r_dir != -1) { // picking a new direction
+            float grade = abs(slopes[r_dir]);
+            float r_slope = logistic_between(grade, -4.f, 5.f, 10.0f);
+
+            // absorption
+            float absorb = step_time_constant * params.soil_absorption * w * (1.f - r_slope);
+            absorb = min(absorb, cellMoistureCapacity(p) - p.M);
+            w -= absorb;
+            p.M += absorb;
+
+            // erosion interactions
+            const float cell_vd = params.getCellVegitationDensity(p);
+            float sand;
+            float humus;
+            float rock;
+            if (grade > params.slope_threshold_sediment_lift) { // material transport
+                // sediment lift
+                sand = sedimentLiftCalculation(p.C, r_slope, cell_vd);
+                humus = sedimentLiftCalculation(p.H, r_slope, cell_vd);
+                rock = sedimentLiftCalculation(p.R, r_slope, cell_vd);
+
+            } else {
+                // sediment deposition
+                sand = -sedimentDepositionCalculation(sediment_sand, r_slope);
+                humus = -sedimentDepositionCalculation(sediment_humus, r_slope);
+                rock = -sedimentDepositionCalculation(sediment_rock, r_slope);
+            }
+
+            // erosion bedrock -> rock -> sand
+            float b_r = erosion(params.bedrock_erosion_base_value, p.Sz, r_slope, w, sedimentSaturation(), cell_vd, params.getCellGranularDepth(p));
+            float r_c = erosion(params.rock_erosion_base_value, p.R, r_slope, w, sedimentSaturation(), cell_vd, params.getCellGranularDepth(p));
+            p.Sz -= b_r;
+            p.R += b_r - r_c;
+            p.C += r_c;
+
+            const float capacity = sedimentCapacity();
+            float total = sand + humus + rock;
+            float current = currentSediment();
+            float remaining = capacity - current;
+            if (current > capacity) {
+                sand = sediment_sand / current * remaining;
+                humus = sediment_humus / current * remaining;
+                rock = sediment_rock / current * remaining;
+            } else if (total > remaining) {
+                sand = sand / (total + 1e-4f) * remaining;
+                humus = humus / (total + 1e-4f) * remaining;
+                rock = rock / (total + 1e-4f) * remaining;
+            }
+
+            sediment_sand += sand;
+            p.C -= sand;
+
+            sediment_humus += humus;
+            p.H -= humus;
+
+            sediment_rock += rock;
+            p.R -= rock;
+
+            assert(!p.isNanOrInf());
+        }
+        return r_dir;
+    }
+
+    void doRunoffEvent(ETESGrid& input_grid, vec2i point, float w, util::CounterRNG& rng) {
+        ETESCellData* p = input_grid.safeGet(point);
+        reset();
+        this->w = w;
+        if (p) {
+            for (int i = 0; i < ETESModelCPU::MaxRunoffSteps; ++i) {
+                int dir = stepRunoffEvent(*p, input_grid.neighborhoodOf(point.x(), point.y()), rng);
+                p->clamp();
+                if (dir != -1 && this->w > 0.0f) {
+                    point += ETESN::directions[dir];
+                    p = input_grid.safeGet(point);
+                    if (!p) break;
+                } else {
+                    // deposit all remaining
+                    p->C += sediment_sand;
+                    p->H += sediment_humus;
+                    p->R += sediment_rock;
+                    break;
+                }
+            }
+        }
+    }
+};
+
+
+using clock_type = std::chrono::steady_clock;
+
+double seconds_since(clock_type::time_point start) {
+    return std::chrono::duration<double>(clock_type::now() - start).count();
+}
+
+// granular depth at which each plant type reaches full cover, m. Grass roots in sand and humus,
+// shrubs and trees in any granular layer
+constexpr float GrassSoilDepth = 0.1f;
+constexpr float ShrubSoilDepth = 0.5f;
+constexpr float TreeSoilDepth = 2.0f;
+// height of mature plants in m, and years to reach about 2/3 of it
+constexpr float ShrubMaxHeight = 2.0f;
+constexpr float ShrubMaturity = 5.0f;
+constexpr float TreeMaxHeight = 25.0f;
+constexpr float TreeMaturity = 40.0f;
+// water use and dead vegetation of a full cover relative to trees
+constexpr float GrassWeight = 0.2f;
+constexpr float ShrubWeight = 0.5f;
+// cover below which a plant type is gone and its age restarts
+constexpr float MinCover = 0.01f;
+
+/**
+ * @brief move cover towards target at rate per year
+ *
+ * @return float cover lost, which becomes dead vegetation
+ */
+float approach(float& cover, float target, float rate, float years) {
+    const float next = cover + (target - cover) * (1.f - std::exp(-rate * years));
+    const float lost = std::max(cover - next, 0.f);
+    cover = next;
+    return lost;
+}
+
+void grow_plants(float cover, float& age, float& height, float max_height, float maturity, float years) {
+    age = cover >= MinCover ? age + years : 0.f;
+    height = max_height * (1.f - std::exp(-age / maturity));
+}
+
+// cells of direction i of ETESN::directions apart, diagonals are odd
+float direction_distance(int i) {
+    return (i & 1) ? 1.41421356f : 1.f;
+}
+
+}
+
+void ETESModelCPU::init(int width, int height, const float* rgba) {
+    cells = ETESGrid{width, height, 0.0f};
+    tiles_x = (width + TileSize - 1) / TileSize;
+    tiles_y = (height + TileSize - 1) / TileSize;
+    iteration = 0;
+    last_step = {};
+    steepest.assign((std::size_t)width * height, 0.0f);
+    slide_offsets.assign((std::size_t)tiles_x * tiles_y * TileCells + 1, 0);
+    slide_events.clear();
+
+    for (int y = 0; y < height; ++y)
+        for (int x = 0; x < width; ++x)
+            cells.at(x, y).Sz = rgba[4 * ((std::size_t)y * width + x)] * params.terrain_elevation_scale;
+}
+
+void ETESModelCPU::copyTo(float* rgba) const {
+    for (int y = 0; y < cells.height; ++y)
+        for (int x = 0; x < cells.width; ++x)
+            rgba[4 * ((std::size_t)y * cells.width + x)] = params.getCellElevation(cells.at(x, y)) / params.terrain_elevation_scale;
+}
+
+void ETESModelCPU::saveState(ErosionCheckpoint& checkpoint) const {
+    // ETESCellData is all floats, stored as one interleaved plane
+    constexpr int channels = sizeof(ETESCellData) / sizeof(float);
+    checkpoint.iteration = iteration;
+    checkpoint.addPlane("cells", cells.width, cells.height, channels, reinterpret_cast<const float*>(cells.data.data()));
+}
+
+bool ETESModelCPU::restoreState(const ErosionCheckpoint& checkpoint) {
+    constexpr int channels = sizeof(ETESCellData) / sizeof(float);
+    if (!checkpoint.readPlane("cells", cells.width, cells.height, channels, reinterpret_cast<float*>(cells.data.data())))
+        return false;
+    iteration = checkpoint.iteration;
+    return true;
+}
+
+uint32_t ETESModelCPU::due_runs(float interval) const {
+    if (interval <= 0)
+        return 0;
+    const double before = (double)iteration * params.time_step_years;
+    const double after = (double)(iteration + 1) * params.time_step_years;
+    return (uint32_t)(std::floor(after / interval) - std::floor(before / interval));
+}
+
+template<typename Fn>
+void ETESModelCPU::for_each_color(Fn&& fn) {
+    for (int color = 0; color < NumColors; ++color) {
+        const int cx = color & 1;
+        const int cy = color >> 1;
+        // tiles of this color in each direction
+        const int nx = (tiles_x - cx + 1) / 2;
+        const int ny = (tiles_y - cy + 1) / 2;
+        pool->parallel_for(0, nx * ny, [&fn, cx, cy, nx](int t) {
+            fn(cx + 2 * (t % nx), cy + 2 * (t / nx));
+        });
+    }
+}
+
+void ETESModelCPU::step() {
+    last_step = {};
+    auto start = clock_type::now();
+    for_each_color([this](int tx, int ty) {run_tile(tx, ty);});
+    last_step.runoff_seconds = seconds_since(start);
+
+    // vegetation grows on its own time scale, whatever the runoff time step
+    last_step.vegetation_updates = due_runs(ecosystem.vegetation_interval_years);
+    if (last_step.vegetation_updates > 0) {
+        start = clock_type::now();
+        for (uint32_t i = 0; i < last_step.vegetation_updates; ++i) {
+            pool->parallel_for(0, tiles_y, [this](int t) {
+                scan_slopes(t * TileSize, std::min((t + 1) * TileSize, cells.height));
+            });
+            pool->parallel_for(0, tiles_y, [this](int t) {
+                grow_vegetation(t * TileSize, std::min((t + 1) * TileSize, cells.height), ecosystem.vegetation_interval_years);
+            });
+        }
+        last_step.vegetation_seconds = seconds_since(start);
+    }
+
+    // the slope scan is cheap, slide events only run where it finds unstable cells
+    last_step.landslide_scans = due_runs(ecosystem.landslide_interval_years);
+    if (last_step.landslide_scans > 0) {
+        start = clock_type::now();
+        for (uint32_t i = 0; i < last_step.landslide_scans; ++i) {
+            // count, scan and scatter, the slide events end up compact and grouped by tile
+            const int tiles = tiles_x * tiles_y;
+            pool->parallel_for(0, tiles, [this](int t) {count_unstable(t % tiles_x, t / tiles_x);});
+            const uint32_t found = pool->parallel_exclusive_scan(slide_offsets.data(), tiles * TileCells, TileCells);
+            slide_offsets.back() = found;
+            last_step.unstable_cells += found;
+            if (found > 0) {
+                slide_events.resize(found);
+                pool->parallel_for(0, tiles, [this](int t) {scatter_unstable(t % tiles_x, t / tiles_x);});
+                for_each_color([this](int tx, int ty) {run_landslides(tx, ty);});
+            }
+        }
+        last_step.landslide_seconds = seconds_since(start);
+    }
+
+    iteration++;
+}
+
+void ETESModelCPU::run_tile(int tx, int ty) {
+    const int x0 = tx * TileSize;
+    const int y0 = ty * TileSize;
+    const int tw = std::min(TileSize, cells.width - x0);
+    const int th = std::min(TileSize, cells.height - y0);
+
+    // picks start cells of this tile. Streams are keyed by (seed, iteration, cell), so no
+    // generator state is shared between threads and nothing is allocated per event
+    const uint32_t tile = (uint32_t)(ty * tiles_x + tx);
+    util::CounterRNG tile_rng{seed, iteration, tile, TileStream};
+
+    RunoffEvent runoff{params, 1.0f};
+    for (int i = 0; i < tw * th; ++i) {
+        const int xr = x0 + (int)tile_rng.uniformInt(tw);
+        const int yr = y0 + (int)tile_rng.uniformInt(th);
+        // a cell may be picked several times, the event index keeps their streams apart
+        util::CounterRNG event_rng{seed, iteration, (uint32_t)(yr * cells.width + xr), EventStream + (uint32_t)i};
+        runoff.doRunoffEvent(cells, vec2i{xr, yr}, params.rainfall, event_rng);
+    }
+}
+
+float ETESModelCPU::steepest_grade(int x, int y) const {
+    const float e = params.getCellElevation(cells.at(x, y));
+    float grade = 0;
+    for (int i = 0; i < 8; ++i) {
+        const vec2i n = vec2i{x, y} + ETESN::directions[i];
+        if (const ETESCellData* cell = cells.safeGet(n.x(), n.y()))
+            grade = std::max(grade, (e - params.getCellElevation(*cell)) / (params.cell_size * direction_distance(i)));
+    }
+    return grade;
+}
+
+float ETESModelCPU::repose_slope(const ETESCellData& cell) const {
+    // the top material slides first, roots hold it back
+    const float repose = cell.H > 0 ? ecosystem.humus_repose_slope : cell.C > 0 ? ecosystem.sand_repose_slope : ecosystem.rock_repose_slope;
+    return repose * (1.f + ecosystem.root_reinforcement * cell.V);
+}
+
+void ETESModelCPU::scan_slopes(int y0, int y1) {
+    for (int y = y0; y < y1; ++y)
+        for (int x = 0; x < cells.width; ++x)
+            steepest[(std::size_t)y * cells.width + x] = steepest_grade(x, y);
+}
+
+void ETESModelCPU::grow_vegetation(int y0, int y1, float years) {
+    const ETESEcosystemParameters& e = ecosystem;
+    for (int y = y0; y < y1; ++y) {
+        for (int x = 0; x < cells.width; ++x) {
+            ETESCellData& c = cells.at(x, y);
+            const float capacity = params.getCellMoistureCapacity(c);
+            const float wetness = capacity > 0 ? std::min(c.M / capacity, 1.f) : 0.f;
+            const float flatness = std::clamp(1.f - steepest[(std::size_t)y * cells.width + x] / e.vegetation_max_slope, 0.f, 1.f);
+            const float viability = wetness * flatness;
+            const float granular = params.getCellGranularDepth(c);
+
+            // trees shade out part of the grass below them
+            float dead = 0;
+            dead += GrassWeight * approach(c.Gd, viability * std::min((c.C + c.H) / GrassSoilDepth, 1.f) * (1.f - 0.5f * c.Tc), e.grass_growth_rate, years);
+            dead += ShrubWeight * approach(c.Sc, viability * std::min(granular / ShrubSoilDepth, 1.f), e.shrub_growth_rate, years);
+            dead += approach(c.Tc, viability * std::min(granular / TreeSoilDepth, 1.f), e.tree_growth_rate, years);
+            grow_plants(c.Sc, c.Sa, c.Sh, ShrubMaxHeight, ShrubMaturity, years);
+            grow_plants(c.Tc, c.Ta, c.Th, TreeMaxHeight, TreeMaturity, years);
+
+            const float use = e.transpiration * (GrassWeight * c.Gd + ShrubWeight * c.Sc + c.Tc) * years;
+            c.M -= std::min(c.M, use);
+
+            c.D += dead;
+            const float decayed = c.D * (1.f - std::exp(-e.dead_vegetation_decay * years));
+            c.D -= decayed;
+            c.H += decayed * e.humus_per_dead_vegetation;
+
+            // grass holds back part of the runoff, shrubs and trees more as they mature
+            const float cover = 1.f - (1.f - 0.5f * c.Gd) * (1.f - c.Sc * c.Sh / ShrubMaxHeight) * (1.f - c.Tc * c.Th / TreeMaxHeight);
+            c.V = e.vegetation_protection * cover;
+            c.clamp();
+        }
+    }
+}
+
+void ETESModelCPU::count_unstable(int tx, int ty) {
+    uint32_t* counts = slide_offsets.data() + (std::size_t)(ty * tiles_x + tx) * TileCells;
+    const int x0 = tx * TileSize;
+    const int y0 = ty * TileSize;
+    const int x1 = std::min(x0 + TileSize, cells.width);
+    const int y1 = std::min(y0 + TileSize, cells.height);
+    // cells past the edge of the grid count 0
+    std::fill_n(counts, TileCells, 0u);
+    for (int y = y0; y < y1; ++y) {
+        for (int x = x0; x < x1; ++x) {
+            const ETESCellData& c = cells.at(x, y);
+            counts[(y - y0) * TileSize + (x - x0)] = params.getCellGranularDepth(c) > 0 && steepest_grade(x, y) > repose_slope(c);
+        }
+    }
+}
+
+void ETESModelCPU::scatter_unstable(int tx, int ty) {
+    const uint32_t* offsets = slide_offsets.data() + (std::size_t)(ty * tiles_x + tx) * TileCells;
+    if (offsets[0] == offsets[TileCells])
+        return;
+    const int x0 = tx * TileSize;
+    const int y0 = ty * TileSize;
+    for (int i = 0; i < TileCells; ++i)
+        if (offsets[i + 1] > offsets[i])
+            slide_events[offsets[i]] = (y0 + i / TileSize) * cells.width + x0 + i % TileSize;
+}
+
+void ETESModelCPU::run_landslides(int tx, int ty) {
+    const uint32_t* offsets = slide_offsets.data() + (std::size_t)(ty * tiles_x + tx) * TileCells;
+    for (uint32_t e = offsets[0]; e < offsets[TileCells]; ++e) {
+        const int32_t start = slide_events[e];
+        int x = start % cells.width;
+        int y = start / cells.width;
+        // the material follows the steepest descent until it rests at its repose slope
+        for (int i = 0; i < MaxSlideSteps; ++i) {
+            ETESCellData& p = cells.at(x, y);
+            const float e = params.getCellElevation(p);
+            int dir = -1;
+            float grade = 0;
+            for (int d = 0; d < 8; ++d) {
+                const vec2i n = vec2i{x, y} + ETESN::directions[d];
+                const ETESCellData* cell = cells.safeGet(n.x(), n.y());
+                if (!cell)
+                    continue;
+                const float g = (e - params.getCellElevation(*cell)) / (params.cell_size * direction_distance(d));
+                if (g > grade) {
+                    grade = g;
+                    dir = d;
+                }
+            }
+            const float repose = repose_slope(p);
+            if (dir == -1 || grade <= repose)
+                break;
+
+            // moving half of the height above the repose slope leaves both cells on it
+            float excess = 0.5f * (grade - repose) * params.cell_size * direction_distance(dir);
+            const vec2i next = vec2i{x, y} + ETESN::directions[dir];
+            ETESCellData& q = cells.at(next.x(), next.y());
+            for (float ETESCellData::*layer : {&ETESCellData::H, &ETESCellData::C, &ETESCellData::R}) {
+                const float moved = std::min(p.*layer, excess);
+                p.*layer -= moved;
+                q.*layer += moved;
+                excess -= moved;
+            }
+
+            // the slide strips the vegetation of the cells it leaves
+            p.D += GrassWeight * p.Gd + ShrubWeight * p.Sc + p.Tc;
+            p.Gd = 0;
+            p.Sc = 0;
+            p.Tc = 0;
+            p.V = 0;
+            x = next.x();
+            y = next.y();
+        }
+    }
+}
+
+}
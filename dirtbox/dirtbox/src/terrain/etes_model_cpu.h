@@ -0,0 +1,186 @@
+/**
+ * @author Hunter Borlik
+ * @brief CPU implementation of the ETES runoff model
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ */
+#pragma once
+#ifndef DIRTBOX_ETES_MODEL_CPU_H
+#define DIRTBOX_ETES_MODEL_CPU_H
+
+#include <vector>
+#include <cstdint>
+
+#include <util/thread_pool.h>
+#include <util/hash.h>
+
+#include <terrain/etes_erosion_params.h>
+#include <terrain/erosion_util.h>
+#include <terrain/erosion_checkpoint.h>
+
+namespace dirtbox::terrain {
+
+using ETESGrid  = ModelSubstate<ETESCellData>;
+using ETESN     = ETESGrid::Neighborhood;
+
+/**
+ * @brief work of the passes of the last ETESModelCPU::step
+ *
+ */
+struct ETESStepReport {
+    double runoff_seconds = 0;
+    double vegetation_seconds = 0;
+    double landslide_seconds = 0;
+    // vegetation updates and landslide scans run by the step, 0 when not due
+    uint32_t vegetation_updates = 0;
+    uint32_t landslide_scans = 0;
+    // cells the scans found unstable, one slide event each
+    uint64_t unstable_cells = 0;
+};
+
+/**
+ * @brief Multithreaded CPU version of the ETES runoff simulation. Has no dependency on the renderer.
+ *
+ * Runoff events walk at most MaxRunoffSteps cells and only modify the cell they are on, reading
+ * its 8 neighbors. The grid is split into TileSize tiles coloured as a 2x2 checkerboard. Tiles of
+ * one colour are a full tile apart, which is more than two event footprints, so all tiles of a
+ * colour run their events concurrently on util::ThreadPool without locking. The 4 colours run one
+ * after the other.
+ *
+ * Vegetation and landslides run as separate passes on the simulated time scales of
+ * ETESEcosystemParameters, so a short runoff time step does not run them every step. The
+ * vegetation pass grows grass, shrubs and trees from moisture, slope and soil depth, turns dead
+ * vegetation into humus and sets the vegetation density that holds back runoff erosion. The
+ * landslide pass scans the slopes and only runs slide events from the cells steeper than the
+ * repose slope of their top material. The scan counts the events of every cell, an exclusive scan
+ * of the counts gives each event its slot and the events are scattered into one compact array,
+ * grouped by tile, as the GPU model schedules its runoff events. Slide events reach fewer cells
+ * than runoff events and run on the same tile colours.
+ *
+ */
+class ETESModelCPU {
+public:
+    static constexpr int TileSize = 64;
+    static constexpr int MaxRunoffSteps = 25;
+    static constexpr int MaxSlideSteps = 8;
+    static constexpr int NumColors = 4;
+    static constexpr int TileCells = TileSize * TileSize;
+
+    // an event reaches at most MaxRunoffSteps + 1 cells outside of its tile
+    static_assert(TileSize >= 2 * (MaxRunoffSteps + 1), "events from same coloured tiles may overlap");
+    static_assert(MaxSlideSteps <= MaxRunoffSteps, "slide events may overlap");
+
+    explicit ETESModelCPU(const ETESModelParameters& params, uint32_t seed = 0, const ETESEcosystemParameters& ecosystem = {}) :
+        params{params}, ecosystem{ecosystem}, seed{seed} {}
+
+    /**
+     * @brief initialize model state from terrain data. The rock channel becomes bedrock, other
+     * layers start empty.
+     *
+     * @param width
+     * @param height
+     * @param rgba terrain RGBA32F texture data, width * height * 4 floats
+     */
+    void init(int width, int height, const float* rgba);
+
+    /**
+     * @brief run one iteration, width * height runoff events starting at random cells, then the
+     * vegetation updates and landslide scans due in its time_step_years
+     *
+     */
+    void step();
+
+    /**
+     * @brief write total elevation into the rock channel of the terrain RGBA32F texture layout.
+     * Other channels are left unchanged.
+     *
+     * @param rgba width * height * 4 floats
+     */
+    void copyTo(float* rgba) const;
+
+    /**
+     * @brief pool the tiles run on. Results do not depend on the pool size
+     *
+     * @param pool
+     */
+    void setThreadPool(util::ThreadPool& pool) {this->pool = &pool;}
+
+    /**
+     * @brief xxHash64 of the cell state
+     *
+     * @return uint64_t
+     */
+    uint64_t getStateHash() const {
+        return util::XXHash64::hash(cells.data.data(), cells.data.size() * sizeof(ETESCellData));
+    }
+
+    /**
+     * @brief add the cell layers and iteration counter to checkpoint
+     *
+     * @param checkpoint
+     */
+    void saveState(ErosionCheckpoint& checkpoint) const;
+
+    /**
+     * @brief continue from checkpoint. Call after init with the same size
+     *
+     * @param checkpoint
+     * @return false if a layer is missing or has the wrong size, the state is then undefined
+     */
+    bool restoreState(const ErosionCheckpoint& checkpoint);
+
+    int getWidth() const {return cells.width;}
+    int getHeight() const {return cells.height;}
+    uint32_t getIteration() const {return iteration;}
+    const ETESModelParameters& getParameters() const {return params;}
+    const ETESEcosystemParameters& getEcosystemParameters() const {return ecosystem;}
+    const ETESStepReport& getLastStep() const {return last_step;}
+
+    const ETESGrid& getState() const {return cells;}
+
+private:
+    // CounterRNG stream ids. Tile streams use the tile index as cell, event streams the start cell
+    static constexpr uint32_t TileStream = 0;
+    static constexpr uint32_t EventStream = 1;
+
+    // runs of a pass every interval years due in the current step
+    uint32_t due_runs(float interval) const;
+    // run fn(tx, ty) for every tile, one colour after the other
+    template<typename Fn>
+    void for_each_color(Fn&& fn);
+
+    void run_tile(int tx, int ty);
+    float steepest_grade(int x, int y) const;
+    // grade the top material of cell slides at
+    float repose_slope(const ETESCellData& cell) const;
+    // steepest descent grade of every cell of rows [y0, y1)
+    void scan_slopes(int y0, int y1);
+    void grow_vegetation(int y0, int y1, float years);
+    // count the slide events of the cells of a tile, 1 for cells steeper than their repose slope
+    void count_unstable(int tx, int ty);
+    // write the start cells of the slide events of a tile to their slots
+    void scatter_unstable(int tx, int ty);
+    void run_landslides(int tx, int ty);
+
+    ETESModelParameters params;
+    ETESEcosystemParameters ecosystem;
+    util::ThreadPool* pool = &util::ThreadPool::Get();
+    uint32_t seed;
+    uint32_t iteration = 0;
+    ETESStepReport last_step;
+
+    ETESGrid cells{0, 0, 0.0f};
+    int tiles_x = 0;
+    int tiles_y = 0;
+    std::vector<float> steepest;
+    // slide events per cell, then the slot of its first event after the scan. Tile major with
+    // TileCells entries per tile and the total at the end
+    std::vector<uint32_t> slide_offsets;
+    // start cells of the slide events, tile by tile in scan order
+    std::vector<int32_t> slide_events;
+};
+
+}
+
+#endif // DIRTBOX_ETES_MODEL_CPU_H
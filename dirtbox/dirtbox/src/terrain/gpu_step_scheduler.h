@@ -0,0 +1,75 @@
+/**
+ * @author Hunter Borlik
+ * @brief iterations per frame for GPU erosion within a GPU time budget
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ */
+#pragma once
+#ifndef DIRTBOX_GPU_STEP_SCHEDULER_H
+#define DIRTBOX_GPU_STEP_SCHEDULER_H
+
+#include <array>
+#include <algorithm>
+
+namespace dirtbox::terrain {
+
+/**
+ * @brief Picks how many iterations a GPU erosion engine submits per frame so the GPU time of its
+ * compute view stays within a budget. GPU timings arrive a few frames late, so the cost of an
+ * iteration is estimated from the measured time and the smallest batch of the last frames. The
+ * batch grows by at most 2x per frame and shrinks right away when a frame goes over budget.
+ *
+ */
+class GPUStepScheduler {
+public:
+    // largest batch, bounds the work queued in one frame
+    static constexpr int MaxBatch = 512;
+
+    /**
+     * @brief iterations to submit in the coming frame
+     *
+     * @return int >= 1
+     */
+    int getBatch() const {return batch;}
+
+    float getBudget() const {return budget_ms;}
+    void setBudget(float ms) {budget_ms = std::max(ms, 0.1f);}
+
+    // start over at one iteration per frame
+    void reset() {
+        batch = 1;
+        history.fill(1);
+    }
+
+    /**
+     * @brief update the batch from the GPU time of the compute view and record the batch that
+     * was submitted this frame
+     *
+     * @param gpu_ms measured GPU time of a recent frame, <= 0 when there is no measurement
+     * @param submitted iterations submitted this frame
+     */
+    void update(float gpu_ms, int submitted) {
+        std::rotate(history.rbegin(), history.rbegin() + 1, history.rend());
+        history[0] = std::max(submitted, 1);
+        if (gpu_ms <= 0)
+            return;
+
+        // the measured frame ran one of the recent batches. Dividing by the smallest one
+        // overestimates the cost while the batch grows, so growth is cautious
+        const int smallest = *std::min_element(history.begin(), history.end());
+        const float ms_per_iteration = gpu_ms / smallest;
+        const int target = (int)(budget_ms / ms_per_iteration);
+        batch = std::clamp(std::min(target, 2 * batch), 1, MaxBatch);
+    }
+
+private:
+    float budget_ms = 8;
+    int batch = 1;
+    // batches of the last frames, newest first. Covers the latency of the GPU timer queries
+    std::array<int, 3> history{1, 1, 1};
+};
+
+}
+
+#endif // DIRTBOX_GPU_STEP_SCHEDULER_H
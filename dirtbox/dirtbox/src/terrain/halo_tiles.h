@@ -0,0 +1,81 @@
+/**
+ * @author Hunter Borlik
+ * @brief split a grid into equally sized windows with halos
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ */
+#pragma once
+#ifndef DIRTBOX_HALO_TILES_H
+#define DIRTBOX_HALO_TILES_H
+
+#include <vector>
+#include <algorithm>
+#include <utility>
+
+namespace dirtbox::terrain {
+
+/**
+ * @brief A tile of a grid run in its own window. The interior [x0, x1) x [y0, y1) is the part of
+ * the grid the tile is responsible for. The window starting at (wx, wy) holds the interior and
+ * halo cells around it, except where the interior touches the grid border.
+ *
+ */
+struct HaloTile {
+    int x0, y0, x1, y1;
+    int wx, wy;
+};
+
+/**
+ * @brief Tiles covering a width x height grid with windows of at most max_size cells per side.
+ * Every window has the same size, see haloWindowSize, so one set of GPU resources fits all tiles.
+ * Windows at the grid border are shifted inwards instead of cut off. A grid that fits in one
+ * window gives a single tile without halo.
+ *
+ * @param width
+ * @param height
+ * @param max_size largest window side, > 2 * halo
+ * @param halo cells around the interior
+ * @return std::vector<HaloTile> row major
+ */
+inline std::vector<HaloTile> planHaloTiles(int width, int height, int max_size, int halo) {
+    // interior size and window size along one axis
+    auto split = [max_size, halo](int n) {
+        const int window = std::min(n, max_size);
+        const int interior = n <= max_size ? n : max_size - 2 * halo;
+        return std::pair{interior, window};
+    };
+    const auto [ix, sx] = split(width);
+    const auto [iy, sy] = split(height);
+
+    std::vector<HaloTile> tiles;
+    for (int y0 = 0; y0 < height; y0 += iy) {
+        for (int x0 = 0; x0 < width; x0 += ix) {
+            HaloTile t;
+            t.x0 = x0;
+            t.y0 = y0;
+            t.x1 = std::min(width, x0 + ix);
+            t.y1 = std::min(height, y0 + iy);
+            t.wx = std::clamp(x0 - halo, 0, width - sx);
+            t.wy = std::clamp(y0 - halo, 0, height - sy);
+            tiles.push_back(t);
+        }
+    }
+    return tiles;
+}
+
+/**
+ * @brief size of the windows of planHaloTiles
+ *
+ * @param width
+ * @param height
+ * @param max_size
+ * @return std::pair<int, int> width, height
+ */
+inline std::pair<int, int> haloWindowSize(int width, int height, int max_size) {
+    return {std::min(width, max_size), std::min(height, max_size)};
+}
+
+}
+
+#endif // DIRTBOX_HALO_TILES_H
@@ -0,0 +1,257 @@
+/**
+ * @author Hunter Borlik
+ * @brief structure of arrays grid storage for CPU simulation kernels
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ */
+#pragma once
+#ifndef DIRTBOX_SOA_GRID_H
+#define DIRTBOX_SOA_GRID_H
+
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <new>
+#include <algorithm>
+#include <type_traits>
+
+#include <util/vec.h>
+#include <util/hash.h>
+
+namespace dirtbox::terrain {
+
+/**
+ * @brief allocator returning memory aligned to Align bytes
+ *
+ * @tparam T
+ * @tparam Align
+ */
+template<typename T, std::size_t Align>
+struct AlignedAllocator {
+    using value_type = T;
+
+    template<typename U>
+    struct rebind {using other = AlignedAllocator<U, Align>;};
+
+    AlignedAllocator() noexcept = default;
+    template<typename U>
+    AlignedAllocator(const AlignedAllocator<U, Align>&) noexcept {}
+
+    T* allocate(std::size_t n) {
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t{Align}));
+    }
+
+    void deallocate(T* p, std::size_t) noexcept {
+        ::operator delete(p, std::align_val_t{Align});
+    }
+
+    template<typename U>
+    bool operator==(const AlignedAllocator<U, Align>&) const noexcept {return true;}
+    template<typename U>
+    bool operator!=(const AlignedAllocator<U, Align>&) const noexcept {return false;}
+};
+
+// neighbor offsets in the Dirmap order of cs_model2_common.sh, the opposite of d is (d + 4) % 8
+constexpr int DirmapDX[8] = {-1, 0, 1, 1, 1, 0, -1, -1};
+constexpr int DirmapDY[8] = {1, 1, 1, 0, -1, -1, -1, 0};
+
+/**
+ * @brief values of a cell and its 8 neighbors in one plane, in Dirmap order. Neighbors outside
+ * the grid take the value of the nearest edge cell and are cleared in the valid mask.
+ *
+ * @tparam T
+ */
+template<typename T>
+struct PlaneNeighborhood {
+    T center;
+    // adjacent[d] is the cell at (x + DirmapDX[d], y + DirmapDY[d])
+    std::array<T, 8> adjacent;
+    // bit d set when adjacent[d] is inside the grid
+    uint8_t valid;
+
+    static constexpr int opposite(int d) {return (d + 4) % 8;}
+
+    bool isValid(int d) const {return valid & (1u << d);}
+};
+
+/**
+ * @brief view of a single plane of an SoAGrid. Rows are Stride elements apart and every row
+ * starts on a 64 byte boundary.
+ *
+ * @tparam T float or const float
+ */
+template<typename T>
+class PlaneView {
+public:
+    using value_type = std::remove_const_t<T>;
+
+    PlaneView(T* data, int width, int height, int stride) :
+        data{data}, width{width}, height{height}, stride{stride} {}
+
+    template<typename U, typename = std::enable_if_t<std::is_same_v<const U, T>>>
+    PlaneView(const PlaneView<U>& o) :
+        data{o.row(0)}, width{o.getWidth()}, height{o.getHeight()}, stride{o.getStride()} {}
+
+    T* row(int y) const {return data + (std::ptrdiff_t)y * stride;}
+    T& at(int x, int y) const {return row(y)[x];}
+
+    value_type clampedAt(int x, int y) const {
+        return at(std::clamp(x, 0, width - 1), std::clamp(y, 0, height - 1));
+    }
+
+    bool contains(int x, int y) const {return x >= 0 && x < width && y >= 0 && y < height;}
+
+    PlaneNeighborhood<value_type> neighborhoodOf(int x, int y) const {
+        PlaneNeighborhood<value_type> n;
+        n.center = at(x, y);
+        n.valid = 0;
+        for (int d = 0; d < 8; ++d) {
+            const int nx = x + DirmapDX[d];
+            const int ny = y + DirmapDY[d];
+            if (contains(nx, ny))
+                n.valid |= 1u << d;
+            n.adjacent[d] = clampedAt(nx, ny);
+        }
+        return n;
+    }
+
+    int getWidth() const {return width;}
+    int getHeight() const {return height;}
+    int getStride() const {return stride;}
+
+private:
+    T* data;
+    int width;
+    int height;
+    int stride;
+};
+
+/**
+ * @brief single plane field set for scalar grids
+ *
+ */
+enum class ScalarField : uint8_t {
+    Value,
+    Count
+};
+
+/**
+ * @brief Structure of arrays grid. Each field of Field is stored as its own contiguous plane so a
+ * kernel only streams the planes it touches. Planes and rows are aligned to 64 bytes and rows are
+ * padded to a multiple of Lanes elements. Padding is zero filled so SIMD kernels may run over a
+ * full row.
+ *
+ * @tparam Field enum class of plane names, terminated with Count
+ * @tparam T element type
+ */
+template<typename Field, typename T = float>
+class SoAGrid {
+public:
+    static constexpr std::size_t Alignment = 64;
+    static constexpr int Lanes = Alignment / sizeof(T);
+    static constexpr std::size_t NumFields = static_cast<std::size_t>(Field::Count);
+
+    SoAGrid() = default;
+    SoAGrid(int width, int height) {resize(width, height);}
+
+    void resize(int width, int height) {
+        w = width;
+        h = height;
+        stride = (width + Lanes - 1) / Lanes * Lanes;
+        plane_size = (std::size_t)stride * height;
+        storage.assign(plane_size * NumFields, T{});
+    }
+
+    int getWidth() const {return w;}
+    int getHeight() const {return h;}
+    int getStride() const {return stride;}
+    vec2i getSize() const {return {w, h};}
+    std::size_t getPlaneSize() const {return plane_size;}
+
+    T* data(Field f) {return storage.data() + plane_size * static_cast<std::size_t>(f);}
+    const T* data(Field f) const {return storage.data() + plane_size * static_cast<std::size_t>(f);}
+
+    PlaneView<T> plane(Field f) {return {data(f), w, h, stride};}
+    PlaneView<const T> plane(Field f) const {return {data(f), w, h, stride};}
+
+    T& at(Field f, int x, int y) {return data(f)[(std::ptrdiff_t)y * stride + x];}
+    const T& at(Field f, int x, int y) const {return data(f)[(std::ptrdiff_t)y * stride + x];}
+
+    std::size_t index(int x, int y) const {return (std::size_t)y * stride + x;}
+
+    /**
+     * @brief xxHash64 of every plane in field order. Row padding is skipped, so the hash only
+     * depends on the cell values.
+     *
+     * @return uint64_t
+     */
+    uint64_t hash() const {
+        util::XXHash64 h;
+        for (std::size_t f = 0; f < NumFields; ++f)
+            for (int y = 0; y < this->h; ++y)
+                h.update(data(static_cast<Field>(f)) + index(0, y), sizeof(T) * w);
+        return h.digest();
+    }
+
+    void fill(Field f, T value) {
+        for (int y = 0; y < h; ++y)
+            std::fill_n(data(f) + index(0, y), w, value);
+    }
+
+    /**
+     * @brief copy from interleaved 4 channel data such as the RGBA32F Terrain texture.
+     * Channels mapped to Field::Count are skipped.
+     *
+     * @param rgba width * height * 4 values
+     * @param channels field for each of the r, g, b, a channels
+     * @param scale multiplied with every loaded value
+     */
+    void copyFromRGBA(const float* rgba, const std::array<Field, 4>& channels, float scale = 1.0f) {
+        for (int c = 0; c < 4; ++c) {
+            if (channels[c] == Field::Count)
+                continue;
+            T* dst = data(channels[c]);
+            for (int y = 0; y < h; ++y) {
+                const float* src = rgba + 4 * (std::size_t)y * w + c;
+                T* drow = dst + index(0, y);
+                for (int x = 0; x < w; ++x)
+                    drow[x] = static_cast<T>(src[4 * x] * scale);
+            }
+        }
+    }
+
+    /**
+     * @brief copy to interleaved 4 channel data such as the RGBA32F Terrain texture.
+     * Channels mapped to Field::Count are left unchanged.
+     *
+     * @param rgba width * height * 4 values
+     * @param channels field for each of the r, g, b, a channels
+     * @param scale multiplied with every stored value
+     */
+    void copyToRGBA(float* rgba, const std::array<Field, 4>& channels, float scale = 1.0f) const {
+        for (int c = 0; c < 4; ++c) {
+            if (channels[c] == Field::Count)
+                continue;
+            const T* src = data(channels[c]);
+            for (int y = 0; y < h; ++y) {
+                float* dst = rgba + 4 * (std::size_t)y * w + c;
+                const T* srow = src + index(0, y);
+                for (int x = 0; x < w; ++x)
+                    dst[4 * x] = static_cast<float>(srow[x]) * scale;
+            }
+        }
+    }
+
+private:
+    int w = 0;
+    int h = 0;
+    int stride = 0;
+    std::size_t plane_size = 0;
+    std::vector<T, AlignedAllocator<T, Alignment>> storage;
+};
+
+}
+
+#endif // DIRTBOX_SOA_GRID_H
@@ -0,0 +1,277 @@
+#include <terrain/stream_power_cpu.h>
+
+#include <cmath>
+#include <queue>
+#include <limits>
+#include <utility>
+#include <algorithm>
+#include <functional>
+
+namespace dirtbox::terrain {
+
+namespace {
+
+// the 8 neighbors, axis aligned ones first
+constexpr int NeighborX[8] = {1, 0, -1, 0, 1, -1, -1, 1};
+constexpr int NeighborY[8] = {0, 1, 0, -1, 1, 1, -1, -1};
+
+bool on_border(int x, int y, int w, int h) {
+    return x == 0 || y == 0 || x == w - 1 || y == h - 1;
+}
+
+// smallest float above h, keeps a strict descent towards the receiver
+float above(float h) {
+    return std::nextafter(h, std::numeric_limits<float>::infinity());
+}
+
+/**
+ * @brief height of a cell after an implicit step against its receiver, solving
+ * h - h_up + F (h - h_r)^n = 0 with h_up the cell height after uplift
+ *
+ */
+double implicit_height(double h_up, double h_r, double F, double n) {
+    const double drop = h_up - h_r;
+    if (drop <= 0)
+        return h_r;
+    if (n == 1.0)
+        return h_r + drop / (1 + F);
+    // Newton iteration on the drop to the receiver, f is monotonic in x > 0
+    double x = drop;
+    for (int i = 0; i < 20; ++i) {
+        const double f = x + F * std::pow(x, n) - drop;
+        const double df = 1 + n * F * std::pow(x, n - 1);
+        double next = x - f / df;
+        if (next <= 0)
+            next = 0.5 * x;
+        const bool done = std::abs(next - x) <= 1e-6 * drop;
+        x = next;
+        if (done)
+            break;
+    }
+    return h_r + x;
+}
+
+}
+
+StreamPowerModelCPU::StreamPowerModelCPU(const StreamPowerParameters& params, float cell_size, float elevation_scale) :
+    params{params}, cell_size{cell_size}, elevation_scale{elevation_scale} {
+}
+
+void StreamPowerModelCPU::init(int width, int height, const float* rgba) {
+    state.resize(width, height);
+    state.copyFromRGBA(rgba, {StreamPowerField::Ground, StreamPowerField::Sand, StreamPowerField::Count, StreamPowerField::Count}, elevation_scale);
+    float highest = 0;
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            float& ground = state.at(StreamPowerField::Ground, x, y);
+            ground += state.at(StreamPowerField::Sand, x, y);
+            highest = std::max(highest, ground);
+        }
+    }
+    // uplift follows the input terrain so its ranges keep growing while rivers cut into them,
+    // the base level does not move
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            const float relative = highest > 0 ? std::clamp(state.at(StreamPowerField::Ground, x, y) / highest, 0.0f, 1.0f) : 0.0f;
+            state.at(StreamPowerField::Uplift, x, y) = on_border(x, y, width, height) ? 0.0f : params.uplift_rate * relative;
+        }
+    }
+
+    receivers.assign(state.getPlaneSize(), 0);
+    band_roots.assign((height + BandRows - 1) / BandRows, {});
+    iteration = 0;
+    fill_depressions();
+}
+
+void StreamPowerModelCPU::fill_depressions() {
+    const int w = state.getWidth();
+    const int h = state.getHeight();
+    const int stride = state.getStride();
+    float* ground = state.data(StreamPowerField::Ground);
+    float* sand = state.data(StreamPowerField::Sand);
+
+    // ties are broken by index so the fill does not depend on the queue implementation
+    using Entry = std::pair<float, int32_t>;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> open;
+    // cells raised to just above the cell they were reached from, processed before open
+    std::queue<int32_t> pit;
+    std::vector<uint8_t> closed(state.getPlaneSize(), 0);
+
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            if (!on_border(x, y, w, h))
+                continue;
+            const int32_t i = (int32_t)state.index(x, y);
+            closed[i] = 1;
+            open.push({ground[i], i});
+        }
+    }
+
+    filled_cells = 0;
+    while (!open.empty() || !pit.empty()) {
+        int32_t c;
+        if (!pit.empty()) {
+            c = pit.front();
+            pit.pop();
+        } else {
+            c = open.top().second;
+            open.pop();
+        }
+        const int cx = c % stride;
+        const int cy = c / stride;
+        for (int k = 0; k < 8; ++k) {
+            const int nx = cx + NeighborX[k];
+            const int ny = cy + NeighborY[k];
+            if (nx < 0 || ny < 0 || nx >= w || ny >= h)
+                continue;
+            const int32_t n = (int32_t)state.index(nx, ny);
+            if (closed[n])
+                continue;
+            closed[n] = 1;
+            const float floor = above(ground[c]);
+            if (ground[n] < floor) {
+                sand[n] += floor - ground[n];
+                ground[n] = floor;
+                filled_cells++;
+                pit.push(n);
+            } else {
+                open.push({ground[n], n});
+            }
+        }
+    }
+}
+
+void StreamPowerModelCPU::route(int y0, int y1) {
+    const int w = state.getWidth();
+    const int h = state.getHeight();
+    const float* ground = state.data(StreamPowerField::Ground);
+    const float diagonal = cell_size * std::sqrt(2.0f);
+
+    std::vector<int32_t>& band = band_roots[y0 / BandRows];
+    band.clear();
+    for (int y = y0; y < y1; ++y) {
+        for (int x = 0; x < w; ++x) {
+            const int32_t i = (int32_t)state.index(x, y);
+            int32_t receiver = i;
+            if (!on_border(x, y, w, h)) {
+                float steepest = 0;
+                for (int k = 0; k < 8; ++k) {
+                    const int32_t n = (int32_t)state.index(x + NeighborX[k], y + NeighborY[k]);
+                    const float slope = (ground[i] - ground[n]) / (k < 4 ? cell_size : diagonal);
+                    if (slope > steepest) {
+                        steepest = slope;
+                        receiver = n;
+                    }
+                }
+            }
+            receivers[i] = receiver;
+            // the border and cells without a lower neighbor, such as non-finite ones
+            if (receiver == i)
+                band.push_back(i);
+        }
+    }
+}
+
+void StreamPowerModelCPU::solve_basins(std::vector<int32_t>& order, std::size_t r0, std::size_t r1) {
+    const int w = state.getWidth();
+    const int h = state.getHeight();
+    const int stride = state.getStride();
+    float* ground = state.data(StreamPowerField::Ground);
+    float* sand = state.data(StreamPowerField::Sand);
+    float* area = state.data(StreamPowerField::Area);
+    const float* uplift = state.data(StreamPowerField::Uplift);
+
+    const float cell_area = cell_size * cell_size;
+    const double dt = params.time_step;
+    const double m = params.area_exponent;
+    const double n = params.slope_exponent;
+    const double K = params.erodibility;
+    const double axis_scale = 1.0 / std::pow((double)cell_size, n);
+    const double diagonal_scale = 1.0 / std::pow(cell_size * std::sqrt(2.0), n);
+
+    std::ptrdiff_t offsets[8];
+    for (int j = 0; j < 8; ++j)
+        offsets[j] = (std::ptrdiff_t)NeighborY[j] * stride + NeighborX[j];
+
+    order.clear();
+    for (std::size_t r = r0; r < r1; ++r) {
+        // breadth first over the donors, every cell comes after its receiver
+        const int32_t root = roots[r];
+        const std::size_t begin = order.size();
+        order.push_back(root);
+        area[root] = cell_area;
+        const int rx = root % stride;
+        const int ry = root / stride;
+        for (int j = 0; j < 8; ++j) {
+            const int nx = rx + NeighborX[j];
+            const int ny = ry + NeighborY[j];
+            if (nx < 0 || ny < 0 || nx >= w || ny >= h)
+                continue;
+            const int32_t d = (int32_t)state.index(nx, ny);
+            if (receivers[d] == root && d != root)
+                order.push_back(d);
+        }
+        // border cells are roots, so the donors below have all 8 neighbors in the grid
+        for (std::size_t k = begin + 1; k < order.size(); ++k) {
+            const int32_t c = order[k];
+            area[c] = cell_area;
+            for (int j = 0; j < 8; ++j)
+                if (receivers[c + offsets[j]] == c)
+                    order.push_back((int32_t)(c + offsets[j]));
+        }
+
+        for (std::size_t k = order.size(); k-- > begin + 1;) {
+            const int32_t c = order[k];
+            area[receivers[c]] += area[c];
+        }
+
+        for (std::size_t k = begin + 1; k < order.size(); ++k) {
+            const int32_t c = order[k];
+            const int32_t r = receivers[c];
+            const std::ptrdiff_t step = std::abs((std::ptrdiff_t)r - c);
+            const double distance_scale = step == 1 || step == stride ? axis_scale : diagonal_scale;
+            const double F = K * dt * std::pow(area[c], (float)m) * distance_scale;
+
+            const float lifted = ground[c] + uplift[c] * (float)dt;
+            // never at or below the receiver, lakes fill with sand
+            const float target = std::max((float)implicit_height(lifted, ground[r], F, n), above(ground[r]));
+            // uplift raises the rock, erosion takes the sand first
+            const float change = target - lifted;
+            sand[c] = change < 0 ? std::max(0.0f, sand[c] + change) : sand[c] + change;
+            ground[c] = target;
+        }
+    }
+}
+
+void StreamPowerModelCPU::step() {
+    const int h = state.getHeight();
+    pool->parallel_for(0, (int)band_roots.size(), [this, h](int b) {
+        route(b * BandRows, std::min(h, (b + 1) * BandRows));
+    });
+    roots.clear();
+    for (const auto& band : band_roots)
+        roots.insert(roots.end(), band.begin(), band.end());
+
+    const int tasks = (int)((roots.size() + BasinsPerTask - 1) / BasinsPerTask);
+    if ((int)orders.size() < tasks)
+        orders.resize(tasks);
+    pool->parallel_for(0, tasks, [this](int t) {
+        const std::size_t r0 = (std::size_t)t * BasinsPerTask;
+        solve_basins(orders[t], r0, std::min(roots.size(), r0 + BasinsPerTask));
+    });
+    iteration++;
+}
+
+void StreamPowerModelCPU::copyTo(float* rgba) const {
+    const float inv_scale = 1.0f / elevation_scale;
+    for (int y = 0; y < state.getHeight(); ++y) {
+        for (int x = 0; x < state.getWidth(); ++x) {
+            float* cell = rgba + 4 * ((std::size_t)y * state.getWidth() + x);
+            const float sand = state.at(StreamPowerField::Sand, x, y);
+            cell[0] = (state.at(StreamPowerField::Ground, x, y) - sand) * inv_scale;
+            cell[1] = sand * inv_scale;
+        }
+    }
+}
+
+}
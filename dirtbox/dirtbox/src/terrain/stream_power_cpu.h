@@ -0,0 +1,171 @@
+/**
+ * @author Hunter Borlik
+ * @brief implicit stream power law erosion with uplift for large scale landforms
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ */
+#pragma once
+#ifndef DIRTBOX_STREAM_POWER_CPU_H
+#define DIRTBOX_STREAM_POWER_CPU_H
+
+#include <vector>
+#include <cstdint>
+
+#include <util/parameter.h>
+#include <util/thread_pool.h>
+#include <terrain/soa_grid.h>
+
+namespace dirtbox::terrain {
+
+/**
+ * @brief settings of the stream power solver. Cell size and elevation scale come from the engine
+ *
+ */
+struct StreamPowerParameters {
+    // implicit sweeps, one time step each. 0 disables the stream power pass of engines that run
+    // it before the pipe model
+    float sweeps            = 40;
+    // years per sweep
+    float time_step         = 10000;
+    // m per year at the highest point of the input terrain, scaled by the input height elsewhere
+    float uplift_rate       = 0.0001f;
+    // K in dh/dt = U - K A^m S^n
+    float erodibility       = 0.00001f;
+    float area_exponent     = 0.45f;
+    float slope_exponent    = 1.0f;
+
+    void toParameterSet(util::ParameterCollection<float>& parameters) {
+        parameters.addParameter("stream_power_sweeps", 0, 500, sweeps);
+        parameters.addParameter("stream_power_time_step", 100, 100000, time_step);
+        parameters.addParameter("uplift_rate", 0, 0.005f, uplift_rate);
+        parameters.addParameter("erodibility", 0.0000001f, 0.001f, erodibility);
+        parameters.addParameter("area_exponent", 0.2f, 1.0f, area_exponent);
+        parameters.addParameter("slope_exponent", 0.5f, 2.0f, slope_exponent);
+    }
+
+    void fromParameterSet(const util::ParameterCollection<float>& p) {
+        sweeps          = p.getParam("stream_power_sweeps");
+        time_step       = p.getParam("stream_power_time_step");
+        uplift_rate     = p.getParam("uplift_rate");
+        erodibility     = p.getParam("erodibility");
+        area_exponent   = p.getParam("area_exponent");
+        slope_exponent  = p.getParam("slope_exponent");
+    }
+};
+
+/**
+ * @brief stream power state planes, elevations in meters
+ *
+ */
+enum class StreamPowerField : uint8_t {
+    Ground,     // rock and sand
+    Sand,       // loose layer on top of the rock, eroded first
+    Uplift,     // m per year
+    Area,       // drainage area, m^2
+    Count
+};
+
+using StreamPowerGrid = SoAGrid<StreamPowerField>;
+
+/**
+ * @brief Implicit solver of the stream power law dh/dt = U - K A^m S^n (Braun and Willett 2013),
+ * for carving drainage networks into large terrains in a few dozen sweeps instead of the many
+ * thousands of steps the pipe model needs. Has no dependency on the renderer.
+ *
+ * Every sweep routes each cell to its steepest descent neighbor of 8 (its receiver), walks the
+ * receiver trees from their base level breadth first so receivers come before their donors,
+ * accumulates drainage area in reverse order and solves the implicit update of each cell against
+ * its already updated receiver. All of it is O(n). The border is the fixed base level.
+ *
+ * init fills closed depressions with sand (priority flood with epsilon gradients) so every cell
+ * drains to the border. A sweep never lowers a cell to or below its receiver, so no depressions
+ * form again. The water and sediment layers are left untouched.
+ *
+ * Drainage basins are independent, so basins run concurrently on util::ThreadPool in fixed
+ * groups, each of them sequentially. Results are bit identical for any number of threads, but a
+ * single basin draining most of the map does not run faster with more threads.
+ *
+ */
+class StreamPowerModelCPU {
+public:
+    // rows per work item of the routing pass
+    static constexpr int BandRows = 32;
+    // base level cells per work item of the basin pass
+    static constexpr int BasinsPerTask = 16;
+    // bytes read and written per cell by a sweep, for throughput stats
+    static constexpr int StepBytesPerCell = sizeof(float) * (2 * StreamPowerGrid::NumFields) + 3 * sizeof(int32_t);
+
+    StreamPowerModelCPU(const StreamPowerParameters& params, float cell_size, float elevation_scale);
+
+    /**
+     * @brief initialize from terrain data and fill closed depressions
+     *
+     * @param width
+     * @param height
+     * @param rgba terrain RGBA32F texture data, width * height * 4 floats
+     */
+    void init(int width, int height, const float* rgba);
+
+    /**
+     * @brief run one sweep of time_step years
+     *
+     */
+    void step();
+
+    /**
+     * @brief write the rock and sand layers into the terrain RGBA32F texture layout. Water and
+     * sediment are left unchanged.
+     *
+     * @param rgba width * height * 4 floats
+     */
+    void copyTo(float* rgba) const;
+
+    /**
+     * @brief pool the basins run on. Results do not depend on the pool size
+     *
+     * @param pool
+     */
+    void setThreadPool(util::ThreadPool& pool) {this->pool = &pool;}
+
+    uint64_t getStateHash() const {return state.hash();}
+
+    int getWidth() const {return state.getWidth();}
+    int getHeight() const {return state.getHeight();}
+    uint32_t getIteration() const {return iteration;}
+    // drainage basins of the last sweep
+    std::size_t getBasins() const {return roots.size();}
+    // cells raised by init to fill depressions
+    uint64_t getFilledCells() const {return filled_cells;}
+    const StreamPowerParameters& getParameters() const {return params;}
+
+    const StreamPowerGrid& getState() const {return state;}
+
+private:
+    // steepest descent receivers of rows [y0, y1)
+    void route(int y0, int y1);
+    // stack order, drainage area and height update of the basins of roots [r0, r1)
+    void solve_basins(std::vector<int32_t>& order, std::size_t r0, std::size_t r1);
+    // raise closed depressions to drain to the border
+    void fill_depressions();
+
+    StreamPowerParameters params;
+    float cell_size;
+    float elevation_scale;
+    util::ThreadPool* pool = &util::ThreadPool::Get();
+    uint32_t iteration = 0;
+    uint64_t filled_cells = 0;
+
+    StreamPowerGrid state;
+    // receiver of every cell as a plane index, the cell itself at the base level
+    std::vector<int32_t> receivers;
+    std::vector<int32_t> roots;
+    // per routing band, then concatenated into roots in band order
+    std::vector<std::vector<int32_t>> band_roots;
+    // stack order scratch per basin task, reused across sweeps
+    std::vector<std::vector<int32_t>> orders;
+};
+
+}
+
+#endif // DIRTBOX_STREAM_POWER_CPU_H
@@ -0,0 +1,43 @@
+#include <terrain/stream_power_erosion.h>
+
+#include <limits>
+#include <chrono>
+
+#include <terrain/stream_power_cpu.h>
+
+namespace dirtbox::terrain {
+
+StreamPowerSimulation::StreamPowerSimulation(std::shared_ptr<Terrain> target)
+    : CPUErosion{"StreamPowerSimulation", std::move(target)}
+{
+    StreamPowerParameters{}.toParameterSet(parameters);
+    // same names and ranges as the Erosion2 parameters
+    parameters.addParameter("cell_size", 0.5f, 150.0f, 30.0f);
+    parameters.addParameter("terrain_elevation_scale", 1, 500, 100);
+}
+
+// on task thread
+void StreamPowerSimulation::runErosion(resource::ImageData& terrain, std::atomic_uint32_t& progress, const std::future<void>& kill_me) {
+    StreamPowerParameters params;
+    params.fromParameterSet(taskParameters());
+
+    StreamPowerModelCPU model{params, taskParameters().getParam("cell_size"), taskParameters().getParam("terrain_elevation_scale")};
+    float* data = static_cast<float*>(terrain.get()->m_data);
+    model.init(terrain.getWidth(), terrain.getHeight(), data);
+
+    const int sweeps = (int)params.sweeps;
+    const uint64_t cells = (uint64_t)terrain.getWidth() * terrain.getHeight();
+    while ((int)model.getIteration() < sweeps && !stopRequested(kill_me)) {
+        const auto start = std::chrono::steady_clock::now();
+        model.step();
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        const float done_fraction = (float)model.getIteration() / sweeps;
+        progress.store(done_fraction * std::numeric_limits<uint32_t>::max());
+        stats.addSteps(1, cells, cells * StreamPowerModelCPU::StepBytesPerCell, seconds, done_fraction);
+        if (snapshotDue())
+            publishSnapshot([&](float* rgba) {model.copyTo(rgba);});
+    }
+    model.copyTo(data);
+}
+
+}
@@ -0,0 +1,32 @@
+/**
+ * @author Hunter Borlik
+ * @brief stream power erosion engine for large scale landforms
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ */
+#pragma once
+#ifndef DIRTBOX_STREAM_POWER_EROSION_H
+#define DIRTBOX_STREAM_POWER_EROSION_H
+
+#include <terrain/erosion_cpu.h>
+
+namespace dirtbox::terrain {
+
+/**
+ * @brief Carves drainage networks with StreamPowerModelCPU in a few dozen implicit sweeps. Meant
+ * for large base terrains before the detailed pipe model, which the Erosion2 CPU engines can also
+ * run it ahead of with their stream_power_sweeps parameter
+ *
+ */
+class StreamPowerSimulation : public CPUErosion {
+public:
+    StreamPowerSimulation(std::shared_ptr<Terrain> target);
+
+protected:
+    void runErosion(resource::ImageData& terrain, std::atomic_uint32_t& progress, const std::future<void>& kill_me) override;
+};
+
+}
+
+#endif // DIRTBOX_STREAM_POWER_EROSION_H
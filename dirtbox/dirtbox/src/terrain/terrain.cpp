@@ -1,6 +1,9 @@
 #include <terrain/terrain.h>
 #include <terrain/terrain_manager.h>
 #include <terrain/erosion_model2.h>
+#include <terrain/etes_erosion.h>
+#include <terrain/stream_power_erosion.h>
+#include <terrain/droplet_erosion.h>
 #include <resource/resource_manager.h>
 #include <core/core.h>
 
@@ -42,6 +45,18 @@ bool Terrain::setTerrainData(const resource::ImageData& image) {
     return m_terrain->setImageData(img, 0, 0, img.getWidth(), img.getHeight());
 }
 
+bool Terrain::updateTerrainData(const resource::ImageData& image) {
+    if (image.getFormat() != bimg::TextureFormat::RGBA32F || vec2u{image.getWidth(), image.getHeight()} != getSize())
+        return false;
+    return m_terrain->setImageData(image, 0, 0, image.getWidth(), image.getHeight());
+}
+
+bool Terrain::updateTerrainRegion(const resource::ImageData& image, uint32_t x, uint32_t y) {
+    if (image.getFormat() != bimg::TextureFormat::RGBA32F || x + image.getWidth() > getSize().x() || y + image.getHeight() > getSize().y())
+        return false;
+    return m_terrain->setImageData(image, x, y, image.getWidth(), image.getHeight());
+}
+
 vec2u Terrain::getSize() const {
     return m_terrain->getDim().xy();
 }
@@ -55,6 +70,18 @@ TerrainManager::TerrainManager(const vec2u& size) :
 std::unique_ptr<Erosion> TerrainManager::createErosion(const std::string& name) {
     if (name == "Erosion2SimulationGPU")
         return std::make_unique<Erosion2SimulationGPU>(m_terrain);
+    if (name == "Erosion2SimulationCPU")
+        return std::make_unique<Erosion2SimulationCPU>(m_terrain);
+    if (name == "Erosion2PyramidSimulation")
+        return std::make_unique<Erosion2PyramidSimulation>(m_terrain);
+    if (name == "EcosystemTerrainErosionSimulation")
+        return std::make_unique<EcosystemTerrainErosionSimulation>(m_terrain);
+    if (name == "EcosystemTerrainErosionSimulationGPU")
+        return std::make_unique<EcosystemTerrainErosionSimulationGPU>(m_terrain);
+    if (name == "StreamPowerSimulation")
+        return std::make_unique<StreamPowerSimulation>(m_terrain);
+    if (name == "DropletErosionSimulation")
+        return std::make_unique<DropletErosionSimulation>(m_terrain);
     return {};
 }
 
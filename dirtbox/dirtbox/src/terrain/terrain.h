@@ -25,6 +25,23 @@ public:
     bool loadTerrain(const std::string& filename);
     void saveTerrain(const std::string& filename);
     bool setTerrainData(const resource::ImageData& image);
+    /**
+     * @brief upload RGBA32F terrain layers as they are. Image must match the terrain size
+     * 
+     * @param image 
+     * @return true on success
+     */
+    bool updateTerrainData(const resource::ImageData& image);
+    /**
+     * @brief upload RGBA32F terrain layers to the cells starting at (x, y). Image must fit in
+     * the terrain
+     * 
+     * @param image 
+     * @param x 
+     * @param y 
+     * @return true on success
+     */
+    bool updateTerrainRegion(const resource::ImageData& image, uint32_t x, uint32_t y);
     vec2u getSize() const;
     const graphics::Texture& getTerrainTexture() const {return *m_terrain;}
 
@@ -0,0 +1,129 @@
+/**
+ * @author Hunter Borlik
+ * @brief rectangular regions of the terrain for incremental erosion around edits
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ */
+#pragma once
+#ifndef DIRTBOX_TERRAIN_REGION_H
+#define DIRTBOX_TERRAIN_REGION_H
+
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+
+#include <util/parameter.h>
+
+namespace dirtbox::terrain {
+
+/**
+ * @brief cells [x0, x1) x [y0, y1) of the terrain
+ *
+ */
+struct TerrainRegion {
+    int x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+
+    int width() const {return x1 - x0;}
+    int height() const {return y1 - y0;}
+    bool empty() const {return x1 <= x0 || y1 <= y0;}
+
+    // the part inside a width x height grid
+    TerrainRegion clamped(int width, int height) const {
+        return {std::clamp(x0, 0, width), std::clamp(y0, 0, height), std::clamp(x1, 0, width), std::clamp(y1, 0, height)};
+    }
+
+    // margin cells more on every side, cut off at the grid border
+    TerrainRegion grown(int margin, int width, int height) const {
+        return TerrainRegion{x0 - margin, y0 - margin, x1 + margin, y1 + margin}.clamped(width, height);
+    }
+};
+
+/**
+ * @brief settings of incremental runs, on top of the engine parameters
+ *
+ */
+struct IncrementalErosionParameters {
+    // cells simulated around the edited region; the result fades out over them
+    float influence_margin          = 32;
+    float incremental_iterations    = 200;
+
+    void toParameterSet(util::ParameterCollection<float>& parameters) {
+        parameters.addParameter("influence_margin", 0, 256, influence_margin);
+        parameters.addParameter("incremental_iterations", 1, 5000, incremental_iterations);
+    }
+
+    void fromParameterSet(const util::ParameterCollection<float>& p) {
+        influence_margin        = p.getParam("influence_margin");
+        incremental_iterations  = p.getParam("incremental_iterations");
+    }
+};
+
+/**
+ * @brief An incremental run: the edited cells and the window simulated around them
+ *
+ */
+struct IncrementalRegion {
+    TerrainRegion dirty;
+    // dirty grown by margin
+    TerrainRegion window;
+    int margin = 0;
+    // size of the terrain the regions are in
+    int width = 0;
+    int height = 0;
+};
+
+/**
+ * @brief copy a region of interleaved RGBA data
+ *
+ * @param rgba width * height * 4 floats
+ * @param width
+ * @param region
+ * @return std::vector<float> region.width() * region.height() * 4 floats
+ */
+inline std::vector<float> cropRGBA(const float* rgba, int width, const TerrainRegion& region) {
+    std::vector<float> out((std::size_t)region.width() * region.height() * 4);
+    for (int y = 0; y < region.height(); ++y) {
+        const float* src = rgba + 4 * ((std::size_t)(region.y0 + y) * width + region.x0);
+        std::copy(src, src + 4 * region.width(), out.begin() + 4 * (std::size_t)y * region.width());
+    }
+    return out;
+}
+
+/**
+ * @brief share of the incremental result kept at (x, y). 1 inside the dirty region, falls
+ * smoothly to 0 at margin cells from it, where the window boundary has cut off the flow
+ *
+ */
+inline float regionBlendWeight(const TerrainRegion& dirty, int margin, int x, int y) {
+    const int d = std::max({dirty.x0 - x, x - (dirty.x1 - 1), dirty.y0 - y, y - (dirty.y1 - 1), 0});
+    if (margin <= 0)
+        return d == 0 ? 1.0f : 0.0f;
+    const float t = std::clamp(1.0f - (float)d / margin, 0.0f, 1.0f);
+    return t * t * (3 - 2 * t);
+}
+
+/**
+ * @brief blend the result of an incremental run into interleaved RGBA data
+ *
+ * @param rgba width * height * 4 floats
+ * @param width
+ * @param region dirty and window region of the run
+ * @param result window.width() * window.height() * 4 floats
+ */
+inline void blendRGBA(float* rgba, int width, const IncrementalRegion& region, const float* result) {
+    const TerrainRegion& window = region.window;
+    for (int y = window.y0; y < window.y1; ++y) {
+        for (int x = window.x0; x < window.x1; ++x) {
+            const float a = regionBlendWeight(region.dirty, region.margin, x, y);
+            float* dst = rgba + 4 * ((std::size_t)y * width + x);
+            const float* src = result + 4 * ((std::size_t)(y - window.y0) * window.width() + (x - window.x0));
+            for (int c = 0; c < 4; ++c)
+                dst[c] += (src[c] - dst[c]) * a;
+        }
+    }
+}
+
+}
+
+#endif // DIRTBOX_TERRAIN_REGION_H
@@ -0,0 +1,110 @@
+/**
+ * @author Hunter Borlik
+ * @brief stateless counter based random numbers for the CPU simulations
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ */
+#pragma once
+#ifndef UTIL_COUNTER_RNG_H
+#define UTIL_COUNTER_RNG_H
+
+#include <array>
+#include <cstdint>
+#include <limits>
+
+namespace util {
+
+/**
+ * @brief Philox4x32-10 block function (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3").
+ * Maps a 128 bit counter and a 64 bit key to 128 random bits. The same inputs always give the same
+ * output, so there is no generator state to share between threads.
+ *
+ * @param ctr
+ * @param key
+ * @return std::array<uint32_t, 4>
+ */
+inline std::array<uint32_t, 4> philox4x32(std::array<uint32_t, 4> ctr, std::array<uint32_t, 2> key) {
+    constexpr uint32_t M0 = 0xD2511F53u;
+    constexpr uint32_t M1 = 0xCD9E8D57u;
+    constexpr uint32_t W0 = 0x9E3779B9u;
+    constexpr uint32_t W1 = 0xBB67AE85u;
+
+    for (int round = 0; round < 10; ++round) {
+        const uint64_t p0 = (uint64_t)M0 * ctr[0];
+        const uint64_t p1 = (uint64_t)M1 * ctr[2];
+        ctr = {
+            (uint32_t)(p1 >> 32) ^ ctr[1] ^ key[0],
+            (uint32_t)p1,
+            (uint32_t)(p0 >> 32) ^ ctr[3] ^ key[1],
+            (uint32_t)p0
+        };
+        key[0] += W0;
+        key[1] += W1;
+    }
+    return ctr;
+}
+
+/**
+ * @brief uniform float in [0, 1) from the upper 24 bits of x
+ *
+ * @param x
+ * @return float
+ */
+inline float uniform_float(uint32_t x) {
+    return (x >> 8) * (1.0f / 16777216.0f);
+}
+
+/**
+ * @brief Random stream keyed by (seed, iteration, cell, stream). Two generators with the same key
+ * produce the same sequence, generators with different keys are independent. Lives on the stack
+ * and never allocates, so every event or work item can construct its own.
+ *
+ * Satisfies UniformRandomBitGenerator. Prefer uniform() and uniformInt() over the std
+ * distributions; their results are implementation defined and may draw a varying number of values.
+ *
+ */
+class CounterRNG {
+public:
+    using result_type = uint32_t;
+
+    CounterRNG(uint32_t seed, uint32_t iteration, uint32_t cell, uint32_t stream = 0) :
+        key{seed, iteration}, ctr{0, cell, stream, 0} {}
+
+    result_type operator()() {
+        if (used == 4) {
+            block = philox4x32(ctr, key);
+            ctr[0]++;
+            used = 0;
+        }
+        return block[used++];
+    }
+
+    /**
+     * @brief uniform float in [0, 1)
+     *
+     * @return float
+     */
+    float uniform() {return uniform_float((*this)());}
+
+    /**
+     * @brief uniform integer in [0, n), n > 0
+     *
+     * @param n
+     * @return uint32_t
+     */
+    uint32_t uniformInt(uint32_t n) {return (uint32_t)(((uint64_t)(*this)() * n) >> 32);}
+
+    static constexpr result_type min() {return 0;}
+    static constexpr result_type max() {return std::numeric_limits<result_type>::max();}
+
+private:
+    std::array<uint32_t, 2> key;
+    std::array<uint32_t, 4> ctr;
+    std::array<uint32_t, 4> block{};
+    int used = 4;
+};
+
+}
+
+#endif // UTIL_COUNTER_RNG_H
@@ -0,0 +1,122 @@
+/**
+ * @author Hunter Borlik
+ * @brief IEEE 754 binary16 conversion for half precision state storage
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ */
+#pragma once
+#ifndef UTIL_HALF_H
+#define UTIL_HALF_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+
+namespace util {
+
+// largest finite half float
+constexpr float HalfMax = 65504.0f;
+
+/**
+ * @brief convert to the nearest half float, ties to even. Values beyond HalfMax round to infinity
+ *
+ * @param value
+ * @return uint16_t half float bits
+ */
+inline uint16_t floatToHalf(float value) {
+    uint32_t f;
+    std::memcpy(&f, &value, sizeof(f));
+    const uint16_t sign = (f >> 16) & 0x8000u;
+    f &= 0x7fffffffu;
+
+    // 2^16 and up, infinity and NaN
+    if (f >= 0x47800000u)
+        return sign | (f > 0x7f800000u ? 0x7e00u : 0x7c00u);
+
+    // below the smallest normal half, 2^-14
+    if (f < 0x38800000u) {
+        // below half of the smallest subnormal
+        if (f < 0x33000000u)
+            return sign;
+        const uint32_t shift = 126 - (f >> 23);
+        const uint32_t m = (f & 0x7fffffu) | 0x800000u;
+        uint32_t h = m >> shift;
+        const uint32_t rem = m & ((1u << shift) - 1);
+        const uint32_t half_way = 1u << (shift - 1);
+        if (rem > half_way || (rem == half_way && (h & 1)))
+            h++;
+        return sign | h;
+    }
+
+    // rebias the exponent and drop 13 mantissa bits. A carry out of the mantissa moves into the
+    // exponent, up to infinity
+    uint32_t h = (f - 0x38000000u) >> 13;
+    const uint32_t rem = f & 0x1fffu;
+    if (rem > 0x1000u || (rem == 0x1000u && (h & 1)))
+        h++;
+    return sign | h;
+}
+
+inline float halfToFloat(uint16_t h) {
+    const uint32_t sign = (uint32_t)(h & 0x8000u) << 16;
+    const uint32_t e = (h >> 10) & 0x1fu;
+    const uint32_t m = h & 0x3ffu;
+
+    float value;
+    if (e == 0) {
+        // subnormal, m * 2^-24 is exact
+        value = m * 5.9604644775390625e-8f;
+        return sign ? -value : value;
+    }
+    const uint32_t f = e == 31
+        ? sign | 0x7f800000u | (m << 13)
+        : sign | ((e + 112) << 23) | (m << 13);
+    std::memcpy(&value, &f, sizeof(value));
+    return value;
+}
+
+/**
+ * @brief value as stored in a half float texture by the GPU passes, which saturate at HalfMax
+ *
+ * @param value
+ * @return float
+ */
+inline float roundToHalf(float value) {
+    return halfToFloat(floatToHalf(std::clamp(value, -HalfMax, HalfMax)));
+}
+
+/**
+ * @brief convert n floats to half floats
+ *
+ * @param src
+ * @param dst
+ * @param n
+ */
+inline void packHalf(const float* src, uint16_t* dst, std::size_t n) {
+    for (std::size_t i = 0; i < n; ++i)
+        dst[i] = floatToHalf(src[i]);
+}
+
+/**
+ * @brief expand n half floats at the start of data to n floats in the same buffer, for GPU read
+ * backs of half float textures into float planes
+ *
+ * @param data n floats, the first n * 2 bytes hold the half floats
+ * @param n
+ */
+inline void expandHalfInPlace(float* data, std::size_t n) {
+    unsigned char* bytes = reinterpret_cast<unsigned char*>(data);
+    // back to front, float i only overwrites halves i * 2 and i * 2 + 1, which are already done
+    for (std::size_t i = n; i-- > 0;) {
+        uint16_t h;
+        std::memcpy(&h, bytes + i * sizeof(uint16_t), sizeof(h));
+        const float value = halfToFloat(h);
+        std::memcpy(bytes + i * sizeof(float), &value, sizeof(value));
+    }
+}
+
+}
+
+#endif // UTIL_HALF_H
@@ -0,0 +1,112 @@
+#include <util/hash.h>
+
+#include <cstring>
+
+namespace util {
+
+namespace {
+
+constexpr uint64_t P1 = 11400714785074694791ULL;
+constexpr uint64_t P2 = 14029467366897019727ULL;
+constexpr uint64_t P3 = 1609587929392839161ULL;
+constexpr uint64_t P4 = 9650029242287828579ULL;
+constexpr uint64_t P5 = 2870177450012600261ULL;
+
+inline uint64_t rotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+// little endian loads, the hash must not depend on the host byte order
+inline uint64_t read64(const unsigned char* p) {
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; --i)
+        v = (v << 8) | p[i];
+    return v;
+}
+
+inline uint32_t read32(const unsigned char* p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+inline uint64_t round(uint64_t acc, uint64_t input) {
+    acc += input * P2;
+    acc = rotl(acc, 31);
+    return acc * P1;
+}
+
+inline uint64_t merge_round(uint64_t acc, uint64_t val) {
+    acc ^= round(0, val);
+    return acc * P1 + P4;
+}
+
+}
+
+XXHash64::XXHash64(uint64_t seed) :
+    acc{seed + P1 + P2, seed + P2, seed, seed - P1}, seed{seed} {
+}
+
+void XXHash64::update(const void* data, std::size_t size) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    total += size;
+
+    if (buffered + size < 32) {
+        std::memcpy(buffer + buffered, p, size);
+        buffered += size;
+        return;
+    }
+
+    if (buffered > 0) {
+        const std::size_t fill = 32 - buffered;
+        std::memcpy(buffer + buffered, p, fill);
+        for (int i = 0; i < 4; ++i)
+            acc[i] = round(acc[i], read64(buffer + 8 * i));
+        p += fill;
+        size -= fill;
+        buffered = 0;
+    }
+
+    for (; size >= 32; p += 32, size -= 32)
+        for (int i = 0; i < 4; ++i)
+            acc[i] = round(acc[i], read64(p + 8 * i));
+
+    std::memcpy(buffer, p, size);
+    buffered = size;
+}
+
+uint64_t XXHash64::digest() const {
+    uint64_t h;
+    if (total >= 32) {
+        h = rotl(acc[0], 1) + rotl(acc[1], 7) + rotl(acc[2], 12) + rotl(acc[3], 18);
+        for (int i = 0; i < 4; ++i)
+            h = merge_round(h, acc[i]);
+    } else {
+        h = seed + P5;
+    }
+    h += total;
+
+    const unsigned char* p = buffer;
+    std::size_t n = buffered;
+    for (; n >= 8; p += 8, n -= 8) {
+        h ^= round(0, read64(p));
+        h = rotl(h, 27) * P1 + P4;
+    }
+    if (n >= 4) {
+        h ^= (uint64_t)read32(p) * P1;
+        h = rotl(h, 23) * P2 + P3;
+        p += 4;
+        n -= 4;
+    }
+    for (; n > 0; ++p, --n) {
+        h ^= (*p) * P5;
+        h = rotl(h, 11) * P1;
+    }
+
+    h ^= h >> 33;
+    h *= P2;
+    h ^= h >> 29;
+    h *= P3;
+    h ^= h >> 32;
+    return h;
+}
+
+}
@@ -0,0 +1,45 @@
+/**
+ * @author Hunter Borlik
+ * @brief xxHash64 for fingerprinting simulation results
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ */
+#pragma once
+#ifndef UTIL_HASH_H
+#define UTIL_HASH_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace util {
+
+/**
+ * @brief streaming xxHash64 (https://github.com/Cyan4973/xxHash). Feeding the same bytes in any
+ * number of update() calls gives the same digest as one call with all of them.
+ *
+ */
+class XXHash64 {
+public:
+    explicit XXHash64(uint64_t seed = 0);
+
+    void update(const void* data, std::size_t size);
+    uint64_t digest() const;
+
+    static uint64_t hash(const void* data, std::size_t size, uint64_t seed = 0) {
+        XXHash64 h{seed};
+        h.update(data, size);
+        return h.digest();
+    }
+
+private:
+    uint64_t acc[4];
+    uint64_t seed;
+    uint64_t total = 0;
+    unsigned char buffer[32];
+    std::size_t buffered = 0;
+};
+
+}
+
+#endif // UTIL_HASH_H
@@ -48,7 +48,8 @@ public:
     bool setParam(const std::string& key, const T& value) {
         auto p = parameters.find(key);
         if (p != parameters.end()) {
-            if ((value < p->second.max && value > p->second.min) || p->second.min == p->second.max) {
+            // the ends are part of the range, toggles and "0 = off" values sit on them
+            if ((value <= p->second.max && value >= p->second.min) || p->second.min == p->second.max) {
                 p->second.value = value;
                 return true;
             }
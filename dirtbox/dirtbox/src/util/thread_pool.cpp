@@ -0,0 +1,80 @@
+#include <util/thread_pool.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+
+namespace util {
+
+struct ThreadPool::Job {
+    Job(int begin, int end, const IndexFnType& fn) :
+        fn{fn}, next{begin}, end{end}, remaining{end - begin} {}
+
+    // claim and run indices until none are left
+    void run() {
+        int i;
+        while ((i = next.fetch_add(1)) < end) {
+            fn(i);
+            if (remaining.fetch_sub(1) == 1) {
+                std::unique_lock<std::mutex> lock{mutex};
+                cond.notify_all();
+            }
+        }
+    }
+
+    void wait() {
+        std::unique_lock<std::mutex> lock{mutex};
+        cond.wait(lock, [this]() {return remaining.load() == 0;});
+    }
+
+    const IndexFnType& fn;
+    std::atomic_int next;
+    const int end;
+    std::atomic_int remaining;
+
+    std::mutex mutex;
+    std::condition_variable cond;
+};
+
+ThreadPool::ThreadPool(unsigned int num_workers) {
+    for (unsigned int i = 0; i < num_workers; ++i)
+        workers.emplace_back(&ThreadPool::worker_fn, this);
+}
+
+ThreadPool::~ThreadPool() {
+    // an empty job stops the worker that takes it
+    for (std::size_t i = 0; i < workers.size(); ++i)
+        jobs.push_back(nullptr);
+    for (auto& w : workers)
+        w.join();
+}
+
+void ThreadPool::parallel_for(int begin, int end, const IndexFnType& fn) {
+    if (end <= begin)
+        return;
+    if (workers.empty() || end - begin == 1) {
+        for (int i = begin; i < end; ++i)
+            fn(i);
+        return;
+    }
+
+    auto job = std::make_shared<Job>(begin, end, fn);
+    const int helpers = std::min<int>(workers.size(), end - begin - 1);
+    for (int i = 0; i < helpers; ++i)
+        jobs.push_back(job);
+    job->run();
+    job->wait();
+}
+
+ThreadPool& ThreadPool::Get() {
+    static ThreadPool pool{std::max(1u, std::thread::hardware_concurrency()) - 1};
+    return pool;
+}
+
+// idle workers sleep in pop_front until a job or the stop signal is pushed
+void ThreadPool::worker_fn() {
+    while (auto job = jobs.pop_front())
+        job->run();
+}
+
+}
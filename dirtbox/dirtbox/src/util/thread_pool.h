@@ -0,0 +1,151 @@
+/**
+ * @author Hunter Borlik
+ * @brief fixed size worker pool for data parallel loops
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ */
+#pragma once
+#ifndef UTIL_THREAD_POOL_H
+#define UTIL_THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <future>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <util/sharedqueue.h>
+
+namespace util {
+
+/**
+ * @brief Pool of worker threads used by the CPU simulations. parallel_for may be called from
+ * any thread, including from several threads at once; the calling thread always takes part in
+ * its own loop so nested or concurrent calls cannot starve each other.
+ *
+ */
+class ThreadPool {
+public:
+    using IndexFnType = std::function<void(int)>;
+
+    explicit ThreadPool(unsigned int num_workers);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * @brief number of threads that execute a parallel_for, including the caller
+     *
+     * @return unsigned int
+     */
+    unsigned int getNumThreads() const {return workers.size() + 1;}
+
+    /**
+     * @brief calls fn(i) once for every i in [begin, end). Indices are claimed from an atomic
+     * counter, so the order and the thread an index runs on are unspecified. Blocks until all
+     * indices are complete.
+     *
+     * @param begin
+     * @param end
+     * @param fn
+     */
+    void parallel_for(int begin, int end, const IndexFnType& fn);
+
+    /**
+     * @brief reduce [begin, end) split into fixed chunks of grain indices. Each chunk is mapped to
+     * a partial with map(chunk_begin, chunk_end), then the partials are combined in chunk order on
+     * the calling thread. The chunking does not depend on the number of threads, so floating point
+     * results are bit identical for any pool size.
+     *
+     * @tparam T partial result
+     * @param begin
+     * @param end
+     * @param grain indices per chunk, > 0
+     * @param identity initial value of the combination
+     * @param map T(int chunk_begin, int chunk_end)
+     * @param combine T(const T&, const T&)
+     * @return T
+     */
+    template<typename T, typename MapFn, typename CombineFn>
+    T parallel_reduce(int begin, int end, int grain, T identity, MapFn&& map, CombineFn&& combine) {
+        if (end <= begin)
+            return identity;
+        const int chunks = (end - begin + grain - 1) / grain;
+        std::vector<T> partials(chunks, identity);
+        parallel_for(0, chunks, [&](int c) {
+            const int b = begin + c * grain;
+            partials[c] = map(b, std::min(end, b + grain));
+        });
+        T result = identity;
+        for (const auto& p : partials)
+            result = combine(result, p);
+        return result;
+    }
+
+    /**
+     * @brief replace values[i] for i in [0, n) with the sum of the values before it, in place.
+     * Runs in three passes like the GPU scans: the chunks of grain values are summed in parallel,
+     * the chunk sums are scanned on the calling thread, then every chunk is scanned from its
+     * offset in parallel.
+     *
+     * @tparam T integer count
+     * @param values
+     * @param n
+     * @param grain values per chunk, > 0
+     * @return T sum of all values
+     */
+    template<typename T>
+    T parallel_exclusive_scan(T* values, int n, int grain) {
+        if (n <= 0)
+            return T{};
+        const int chunks = (n + grain - 1) / grain;
+        std::vector<T> offsets(chunks);
+        parallel_for(0, chunks, [&](int c) {
+            const int b = c * grain;
+            T sum{};
+            for (int i = b; i < std::min(n, b + grain); ++i)
+                sum += values[i];
+            offsets[c] = sum;
+        });
+        T total{};
+        for (T& o : offsets) {
+            const T sum = o;
+            o = total;
+            total += sum;
+        }
+        parallel_for(0, chunks, [&](int c) {
+            const int b = c * grain;
+            T sum = offsets[c];
+            for (int i = b; i < std::min(n, b + grain); ++i) {
+                const T v = values[i];
+                values[i] = sum;
+                sum += v;
+            }
+        });
+        return total;
+    }
+
+    /**
+     * @brief shared pool sized to the hardware concurrency
+     *
+     * @return ThreadPool&
+     */
+    static ThreadPool& Get();
+
+private:
+    struct Job;
+
+    void worker_fn();
+
+    // jobs for the workers, nullptr stops a worker
+    SharedQueue<std::shared_ptr<Job>> jobs;
+    std::vector<std::thread> workers;
+};
+
+}
+
+#endif // UTIL_THREAD_POOL_H
@@ -0,0 +1,79 @@
+/**
+ * @author Hunter Borlik
+ * @brief single producer, single consumer triple buffer
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ */
+#pragma once
+#ifndef UTIL_TRIPLE_BUFFER_H
+#define UTIL_TRIPLE_BUFFER_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace util {
+
+/**
+ * @brief Passes the latest value from one producer thread to one consumer thread without locks
+ * or waiting. The producer fills back() and publishes it, the consumer takes the latest published
+ * value with consume(). A value published before the consumer took the previous one replaces it,
+ * so stale values are dropped instead of queued.
+ *
+ * @tparam T
+ */
+template<typename T>
+class TripleBuffer {
+public:
+    // producer. The buffer to fill, its content is whatever it held before
+    T& back() {return buffers[back_index];}
+
+    // producer. Hand back() to the consumer and take a free buffer
+    void publish() {
+        const uint8_t prev = middle.exchange(back_index | Fresh, std::memory_order_acq_rel);
+        back_index = prev & IndexMask;
+    }
+
+    /**
+     * @brief consumer. The latest published buffer, it stays valid until the next call
+     *
+     * @return T* nullptr when nothing was published since the last call
+     */
+    T* consume() {
+        if (!(middle.load(std::memory_order_acquire) & Fresh))
+            return nullptr;
+        const uint8_t prev = middle.exchange(front_index, std::memory_order_acq_rel);
+        front_index = prev & IndexMask;
+        return &buffers[front_index];
+    }
+
+    // drop a published value. Only while neither side is active
+    void reset() {
+        back_index = 0;
+        front_index = 1;
+        middle.store(2);
+    }
+
+    /**
+     * @brief all buffers, to set them up while neither side is active, or by the producer before
+     * its first publish
+     *
+     * @return std::array<T, 3>&
+     */
+    std::array<T, 3>& all() {return buffers;}
+
+private:
+    static constexpr uint8_t IndexMask = 0x3;
+    static constexpr uint8_t Fresh = 0x4;
+
+    std::array<T, 3> buffers{};
+    uint8_t back_index = 0;
+    uint8_t front_index = 1;
+    // index of the buffer between the sides, with Fresh set while it has not been consumed
+    std::atomic<uint8_t> middle{2};
+};
+
+}
+
+#endif // UTIL_TRIPLE_BUFFER_H
@@ -0,0 +1,64 @@
+// runs a parameter sweep over a CPU erosion engine without the editor. Writes one heightmap per
+// configuration and manifest.csv / manifest.json with the parameters and the metrics of each run.
+// See terrain/erosion_sweep.h for the sweep file.
+//
+// usage: erosion_sweep sweep.json
+#include <terrain/erosion_sweep.h>
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+using namespace dirtbox::terrain;
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        std::fprintf(stderr, "usage: %s sweep.json\n", argv[0]);
+        return 1;
+    }
+
+    std::ifstream file{argv[1]};
+    if (!file) {
+        std::fprintf(stderr, "could not open %s\n", argv[1]);
+        return 1;
+    }
+    std::stringstream text;
+    text << file.rdbuf();
+
+    std::string error;
+    auto spec = SweepSpec::fromJson(text.str(), error);
+    if (!spec) {
+        std::fprintf(stderr, "%s: %s\n", argv[1], error.c_str());
+        return 1;
+    }
+
+    ErosionSweep sweep{*spec};
+    if (!sweep.prepare(error)) {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+
+    const std::size_t total = planSweep(*spec).size();
+    std::printf("%zu runs of %s\n", total, spec->engine.c_str());
+    std::size_t finished = 0;
+    auto runs = sweep.run([&](const SweepRun& run) {
+        ++finished;
+        if (run.ok)
+            std::printf("[%zu/%zu] run %d: %.2fs, eroded %.4g m3, deposited %.4g m3, drainage %.4g 1/m\n",
+                finished, total, run.index, run.metrics.runtime, run.metrics.eroded_volume,
+                run.metrics.deposited_volume, run.metrics.drainage_density);
+        else
+            std::printf("[%zu/%zu] run %d failed: %s\n", finished, total, run.index, run.error.c_str());
+        std::fflush(stdout);
+    });
+
+    if (!sweep.writeManifest(runs)) {
+        std::fprintf(stderr, "could not write the manifest to %s\n", spec->output.c_str());
+        return 1;
+    }
+    int failed = 0;
+    for (const auto& run : runs)
+        failed += run.ok ? 0 : 1;
+    std::printf("%zu runs, %d failed, results in %s\n", runs.size(), failed, spec->output.c_str());
+    return failed == 0 ? 0 : 2;
+}